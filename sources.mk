@@ -185,6 +185,7 @@ SRCS-$(CONFIG_HTTPSERVER) += \
 # Video support
 #
 SRCS += src/video/video_playback.c \
+	src/video/hls.c \
 	src/video/video_decoder.c \
 	src/video/video_overlay.c \
 	src/video/sub_ass.c \
@@ -260,6 +261,7 @@ SRCS-$(CONFIG_GLW)   += src/ui/glw/glw.c \
 			src/ui/glw/glw_view_eval.c \
 			src/ui/glw/glw_view_preproc.c \
 			src/ui/glw/glw_view_support.c \
+			src/ui/glw/glw_view_bincache.c \
 			src/ui/glw/glw_view_attrib.c \
 			src/ui/glw/glw_view_loader.c \
 			src/ui/glw/glw_dummy.c \
@@ -283,6 +285,7 @@ SRCS-$(CONFIG_GLW)   += src/ui/glw/glw.c \
 			src/ui/glw/glw_texture_loader.c \
 			src/ui/glw/glw_image.c \
 			src/ui/glw/glw_text_bitmap.c \
+			src/ui/glw/glw_text_atlas.c \
 			src/ui/glw/glw_fx_texrot.c \
 			src/ui/glw/glw_bloom.c \
 			src/ui/glw/glw_cube.c \
@@ -306,6 +309,10 @@ SRCS-$(CONFIG_GLW_FRONTEND_X11)	  += src/ui/glw/glw_x11.c \
 
 SRCS-$(CONFIG_GLW_FRONTEND_COCOA) += src/ui/glw/glw_cocoa.m
 
+SRCS-$(CONFIG_GLW_FRONTEND_HEADLESS) += src/ui/glw/glw_headless.c
+SRCS-$(CONFIG_GLW_BACKEND_NULL)      += src/ui/glw/glw_null.c \
+                                        src/ui/glw/glw_texture_null.c
+
 SRCS-$(CONFIG_GLW_BACKEND_OPENGL) += src/ui/glw/glw_opengl_common.c \
                                      src/ui/glw/glw_opengl_shaders.c \
                                      src/ui/glw/glw_opengl_ff.c \
@@ -19,6 +19,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 
 #include "networking/http_server.h"
 #include "httpcontrol.h"
@@ -353,24 +354,19 @@ static int
 hc_logfile(http_connection_t *hc, const char *remain, void *opaque,
 	   http_cmd_t method)
 {
-  htsbuf_queue_t out;
-  htsbuf_queue_init(&out, 0);
-
   if(remain == NULL)
     return 400;
   const int n = atoi(remain);
-  size_t size;
 
   char p1[500];
   snprintf(p1, sizeof(p1), "%s/log/showtime.log.%d", showtime_cache_path, n);
-  char *buf = fa_load(p1, &size, NULL, NULL, 0, NULL, 0, NULL, NULL);
+  int fd = open(p1, O_RDONLY);
   
-  if(buf == NULL)
+  if(fd == -1)
     return 404;
-  htsbuf_append_prealloc(&out, buf, size);
   snprintf(p1, sizeof(p1), "attachment; filename=\"showtime.log.%d\"", n);
   http_set_response_hdr(hc, "Content-Disposition", p1);
-  return http_send_reply(hc, 0, "text/ascii", NULL, NULL, 0, &out);
+  return http_send_file(hc, fd, "text/ascii", 0);
 }
 
 
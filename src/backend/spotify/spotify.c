@@ -4483,7 +4483,7 @@ be_spotify_init(void)
 		       _p("Spotify music service"),
 		       "spotify:settings");
 
-  spotify_courier = prop_courier_create_notify(courier_notify, NULL);
+  spotify_courier = prop_courier_create_notify(courier_notify, NULL, 0);
 
   spotify = prop_create(prop_get_global(), "spotify");
 
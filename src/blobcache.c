@@ -93,7 +93,7 @@ blobcache_put0(sqlite3 *db, const char *key, const char *stash,
     sqlite3_bind_int(stmt,  7, mtime);
 
   rc = db_step(stmt);
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
 
   if(rc == SQLITE_LOCKED)
     goto restart;
@@ -160,7 +160,7 @@ blobcache_get0(sqlite3 *db, const char *key, const char *stash,
   rc = db_step(stmt);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     db_rollback(db);
     if(rc == SQLITE_LOCKED)
       goto restart;
@@ -193,7 +193,7 @@ blobcache_get0(sqlite3 *db, const char *key, const char *stash,
     *mtimep = sqlite3_column_int(stmt, 3);
 
 
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
 
   // Update atime
 
@@ -213,7 +213,7 @@ blobcache_get0(sqlite3 *db, const char *key, const char *stash,
     sqlite3_bind_text(stmt, 2, stash, -1, SQLITE_STATIC);
     sqlite3_bind_int(stmt, 3, time(NULL));
     rc = db_step(stmt);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
   }
 
   db_commit(db);
@@ -276,7 +276,7 @@ blobcache_get_meta0(sqlite3 *db, const char *key, const char *stash,
   rc = db_step(stmt);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     if(rc == SQLITE_LOCKED)
       goto restart;
     return -1;
@@ -289,7 +289,7 @@ blobcache_get_meta0(sqlite3 *db, const char *key, const char *stash,
   if(mtimep != NULL)
     *mtimep = sqlite3_column_int(stmt, 1);
 
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   return 0;
 }
 
@@ -446,16 +446,16 @@ blobcache_prune(sqlite3 *db)
     if(rc != SQLITE_OK) {
       TRACE(TRACE_ERROR, "SQLITE", "SQL Error %d at %s:%d",
 	    rc, __FUNCTION__, __LINE__);
-      sqlite3_finalize(sel);
+      db_finalize(sel);
       db_rollback(db);
       return;
     }
     sqlite3_bind_int(del, 1, id);
     rc = db_step(del);
-    sqlite3_finalize(del);
+    db_finalize(del);
 
     if(rc != SQLITE_DONE) {
-      sqlite3_finalize(sel);
+      db_finalize(sel);
       db_rollback(db);
       return;
     }
@@ -470,7 +470,7 @@ blobcache_prune(sqlite3 *db)
 	"Pruned %d items, %"PRId64" bytes from cache",
 	pruned_items, pruned_bytes);
   estimated_cache_size = currentsize;
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   db_commit(db);
   
 }
@@ -40,7 +40,12 @@
 #include "settings.h"
 #include "notifications.h"
 
-#define BC2_MAGIC 0x62630201
+#if ENABLE_MMAP
+#include <sys/mman.h>
+#endif
+
+#define BC2_MAGIC 0x62630201  // Legacy index, read once to migrate
+#define BC3_MAGIC 0x62630301
 
 typedef struct blobcache_item {
   struct blobcache_item *bi_link;
@@ -61,16 +66,49 @@ typedef struct blobcache_diskitem {
   uint32_t di_size;
 } __attribute__((packed)) blobcache_diskitem_t;
 
-#define ITEM_HASH_SIZE 256
-#define ITEM_HASH_MASK (ITEM_HASH_SIZE - 1)
+/**
+ * Record in the append only index log. Later records for the same
+ * key supersede earlier ones. The log is compacted (rewritten with
+ * only live items) on prune and shutdown.
+ */
+typedef struct blobcache_logitem {
+  blobcache_diskitem_t li_item;
+  uint32_t li_flags;
+#define BCL_DELETE 0x1
+  uint32_t li_csum;
+} __attribute__((packed)) blobcache_logitem_t;
+
+typedef struct blobcache_loghdr {
+  uint32_t lh_magic;
+  uint32_t lh_recsize;
+} __attribute__((packed)) blobcache_loghdr_t;
+
+
+/**
+ * The index is split into shards on the top bits of the key hash,
+ * each with its own lock and a hash table (indexed by the low bits)
+ * that grows as items are added
+ */
+#define BC_SHARD_BITS 4
+#define BC_SHARDS     (1 << BC_SHARD_BITS)
+#define BC_SHARD_INITIAL_SIZE 64
 
-static blobcache_item_t *hashvector[ITEM_HASH_SIZE];
+typedef struct blobcache_shard {
+  hts_mutex_t bs_lock;
+  blobcache_item_t **bs_hash;
+  unsigned int bs_hash_size;   // Always a power of 2
+  unsigned int bs_items;
+  uint64_t bs_bytes;
+  pool_t *bs_pool;
+} blobcache_shard_t;
 
-static pool_t *item_pool;
-static hts_mutex_t cache_lock;
-static int zombie;
+static blobcache_shard_t shards[BC_SHARDS];
 
+static volatile int zombie;
 
+static hts_mutex_t index_lock;  // Protects the log, taken after shard locks
+static int index_fd = -1;
+static int index_records;       // Records in log, incl. superseded ones
 
 
 static callout_t blobcache_callout;
@@ -80,7 +118,66 @@ static void blobcache_do_prune(struct callout *c, void *opaque);
 #define BLOB_CACHE_MINSIZE  (10 * 1000 * 1000)
 #define BLOB_CACHE_MAXSIZE (500 * 1000 * 1000)
 
-static uint64_t current_cache_size;
+
+/**
+ *
+ */
+static blobcache_shard_t *
+shard_get(uint64_t dk)
+{
+  return &shards[dk >> (64 - BC_SHARD_BITS)];
+}
+
+
+/**
+ *
+ */
+static void
+shards_lock(void)
+{
+  int i;
+  for(i = 0; i < BC_SHARDS; i++)
+    hts_mutex_lock(&shards[i].bs_lock);
+}
+
+
+/**
+ *
+ */
+static void
+shards_unlock(void)
+{
+  int i;
+  for(i = BC_SHARDS - 1; i >= 0; i--)
+    hts_mutex_unlock(&shards[i].bs_lock);
+}
+
+
+/**
+ * Not locked, the result is only used as an estimate
+ */
+static uint64_t
+cache_size(void)
+{
+  uint64_t sum = 0;
+  int i;
+  for(i = 0; i < BC_SHARDS; i++)
+    sum += shards[i].bs_bytes;
+  return sum;
+}
+
+
+/**
+ *
+ */
+static int
+cache_items(void)
+{
+  int i, sum = 0;
+  for(i = 0; i < BC_SHARDS; i++)
+    sum += shards[i].bs_items;
+  return sum;
+}
 
 
 /**
@@ -89,12 +186,88 @@ static uint64_t current_cache_size;
 static uint64_t 
 blobcache_compute_maxsize(void)
 {
-  uint64_t avail = arch_cache_avail_bytes() + current_cache_size;
+  uint64_t current = cache_size();
+  uint64_t avail = arch_cache_avail_bytes() + current;
   avail = MAX(BLOB_CACHE_MINSIZE, MIN(avail / 10, BLOB_CACHE_MAXSIZE));
   return avail;
 }
 
 
+/**
+ * Return pointer to the link pointing to the item (or to the
+ * terminating NULL if not found). Shard must be locked
+ */
+static blobcache_item_t **
+shard_lookup(blobcache_shard_t *bs, uint64_t dk)
+{
+  blobcache_item_t *p, **q;
+
+  for(q = &bs->bs_hash[dk & (bs->bs_hash_size - 1)]; (p = *q) != NULL;
+      q = &p->bi_link)
+    if(p->bi_key_hash == dk)
+      break;
+  return q;
+}
+
+
+/**
+ *
+ */
+static void
+shard_resize(blobcache_shard_t *bs, unsigned int size)
+{
+  blobcache_item_t **nh = calloc(size, sizeof(blobcache_item_t *));
+  blobcache_item_t *p, *n;
+  int i;
+
+  if(nh == NULL)
+    return;
+
+  for(i = 0; i < bs->bs_hash_size; i++) {
+    for(p = bs->bs_hash[i]; p != NULL; p = n) {
+      n = p->bi_link;
+      p->bi_link = nh[p->bi_key_hash & (size - 1)];
+      nh[p->bi_key_hash & (size - 1)] = p;
+    }
+  }
+  free(bs->bs_hash);
+  bs->bs_hash = nh;
+  bs->bs_hash_size = size;
+}
+
+
+/**
+ *
+ */
+static void
+shard_link(blobcache_shard_t *bs, blobcache_item_t *p)
+{
+  blobcache_item_t **b;
+
+  if(bs->bs_items >= bs->bs_hash_size * 2)
+    shard_resize(bs, bs->bs_hash_size * 2);
+
+  b = &bs->bs_hash[p->bi_key_hash & (bs->bs_hash_size - 1)];
+  p->bi_link = *b;
+  *b = p;
+  bs->bs_items++;
+  bs->bs_bytes += p->bi_size;
+}
+
+
+/**
+ *
+ */
+static void
+shard_unlink(blobcache_shard_t *bs, blobcache_item_t **q)
+{
+  blobcache_item_t *p = *q;
+  *q = p->bi_link;
+  bs->bs_items--;
+  bs->bs_bytes -= p->bi_size;
+}
+
+
 /**
  *
  */
@@ -147,59 +320,214 @@ make_filename(char *buf, size_t len, uint64_t hash, int for_write)
 }
 
 
+/**
+ *
+ */
+static uint32_t
+logitem_csum(const blobcache_logitem_t *li)
+{
+  const uint8_t *d = (const uint8_t *)li;
+  uint32_t h = 2166136261U;
+  int i;
+  for(i = 0; i < offsetof(blobcache_logitem_t, li_csum); i++)
+    h = (h ^ d[i]) * 16777619;
+  return h;
+}
+
+
 /**
  *
  */
 static void
-save_index(void)
+logitem_fill(blobcache_logitem_t *li, const blobcache_item_t *p, int flags)
+{
+  li->li_item.di_key_hash     = p->bi_key_hash;
+  li->li_item.di_content_hash = p->bi_content_hash;
+  li->li_item.di_lastaccess   = p->bi_lastaccess;
+  li->li_item.di_expiry       = p->bi_expiry;
+  li->li_item.di_modtime      = p->bi_modtime;
+  li->li_item.di_size         = p->bi_size;
+  li->li_flags = flags;
+  li->li_csum = logitem_csum(li);
+}
+
+
+/**
+ * Append a record for the item to the index log
+ *
+ * Called with the item's shard locked
+ */
+static void
+index_append(const blobcache_item_t *p, int flags)
+{
+  blobcache_logitem_t li;
+
+  logitem_fill(&li, p, flags);
+
+  hts_mutex_lock(&index_lock);
+  if(index_fd != -1) {
+    if(write(index_fd, &li, sizeof(li)) == sizeof(li))
+      index_records++;
+  }
+  hts_mutex_unlock(&index_lock);
+}
+
+
+/**
+ * Rewrite the index log with only live items
+ *
+ * Called with all shards locked
+ */
+static void
+index_compact(void)
 {
   char filename[PATH_MAX];
-  uint8_t *out;
-  int i, j;
+  char tmpname[PATH_MAX];
+  blobcache_loghdr_t lh;
+  blobcache_logitem_t *out;
   blobcache_item_t *p;
-  blobcache_diskitem_t *di;
+  int i, j, n = 0, fd;
   size_t siz;
-  snprintf(filename, sizeof(filename), "%s/bc2/index.dat", showtime_cache_path);
-  
-  int fd = open(filename, O_CREAT | O_WRONLY | O_TRUNC, 0666);
-  if(fd == -1)
+
+  snprintf(filename, sizeof(filename), "%s/bc2/index.dat",
+	   showtime_cache_path);
+  snprintf(tmpname, sizeof(tmpname), "%s/bc2/index.tmp",
+	   showtime_cache_path);
+
+  siz = cache_items() * sizeof(blobcache_logitem_t);
+  out = mymalloc(siz ?: 1);
+  if(out == NULL)
     return;
 
-  int tot = pool_num(item_pool);
-  siz = 4 + tot * sizeof(blobcache_diskitem_t) + 20;
-  out = mymalloc(siz);
-  if(out == NULL) {
+  for(i = 0; i < BC_SHARDS; i++)
+    for(j = 0; j < shards[i].bs_hash_size; j++)
+      for(p = shards[i].bs_hash[j]; p != NULL; p = p->bi_link)
+	logitem_fill(&out[n++], p, 0);
+
+  lh.lh_magic = BC3_MAGIC;
+  lh.lh_recsize = sizeof(blobcache_logitem_t);
+
+  fd = open(tmpname, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+  if(fd == -1) {
+    free(out);
+    return;
+  }
+
+  if(write(fd, &lh, sizeof(lh)) != sizeof(lh) ||
+     write(fd, out, siz) != siz) {
+    TRACE(TRACE_INFO, "blobcache", "Unable to store index file %s -- %s",
+	  tmpname, strerror(errno));
     close(fd);
+    unlink(tmpname);
+    free(out);
     return;
   }
-  *(uint32_t *)out = BC2_MAGIC;
-  j = 0;
-  for(i = 0; i < ITEM_HASH_SIZE; i++) {
-    for(p = hashvector[i]; p != NULL; p = p->bi_link) {
-      assert(j < tot);
-      di = &((blobcache_diskitem_t *)(out + 4))[j++];
-      di->di_key_hash     = p->bi_key_hash;
-      di->di_content_hash = p->bi_content_hash;
-      di->di_lastaccess   = p->bi_lastaccess;
-      di->di_expiry       = p->bi_expiry;
-      di->di_modtime      = p->bi_modtime;
-      di->di_size         = p->bi_size;
+  free(out);
+  close(fd);
+
+  hts_mutex_lock(&index_lock);
+  if(index_fd != -1)
+    close(index_fd);
+
+  if(rename(tmpname, filename)) {
+    TRACE(TRACE_INFO, "blobcache", "Unable to rename %s -- %s",
+	  tmpname, strerror(errno));
+    index_fd = -1;
+  } else {
+    index_fd = open(filename, O_WRONLY | O_APPEND, 0);
+  }
+  index_records = n;
+  hts_mutex_unlock(&index_lock);
+}
+
+
+/**
+ * Insert or update item from a record read from disk
+ */
+static void
+index_apply(const blobcache_diskitem_t *di, int flags)
+{
+  blobcache_shard_t *bs = shard_get(di->di_key_hash);
+  blobcache_item_t **q = shard_lookup(bs, di->di_key_hash);
+  blobcache_item_t *p = *q;
+
+  if(p != NULL) {
+    shard_unlink(bs, q);
+    if(flags & BCL_DELETE) {
+      pool_put(bs->bs_pool, p);
+      return;
     }
+  } else {
+    if(flags & BCL_DELETE)
+      return;
+    p = pool_get(bs->bs_pool);
   }
 
+  p->bi_key_hash     = di->di_key_hash;
+  p->bi_content_hash = di->di_content_hash;
+  p->bi_lastaccess   = di->di_lastaccess;
+  p->bi_expiry       = di->di_expiry;
+  p->bi_modtime      = di->di_modtime;
+  p->bi_size         = di->di_size;
+  shard_link(bs, p);
+}
+
+
+/**
+ * Read legacy index, all or nothing since it's protected by a digest
+ */
+static void
+load_index_v2(const uint8_t *in, size_t size)
+{
+  uint8_t digest[20];
+  int i, items;
+
+  if(size < 24 || ((size - 24) % sizeof(blobcache_diskitem_t)) != 0)
+    return;
+
+  items = (size - 24) / sizeof(blobcache_diskitem_t);
+
   sha1_decl(shactx);
   sha1_init(shactx);
-  sha1_update(shactx, out, 4 + tot * sizeof(blobcache_diskitem_t));
-  sha1_final(shactx, out + 4 + tot * sizeof(blobcache_diskitem_t));
+  sha1_update(shactx, in, size - 20);
+  sha1_final(shactx, digest);
 
-  if(write(fd, out, siz) != siz)
-    TRACE(TRACE_INFO, "blobcache", "Unable to store index file %s -- %s",
-	  filename, strerror(errno));
-  free(out);
-  close(fd);
+  if(memcmp(digest, in + size - 20, 20))
+    return;
+
+  for(i = 0; i < items; i++)
+    index_apply(&((const blobcache_diskitem_t *)(in + 4))[i], 0);
 }
 
 
+/**
+ * Replay the index log. Stops at the first damaged record (ie, a
+ * write that was torn by a crash)
+ */
+static void
+load_index_v3(const uint8_t *in, size_t size)
+{
+  const blobcache_loghdr_t *lh = (const blobcache_loghdr_t *)in;
+  const blobcache_logitem_t *li;
+  size_t off = sizeof(blobcache_loghdr_t);
+
+  if(size < sizeof(blobcache_loghdr_t) ||
+     lh->lh_recsize != sizeof(blobcache_logitem_t))
+    return;
+
+  for(; off + sizeof(blobcache_logitem_t) <= size;
+      off += sizeof(blobcache_logitem_t)) {
+    li = (const blobcache_logitem_t *)(in + off);
+    if(li->li_csum != logitem_csum(li)) {
+      TRACE(TRACE_INFO, "blobcache", 
+	    "Index damaged at offset %zd, ignoring rest", off);
+      break;
+    }
+    index_apply(&li->li_item, li->li_flags);
+    index_records++;
+  }
+}
+
 
 /**
  *
@@ -209,11 +537,7 @@ load_index(void)
 {
   char filename[PATH_MAX];
   uint8_t *in;
-  int i;
-  blobcache_item_t *p;
-  blobcache_diskitem_t *di;
   struct stat st;
-  uint8_t digest[20];
 
   snprintf(filename, sizeof(filename), "%s/bc2/index.dat", showtime_cache_path);
   
@@ -221,14 +545,17 @@ load_index(void)
   if(fd == -1)
     return;
 
-  if(fstat(fd, &st) || st.st_size < 24 ||
-     ((st.st_size - 24) % sizeof(blobcache_diskitem_t)) != 0) {
+  if(fstat(fd, &st) || st.st_size < 4) {
     close(fd);
     return;
   }
 
-  int items = (st.st_size - 24) / sizeof(blobcache_diskitem_t);
-
+#if ENABLE_MMAP
+  in = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(in == MAP_FAILED)
+    return;
+#else
   in = mymalloc(st.st_size);
   if(in == NULL) {
     close(fd);
@@ -241,39 +568,22 @@ load_index(void)
     free(in);
     return;
   }
-
-
-  if(*(uint32_t *)in != BC2_MAGIC) {
-    free(in);
-    return;
+#endif
+
+  switch(*(uint32_t *)in) {
+  case BC2_MAGIC:
+    load_index_v2(in, st.st_size);
+    break;
+  case BC3_MAGIC:
+    load_index_v3(in, st.st_size);
+    break;
   }
-       
 
-  sha1_decl(shactx);
-  sha1_init(shactx);
-  sha1_update(shactx, in, st.st_size - 20);
-  sha1_final(shactx, digest);
-
-  if(memcmp(digest, in + st.st_size - 20, 20)) {
-    free(in);
-    return;
-  }
-
-  for(i = 0; i < items; i++) {
-    di = &((blobcache_diskitem_t *)(in + 4))[i];
-    p = pool_get(item_pool);
-
-    p->bi_key_hash     = di->di_key_hash;
-    p->bi_content_hash = di->di_content_hash;
-    p->bi_lastaccess   = di->di_lastaccess;
-    p->bi_expiry       = di->di_expiry;
-    p->bi_modtime      = di->di_modtime;
-    p->bi_size         = di->di_size;
-    p->bi_link = hashvector[p->bi_key_hash & ITEM_HASH_MASK];
-    hashvector[p->bi_key_hash & ITEM_HASH_MASK] = p;
-    current_cache_size += p->bi_size;
-  }
+#if ENABLE_MMAP
+  munmap(in, st.st_size);
+#else
   free(in);
+#endif
 }
 
 
@@ -290,46 +600,46 @@ blobcache_put(const char *key, const char *stash,
   uint64_t dc = digest_content(data, size);
   uint32_t now = time(NULL);
   char filename[PATH_MAX];
-  blobcache_item_t *p;
+  blobcache_shard_t *bs = shard_get(dk);
+  blobcache_item_t *p, **q;
 
-  hts_mutex_lock(&cache_lock);
+  hts_mutex_lock(&bs->bs_lock);
   if(zombie) {
-    hts_mutex_unlock(&cache_lock);
+    hts_mutex_unlock(&bs->bs_lock);
     return 0;
   }
 
-  for(p = hashvector[dk & ITEM_HASH_MASK]; p != NULL; p = p->bi_link)
-    if(p->bi_key_hash == dk)
-      break;
+  q = shard_lookup(bs, dk);
+  p = *q;
 
   if(p != NULL && p->bi_content_hash == dc && p->bi_size == size) {
     p->bi_modtime = mtime;
     p->bi_expiry = now + maxage;
     p->bi_lastaccess = now;
-    hts_mutex_unlock(&cache_lock);
+    index_append(p, 0);
+    hts_mutex_unlock(&bs->bs_lock);
     return 1;
   }
 
   make_filename(filename, sizeof(filename), dk, 1);
   int fd = open(filename, O_CREAT | O_WRONLY | O_TRUNC, 0666);
   if(fd == -1) {
-    hts_mutex_unlock(&cache_lock);
+    hts_mutex_unlock(&bs->bs_lock);
     return 0;
   }
 
   if(write(fd, data, size) != size) {
     unlink(filename);
-    hts_mutex_unlock(&cache_lock);
+    hts_mutex_unlock(&bs->bs_lock);
     return 0;
   }
   close(fd);
 
   if(p == NULL) {
-    p = pool_get(item_pool);
+    p = pool_get(bs->bs_pool);
     p->bi_key_hash = dk;
-    p->bi_size = 0;
-    p->bi_link = hashvector[dk & ITEM_HASH_MASK];
-    hashvector[dk & ITEM_HASH_MASK] = p;
+  } else {
+    shard_unlink(bs, q);
   }
 
   int64_t expiry = (int64_t)maxage + now;
@@ -338,15 +648,16 @@ blobcache_put(const char *key, const char *stash,
   p->bi_expiry = MIN(INT32_MAX, expiry);
   p->bi_lastaccess = now;
   p->bi_content_hash = dc;
-  current_cache_size -= p->bi_size;
   p->bi_size = size;
-  current_cache_size += p->bi_size;
+  shard_link(bs, p);
+  index_append(p, 0);
 
-  if(blobcache_compute_maxsize() < current_cache_size &&
+  if((blobcache_compute_maxsize() < cache_size() ||
+      index_records > cache_items() * 2 + 1024) &&
      !callout_isarmed(&blobcache_callout))
-    callout_arm(&blobcache_callout, blobcache_do_prune, NULL, 5);
+    callout_arm_worker(&blobcache_callout, blobcache_do_prune, NULL, 5);
 
-  hts_mutex_unlock(&cache_lock);
+  hts_mutex_unlock(&bs->bs_lock);
   return 0;
 }
 
@@ -359,23 +670,23 @@ blobcache_get(const char *key, const char *stash, size_t *sizep, int pad,
 	      int *ignore_expiry, char **etagp, time_t *mtimep)
 {
   uint64_t dk = digest_key(key, stash);
+  blobcache_shard_t *bs = shard_get(dk);
   blobcache_item_t *p, **q;
   char filename[PATH_MAX];
   struct stat st;
   uint32_t now;
 
-  hts_mutex_lock(&cache_lock);
+  hts_mutex_lock(&bs->bs_lock);
 
   if(zombie) {
     p = NULL;
   } else {
-    for(q = &hashvector[dk & ITEM_HASH_MASK]; (p = *q); q = &p->bi_link)
-      if(p->bi_key_hash == dk)
-	break;
+    q = shard_lookup(bs, dk);
+    p = *q;
   }
 
   if(p == NULL) {
-    hts_mutex_unlock(&cache_lock);
+    hts_mutex_unlock(&bs->bs_lock);
     return NULL;
   }
   
@@ -383,25 +694,27 @@ blobcache_get(const char *key, const char *stash, size_t *sizep, int pad,
 
   int expired = now > p->bi_expiry;
 
-  if(expired && ignore_expiry == NULL) {
-    hts_mutex_unlock(&cache_lock);
+  if(expired && ignore_expiry == NULL)
     goto bad;
-  }
 
   make_filename(filename, sizeof(filename), p->bi_key_hash, 0);
   int fd = open(filename, O_RDONLY, 0);
   if(fd == -1) {
   bad:
-    *q = p->bi_link;
-    pool_put(item_pool, p);
-    hts_mutex_unlock(&cache_lock);
+    shard_unlink(bs, q);
+    index_append(p, BCL_DELETE);
+    pool_put(bs->bs_pool, p);
+    hts_mutex_unlock(&bs->bs_lock);
     return NULL;
   }
   
-  if(fstat(fd, &st))
+  if(fstat(fd, &st)) {
+    close(fd);
     goto bad;
+  }
 
   if(st.st_size != p->bi_size) {
+    close(fd);
     unlink(filename);
     goto bad;
   }
@@ -411,7 +724,7 @@ blobcache_get(const char *key, const char *stash, size_t *sizep, int pad,
 
   p->bi_lastaccess = now;
 
-  hts_mutex_unlock(&cache_lock);
+  hts_mutex_unlock(&bs->bs_lock);
 
   if(ignore_expiry != NULL)
     *ignore_expiry = expired;
@@ -446,15 +759,15 @@ blobcache_get_meta(const char *key, const char *stash,
 		   char **etagp, time_t *mtimep)
 {
   uint64_t dk = digest_key(key, stash);
+  blobcache_shard_t *bs = shard_get(dk);
   blobcache_item_t *p;
   int r;
-  hts_mutex_lock(&cache_lock);
+
+  hts_mutex_lock(&bs->bs_lock);
   if(zombie) {
     p = NULL;
   } else {
-    for(p = hashvector[dk & ITEM_HASH_MASK]; p != NULL; p = p->bi_link)
-      if(p->bi_key_hash == dk)
-	break;
+    p = *shard_lookup(bs, dk);
   }
 
   if(p != NULL) {
@@ -467,22 +780,23 @@ blobcache_get_meta(const char *key, const char *stash,
     r = -1;
   }
 
-  hts_mutex_unlock(&cache_lock);
+  hts_mutex_unlock(&bs->bs_lock);
   return r;
 }
 
 
 /**
- * Assume we're locked
+ *
  */
-static blobcache_item_t *
-lookup_item(uint64_t dk)
+static int
+item_exists(uint64_t dk)
 {
-  blobcache_item_t *p;
-  for(p = hashvector[dk & ITEM_HASH_MASK]; p != NULL; p = p->bi_link)
-    if(p->bi_key_hash == dk)
-      return p;
-  return NULL;
+  blobcache_shard_t *bs = shard_get(dk);
+  int r;
+  hts_mutex_lock(&bs->bs_lock);
+  r = *shard_lookup(bs, dk) != NULL;
+  hts_mutex_unlock(&bs->bs_lock);
+  return r;
 }
 
 /**
@@ -517,7 +831,7 @@ prune_stale(void)
 		     de2->d_name);
 
 	    if(sscanf(de2->d_name, "%016"PRIx64, &k) != 1 ||
-	       lookup_item(k) == NULL) {
+	       !item_exists(k)) {
 	      TRACE(TRACE_DEBUG, "Blobcache", "Removed stale file %s", path3);
 	      unlink(path3);
 	    }
@@ -538,12 +852,12 @@ prune_stale(void)
  *
  */
 static void
-prune_item(blobcache_item_t *p)
+prune_item(blobcache_shard_t *bs, blobcache_item_t *p)
 {
   char filename[PATH_MAX];
   make_filename(filename, sizeof(filename), p->bi_key_hash, 0);
   unlink(filename);
-  pool_put(item_pool, p);
+  pool_put(bs->bs_pool, p);
 }
 
 
@@ -565,47 +879,43 @@ accesstimecmp(const void *A, const void *B)
 static void
 prune_to_size(void)
 {
-  int i, tot, j = 0;
+  int i, j, tot, n = 0;
   blobcache_item_t *p, **sv;
+  blobcache_shard_t *bs;
+  uint64_t current;
 
-  hts_mutex_lock(&cache_lock);
+  shards_lock();
   if(zombie)
     goto out;
 
   uint64_t maxsize = blobcache_compute_maxsize();
-  tot = pool_num(item_pool);
-
-  sv = malloc(sizeof(blobcache_item_t *) * tot);
-  current_cache_size = 0;
-  for(i = 0; i < ITEM_HASH_SIZE; i++) {
-    for(p = hashvector[i]; p != NULL; p = p->bi_link) {
-      sv[j++] = p;
-      current_cache_size += p->bi_size;
+  tot = cache_items();
+  current = cache_size();
+
+  if(current >= maxsize) {
+    sv = malloc(sizeof(blobcache_item_t *) * tot);
+    for(i = 0; i < BC_SHARDS; i++)
+      for(j = 0; j < shards[i].bs_hash_size; j++)
+	for(p = shards[i].bs_hash[j]; p != NULL; p = p->bi_link)
+	  sv[n++] = p;
+
+    assert(n == tot);
+
+    qsort(sv, n, sizeof(blobcache_item_t *), accesstimecmp);
+    for(i = 0; i < n; i++) {
+      p = sv[i];
+      if(current < maxsize)
+	break;
+      current -= p->bi_size;
+      bs = shard_get(p->bi_key_hash);
+      shard_unlink(bs, shard_lookup(bs, p->bi_key_hash));
+      prune_item(bs, p);
     }
-    hashvector[i] = NULL;
+    free(sv);
   }
-
-  assert(j == tot);
-
-  qsort(sv, j, sizeof(blobcache_item_t *), accesstimecmp);
-  for(i = 0; i < j; i++) {
-    p = sv[i];
-    if(current_cache_size < maxsize)
-      break;
-    current_cache_size -= p->bi_size;
-    prune_item(p);
-  }
-
-  for(; i < j; i++) {
-    p = sv[i];
-    p->bi_link = hashvector[p->bi_key_hash & ITEM_HASH_MASK];
-    hashvector[p->bi_key_hash & ITEM_HASH_MASK] = p;
-  }
-
-  free(sv);
-  save_index();
+  index_compact();
  out:
-  hts_mutex_unlock(&cache_lock);
+  shards_unlock();
 }
 
 
@@ -661,21 +971,26 @@ blobcache_prune_old(void)
 static void
 cache_clear(void *opaque, prop_event_t event, ...)
 {
-  int i;
+  int i, j;
   blobcache_item_t *p, *n;
+  blobcache_shard_t *bs;
 
-  hts_mutex_lock(&cache_lock);
+  shards_lock();
 
-  for(i = 0; i < ITEM_HASH_SIZE; i++) {
-    for(p = hashvector[i]; p != NULL; p = n) {
-      n = p->bi_link;
-      prune_item(p);
+  for(i = 0; i < BC_SHARDS; i++) {
+    bs = &shards[i];
+    for(j = 0; j < bs->bs_hash_size; j++) {
+      for(p = bs->bs_hash[j]; p != NULL; p = n) {
+	n = p->bi_link;
+	prune_item(bs, p);
+      }
+      bs->bs_hash[j] = NULL;
     }
-    hashvector[i] = NULL;
+    bs->bs_items = 0;
+    bs->bs_bytes = 0;
   }
-  current_cache_size = 0;
-  save_index();
-  hts_mutex_unlock(&cache_lock);
+  index_compact();
+  shards_unlock();
   notify_add(NULL, NOTIFY_INFO, NULL, 3, _("Cache cleared"));
 }
 
@@ -686,6 +1001,7 @@ void
 blobcache_init(void)
 {
   char buf[256];
+  int i;
 
   blobcache_prune_old();
   snprintf(buf, sizeof(buf), "%s/bc2", showtime_cache_path);
@@ -693,15 +1009,24 @@ blobcache_init(void)
     TRACE(TRACE_ERROR, "blobcache", "Unable to create cache dir %s -- %s",
 	  buf, strerror(errno));
 
-  hts_mutex_init(&cache_lock);
-  item_pool = pool_create("blobcacheitems", sizeof(blobcache_item_t), 0);
+  hts_mutex_init(&index_lock);
+
+  for(i = 0; i < BC_SHARDS; i++) {
+    blobcache_shard_t *bs = &shards[i];
+    hts_mutex_init(&bs->bs_lock);
+    bs->bs_pool = pool_create("blobcacheitems", sizeof(blobcache_item_t), 0);
+    bs->bs_hash_size = BC_SHARD_INITIAL_SIZE;
+    bs->bs_hash = calloc(bs->bs_hash_size, sizeof(blobcache_item_t *));
+  }
 
   load_index();
+  i = index_records;
   prune_stale();
   prune_to_size();
   TRACE(TRACE_INFO, "blobcache",
-	"Initialized: %d items consuming %"PRId64" bytes on disk in %s",
-	pool_num(item_pool), current_cache_size, buf);
+	"Initialized: %d items consuming %"PRId64" bytes on disk in %s "
+	"(%d index records replayed)",
+	cache_items(), cache_size(), buf, i);
 
   settings_create_action(settings_general, _p("Clear cached files"),
 			 cache_clear, NULL, NULL);
@@ -711,10 +1036,10 @@ blobcache_init(void)
 void
 blobcache_fini(void)
 {
-  hts_mutex_lock(&cache_lock);
+  shards_lock();
   zombie = 1;
-  save_index();
-  hts_mutex_unlock(&cache_lock);
+  index_compact();
+  shards_unlock();
 }
 
 /**
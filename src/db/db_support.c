@@ -22,10 +22,43 @@
 
 #include "showtime.h"
 #include "fileaccess/fileaccess.h"
+#include "prop/prop.h"
 
 #include "db_support.h"
 
 
+#define DB_BUSY_SLEEP_MS    5
+#define DB_BUSY_MAX_RETRIES 400
+
+static hts_mutex_t db_lock_mutex;
+static int db_lock_waits;
+static int64_t db_lock_wait_time;
+static prop_t *db_prop_lock_waits;
+static prop_t *db_prop_lock_wait_time;
+
+
+/**
+ * Account time spent waiting for a database lock
+ */
+static void
+db_lock_wait_account(int64_t us, const char *how)
+{
+  int waits, ms;
+
+  hts_mutex_lock(&db_lock_mutex);
+  waits = ++db_lock_waits;
+  db_lock_wait_time += us;
+  ms = db_lock_wait_time / 1000;
+  hts_mutex_unlock(&db_lock_mutex);
+
+  if(us > 100000)
+    TRACE(TRACE_DEBUG, "DB", "Waited %d ms for %s", (int)(us / 1000), how);
+
+  prop_set_int(db_prop_lock_waits, waits);
+  prop_set_int(db_prop_lock_wait_time, ms);
+}
+
+
 typedef struct unlock_notify {
   int fired;
   hts_cond_t cond;
@@ -49,6 +82,7 @@ wait_for_unlock_notify(sqlite3 *db)
 {
   int rc;
   unlock_notify_t un;
+  int64_t ts;
 
   /* Initialize the UnlockNotification structure. */
   un.fired = 0;
@@ -59,10 +93,12 @@ wait_for_unlock_notify(sqlite3 *db)
   rc = sqlite3_unlock_notify(db, unlock_notify_cb, (void *)&un);
 
   if(rc==SQLITE_OK ) {
+    ts = showtime_get_ts();
     hts_mutex_lock(&un.mutex);
     while(!un.fired)
       hts_cond_wait(&un.cond, &un.mutex);
     hts_mutex_unlock(&un.mutex);
+    db_lock_wait_account(showtime_get_ts() - ts, "unlock notify");
   }
 
   hts_cond_destroy(&un.cond);
@@ -84,9 +120,9 @@ db_step(sqlite3_stmt *pStmt)
   return rc;
 }
 
-int
-db_prepare(sqlite3 *db, const char *zSql, int nSql,
-	   sqlite3_stmt **ppStmt, const char **pz)
+static int
+db_prepare0(sqlite3 *db, const char *zSql, int nSql,
+	    sqlite3_stmt **ppStmt, const char **pz)
 {
   int rc;
   while( SQLITE_LOCKED==(rc = sqlite3_prepare_v2(db, zSql, nSql, ppStmt, pz)) ){
@@ -96,6 +132,341 @@ db_prepare(sqlite3 *db, const char *zSql, int nSql,
   return rc;
 }
 
+
+/**
+ * Per connection state and prepared statement cache
+ *
+ * Each connection has its own cache, keyed on SQL text. Connections
+ * are opened with SQLITE_OPEN_NOMUTEX so a cache is only ever touched
+ * (and its statements only finalized) from the thread currently
+ * holding the connection. A statement handed out by db_prepare() is
+ * owned by the caller until db_finalize() puts it back (reset and
+ * with all bindings cleared). Idle statements are kept on an LRU and
+ * the oldest ones are finalized once the cache grows past
+ * DB_STMT_CACHE_SIZE.
+ */
+#define DB_STMT_HASH_SIZE  31
+#define DB_STMT_CACHE_SIZE 64
+
+LIST_HEAD(db_stmt_list, db_stmt);
+TAILQ_HEAD(db_stmt_queue, db_stmt);
+LIST_HEAD(db_conn_list, db_conn);
+
+typedef struct db_conn {
+  LIST_ENTRY(db_conn) dc_link;
+  sqlite3 *dc_db;
+  struct db_stmt_list dc_hash[DB_STMT_HASH_SIZE];
+  struct db_stmt_queue dc_lru;
+  int dc_entries;
+
+  int64_t dc_busy_start;  /* First retry of current busy wait, 0 if none */
+  int64_t dc_busy_end;    /* When the last retry was made */
+} db_conn_t;
+
+typedef struct db_stmt {
+  LIST_ENTRY(db_stmt) ds_hash_link;
+  TAILQ_ENTRY(db_stmt) ds_lru_link;  /* Only linked when idle */
+  sqlite3_stmt *ds_stmt;
+  char *ds_sql;
+  unsigned int ds_hash;
+  char ds_inuse;
+  char ds_stale;   /* Invalidated while in use, finalize on release */
+} db_stmt_t;
+
+static hts_mutex_t db_stmt_mutex;  /* Protects the list of connections */
+static struct db_conn_list db_conns;
+
+static int db_stmt_hits;
+static int db_stmt_misses;
+static prop_t *db_stmt_prop_hits;
+static prop_t *db_stmt_prop_misses;
+
+
+/**
+ *
+ */
+static unsigned int
+db_stmt_hashfn(const char *sql)
+{
+  unsigned int h = 5381;
+  while(*sql)
+    h = h * 33 + (unsigned char)*sql++;
+  return h;
+}
+
+
+/**
+ * Find cache for connection, optionally creating it
+ */
+static db_conn_t *
+db_conn_find(sqlite3 *db, int create)
+{
+  db_conn_t *dc;
+  int i;
+
+  hts_mutex_lock(&db_stmt_mutex);
+  LIST_FOREACH(dc, &db_conns, dc_link)
+    if(dc->dc_db == db)
+      break;
+
+  if(dc == NULL && create) {
+    dc = calloc(1, sizeof(db_conn_t));
+    dc->dc_db = db;
+    for(i = 0; i < DB_STMT_HASH_SIZE; i++)
+      LIST_INIT(&dc->dc_hash[i]);
+    TAILQ_INIT(&dc->dc_lru);
+    LIST_INSERT_HEAD(&db_conns, dc, dc_link);
+  }
+  hts_mutex_unlock(&db_stmt_mutex);
+  return dc;
+}
+
+
+/**
+ *
+ */
+static void
+db_stmt_destroy(db_conn_t *dc, db_stmt_t *ds)
+{
+  LIST_REMOVE(ds, ds_hash_link);
+  if(!ds->ds_inuse)
+    TAILQ_REMOVE(&dc->dc_lru, ds, ds_lru_link);
+  sqlite3_finalize(ds->ds_stmt);
+  free(ds->ds_sql);
+  free(ds);
+  dc->dc_entries--;
+}
+
+
+/**
+ *
+ */
+static void
+db_stmt_update_stats(int hit)
+{
+  int hits, misses;
+
+  hts_mutex_lock(&db_stmt_mutex);
+  if(hit)
+    db_stmt_hits++;
+  else
+    db_stmt_misses++;
+  hits = db_stmt_hits;
+  misses = db_stmt_misses;
+  hts_mutex_unlock(&db_stmt_mutex);
+
+  if(((hits + misses) & 63) == 0) {
+    prop_set_int(db_stmt_prop_hits, hits);
+    prop_set_int(db_stmt_prop_misses, misses);
+  }
+}
+
+
+/**
+ *
+ */
+int
+db_prepare(sqlite3 *db, const char *zSql, int nSql,
+	   sqlite3_stmt **ppStmt, const char **pz)
+{
+  db_conn_t *dc;
+  db_stmt_t *ds;
+  unsigned int h;
+  int rc;
+
+  if(nSql != -1 || pz != NULL)
+    return db_prepare0(db, zSql, nSql, ppStmt, pz);
+
+  dc = db_conn_find(db, 1);
+  h = db_stmt_hashfn(zSql);
+
+  LIST_FOREACH(ds, &dc->dc_hash[h % DB_STMT_HASH_SIZE], ds_hash_link)
+    if(ds->ds_hash == h && !ds->ds_inuse && !ds->ds_stale &&
+       !strcmp(ds->ds_sql, zSql))
+      break;
+
+  if(ds != NULL) {
+    TAILQ_REMOVE(&dc->dc_lru, ds, ds_lru_link);
+    ds->ds_inuse = 1;
+    *ppStmt = ds->ds_stmt;
+    db_stmt_update_stats(1);
+    return SQLITE_OK;
+  }
+
+  db_stmt_update_stats(0);
+
+  rc = db_prepare0(db, zSql, -1, ppStmt, NULL);
+  if(rc != SQLITE_OK)
+    return rc;
+
+  ds = malloc(sizeof(db_stmt_t));
+  ds->ds_stmt = *ppStmt;
+  ds->ds_sql = strdup(zSql);
+  ds->ds_hash = h;
+  ds->ds_inuse = 1;
+  ds->ds_stale = 0;
+
+  LIST_INSERT_HEAD(&dc->dc_hash[h % DB_STMT_HASH_SIZE], ds, ds_hash_link);
+  dc->dc_entries++;
+
+  while(dc->dc_entries > DB_STMT_CACHE_SIZE &&
+	(ds = TAILQ_FIRST(&dc->dc_lru)) != NULL)
+    db_stmt_destroy(dc, ds);
+
+  return SQLITE_OK;
+}
+
+
+/**
+ * Return a statement obtained from db_prepare()
+ */
+void
+db_finalize(sqlite3_stmt *stmt)
+{
+  db_conn_t *dc;
+  db_stmt_t *ds = NULL;
+  unsigned int h;
+
+  if(stmt == NULL)
+    return;
+
+  dc = db_conn_find(sqlite3_db_handle(stmt), 0);
+
+  if(dc != NULL) {
+    h = db_stmt_hashfn(sqlite3_sql(stmt));
+    LIST_FOREACH(ds, &dc->dc_hash[h % DB_STMT_HASH_SIZE], ds_hash_link)
+      if(ds->ds_stmt == stmt)
+	break;
+  }
+
+  if(ds == NULL) {
+    sqlite3_finalize(stmt);
+    return;
+  }
+
+  assert(ds->ds_inuse);
+
+  if(ds->ds_stale) {
+    db_stmt_destroy(dc, ds);
+    return;
+  }
+
+  ds->ds_inuse = 0;
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  TAILQ_INSERT_TAIL(&dc->dc_lru, ds, ds_lru_link);
+}
+
+
+/**
+ * Drop all cached statements for the given connection. Statements
+ * currently in use are finalized when they are returned.
+ */
+void
+db_stmt_cache_flush(sqlite3 *db)
+{
+  db_conn_t *dc = db_conn_find(db, 0);
+  db_stmt_t *ds, *next;
+  int i;
+
+  if(dc == NULL)
+    return;
+
+  for(i = 0; i < DB_STMT_HASH_SIZE; i++) {
+    for(ds = LIST_FIRST(&dc->dc_hash[i]); ds != NULL; ds = next) {
+      next = LIST_NEXT(ds, ds_hash_link);
+      if(ds->ds_inuse)
+	ds->ds_stale = 1;
+      else
+	db_stmt_destroy(dc, ds);
+    }
+  }
+}
+
+
+/**
+ * Account a finished busy wait. It ended with the last retry
+ */
+static void
+db_busy_account(db_conn_t *dc)
+{
+  if(dc == NULL || dc->dc_busy_start == 0)
+    return;
+  db_lock_wait_account(dc->dc_busy_end - dc->dc_busy_start, "busy database");
+  dc->dc_busy_start = 0;
+}
+
+
+/**
+ * Used when a connection is blocked by another connection that
+ * does not share our cache (ie, a WAL reader vs. the writer).
+ *
+ * sqlite does not tell us when a retry succeeds, so a wait is accounted
+ * when the next one starts or the connection is returned to its pool
+ */
+static int
+db_busy_handler(void *opaque, int count)
+{
+  db_conn_t *dc = opaque;
+
+  if(count == 0) {
+    db_busy_account(dc);
+    dc->dc_busy_start = showtime_get_ts();
+  }
+
+  if(count >= DB_BUSY_MAX_RETRIES) {
+    TRACE(TRACE_ERROR, "DB", "Giving up waiting for busy database");
+    dc->dc_busy_end = showtime_get_ts();
+    db_busy_account(dc);
+    return 0;
+  }
+  usleep(DB_BUSY_SLEEP_MS * 1000);
+  dc->dc_busy_end = showtime_get_ts();
+  return 1;
+}
+
+
+/**
+ * Close a connection and drop its state
+ */
+static void
+db_conn_close(sqlite3 *db)
+{
+  db_conn_t *dc;
+
+  db_stmt_cache_flush(db);
+
+  if((dc = db_conn_find(db, 0)) != NULL) {
+    db_busy_account(dc);
+    hts_mutex_lock(&db_stmt_mutex);
+    LIST_REMOVE(dc, dc_link);
+    hts_mutex_unlock(&db_stmt_mutex);
+    free(dc);
+  }
+  sqlite3_close(db);
+}
+
+
+/**
+ *
+ */
+void
+db_init(void)
+{
+  prop_t *db = prop_create(prop_get_global(), "db");
+  prop_t *p = prop_create(db, "statementCache");
+
+  hts_mutex_init(&db_stmt_mutex);
+  hts_mutex_init(&db_lock_mutex);
+  LIST_INIT(&db_conns);
+
+  db_stmt_prop_hits = prop_create(p, "hits");
+  db_stmt_prop_misses = prop_create(p, "misses");
+
+  db_prop_lock_waits = prop_create(db, "lockWaits");
+  db_prop_lock_wait_time = prop_create(db, "lockWaitTime");
+}
+
 /**
  *
  */
@@ -135,7 +506,7 @@ db_get_int64_from_query(sqlite3 *db, const char *query, int64_t *v)
 
   rc = sqlite3_step(stmt);
   if(rc == SQLITE_LOCKED) {
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     goto restart;
   }
 
@@ -146,7 +517,7 @@ db_get_int64_from_query(sqlite3 *db, const char *query, int64_t *v)
     rval = -1;
   }
 
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   return rval;
 }
 
@@ -207,6 +578,8 @@ db_upgrade_schema(sqlite3 *db, const char *schemadir, const char *dbname)
   char path[256];
   char buf[256];
 
+  db_stmt_cache_flush(db);
+
   db_one_statement(db, "pragma journal_mode=wal;", NULL);
 
   if(db_get_int_from_query(db, "pragma user_version", &ver)) {
@@ -289,11 +662,13 @@ db_upgrade_schema(sqlite3 *db, const char *schemadir, const char *dbname)
     }
 
     db_commit(db);
+    db_stmt_cache_flush(db);
     TRACE(TRACE_INFO, "DB", "%s: Upgraded to version %d", dbname, ver);
     free(sql);
   }
  fail:
   db_rollback(db);
+  db_stmt_cache_flush(db);
   return -1;
 }
 
@@ -304,6 +679,7 @@ db_upgrade_schema(sqlite3 *db, const char *schemadir, const char *dbname)
 struct db_pool {
   int dp_size;
   int dp_closed;
+  int dp_readonly;
   char *dp_path;
   hts_mutex_t dp_mutex;
   sqlite3 *dp_pool[0];
@@ -324,6 +700,22 @@ db_pool_create(const char *path, int size)
   return dp;
 }
 
+
+/**
+ * Pool of read only connections. These do not use the shared cache
+ * so with the database in WAL mode they can read concurrently with
+ * an ongoing write transaction instead of being locked out by it.
+ *
+ * The database must already exist (ie. be created by a read-write pool)
+ */
+db_pool_t *
+db_pool_create_readonly(const char *path, int size)
+{
+  db_pool_t *dp = db_pool_create(path, size);
+  dp->dp_readonly = 1;
+  return dp;
+}
+
 /**
  *
  */
@@ -357,6 +749,9 @@ db_pool_get(db_pool_t *dp)
   hts_mutex_unlock(&dp->dp_mutex);
 
   rc = sqlite3_open_v2(dp->dp_path, &db,
+		       dp->dp_readonly ?
+		       SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX |
+		       SQLITE_OPEN_PRIVATECACHE :
 		       SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | 
 		       SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_SHAREDCACHE,
 		       NULL);
@@ -377,6 +772,8 @@ db_pool_get(db_pool_t *dp)
     sqlite3_close(db);
     return NULL;
   }
+
+  sqlite3_busy_handler(db, db_busy_handler, db_conn_find(db, 1));
   return db;
 }
 
@@ -394,10 +791,12 @@ db_pool_put(db_pool_t *dp, sqlite3 *db)
     TRACE(TRACE_ERROR, "DB",
 	  "%s: db handle returned to pool while in transaction, closing handle",
 	  dp->dp_path);
-    sqlite3_close(db);
+    db_conn_close(db);
     return;
   }
 
+  db_busy_account(db_conn_find(db, 0));
+
   hts_mutex_lock(&dp->dp_mutex);
   for(i = 0; i < dp->dp_size; i++) {
     if(dp->dp_pool[i] == NULL) {
@@ -408,7 +807,7 @@ db_pool_put(db_pool_t *dp, sqlite3 *db)
   }
 
   hts_mutex_unlock(&dp->dp_mutex);
-  sqlite3_close(db);
+  db_conn_close(db);
 }
 
 
@@ -426,7 +825,7 @@ db_pool_close(db_pool_t *dp)
   dp->dp_closed = 1;
   for(i = 0; i < dp->dp_size; i++)
     if(dp->dp_pool[i] != NULL)
-      sqlite3_close(dp->dp_pool[i]);
+      db_conn_close(dp->dp_pool[i]);
   hts_mutex_unlock(&dp->dp_mutex);
 }
 
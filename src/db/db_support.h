@@ -22,6 +22,12 @@ int db_step(sqlite3_stmt *pStmt);
 int db_prepare(sqlite3 *db, const char *zSql, int nSql,
 	       sqlite3_stmt **ppStmt, const char **pz);
 
+void db_finalize(sqlite3_stmt *stmt);
+
+void db_stmt_cache_flush(sqlite3 *db);
+
+void db_init(void);
+
 #define db_begin(db)    db_begin0(db, __FUNCTION__)
 #define db_commit(db)   db_commit0(db, __FUNCTION__)
 #define db_rollback(db) db_rollback0(db, __FUNCTION__)
@@ -34,6 +40,8 @@ typedef struct db_pool db_pool_t;
 
 db_pool_t *db_pool_create(const char *path, int size);
 
+db_pool_t *db_pool_create_readonly(const char *path, int size);
+
 sqlite3 *db_pool_get(db_pool_t *p);
 
 void db_pool_put(db_pool_t *p, sqlite3 *db);
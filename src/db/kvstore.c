@@ -128,16 +128,16 @@ get_url(void *db, const char *url, uint64_t *id)
       
   rc = sqlite3_step(stmt);
   if(rc == SQLITE_LOCKED) {
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     return SQLITE_LOCKED;
   }
   if(rc == SQLITE_ROW) {
     *id = sqlite3_column_int64(stmt, 0);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     return SQLITE_OK;
 
   } else if(rc == SQLITE_DONE) {
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
 
     rc = db_prepare(db,
 		    "INSERT INTO url ('url') VALUES (?1)",
@@ -156,7 +156,7 @@ get_url(void *db, const char *url, uint64_t *id)
       rc = SQLITE_OK;
     }
   }
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   return rc;
 }
 
@@ -264,7 +264,7 @@ kv_value_cb(void *opaque, prop_event_t event, ...)
     db_bind_rstr(stmt, 2, key);
     
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     rstr_release(key);
     
     if(rc == SQLITE_LOCKED) {
@@ -404,7 +404,7 @@ kv_prop_bind_create(prop_t *p, const char *url)
     }
   }
 
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   kvstore_close(db);
 
   kv_prop_bind_t *kpb = calloc(1, sizeof(kv_prop_bind_t));
@@ -453,7 +453,7 @@ kv_url_opt_get(void *db, const char *url, int domain, const char *key)
 
   if(db_step(stmt) == SQLITE_ROW)
     return stmt;
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   return NULL;
 }
 
@@ -468,7 +468,7 @@ kv_url_opt_get_rstr(const char *url, int domain, const char *key)
   rstr_t *r = NULL;
   if(stmt) {
     r = db_rstr(stmt, 0);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
   }
   kvstore_close(db);
   return r;
@@ -486,7 +486,7 @@ kv_url_opt_get_int(const char *url, int domain, const char *key, int def)
   int v = def;
   if(stmt) {
     v = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
   }
   kvstore_close(db);
   return v;
@@ -563,7 +563,7 @@ kv_url_opt_set(const char *url, int domain, const char *key,
     break;
   }
   rc = sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   if(rc == SQLITE_LOCKED) {
     db_rollback_deadlock(db);
     goto again;
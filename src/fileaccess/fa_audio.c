@@ -208,7 +208,7 @@ be_file_playaudio(const char *url, media_pipe_t *mp,
 
 
 
-      mb = media_buf_alloc_unlocked(mp, pkt.size);
+      mb = media_buf_from_avpkt_unlocked(mp, &pkt);
       mb->mb_data_type = MB_AUDIO;
 
       mb->mb_pts      = rescale(fctx, pkt.pts,      si);
@@ -217,18 +217,12 @@ be_file_playaudio(const char *url, media_pipe_t *mp,
 
       mb->mb_cw = media_codec_ref(cw);
 
-      /* Move the data pointers from ffmpeg's packet */
-
       mb->mb_stream = pkt.stream_index;
 
-      memcpy(mb->mb_data, pkt.data, pkt.size);
-
       if(mb->mb_pts != AV_NOPTS_VALUE) {
 	mb->mb_delta =  fctx->start_time;
 	mb->mb_drive_clock = 1;
       }
-
-      av_free_packet(&pkt);
     }
 
     /*
@@ -177,9 +177,9 @@ file_open_file(prop_t *page, const char *url, fa_stat_t *fs)
   prop_t *meta;
   metadata_t *md;
 
-  void *db = metadb_get();
+  void *db = metadb_get_ro();
   md = metadb_metadata_get(db, url, fs->fs_mtime);
-  metadb_close(db);
+  metadb_close_ro(db);
 
   if(md == NULL)
     md = fa_probe_metadata(url, errbuf, sizeof(errbuf), NULL);
@@ -23,16 +23,24 @@
 #include <unistd.h>
 #include <stdio.h>
 #include "arch/halloc.h"
+#include "arch/threads.h"
 
 #include "showtime.h"
 #include "fileaccess.h"
 #include "fa_proto.h"
+#include "prop/prop.h"
 
 #define BF_CHK 0
 
-#define BF_ZONES 8
+#define BF_ZONES 32
 #define BF_MASK (BF_ZONES - 1)
 
+/**
+ * Number of back to back reads before we consider the access pattern
+ * sequential and start reading ahead in the background
+ */
+#define BF_SEQ_THRES 4
+
 typedef struct buffered_zone {
   int64_t bz_fpos;
   int bz_mpos;
@@ -63,6 +71,30 @@ typedef struct buffered_file {
 
   buffered_zone_t bf_zones[BF_ZONES];
 
+  /**
+   * Read-ahead. bf_mutex protects everything above. The source handle
+   * is used by the read-ahead thread only while bf_ra_busy is set and
+   * by the reader only when it's not
+   */
+  hts_mutex_t bf_mutex;
+  hts_cond_t bf_cond;
+
+  int64_t bf_ra_last;   // Where last read ended
+  int bf_ra_seq;        // Number of sequential reads
+  char bf_ra_thread;
+  char bf_ra_run;
+  char bf_ra_busy;
+
+  int bf_hits;
+  int bf_misses;
+  int bf_stalls;
+  int64_t bf_ra_bytes;
+  int64_t bf_stats_ts;
+
+  prop_t *bf_stats_hits;
+  prop_t *bf_stats_misses;
+  prop_t *bf_stats_stalls;
+
 } buffered_file_t;
 
 
@@ -231,14 +263,57 @@ fab_close(fa_handle_t *handle)
 {
   buffered_file_t *bf = (buffered_file_t *)handle;
   fa_handle_t *src = bf->bf_src;
+
+  hts_mutex_lock(&bf->bf_mutex);
+  bf->bf_ra_run = 0;
+  hts_cond_broadcast(&bf->bf_cond);
+  while(bf->bf_ra_thread)
+    hts_cond_wait(&bf->bf_cond, &bf->bf_mutex);
+  hts_mutex_unlock(&bf->bf_mutex);
+
+  if(bf->bf_hits + bf->bf_misses)
+    TRACE(TRACE_DEBUG, "FABUF",
+	  "Closed, %d hits, %d misses, %d stalls, %"PRId64" bytes read ahead",
+	  bf->bf_hits, bf->bf_misses, bf->bf_stalls, bf->bf_ra_bytes);
+
   src->fh_proto->fap_close(src);
 
+  prop_ref_dec(bf->bf_stats_hits);
+  prop_ref_dec(bf->bf_stats_misses);
+  prop_ref_dec(bf->bf_stats_stalls);
+
+  hts_cond_destroy(&bf->bf_cond);
+  hts_mutex_destroy(&bf->bf_mutex);
+
   if(bf->bf_mem != NULL)
     hfree(bf->bf_mem, bf->bf_mem_size);
   free(bf);
 }
 
 
+/**
+ *
+ */
+static int64_t
+fab_fsize(fa_handle_t *handle)
+{
+  buffered_file_t *bf = (buffered_file_t *)handle;
+  int64_t r;
+
+  hts_mutex_lock(&bf->bf_mutex);
+  if(bf->bf_size == -1) {
+    while(bf->bf_ra_busy)
+      hts_cond_wait(&bf->bf_cond, &bf->bf_mutex);
+
+    fa_handle_t *src = bf->bf_src;
+    bf->bf_size = src->fh_proto->fap_fsize(src);
+  }
+  r = bf->bf_size;
+  hts_mutex_unlock(&bf->bf_mutex);
+  return r;
+}
+
+
 /**
  *
  */
@@ -246,8 +321,7 @@ static int64_t
 fab_seek(fa_handle_t *handle, int64_t pos, int whence)
 {
   buffered_file_t *bf = (buffered_file_t *)handle;
-  fa_handle_t *src = bf->bf_src;
-  int64_t np;
+  int64_t np, size;
 
   switch(whence) {
   case SEEK_SET:
@@ -259,12 +333,9 @@ fab_seek(fa_handle_t *handle, int64_t pos, int whence)
     break;
 
   case SEEK_END:
-    if(bf->bf_size == -1) {
-      bf->bf_size = src->fh_proto->fap_fsize(src);
-      if(bf->bf_size == -1)
-	return -1;
-    }
-    np = bf->bf_size + pos;
+    if((size = fab_fsize(handle)) == -1)
+      return -1;
+    np = size + pos;
     break;
 
   default:
@@ -275,32 +346,21 @@ fab_seek(fa_handle_t *handle, int64_t pos, int whence)
     return -1;
   }
 
+  hts_mutex_lock(&bf->bf_mutex);
   bf->bf_fpos = np;
+  hts_mutex_unlock(&bf->bf_mutex);
   return np;
 }
 
 
-/**
- *
- */
-static int64_t
-fab_fsize(fa_handle_t *handle)
-{
-  buffered_file_t *bf = (buffered_file_t *)handle;
-  if(bf->bf_size != -1)
-    return bf->bf_size;
-
-  fa_handle_t *src = bf->bf_src;
-  bf->bf_size = src->fh_proto->fap_fsize(src);
-  return bf->bf_size;
-}
 
 
 /**
  *
  */
 static void
-store_in_cache(buffered_file_t *bf, const void *buf, size_t size)
+store_in_cache(buffered_file_t *bf, const void *buf, size_t size,
+	       int64_t fpos)
 {
   if(size > bf->bf_mem_size)
     return;
@@ -316,7 +376,7 @@ store_in_cache(buffered_file_t *bf, const void *buf, size_t size)
 
   erase_zone(bf, bf->bf_mem_ptr, s1);
 
-  map_zone(bf, bf->bf_mem_ptr, s1, bf->bf_fpos);
+  map_zone(bf, bf->bf_mem_ptr, s1, fpos);
   memcpy(bf->bf_mem + bf->bf_mem_ptr, buf, s1);
 
   bf->bf_mem_ptr += s1;
@@ -328,7 +388,7 @@ store_in_cache(buffered_file_t *bf, const void *buf, size_t size)
   if(s2 > 0) {
     erase_zone(bf, bf->bf_mem_ptr, s2);
 
-    map_zone(bf, bf->bf_mem_ptr, s2, bf->bf_fpos + s1);
+    map_zone(bf, bf->bf_mem_ptr, s2, fpos + s1);
     memcpy(bf->bf_mem + bf->bf_mem_ptr, buf + s1, s2);
 
     bf->bf_mem_ptr += s2;
@@ -338,12 +398,11 @@ store_in_cache(buffered_file_t *bf, const void *buf, size_t size)
 
 
 /**
- *
+ * bf_mutex must be held. *accessp is set if we had to go to the source
  */
 static int
-fab_read(fa_handle_t *handle, void *buf, size_t size)
+fab_read0(buffered_file_t *bf, void *buf, size_t size, int *accessp)
 {
-  buffered_file_t *bf = (buffered_file_t *)handle;
   fa_handle_t *src = bf->bf_src;
 
   if(bf->bf_mem == NULL) {
@@ -369,6 +428,15 @@ fab_read(fa_handle_t *handle, void *buf, size_t size)
       continue;
     }
 
+    if(bf->bf_ra_busy) {
+      // Read-ahead is using the source (and probably fetching what we want)
+      *accessp |= 2;
+      hts_cond_wait(&bf->bf_cond, &bf->bf_mutex);
+      continue;
+    }
+
+    *accessp |= 1;
+
     int rreq = need_to_fill(bf, bf->bf_fpos, size);
     if(rreq >= bf->bf_min_request) {
 
@@ -377,7 +445,7 @@ fab_read(fa_handle_t *handle, void *buf, size_t size)
 
       int r = src->fh_proto->fap_read(src, buf, rreq);
       if(r > 0) {
-	store_in_cache(bf, buf, r);
+	store_in_cache(bf, buf, r, bf->bf_fpos);
 	rval += r;
 	buf += r;
 	bf->bf_fpos += r;
@@ -428,6 +496,144 @@ fab_read(fa_handle_t *handle, void *buf, size_t size)
 }
 
 
+/**
+ * Find first position within the read-ahead window that is not
+ * in the cache. bf_mutex must be held
+ */
+static int64_t
+fab_readahead_pos(buffered_file_t *bf)
+{
+  int64_t p, limit;
+  int mpos, cs;
+
+  if(bf->bf_ra_seq < BF_SEQ_THRES || bf->bf_mem == NULL)
+    return -1;
+
+  p = bf->bf_fpos;
+  limit = bf->bf_fpos + bf->bf_mem_size / 2;
+  if(bf->bf_size != -1)
+    limit = MIN(limit, bf->bf_size);
+
+  while(p < limit) {
+    if((cs = resolve_zone(bf, p, INT32_MAX, &mpos)) <= 0)
+      return p;
+    p += cs;
+  }
+  return -1;
+}
+
+
+/**
+ *
+ */
+static void *
+fab_readahead_thread(void *aux)
+{
+  buffered_file_t *bf = aux;
+  fa_handle_t *src = bf->bf_src;
+  void *tmp = malloc(bf->bf_min_request);
+  int64_t pos;
+  int len, r;
+
+  hts_mutex_lock(&bf->bf_mutex);
+
+  while(bf->bf_ra_run) {
+
+    if((pos = fab_readahead_pos(bf)) == -1) {
+      hts_cond_wait(&bf->bf_cond, &bf->bf_mutex);
+      continue;
+    }
+
+    len = bf->bf_min_request;
+    if(bf->bf_size != -1)
+      len = MIN(len, bf->bf_size - pos);
+
+    bf->bf_ra_busy = 1;
+    hts_mutex_unlock(&bf->bf_mutex);
+
+    r = -1;
+    if(src->fh_proto->fap_seek(src, pos, SEEK_SET) == pos)
+      r = src->fh_proto->fap_read(src, tmp, len);
+
+    hts_mutex_lock(&bf->bf_mutex);
+    bf->bf_ra_busy = 0;
+
+    if(r > 0) {
+      store_in_cache(bf, tmp, r, pos);
+      bf->bf_ra_bytes += r;
+    }
+
+    if(r < 0)
+      bf->bf_ra_seq = 0; // Stop reading ahead until next sequential run
+    else if(r != len)
+      bf->bf_size = pos + r;
+
+    hts_cond_broadcast(&bf->bf_cond);
+  }
+
+  bf->bf_ra_thread = 0;
+  hts_cond_broadcast(&bf->bf_cond);
+  hts_mutex_unlock(&bf->bf_mutex);
+  free(tmp);
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static int
+fab_read(fa_handle_t *handle, void *buf, size_t size)
+{
+  buffered_file_t *bf = (buffered_file_t *)handle;
+  int access = 0;
+  int64_t now;
+  int r;
+
+  hts_mutex_lock(&bf->bf_mutex);
+
+  if(bf->bf_fpos == bf->bf_ra_last) {
+    bf->bf_ra_seq++;
+  } else {
+    bf->bf_ra_seq = 0;
+  }
+
+  r = fab_read0(bf, buf, size, &access);
+
+  bf->bf_ra_last = bf->bf_fpos;
+
+  if(access & 2)
+    bf->bf_stalls++;
+  if(access & 1)
+    bf->bf_misses++;
+  else
+    bf->bf_hits++;
+
+  if(bf->bf_ra_seq >= BF_SEQ_THRES) {
+    if(!bf->bf_ra_thread) {
+      bf->bf_ra_thread = 1;
+      bf->bf_ra_run = 1;
+      hts_thread_create_detached("fabuffer", fab_readahead_thread, bf,
+				 THREAD_PRIO_LOW);
+    }
+    hts_cond_broadcast(&bf->bf_cond);
+  }
+
+  if(bf->bf_stats_hits != NULL) {
+    now = showtime_get_ts();
+    if(now - bf->bf_stats_ts > 1000000) {
+      bf->bf_stats_ts = now;
+      prop_set_int(bf->bf_stats_hits,   bf->bf_hits);
+      prop_set_int(bf->bf_stats_misses, bf->bf_misses);
+      prop_set_int(bf->bf_stats_stalls, bf->bf_stalls);
+    }
+  }
+
+  hts_mutex_unlock(&bf->bf_mutex);
+  return r;
+}
+
+
 #if BK_CHK
 static int
 fab_read(fa_handle_t *handle, void *buf, size_t size)
@@ -515,10 +721,19 @@ fa_buffered_open(const char *url, char *errbuf, size_t errsize, int flags,
   buffered_file_t *bf = calloc(1, sizeof(buffered_file_t));
 
   bf->bf_min_request = mflags & FA_BUFFERED_BIG ? 256 * 1024 : 64 * 1024;
-  bf->bf_mem_size = bf->bf_min_request * 4;
+  bf->bf_mem_size = bf->bf_min_request * 8;
 
   bf->bf_src = fh;
   bf->bf_size = -1;
+  bf->bf_ra_last = -1;
+  hts_mutex_init(&bf->bf_mutex);
+  hts_cond_init(&bf->bf_cond, &bf->bf_mutex);
+
+  if(stats != NULL) {
+    bf->bf_stats_hits   = prop_ref_inc(prop_create(stats, "bufferHits"));
+    bf->bf_stats_misses = prop_ref_inc(prop_create(stats, "bufferMisses"));
+    bf->bf_stats_stalls = prop_ref_inc(prop_create(stats, "bufferStalls"));
+  }
   bf->h.fh_proto = &fa_protocol_buffered;
 #if BF_CHK
   bf->bf_chk = fa_open_ex(url, NULL, 0, 0, NULL);
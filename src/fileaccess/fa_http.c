@@ -60,6 +60,27 @@ static uint8_t nonce[20];
 #define STREAMING_LIMIT 128000
 
 
+/**
+ * Once we switch to streaming mode and the server accepts ranges we
+ * keep this many range requests (each of http_prefetch_segment_size
+ * bytes) in flight over separate connections. 0 or 1 disables the
+ * prefetcher and we do a single open ended request instead
+ */
+int http_prefetch_window = 4;
+static int http_prefetch_segment_size = 256 * 1024;
+
+
+/**
+ *
+ */
+void
+http_prefetch_set_segment_size(int size)
+{
+  if(size > 0)
+    http_prefetch_segment_size = size;
+}
+
+
 
 static int http_tokenize(char *buf, char **vec, int vecsize, int delimiter);
 
@@ -148,6 +169,8 @@ typedef struct http_connection {
 
 } http_connection_t;
 
+struct http_prefetch;
+
 
 /**
  *
@@ -504,6 +527,8 @@ typedef struct http_file {
 #define HTTP_CE_GZIP 1
 
 
+  struct http_prefetch *hf_prefetch;
+
   prop_t *hf_stats_speed;
 
 #define STAT_VEC_SIZE 20
@@ -1503,9 +1528,12 @@ http_open0(http_file_t *hf, int probe, char *errbuf, int errlen,
 /**
  *
  */
+static void http_prefetch_stop(http_file_t *hf);
+
 static void
 http_destroy(http_file_t *hf)
 {
+  http_prefetch_stop(hf);
   http_detach(hf, 
 	      hf->hf_rsize == 0 &&
 	      hf->hf_connection_mode == CONNECTION_MODE_PERSISTENT,
@@ -1736,6 +1764,409 @@ http_seek_is_fast(fa_handle_t *handle)
 }
 
 
+/**
+ * Parallel range prefetcher
+ *
+ * Segments are kept in file order. Worker threads each hold their
+ * own connection (from the connection pool) and pick the first
+ * pending segment. The reader consumes segments from the head of the
+ * queue and schedules new ones at the tail.
+ */
+TAILQ_HEAD(http_prefetch_seg_queue, http_prefetch_seg);
+
+typedef struct http_prefetch_seg {
+  TAILQ_ENTRY(http_prefetch_seg) hps_link;
+  int64_t hps_offset;
+  int hps_size;
+  enum {
+    HPS_PENDING,
+    HPS_LOADING,
+    HPS_DONE,
+    HPS_FAILED,
+  } hps_state;
+  char hps_orphaned; // Dropped by reader while loading, worker frees it
+  char *hps_data;
+} http_prefetch_seg_t;
+
+
+typedef struct http_prefetch {
+  hts_mutex_t hp_mutex;
+  hts_cond_t hp_cond;
+
+  struct http_prefetch_seg_queue hp_segs;
+  int hp_refcount;
+  int hp_run;
+
+  int64_t hp_next;     // Offset of next segment to schedule
+  int64_t hp_filesize;
+
+  char *hp_url;
+  char *hp_auth;
+  char hp_path[URL_MAX];
+  char hp_hostname[HOSTNAME_MAX];
+  int hp_port;
+  char hp_ssl;
+  char hp_debug;
+  char hp_version;
+
+  char *hp_request;    // Request line + headers, except Range
+
+  int64_t hp_bytes;    // Total bytes fetched
+  int hp_segments;     // Total segments fetched
+  int64_t hp_start;
+
+  int64_t hp_stat_bytes;
+  int64_t hp_stat_ts;
+
+} http_prefetch_t;
+
+
+/**
+ *
+ */
+static void
+http_prefetch_release(http_prefetch_t *hp)
+{
+  hp->hp_refcount--;
+  if(hp->hp_refcount > 0) {
+    hts_mutex_unlock(&hp->hp_mutex);
+    return;
+  }
+  hts_mutex_unlock(&hp->hp_mutex);
+  hts_cond_destroy(&hp->hp_cond);
+  hts_mutex_destroy(&hp->hp_mutex);
+  free(hp->hp_url);
+  free(hp->hp_auth);
+  free(hp->hp_request);
+  free(hp);
+}
+
+
+/**
+ * hp_mutex must be held
+ */
+static void
+http_prefetch_seg_drop(http_prefetch_t *hp, http_prefetch_seg_t *hps)
+{
+  TAILQ_REMOVE(&hp->hp_segs, hps, hps_link);
+  if(hps->hps_state == HPS_LOADING) {
+    hps->hps_orphaned = 1;
+    return;
+  }
+  free(hps->hps_data);
+  free(hps);
+}
+
+
+/**
+ * Schedule segments until the window is full, hp_mutex must be held
+ */
+static void
+http_prefetch_fill(http_prefetch_t *hp)
+{
+  http_prefetch_seg_t *hps;
+  int n = 0;
+
+  TAILQ_FOREACH(hps, &hp->hp_segs, hps_link)
+    n++;
+
+  for(; n < http_prefetch_window && hp->hp_next < hp->hp_filesize; n++) {
+    hps = calloc(1, sizeof(http_prefetch_seg_t));
+    hps->hps_offset = hp->hp_next;
+    hps->hps_size = MIN(http_prefetch_segment_size,
+			hp->hp_filesize - hp->hp_next);
+    hps->hps_state = HPS_PENDING;
+    hp->hp_next += hps->hps_size;
+    TAILQ_INSERT_TAIL(&hp->hp_segs, hps, hps_link);
+  }
+  hts_cond_broadcast(&hp->hp_cond);
+}
+
+
+/**
+ * Fetch a single segment using the worker's private http_file
+ */
+static int
+http_prefetch_load(http_prefetch_t *hp, http_file_t *hf,
+		   http_prefetch_seg_t *hps)
+{
+  htsbuf_queue_t q;
+  int i, code;
+  char *data;
+
+  for(i = 0; i < 3; i++) {
+
+    if(hf->hf_connection == NULL) {
+      hf->hf_connection = http_connection_get(hp->hp_hostname, hp->hp_port,
+					      hp->hp_ssl, NULL, 0,
+					      hp->hp_debug);
+      if(hf->hf_connection == NULL)
+	return -1;
+    }
+
+    htsbuf_queue_init(&q, 0);
+    htsbuf_append(&q, hp->hp_request, strlen(hp->hp_request));
+    htsbuf_qprintf(&q, "Range: bytes=%"PRId64"-%"PRId64"\r\n\r\n",
+		   hps->hps_offset, hps->hps_offset + hps->hps_size - 1);
+    tcp_write_queue(hf->hf_connection->hc_tc, &q);
+
+    code = http_read_response(hf, NULL);
+
+    if(code != 206 || hf->hf_chunked_transfer ||
+       hf->hf_content_encoding != HTTP_CE_IDENTITY ||
+       hf->hf_rsize != hps->hps_size) {
+      HF_TRACE(hf, "%s: Unexpected prefetch response %d", hf->hf_url, code);
+      http_detach(hf, 0, "Unexpected prefetch response");
+      if(code == -1)
+	continue;
+      return -1;
+    }
+
+    if((data = mymalloc(hps->hps_size)) == NULL) {
+      http_detach(hf, 0, "Out of memory");
+      return -1;
+    }
+
+    if(tcp_read_data(hf->hf_connection->hc_tc, data, hps->hps_size,
+		     NULL, NULL)) {
+      free(data);
+      http_detach(hf, 0, "Read error during prefetch");
+      continue;
+    }
+
+    hf->hf_rsize = 0;
+    if(hf->hf_connection_mode == CONNECTION_MODE_CLOSE)
+      http_detach(hf, 0, "Connection-mode = close");
+
+    hps->hps_data = data;
+    return 0;
+  }
+  return -1;
+}
+
+
+/**
+ *
+ */
+static void *
+http_prefetch_thread(void *aux)
+{
+  http_prefetch_t *hp = aux;
+  http_prefetch_seg_t *hps;
+  http_file_t *hf = calloc(1, sizeof(http_file_t));
+  int r;
+
+  hf->hf_url = strdup(hp->hp_url);
+  hf->hf_auth = hp->hp_auth ? strdup(hp->hp_auth) : NULL;
+  snprintf(hf->hf_path, sizeof(hf->hf_path), "%s", hp->hp_path);
+  hf->hf_debug = hp->hp_debug;
+  hf->hf_version = hp->hp_version;
+  hf->hf_filesize = hp->hp_filesize;
+
+  hts_mutex_lock(&hp->hp_mutex);
+
+  while(hp->hp_run) {
+
+    TAILQ_FOREACH(hps, &hp->hp_segs, hps_link)
+      if(hps->hps_state == HPS_PENDING)
+	break;
+
+    if(hps == NULL) {
+      hts_cond_wait(&hp->hp_cond, &hp->hp_mutex);
+      continue;
+    }
+
+    hps->hps_state = HPS_LOADING;
+    hts_mutex_unlock(&hp->hp_mutex);
+
+    r = http_prefetch_load(hp, hf, hps);
+
+    hts_mutex_lock(&hp->hp_mutex);
+
+    if(hps->hps_orphaned) {
+      free(hps->hps_data);
+      free(hps);
+      continue;
+    }
+
+    if(r) {
+      hps->hps_state = HPS_FAILED;
+    } else {
+      hps->hps_state = HPS_DONE;
+      hp->hp_bytes += hps->hps_size;
+      hp->hp_stat_bytes += hps->hps_size;
+      hp->hp_segments++;
+    }
+    hts_cond_broadcast(&hp->hp_cond);
+  }
+
+  http_prefetch_release(hp);
+  http_destroy(hf);
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static int
+http_prefetch_start(http_file_t *hf)
+{
+  http_connection_t *hc = hf->hf_connection;
+  struct http_header_list headers;
+  htsbuf_queue_t q;
+  int i;
+
+  http_prefetch_t *hp = calloc(1, sizeof(http_prefetch_t));
+  hts_mutex_init(&hp->hp_mutex);
+  hts_cond_init(&hp->hp_cond, &hp->hp_mutex);
+  TAILQ_INIT(&hp->hp_segs);
+
+  hp->hp_run = 1;
+  hp->hp_refcount = 1;
+  hp->hp_next = hf->hf_pos;
+  hp->hp_filesize = hf->hf_filesize;
+  hp->hp_url = strdup(hf->hf_url);
+  snprintf(hp->hp_path, sizeof(hp->hp_path), "%s", hf->hf_path);
+  snprintf(hp->hp_hostname, sizeof(hp->hp_hostname), "%s", hc->hc_hostname);
+  hp->hp_port = hc->hc_port;
+  hp->hp_ssl = hc->hc_ssl;
+  hp->hp_debug = hf->hf_debug;
+  hp->hp_version = hf->hf_version;
+
+  htsbuf_queue_init(&q, 0);
+  htsbuf_qprintf(&q, "GET %s HTTP/1.%d\r\n", hf->hf_path, hf->hf_version);
+  http_headers_init(&headers, hf);
+  http_headers_auth(&headers, hf, "GET", NULL);
+  http_cookie_append(hc->hc_hostname, hf->hf_path, &headers);
+  http_headers_send(&q, &headers, NULL);
+
+  // Strip the terminating empty line, Range is appended per segment
+  hp->hp_request = htsbuf_to_string(&q);
+  hp->hp_request[strlen(hp->hp_request) - 2] = 0;
+  hp->hp_auth = hf->hf_auth ? strdup(hf->hf_auth) : NULL;
+
+  // Our own connection is idle now, let one of the workers pick it up
+  http_detach(hf, hf->hf_connection_mode == CONNECTION_MODE_PERSISTENT,
+	      "Prefetching");
+
+  hp->hp_start = hp->hp_stat_ts = showtime_get_ts();
+
+  hf->hf_prefetch = hp;
+
+  TRACE(TRACE_DEBUG, "HTTP",
+	"%s: Prefetching with %d concurrent requests of %d bytes",
+	hf->hf_url, http_prefetch_window, http_prefetch_segment_size);
+
+  hts_mutex_lock(&hp->hp_mutex);
+  for(i = 0; i < http_prefetch_window; i++) {
+    hp->hp_refcount++;
+    hts_thread_create_detached("httpprefetch", http_prefetch_thread, hp,
+			       THREAD_PRIO_NORMAL);
+  }
+  http_prefetch_fill(hp);
+  hts_mutex_unlock(&hp->hp_mutex);
+  return 0;
+}
+
+
+/**
+ *
+ */
+static void
+http_prefetch_stop(http_file_t *hf)
+{
+  http_prefetch_t *hp = hf->hf_prefetch;
+  http_prefetch_seg_t *hps;
+
+  if(hp == NULL)
+    return;
+
+  hf->hf_prefetch = NULL;
+
+  hts_mutex_lock(&hp->hp_mutex);
+
+  int64_t ts = showtime_get_ts() - hp->hp_start;
+  TRACE(TRACE_DEBUG, "HTTP",
+	"%s: Prefetcher stopped, %"PRId64" bytes in %d segments, %d kB/s",
+	hf->hf_url, hp->hp_bytes, hp->hp_segments,
+	ts > 0 ? (int)(hp->hp_bytes * 1000000 / ts / 1024) : 0);
+
+  hp->hp_run = 0;
+  while((hps = TAILQ_FIRST(&hp->hp_segs)) != NULL)
+    http_prefetch_seg_drop(hp, hps);
+  hts_cond_broadcast(&hp->hp_cond);
+  http_prefetch_release(hp);
+}
+
+
+/**
+ * Read from the prefetch window
+ *
+ * Returns -2 if the read can't be served by the prefetcher (seek
+ * outside the window or failed segment). The prefetcher is stopped
+ * and the caller should fall back to regular requests
+ */
+static int
+http_prefetch_read(http_file_t *hf, void *buf, size_t size)
+{
+  http_prefetch_t *hp = hf->hf_prefetch;
+  http_prefetch_seg_t *hps;
+  size_t totsize = 0;
+  int64_t now;
+
+  hts_mutex_lock(&hp->hp_mutex);
+
+  while(totsize < size && hf->hf_pos < hp->hp_filesize) {
+
+    // Drop everything we've passed
+    while((hps = TAILQ_FIRST(&hp->hp_segs)) != NULL &&
+	  hps->hps_offset + hps->hps_size <= hf->hf_pos)
+      http_prefetch_seg_drop(hp, hps);
+
+    if(hps == NULL || hps->hps_offset > hf->hf_pos) {
+      // Not in our window
+      if(hps == NULL && hf->hf_pos == hp->hp_next) {
+	http_prefetch_fill(hp);
+	continue;
+      }
+      break;
+    }
+
+    http_prefetch_fill(hp);
+
+    while(hps->hps_state == HPS_PENDING || hps->hps_state == HPS_LOADING)
+      hts_cond_wait(&hp->hp_cond, &hp->hp_mutex);
+
+    if(hps->hps_state == HPS_FAILED)
+      break;
+
+    size_t off = hf->hf_pos - hps->hps_offset;
+    size_t len = MIN(size - totsize, hps->hps_size - off);
+    memcpy(buf + totsize, hps->hps_data + off, len);
+    totsize += len;
+    hf->hf_pos += len;
+    hf->hf_consecutive_read += len;
+  }
+
+  now = showtime_get_ts();
+  if(hf->hf_stats_speed != NULL && now - hp->hp_stat_ts > 1000000) {
+    prop_set_int(hf->hf_stats_speed,
+		 hp->hp_stat_bytes * 1000000 / (now - hp->hp_stat_ts));
+    hp->hp_stat_bytes = 0;
+    hp->hp_stat_ts = now;
+  }
+
+  hts_mutex_unlock(&hp->hp_mutex);
+
+  if(totsize > 0 || hf->hf_pos >= hp->hp_filesize)
+    return totsize;
+
+  http_prefetch_stop(hf);
+  return -2;
+}
+
+
 /**
  * Read from file
  */
@@ -1753,6 +2184,20 @@ http_read_i(http_file_t *hf, void *buf, const size_t size)
   if(size == 0)
     return 0;
 
+  if(hf->hf_prefetch == NULL && http_prefetch_window > 1 &&
+     hf->hf_consecutive_read > STREAMING_LIMIT &&
+     hf->hf_filesize > 0 && hf->hf_pos < hf->hf_filesize &&
+     !hf->hf_no_ranges && hf->hf_rsize == 0 &&
+     hf->hf_connection != NULL)
+    http_prefetch_start(hf);
+
+  if(hf->hf_prefetch != NULL) {
+    int r = http_prefetch_read(hf, buf, size);
+    if(r != -2)
+      return r;
+    hf->hf_consecutive_read = 0;
+  }
+
   /* Max 5 retries */
   for(i = 0; i < 5; i++) {
     /* If not connected, try to (re-)connect */
@@ -1919,7 +2364,7 @@ http_read(fa_handle_t *handle, void *buf, const size_t size)
 {
   http_file_t *hf = (http_file_t *)handle;
 
-  if(hf->hf_stats_speed == NULL)
+  if(hf->hf_stats_speed == NULL || hf->hf_prefetch != NULL)
     return http_read_i(hf, buf, size);
 
   int64_t ts = showtime_get_ts();
@@ -45,6 +45,7 @@ static const uint8_t svgsig1[5] = {'<', '?', 'x', 'm', 'l'};
 static const uint8_t svgsig2[4] = {'<', 's', 'v', 'g'};
 
 static hts_mutex_t image_from_video_mutex;
+static hts_cond_t ifv_cond;
 static AVCodecContext *pngencoder;
 
 static pixmap_t *fa_image_from_video(const char *url, const image_meta_t *im,
@@ -59,6 +60,7 @@ void
 fa_imageloader_init(void)
 {
   hts_mutex_init(&image_from_video_mutex);
+  hts_cond_init(&ifv_cond, &image_from_video_mutex);
 
   AVCodec *c = avcodec_find_encoder(CODEC_ID_PNG);
   if(c != NULL) {
@@ -270,234 +272,549 @@ fa_imageloader(const char *url, const struct image_meta *im,
   return pm;
 }
 
-static char *ifv_url;
-static AVFormatContext *ifv_fctx;
-static AVCodecContext *ifv_ctx;
-int ifv_stream;
+/**
+ * Open demuxer + decoder contexts for video thumbnail extraction.
+ * Kept in a small LRU so alternating between a few videos (or several
+ * loader threads working on different files) doesn't reopen and
+ * reprobe the files all the time.
+ *
+ * A slot is owned by one thread at a time (ifs_busy), all other
+ * fields are protected by image_from_video_mutex
+ */
+#define IFV_SLOTS 4
+
+typedef struct ifv_slot {
+  char *ifs_url;
+  AVFormatContext *ifs_fctx;
+  AVCodecContext *ifs_ctx;
+  int ifs_stream;
+  int ifs_busy;
+  int ifs_lru;
+} ifv_slot_t;
+
+static ifv_slot_t ifv_slots[IFV_SLOTS];
+static int ifv_tally;
+
+/**
+ * Number of following seek index positions extracted together with
+ * a missing seek index thumbnail
+ */
+#define IFV_SEEK_INDEX_BATCH 8
+
 
+/**
+ *
+ */
 static void
-ifv_close(void)
+ifv_close(AVFormatContext *fctx, AVCodecContext *ctx)
 {
-  free(ifv_url);
-  ifv_url = NULL;
-
-  if(ifv_ctx != NULL) {
-    avcodec_close(ifv_ctx);
-    ifv_ctx = NULL;
-  }
+  if(ctx != NULL)
+    avcodec_close(ctx);
 
-  if(ifv_fctx != NULL) {
-    fa_libav_close_format(ifv_fctx);
-    ifv_fctx = NULL;
-  }
+  if(fctx != NULL)
+    fa_libav_close_format(fctx);
 }
 
 
 /**
  *
  */
-static pixmap_t *
-fa_image_from_video2(const char *url, const image_meta_t *im, 
-		     const char *cacheid, char *errbuf, size_t errlen,
-		     int sec, time_t mtime, fa_load_cb_t *cb, void *opaque)
+static int
+ifv_open(ifv_slot_t *ifs, const char *url, char *errbuf, size_t errlen)
 {
-  pixmap_t *pm = NULL;
+  int i;
+  AVFormatContext *fctx;
+  fa_handle_t *fh = fa_open_ex(url, errbuf, errlen, FA_BUFFERED_BIG, NULL);
 
-  if(ifv_url == NULL || strcmp(url, ifv_url)) {
-    // Need to open
-    int i;
-    AVFormatContext *fctx;
-    fa_handle_t *fh = fa_open_ex(url, errbuf, errlen, FA_BUFFERED_BIG, NULL);
+  if(fh == NULL)
+    return -1;
 
-    if(fh == NULL)
-      return NULL;
+  AVIOContext *avio = fa_libav_reopen(fh);
 
-    AVIOContext *avio = fa_libav_reopen(fh);
+  if((fctx = fa_libav_open_format(avio, url, NULL, 0, NULL)) == NULL) {
+    fa_libav_close(avio);
+    snprintf(errbuf, errlen, "Unable to open format");
+    return -1;
+  }
 
-    if((fctx = fa_libav_open_format(avio, url, NULL, 0, NULL)) == NULL) {
-      fa_libav_close(avio);
-      snprintf(errbuf, errlen, "Unable to open format");
-      return NULL;
+  if(!strcmp(fctx->iformat->name, "avi"))
+    fctx->flags |= AVFMT_FLAG_GENPTS;
+
+  AVCodecContext *ctx = NULL;
+  for(i = 0; i < fctx->nb_streams; i++) {
+    if(fctx->streams[i]->codec != NULL && 
+       fctx->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
+      ctx = fctx->streams[i]->codec;
+      break;
     }
+  }
+  if(ctx == NULL) {
+    fa_libav_close_format(fctx);
+    snprintf(errbuf, errlen, "No video stream");
+    return -1;
+  }
 
-    if(!strcmp(fctx->iformat->name, "avi"))
-      fctx->flags |= AVFMT_FLAG_GENPTS;
+  AVCodec *codec = avcodec_find_decoder(ctx->codec_id);
+  if(codec == NULL) {
+    fa_libav_close_format(fctx);
+    snprintf(errbuf, errlen, "Unable to find codec");
+    return -1;
+  }
 
-    AVCodecContext *ctx = NULL;
-    for(i = 0; i < fctx->nb_streams; i++) {
-      if(fctx->streams[i]->codec != NULL && 
-	 fctx->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
-	ctx = fctx->streams[i]->codec;
-	break;
-      }
-    }
-    if(ctx == NULL) {
-      fa_libav_close_format(fctx);
+  if(avcodec_open(ctx, codec) < 0) {
+    fa_libav_close_format(fctx);
+    snprintf(errbuf, errlen, "Unable to open codec");
+    return -1;
+  }
+
+  ifs->ifs_stream = i;
+  ifs->ifs_fctx = fctx;
+  ifs->ifs_ctx = ctx;
+  return 0;
+}
+
+
+/**
+ * Get exclusive access to an open context for the given url. Reuses
+ * an idle slot for the same file, otherwise the least recently used
+ * idle slot is recycled
+ */
+static ifv_slot_t *
+ifv_acquire(const char *url, char *errbuf, size_t errlen,
+	    fa_load_cb_t *cb, void *opaque)
+{
+  ifv_slot_t *ifs, *victim;
+  AVFormatContext *fctx;
+  AVCodecContext *ctx;
+  int i;
+
+  hts_mutex_lock(&image_from_video_mutex);
+
+  while(1) {
+    if(cb != NULL && cb(opaque, 0, 1)) {
+      hts_mutex_unlock(&image_from_video_mutex);
+      snprintf(errbuf, errlen, "Aborted");
       return NULL;
     }
 
-    AVCodec *codec = avcodec_find_decoder(ctx->codec_id);
-    if(codec == NULL) {
-      fa_libav_close_format(fctx);
-      snprintf(errbuf, errlen, "Unable to find codec");
-      return NULL;
+    victim = NULL;
+
+    for(i = 0; i < IFV_SLOTS; i++) {
+      ifs = &ifv_slots[i];
+      if(ifs->ifs_url != NULL && !strcmp(ifs->ifs_url, url))
+	break;
+      if(ifs->ifs_busy)
+	continue;
+      if(victim == NULL || ifs->ifs_url == NULL ||
+	 (victim->ifs_url != NULL && ifs->ifs_lru < victim->ifs_lru))
+	victim = ifs;
     }
 
-    if(avcodec_open(ctx, codec) < 0) {
-      fa_libav_close_format(fctx);
-      snprintf(errbuf, errlen, "Unable to open codec");
-      return NULL;
+    if(i < IFV_SLOTS) {
+      if(!ifs->ifs_busy) {
+	ifs->ifs_busy = 1;
+	hts_mutex_unlock(&image_from_video_mutex);
+	return ifs;
+      }
+    } else if(victim != NULL) {
+      break;
     }
+    // Someone else is using the file (or all slots), wait
+    if(cb != NULL)
+      hts_cond_wait_timeout(&ifv_cond, &image_from_video_mutex, 250);
+    else
+      hts_cond_wait(&ifv_cond, &image_from_video_mutex);
+  }
+
+  // Claim the url so concurrent requests for it wait for us
+
+  fctx = victim->ifs_fctx;
+  ctx = victim->ifs_ctx;
+  free(victim->ifs_url);
+  victim->ifs_url = strdup(url);
+  victim->ifs_fctx = NULL;
+  victim->ifs_ctx = NULL;
+  victim->ifs_busy = 1;
+  hts_mutex_unlock(&image_from_video_mutex);
+
+  ifv_close(fctx, ctx);
 
-    ifv_close();
+  if(!ifv_open(victim, url, errbuf, errlen))
+    return victim;
+
+  hts_mutex_lock(&image_from_video_mutex);
+  free(victim->ifs_url);
+  victim->ifs_url = NULL;
+  victim->ifs_busy = 0;
+  hts_cond_broadcast(&ifv_cond);
+  hts_mutex_unlock(&image_from_video_mutex);
+  return NULL;
+}
+
+
+/**
+ * Give back slot. If 'broken' is set the contexts are closed
+ */
+static void
+ifv_release(ifv_slot_t *ifs, int broken)
+{
+  AVFormatContext *fctx = NULL;
+  AVCodecContext *ctx = NULL;
 
-    ifv_stream = i;
-    ifv_url = strdup(url);
-    ifv_fctx = fctx;
-    ifv_ctx = ctx;
+  hts_mutex_lock(&image_from_video_mutex);
+  if(broken) {
+    fctx = ifs->ifs_fctx;
+    ctx = ifs->ifs_ctx;
+    free(ifs->ifs_url);
+    ifs->ifs_url = NULL;
+    ifs->ifs_fctx = NULL;
+    ifs->ifs_ctx = NULL;
   }
+  ifs->ifs_busy = 0;
+  ifs->ifs_lru = ++ifv_tally;
+  hts_cond_broadcast(&ifv_cond);
+  hts_mutex_unlock(&image_from_video_mutex);
 
-  AVPacket pkt;
-  AVFrame *frame = avcodec_alloc_frame();
-  int got_pic;
+  ifv_close(fctx, ctx);
+}
 
 
-  AVStream *st = ifv_fctx->streams[ifv_stream];
-  int64_t ts = av_rescale(sec, st->time_base.den, st->time_base.num);
+/**
+ *
+ */
+static void
+ifv_cacheid(char *buf, size_t len, const char *url, int sec,
+	    const image_meta_t *im)
+{
+  snprintf(buf, len, "%s#%d-%d-%d-3",
+	   url, sec, im->im_req_width, im->im_req_height);
+}
 
-  if(av_seek_frame(ifv_fctx, ifv_stream, ts, AVSEEK_FLAG_BACKWARD) < 0) {
-    ifv_close();
-    snprintf(errbuf, errlen, "Unable to seek to %"PRId64, ts);
+
+/**
+ *
+ */
+static int
+ifv_is_cached(const char *url, int sec, const image_meta_t *im,
+	      time_t mtime)
+{
+  char cacheid[512];
+  time_t cmtime = 0;
+  size_t datasize;
+  void *data;
+
+  ifv_cacheid(cacheid, sizeof(cacheid), url, sec, im);
+  data = blobcache_get(cacheid, "videothumb", &datasize, 0, 0, NULL, &cmtime);
+  if(data == NULL)
+    return 0;
+  free(data);
+  return cmtime == mtime;
+}
+
+
+/**
+ * Scale a decoded frame to the requested size
+ */
+static pixmap_t *
+ifv_frame_to_pixmap(AVCodecContext *ctx, AVFrame *frame,
+		    const image_meta_t *im, char *errbuf, size_t errlen)
+{
+  pixmap_t *pm;
+  int w,h;
+
+  if(im->im_req_width != -1 && im->im_req_height != -1) {
+    w = im->im_req_width;
+    h = im->im_req_height;
+  } else if(im->im_req_width != -1) {
+    w = im->im_req_width;
+    h = im->im_req_width * ctx->height / ctx->width;
+
+  } else if(im->im_req_height != -1) {
+    w = im->im_req_height * ctx->width / ctx->height;
+    h = im->im_req_height;
+  } else {
+    w = im->im_req_width;
+    h = im->im_req_height;
+  }
+
+  pm = pixmap_create(w, h, PIXMAP_RGB24,
+#ifdef __PPC__
+		     16
+#else
+		     1
+#endif
+		     );
+
+  if(pm == NULL) {
+    snprintf(errbuf, errlen, "Out of memory");
     return NULL;
   }
-  
-  avcodec_flush_buffers(ifv_ctx);
+
+  struct SwsContext *sws;
+  sws = sws_getContext(ctx->width, ctx->height, ctx->pix_fmt,
+		       w, h, PIX_FMT_RGB24, SWS_BILINEAR, NULL, NULL, NULL);
+  if(sws == NULL) {
+    snprintf(errbuf, errlen, "Scaling failed");
+    pixmap_release(pm);
+    return NULL;
+  }
+    
+  uint8_t *ptr[4] = {0,0,0,0};
+  int strides[4] = {0,0,0,0};
+
+  ptr[0] = pm->pm_pixels;
+  strides[0] = pm->pm_linesize;
+
+  sws_scale(sws, (const uint8_t **)frame->data, frame->linesize,
+	    0, ctx->height, ptr, strides);
+
+  sws_freeContext(sws);
+  return pm;
+}
+
+
+/**
+ * Store thumbnail as PNG in the blobcache
+ */
+static void
+ifv_store(const pixmap_t *pm, const char *url, int sec,
+	  const image_meta_t *im, time_t mtime)
+{
+  char cacheid[512];
+
+  if(pngencoder == NULL)
+    return;
+
+  AVFrame *oframe = avcodec_alloc_frame();
+
+  oframe->data[0] = pm->pm_pixels;
+  oframe->linesize[0] = pm->pm_linesize;
+      
+  size_t outputsize = MAX(pm->pm_linesize * pm->pm_height,
+			  FF_MIN_BUFFER_SIZE);
+  void *output = malloc(outputsize);
+
+  hts_mutex_lock(&image_from_video_mutex);
+  pngencoder->width = pm->pm_width;
+  pngencoder->height = pm->pm_height;
+  pngencoder->pix_fmt = PIX_FMT_RGB24;
+
+  int r = avcodec_encode_video(pngencoder, output, outputsize, oframe);
+  hts_mutex_unlock(&image_from_video_mutex);
+
+  if(r > 0) {
+    ifv_cacheid(cacheid, sizeof(cacheid), url, sec, im);
+    blobcache_put(cacheid, "videothumb", output, r, INT32_MAX,
+		  NULL, mtime);
+  }
+  free(output);
+  av_free(oframe);
+}
+
 
 #define MAX_FRAME_SCAN 500
-  
+
+/**
+ * Decode the keyframe closest before 'sec'. Only keyframes are fed
+ * to the decoder so this is cheap even for long GOPs.
+ *
+ * Returns 0 if a picture was decoded, 1 if not found and -1 if
+ * the contexts are broken and should be closed
+ */
+static int
+ifv_decode_keyframe(ifv_slot_t *ifs, AVFrame *frame, int sec,
+		    char *errbuf, size_t errlen,
+		    fa_load_cb_t *cb, void *opaque)
+{
+  AVFormatContext *fctx = ifs->ifs_fctx;
+  AVCodecContext *ctx = ifs->ifs_ctx;
+  AVStream *st = fctx->streams[ifs->ifs_stream];
+  int64_t ts = av_rescale(sec, st->time_base.den, st->time_base.num);
+  AVPacket pkt;
+  int got_pic, r;
   int cnt = MAX_FRAME_SCAN;
-  while(1) {
-    int r;
 
-    r = av_read_frame(ifv_fctx, &pkt);
+  if(av_seek_frame(fctx, ifs->ifs_stream, ts, AVSEEK_FLAG_BACKWARD) < 0) {
+    snprintf(errbuf, errlen, "Unable to seek to %"PRId64, ts);
+    return -1;
+  }
+  
+  avcodec_flush_buffers(ctx);
+  ctx->skip_frame = AVDISCARD_NONKEY;
+
+  while(cnt > 0) {
+
+    r = av_read_frame(fctx, &pkt);
     
     if(r == AVERROR(EAGAIN))
       continue;
     
-    if(r == AVERROR_EOF) {
+    if(r == AVERROR_EOF)
       break;
-    }
     
     if(cb != NULL && cb(opaque, 0, 1)) {
       snprintf(errbuf, errlen, "Aborted");
-      break;
+      return 1;
     }
 
     if(r != 0) {
-      ifv_close();
-      break;
+      snprintf(errbuf, errlen, "Read error");
+      return -1;
     }
 
-    if(pkt.stream_index != ifv_stream) {
+    if(pkt.stream_index != ifs->ifs_stream) {
       av_free_packet(&pkt);
       continue;
     }
-    cnt--;
-    int want_pic = pkt.pts >= ts || cnt <= 0;
 
-    ifv_ctx->skip_frame = want_pic ? AVDISCARD_DEFAULT : AVDISCARD_NONREF;
-    
-    avcodec_decode_video2(ifv_ctx, frame, &got_pic, &pkt);
-    av_free_packet(&pkt);
-    if(got_pic == 0 || !want_pic) {
+    cnt--;
+    if(!(pkt.flags & AV_PKT_FLAG_KEY)) {
+      av_free_packet(&pkt);
       continue;
     }
-    int w,h;
-
-    if(im->im_req_width != -1 && im->im_req_height != -1) {
-      w = im->im_req_width;
-      h = im->im_req_height;
-    } else if(im->im_req_width != -1) {
-      w = im->im_req_width;
-      h = im->im_req_width * ifv_ctx->height / ifv_ctx->width;
-
-    } else if(im->im_req_height != -1) {
-      w = im->im_req_height * ifv_ctx->width / ifv_ctx->height;
-      h = im->im_req_height;
-    } else {
-      w = im->im_req_width;
-      h = im->im_req_height;
-    }
 
-    pm = pixmap_create(w, h, PIXMAP_RGB24,
-#ifdef __PPC__
-		       16
-#else
-		       1
-#endif
-		       );
+    avcodec_decode_video2(ctx, frame, &got_pic, &pkt);
+    av_free_packet(&pkt);
+    if(got_pic)
+      return 0;
+  }
 
+  snprintf(errbuf, errlen, "Frame not found (scanned %d)", 
+	   MAX_FRAME_SCAN - cnt);
+  return 1;
+}
 
 
-    if(pm == NULL) {
-      ifv_close();
-      snprintf(errbuf, errlen, "Out of memory");
-      return NULL;
-    }
+/**
+ * Extract thumbnails for all positions in 'secs' (ascending) in one
+ * forward pass over the file and store them in the blobcache.
+ *
+ * If 'pmp' is given the pixmap for secs[0] is returned there
+ *
+ * Returns number of thumbnails extracted
+ */
+static int
+ifv_extract(ifv_slot_t *ifs, const char *url, const image_meta_t *im,
+	    const int *secs, int num, time_t mtime, pixmap_t **pmp,
+	    char *errbuf, size_t errlen, int *broken,
+	    fa_load_cb_t *cb, void *opaque)
+{
+  AVFrame *frame = avcodec_alloc_frame();
+  pixmap_t *pm;
+  int i, r, n = 0;
 
-    struct SwsContext *sws;
-    sws = sws_getContext(ifv_ctx->width, ifv_ctx->height, ifv_ctx->pix_fmt,
-			 w, h, PIX_FMT_RGB24, SWS_BILINEAR, NULL, NULL, NULL);
-    if(sws == NULL) {
-      ifv_close();
-      snprintf(errbuf, errlen, "Scaling failed");
+  for(i = 0; i < num; i++) {
+
+    if(i > 0 && ifv_is_cached(url, secs[i], im, mtime))
+      continue;
+
+    r = ifv_decode_keyframe(ifs, frame, secs[i], errbuf, errlen, cb, opaque);
+    if(r < 0)
+      *broken = 1;
+    if(r)
+      break;
+
+    pm = ifv_frame_to_pixmap(ifs->ifs_ctx, frame, im, errbuf, errlen);
+    if(pm == NULL)
+      break;
+
+    ifv_store(pm, url, secs[i], im, mtime);
+    n++;
+
+    if(i == 0 && pmp != NULL)
+      *pmp = pm;
+    else
       pixmap_release(pm);
-      return NULL;
-    }
-    
-    uint8_t *ptr[4] = {0,0,0,0};
-    int strides[4] = {0,0,0,0};
+  }
 
-    ptr[0] = pm->pm_pixels;
-    strides[0] = pm->pm_linesize;
+  av_free(frame);
+  return n;
+}
 
-    sws_scale(sws, (const uint8_t **)frame->data, frame->linesize,
-	      0, ifv_ctx->height, ptr, strides);
 
-    sws_freeContext(sws);
+/**
+ *
+ */
+static pixmap_t *
+fa_image_from_video2(const char *url, const image_meta_t *im, 
+		     char *errbuf, size_t errlen,
+		     int sec, time_t mtime, fa_load_cb_t *cb, void *opaque)
+{
+  int secs[IFV_SEEK_INDEX_BATCH];
+  int i, num = 1, broken = 0;
+  pixmap_t *pm = NULL;
+  ifv_slot_t *ifs;
+  char cacheid[512];
+  size_t datasize;
+  time_t cmtime = 0;
+  void *data;
 
-    if(pngencoder != NULL) {
-      AVFrame *oframe = avcodec_alloc_frame();
+  if((ifs = ifv_acquire(url, errbuf, errlen, cb, opaque)) == NULL)
+    return NULL;
 
-      memset(&frame, 0, sizeof(frame));
-      oframe->data[0] = pm->pm_pixels;
-      oframe->linesize[0] = pm->pm_linesize;
-      
-      size_t outputsize = MAX(pm->pm_linesize * h, FF_MIN_BUFFER_SIZE);
-      void *output = malloc(outputsize);
-      pngencoder->width = w;
-      pngencoder->height = h;
-      pngencoder->pix_fmt = PIX_FMT_RGB24;
+  // We might have waited for someone who extracted this already
 
-      r = avcodec_encode_video(pngencoder, output, outputsize, oframe);
-      
-      if(r > 0) 
-	blobcache_put(cacheid, "videothumb", output, r, INT32_MAX,
-		      NULL, mtime);
-      free(output);
-      av_free(oframe);
+  ifv_cacheid(cacheid, sizeof(cacheid), url, sec, im);
+  data = blobcache_get(cacheid, "videothumb", &datasize, 0, 0,
+		       NULL, &cmtime);
+  if(data != NULL && cmtime == mtime) {
+    ifv_release(ifs, 0);
+    pm = pixmap_alloc_coded(data, datasize, PIXMAP_PNG);
+    free(data);
+    return pm;
+  }
+  free(data);
+
+  secs[0] = sec;
+
+  if(sec % FA_SEEK_INDEX_INTERVAL == 0) {
+    /* Part of a seek index, the following positions will most likely
+       be asked for right after this one, so grab them while at it */
+    AVFormatContext *fctx = ifs->ifs_fctx;
+    int end = fctx->duration == AV_NOPTS_VALUE ? sec :
+      fctx->duration / 1000000;
+
+    for(i = 1; i < IFV_SEEK_INDEX_BATCH; i++) {
+      int s = sec + i * FA_SEEK_INDEX_INTERVAL;
+      if(s >= end)
+	break;
+      secs[num++] = s;
     }
-    break;
   }
 
-  av_free(frame);
-  if(pm == NULL)
-    snprintf(errbuf, errlen, "Frame not found (scanned %d)", 
-	     MAX_FRAME_SCAN - cnt);
+  ifv_extract(ifs, url, im, secs, num, mtime, &pm, errbuf, errlen,
+	      &broken, cb, opaque);
+  ifv_release(ifs, broken);
   return pm;
 }
 
 
+/**
+ *
+ */
+static int
+ifv_stat(const char *url, time_t *mtime, char *errbuf, size_t errlen)
+{
+  static char *stated_url;
+  static fa_stat_t fs;
+
+  hts_mutex_lock(&image_from_video_mutex);
+  
+  if(strcmp(url, stated_url ?: "")) {
+    free(stated_url);
+    stated_url = NULL;
+    if(fa_stat(url, &fs, errbuf, errlen)) {
+      hts_mutex_unlock(&image_from_video_mutex);
+      return -1;
+    }
+    stated_url = strdup(url);
+  }
+  *mtime = fs.fs_mtime;
+  hts_mutex_unlock(&image_from_video_mutex);
+  return 0;
+}
+
+
 /**
  *
  */
@@ -506,8 +823,6 @@ fa_image_from_video(const char *url0, const image_meta_t *im,
 		    char *errbuf, size_t errlen, int *cache_control,
 		    fa_load_cb_t *cb, void *opaque)
 {
-  static char *stated_url;
-  static fa_stat_t fs;
   time_t stattime = 0;
   time_t mtime = 0;
   pixmap_t *pm = NULL;
@@ -520,22 +835,10 @@ fa_image_from_video(const char *url0, const image_meta_t *im,
   *tim++ = 0;
   int secs = atoi(tim);
 
-  hts_mutex_lock(&image_from_video_mutex);
-  
-  if(strcmp(url, stated_url ?: "")) {
-    free(stated_url);
-    stated_url = NULL;
-    if(fa_stat(url, &fs, errbuf, errlen)) {
-      hts_mutex_unlock(&image_from_video_mutex);
-      return NULL;
-    }
-    stated_url = strdup(url);
-  }
-  stattime = fs.fs_mtime;
-  hts_mutex_unlock(&image_from_video_mutex);
+  if(ifv_stat(url, &stattime, errbuf, errlen))
+    return NULL;
 
-  snprintf(cacheid, sizeof(cacheid), "%s-%d-%d-3",
-	   url0, im->im_req_width, im->im_req_height);
+  ifv_cacheid(cacheid, sizeof(cacheid), url, secs, im);
 
   data = blobcache_get(cacheid, "videothumb", &datasize, 0, 0,
 		       NULL, &mtime);
@@ -544,15 +847,66 @@ fa_image_from_video(const char *url0, const image_meta_t *im,
     free(data);
     return pm;
   }
+  free(data);
+
+  if(secs % FA_SEEK_INDEX_INTERVAL == 0 &&
+     im->im_req_width != FA_SEEK_THUMB_WIDTH) {
+    // Seek index thumbnails might have been generated in the background
+    image_meta_t im0 = *im;
+    im0.im_req_width = FA_SEEK_THUMB_WIDTH;
+    im0.im_req_height = -1;
+    ifv_cacheid(cacheid, sizeof(cacheid), url, secs, &im0);
+    data = blobcache_get(cacheid, "videothumb", &datasize, 0, 0,
+			 NULL, &mtime);
+    if(data != NULL && mtime == stattime) {
+      pm = pixmap_alloc_coded(data, datasize, PIXMAP_PNG);
+      free(data);
+      return pm;
+    }
+    free(data);
+  }
 
   if(ONLY_CACHED(cache_control)) {
     snprintf(errbuf, errlen, "Not cached");
     return NULL;
   }
 
-  hts_mutex_lock(&image_from_video_mutex);
-  pm = fa_image_from_video2(url, im, cacheid, errbuf, errlen,
-			    secs, stattime, cb, opaque);
-  hts_mutex_unlock(&image_from_video_mutex);
-  return pm;
+  return fa_image_from_video2(url, im, errbuf, errlen,
+			      secs, stattime, cb, opaque);
+}
+
+
+/**
+ * Extract and cache thumbnails for several positions of a video in
+ * one pass. They can then be loaded as "<url>#<sec>" with the same
+ * requested size
+ */
+int
+fa_image_from_video_batch(const char *url, const image_meta_t *im,
+			  const int *secs, int num,
+			  char *errbuf, size_t errlen,
+			  fa_load_cb_t *cb, void *opaque)
+{
+  ifv_slot_t *ifs;
+  time_t mtime;
+  int i, n = 0, broken = 0;
+  int *todo = alloca(num * sizeof(int));
+
+  if(ifv_stat(url, &mtime, errbuf, errlen))
+    return -1;
+
+  for(i = 0; i < num; i++)
+    if(!ifv_is_cached(url, secs[i], im, mtime))
+      todo[n++] = secs[i];
+
+  if(n == 0)
+    return 0;
+
+  if((ifs = ifv_acquire(url, errbuf, errlen, cb, opaque)) == NULL)
+    return -1;
+
+  n = ifv_extract(ifs, url, im, todo, n, mtime, NULL, errbuf, errlen,
+		  &broken, cb, opaque);
+  ifv_release(ifs, broken);
+  return n;
 }
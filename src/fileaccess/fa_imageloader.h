@@ -29,5 +29,10 @@ pixmap_t *fa_imageloader(const char *url, const struct image_meta *im,
 			 const char **vpaths, char *errbuf, size_t errlen,
 			 int *cache_control, fa_load_cb_t *cb, void *opaque);
 
+int fa_image_from_video_batch(const char *url, const struct image_meta *im,
+			      const int *secs, int num,
+			      char *errbuf, size_t errlen,
+			      fa_load_cb_t *cb, void *opaque);
+
 
 #endif /* FA_IMAGELOADER_H */
@@ -112,6 +112,7 @@ static const struct {
   { "video/mp4", "mp4" },
   { "video/x-msvideo", "avi" },
   { "video/vnd.dlna.mpeg-tts,", "mpegts" },
+  { "video/MP2T", "mpegts" },
   { "video/avi", "avi" },
   { "audio/x-mpeg", "mp3" },
 };
@@ -370,7 +370,7 @@ fa_searcher (void *aux)
     return NULL;
   }
 
-  fas->fas_pc = prop_courier_create_passive();
+  fas->fas_pc = prop_courier_create_passive(0);
   fas->fas_sub = 
     prop_subscribe(PROP_SUB_TRACK_DESTROY,
 		   PROP_TAG_CALLBACK, fa_search_nodesub, fas,
@@ -23,6 +23,8 @@
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #include "showtime.h"
 #include "navigator.h"
@@ -36,6 +38,9 @@
 
 extern int media_buffer_hungry;
 
+TAILQ_HEAD(probe_job_queue, probe_job);
+TAILQ_HEAD(scanner_queue, scanner);
+
 typedef struct scanner {
   int s_refcount;
 
@@ -58,11 +63,48 @@ typedef struct scanner {
 
   struct prop_nf *s_pnf;
 
+  metadb_batch_t *s_batch; // Metadata writes while analyzing
+
+  /**
+   * Deep probe jobs, protected by probe_mutex
+   */
+  int s_prio;
+  int s_probe_pending;   // Queued + running
+  char s_probe_queued;   // Linked on probe_scanners
+  struct probe_job_queue s_probe_jobs;
+  TAILQ_ENTRY(scanner) s_probe_link;
+
 } scanner_t;
 
 static void rescan(scanner_t *s);
 
 
+/**
+ * Deep probing is done by a pool of workers shared by all scanners.
+ * Scanners with pending jobs are kept on probe_scanners, most
+ * recently opened directory first, so what the user is currently
+ * looking at is probed before directories further back in the
+ * navigation history. Within a scanner jobs are in directory order.
+ */
+typedef struct probe_job {
+  TAILQ_ENTRY(probe_job) pj_link;
+  fa_dir_entry_t *pj_fde;
+} probe_job_t;
+
+#define PROBE_WORKERS_MAX 4
+
+static hts_mutex_t probe_mutex;
+static hts_cond_t probe_cond;        // New jobs, or a probe finished
+static hts_cond_t probe_done_cond;   // A probe finished, or a scanner stopped
+static struct scanner_queue probe_scanners;
+static int probe_workers_max = PROBE_WORKERS_MAX;
+static int probe_workers;
+static int probe_idle;
+static int probe_queued;      // Jobs not yet picked up by a worker
+static int probe_active;
+static int probe_generation;
+
+
 /**
  *
  */
@@ -218,7 +260,7 @@ type_from_filename(const char *filename)
  *
  */
 static void
-deep_probe(fa_dir_entry_t *fde, scanner_t *s)
+deep_probe(fa_dir_entry_t *fde, scanner_t *s, void *db)
 {
   fde->fde_probestatus = FDE_PROBE_DEEP;
 
@@ -230,7 +272,7 @@ deep_probe(fa_dir_entry_t *fde, scanner_t *s)
     if(!fde->fde_ignore_cache && !fa_dir_entry_stat(fde)) {
       if(fde->fde_md != NULL)
 	metadata_destroy(fde->fde_md);
-      fde->fde_md = metadb_metadata_get(getdb(s), rstr_get(fde->fde_url),
+      fde->fde_md = metadb_metadata_get(db, rstr_get(fde->fde_url),
 					fde->fde_stat.fs_mtime);
     }
 
@@ -259,22 +301,148 @@ deep_probe(fa_dir_entry_t *fde, scanner_t *s)
       }
       
       if(fde->fde_md->md_cached == 0) {
-	metadb_metadata_write(getdb(s), rstr_get(fde->fde_url),
-			      fde->fde_stat.fs_mtime,
-			      fde->fde_md, s->s_url, s->s_mtime);
+	metadb_batch_write(s->s_batch, rstr_get(fde->fde_url),
+			   fde->fde_stat.fs_mtime,
+			   fde->fde_md, s->s_url, s->s_mtime);
       }
     }
     prop_ref_dec(meta);
 
     if(!fde->fde_bound_to_metadb) {
       fde->fde_bound_to_metadb = 1;
-      metadb_bind_url_to_prop(getdb(s), rstr_get(fde->fde_url), fde->fde_prop);
+      metadb_bind_url_to_prop(db, rstr_get(fde->fde_url), fde->fde_prop);
     }
   }
   set_type(fde->fde_prop, fde->fde_type);
 }
 
 
+/**
+ *
+ */
+static void *
+probe_worker(void *aux)
+{
+  scanner_t *s;
+  probe_job_t *pj;
+  void *db;
+
+  hts_mutex_lock(&probe_mutex);
+
+  while(1) {
+
+    if((s = TAILQ_FIRST(&probe_scanners)) == NULL) {
+      probe_idle++;
+      int timeout = hts_cond_wait_timeout(&probe_cond, &probe_mutex, 5000);
+      probe_idle--;
+      if(timeout && TAILQ_FIRST(&probe_scanners) == NULL)
+	break;
+      continue;
+    }
+
+    if(media_buffer_hungry && probe_active > 0) {
+      // Playback is starving, let only one probe run at a time
+      hts_cond_wait_timeout(&probe_cond, &probe_mutex, 1000);
+      continue;
+    }
+
+    pj = TAILQ_FIRST(&s->s_probe_jobs);
+    TAILQ_REMOVE(&s->s_probe_jobs, pj, pj_link);
+    probe_queued--;
+    if(TAILQ_FIRST(&s->s_probe_jobs) == NULL) {
+      TAILQ_REMOVE(&probe_scanners, s, s_probe_link);
+      s->s_probe_queued = 0;
+    }
+
+    probe_active++;
+    hts_mutex_unlock(&probe_mutex);
+
+    db = metadb_get();
+    deep_probe(pj->pj_fde, s, db);
+    metadb_close(db);
+    free(pj);
+
+    hts_mutex_lock(&probe_mutex);
+    probe_active--;
+    s->s_probe_pending--;
+    hts_cond_broadcast(&probe_done_cond);
+    hts_cond_signal(&probe_cond);
+  }
+
+  probe_workers--;
+  hts_mutex_unlock(&probe_mutex);
+  return NULL;
+}
+
+
+/**
+ * probe_mutex must be held
+ */
+static void
+probe_enqueue(scanner_t *s, fa_dir_entry_t *fde)
+{
+  probe_job_t *pj = malloc(sizeof(probe_job_t));
+  scanner_t *n;
+
+  pj->pj_fde = fde;
+  TAILQ_INSERT_TAIL(&s->s_probe_jobs, pj, pj_link);
+  s->s_probe_pending++;
+  probe_queued++;
+
+  if(!s->s_probe_queued) {
+    s->s_probe_queued = 1;
+    TAILQ_FOREACH(n, &probe_scanners, s_probe_link)
+      if(n->s_prio < s->s_prio)
+	break;
+    if(n != NULL)
+      TAILQ_INSERT_BEFORE(n, s, s_probe_link);
+    else
+      TAILQ_INSERT_TAIL(&probe_scanners, s, s_probe_link);
+  }
+
+  /* Idle workers only pick up one job each, so keep growing the pool
+     while there is more work queued than there are idle workers */
+  if(probe_queued > probe_idle && probe_workers < probe_workers_max) {
+    probe_workers++;
+    hts_thread_create_detached("fa probe", probe_worker, NULL,
+			       THREAD_PRIO_LOW);
+  }
+  hts_cond_signal(&probe_cond);
+}
+
+
+/**
+ * Wait for all our probes to complete. If the scanner is stopped,
+ * jobs that have not started yet are dropped
+ */
+static void
+probe_wait(scanner_t *s)
+{
+  probe_job_t *pj;
+
+  hts_mutex_lock(&probe_mutex);
+  while(s->s_probe_pending > 0) {
+
+    if(s->s_stop) {
+      while((pj = TAILQ_FIRST(&s->s_probe_jobs)) != NULL) {
+	TAILQ_REMOVE(&s->s_probe_jobs, pj, pj_link);
+	free(pj);
+	s->s_probe_pending--;
+	probe_queued--;
+      }
+      if(s->s_probe_queued) {
+	TAILQ_REMOVE(&probe_scanners, s, s_probe_link);
+	s->s_probe_queued = 0;
+      }
+      if(s->s_probe_pending == 0)
+	break;
+    }
+    hts_cond_wait(&probe_done_cond, &probe_mutex);
+  }
+  hts_mutex_unlock(&probe_mutex);
+}
+
+
 /**
  *
  */
@@ -312,12 +480,14 @@ analyzer(scanner_t *s, int probe)
   if(probe)
     tryplay(s);
 
+  if(probe)
+    s->s_batch = metadb_batch_begin(s->s_url);
+
+  hts_mutex_lock(&probe_mutex);
+
   /* Scan all entries */
   TAILQ_FOREACH(fde, &s->s_fd->fd_entries, fde_link) {
 
-    while(media_buffer_hungry && !s->s_stop) 
-      sleep(1);
-
     if(s->s_stop)
       break;
 
@@ -329,7 +499,19 @@ analyzer(scanner_t *s, int probe)
     }
 
     if(fde->fde_probestatus == FDE_PROBE_FILENAME && probe)
-      deep_probe(fde, s);
+      probe_enqueue(s, fde);
+  }
+
+  hts_mutex_unlock(&probe_mutex);
+
+  /*
+   * Entries must stay put while probed so we wait for the workers
+   * before returning to whoever might modify the directory
+   */
+  if(probe) {
+    probe_wait(s);
+    metadb_batch_commit(s->s_batch);
+    s->s_batch = NULL;
   }
 }
 
@@ -597,7 +779,10 @@ scanner_stop(void *opaque, prop_event_t event, ...)
 
   prop_unsubscribe(va_arg(ap, prop_sub_t *));
 
+  hts_mutex_lock(&probe_mutex);
   s->s_stop = 1;
+  hts_cond_broadcast(&probe_done_cond);
+  hts_mutex_unlock(&probe_mutex);
   scanner_unref(s);
 }
 
@@ -861,6 +1046,8 @@ fa_scanner(const char *url, time_t url_mtime,
 
   s->s_mtime = url_mtime;
   s->s_playme = playme != NULL ? strdup(playme) : NULL;
+  TAILQ_INIT(&s->s_probe_jobs);
+  s->s_prio = atomic_add(&probe_generation, 1);
 
   prop_set_int(prop_create(model, "loading"), 1);
 
@@ -880,3 +1067,159 @@ fa_scanner(const char *url, time_t url_mtime,
 		 PROP_TAG_ROOT, s->s_root,
 		 NULL);
 }
+
+
+/**
+ *
+ */
+void
+fa_scanner_init(void)
+{
+  hts_mutex_init(&probe_mutex);
+  hts_cond_init(&probe_cond, &probe_mutex);
+  hts_cond_init(&probe_done_cond, &probe_mutex);
+  TAILQ_INIT(&probe_scanners);
+}
+
+
+/**
+ * Append an ID3v2 text frame
+ */
+static int
+bench_id3_frame(uint8_t *p, const char *id, const char *str)
+{
+  int len = strlen(str) + 1;
+
+  memcpy(p, id, 4);
+  p[4] = len >> 24;
+  p[5] = len >> 16;
+  p[6] = len >> 8;
+  p[7] = len;
+  p[8] = p[9] = 0;
+  p[10] = 0; // ISO-8859-1
+  memcpy(p + 11, str, len - 1);
+  return 10 + len;
+}
+
+
+/**
+ * Write a small but valid MP3 file: An ID3v2.3 tag followed by a few
+ * seconds of silent 128kbps mono MPEG-1 layer III frames
+ */
+static int
+bench_write_mp3(const char *fname, int idx)
+{
+  const int framesize = 144 * 128000 / 44100;
+  const int frames = 3 * 44100 / 1152;
+  uint8_t tag[512], frame[framesize];
+  char str[64];
+  int fd, i, len = 10, r = 0;
+
+  snprintf(str, sizeof(str), "Track number %d", idx + 1);
+  len += bench_id3_frame(tag + len, "TIT2", str);
+  snprintf(str, sizeof(str), "Artist %d", idx % 17);
+  len += bench_id3_frame(tag + len, "TPE1", str);
+  snprintf(str, sizeof(str), "Album %d", idx / 12);
+  len += bench_id3_frame(tag + len, "TALB", str);
+  snprintf(str, sizeof(str), "%d", idx % 12 + 1);
+  len += bench_id3_frame(tag + len, "TRCK", str);
+
+  memcpy(tag, "ID3\x03\x00\x00", 6);
+  tag[6] = ((len - 10) >> 21) & 0x7f;
+  tag[7] = ((len - 10) >> 14) & 0x7f;
+  tag[8] = ((len - 10) >>  7) & 0x7f;
+  tag[9] =  (len - 10)        & 0x7f;
+
+  memset(frame, 0, framesize);
+  frame[0] = 0xff;
+  frame[1] = 0xfb;  // MPEG-1, layer III, no CRC
+  frame[2] = 0x90;  // 128kbps, 44100Hz, no padding
+  frame[3] = 0xc4;  // Mono, original
+
+  if((fd = open(fname, O_CREAT | O_TRUNC | O_WRONLY, 0666)) == -1)
+    return 1;
+
+  if(write(fd, tag, len) != len)
+    r = 1;
+
+  for(i = 0; i < frames && !r; i++)
+    if(write(fd, frame, framesize) != framesize)
+      r = 1;
+
+  close(fd);
+  return r;
+}
+
+
+/**
+ * Deep probe a directory of small MP3 files with 1, 2 and 4 workers
+ */
+int
+fa_scanner_bench(void)
+{
+  const int num = 300;
+  char path[256], fname[300], url[300];
+  fa_dir_entry_t *fde;
+  scanner_t *s;
+  int64_t ts;
+  int i, w, probed;
+
+  snprintf(path, sizeof(path), "%s/scannerbench", showtime_cache_path);
+  mkdir(path, 0777);
+
+  for(i = 0; i < num; i++) {
+    snprintf(fname, sizeof(fname), "%s/file%04d.mp3", path, i);
+    if(bench_write_mp3(fname, i))
+      return 1;
+  }
+
+  snprintf(url, sizeof(url), "file://%s", path);
+
+  for(w = 1; w <= PROBE_WORKERS_MAX; w *= 2) {
+    probe_workers_max = w;
+
+    s = calloc(1, sizeof(scanner_t));
+    s->s_url = url;
+    TAILQ_INIT(&s->s_probe_jobs);
+    s->s_prio = atomic_add(&probe_generation, 1);
+
+    if((s->s_fd = fa_scandir(url, NULL, 0)) == NULL) {
+      free(s);
+      return 1;
+    }
+
+    TAILQ_FOREACH(fde, &s->s_fd->fd_entries, fde_link) {
+      fde->fde_ignore_cache = 1;
+      make_prop(fde);
+    }
+
+    ts = showtime_get_ts();
+    analyzer(s, 1);
+    ts = showtime_get_ts() - ts;
+
+    probed = 0;
+    TAILQ_FOREACH(fde, &s->s_fd->fd_entries, fde_link)
+      if(fde->fde_md != NULL && fde->fde_md->md_duration > 0)
+	probed++;
+
+    TRACE(TRACE_INFO, "scanner",
+	  "Probed %d files (%d with duration) with %d workers "
+	  "in %d ms (%d files/s)",
+	  s->s_fd->fd_count, probed, w, (int)(ts / 1000),
+	  (int)(s->s_fd->fd_count * 1000000LL / MAX(ts, 1)));
+
+    TAILQ_FOREACH(fde, &s->s_fd->fd_entries, fde_link)
+      prop_destroy(fde->fde_prop);
+    fa_dir_free(s->s_fd);
+    closedb(s);
+    free(s);
+  }
+
+  for(i = 0; i < num; i++) {
+    snprintf(fname, sizeof(fname), "%s/file%04d.mp3", path, i);
+    unlink(fname);
+  }
+  rmdir(path);
+  probe_workers_max = PROBE_WORKERS_MAX;
+  return 0;
+}
@@ -119,7 +119,7 @@ spotlight_searcher(void *aux)
   snprintf(iconpath, sizeof(iconpath), "%s/resources/fileaccess/fs_icon.png",
 	   showtime_dataroot());
 
-  fas->fas_pc = prop_courier_create_passive();
+  fas->fas_pc = prop_courier_create_passive(0);
   fas->fas_sub = 
   prop_subscribe(PROP_SUB_TRACK_DESTROY,
                  PROP_TAG_CALLBACK, spotlight_search_nodesub, fas,
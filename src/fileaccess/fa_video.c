@@ -44,6 +44,7 @@
 #include "text/text.h"
 #include "video/video_settings.h"
 #include "video/vobsub.h"
+#include "fa_imageloader.h"
 
 
 typedef struct seek_item {
@@ -55,6 +56,11 @@ typedef struct seek_index {
   prop_t *si_root;
   int si_nitems;
   seek_item_t *si_current;
+
+  char *si_url;
+  int si_refcount;             // Playback + background thumbnail generator
+  int si_thumb_stop;
+
   seek_item_t si_items[0];
 } seek_index_t;
 
@@ -598,6 +604,86 @@ video_player_loop(AVFormatContext *fctx, media_codec_t **cwvec,
 }
 
 
+/**
+ *
+ */
+static void
+seek_index_release(seek_index_t *si)
+{
+  if(atomic_add(&si->si_refcount, -1) > 1)
+    return;
+  free(si->si_url);
+  free(si);
+}
+
+
+/**
+ *
+ */
+static int
+seek_thumbs_abort(void *opaque, int loaded, int total)
+{
+  seek_index_t *si = opaque;
+  return si->si_thumb_stop;
+}
+
+
+/**
+ * Extract all seek index thumbnails into the blobcache so scrubbing
+ * doesn't have to wait for the demuxer. We run at low priority, sleep
+ * as long as we worked after each batch and pause completely while
+ * playback is starving for data.
+ *
+ * The thread is detached and holds its own reference to the index, so
+ * stopping playback never waits for a slow open or probe in here
+ */
+static void *
+seek_thumbs_thread(void *aux)
+{
+  seek_index_t *si = aux;
+  image_meta_t im = {0};
+  char errbuf[256];
+  int secs[4];
+  int i, n, r, done = 0;
+  int64_t ts, ms;
+
+  im.im_req_width  = FA_SEEK_THUMB_WIDTH;
+  im.im_req_height = -1;
+
+  for(i = 0; i < si->si_nitems && !si->si_thumb_stop; ) {
+
+    if(media_buffer_hungry) {
+      usleep(100000);
+      continue;
+    }
+
+    for(n = 0; n < 4 && i < si->si_nitems; n++, i++)
+      secs[n] = si->si_items[i].si_start;
+
+    ts = showtime_get_ts();
+    r = fa_image_from_video_batch(si->si_url, &im, secs, n,
+				  errbuf, sizeof(errbuf),
+				  seek_thumbs_abort, si);
+    if(r < 0) {
+      TRACE(TRACE_DEBUG, "Video", "Seek thumbnails for %s failed -- %s",
+	    si->si_url, errbuf);
+      break;
+    }
+    done += r;
+
+    ms = MAX((showtime_get_ts() - ts) / 1000, 100);
+    for(; ms > 0 && !si->si_thumb_stop; ms -= 100)
+      usleep(100000);
+  }
+
+  if(done)
+    TRACE(TRACE_DEBUG, "Video", "Generated %d seek thumbnails for %s",
+	  done, si->si_url);
+  seek_index_release(si);
+  return NULL;
+}
+
+
 /**
  *
  */
@@ -609,7 +695,7 @@ build_index(media_pipe_t *mp, AVFormatContext *fctx, const char *url)
 
   char buf[URL_MAX];
 
-  int items = fctx->duration / 60000000;
+  int items = fctx->duration / (FA_SEEK_INDEX_INTERVAL * 1000000LL);
 
   seek_index_t *si = mymalloc(sizeof(seek_index_t) +
 			      sizeof(seek_item_t) * items);
@@ -621,6 +707,9 @@ build_index(media_pipe_t *mp, AVFormatContext *fctx, const char *url)
 
   si->si_current = NULL;
   si->si_nitems = items;
+  si->si_url = strdup(url);
+  si->si_refcount = 1;
+  si->si_thumb_stop = 0;
 
   prop_set_int(prop_create(si->si_root, "available"), 1);
 
@@ -630,16 +719,22 @@ build_index(media_pipe_t *mp, AVFormatContext *fctx, const char *url)
 
     prop_t *p = prop_create_root(NULL);
 
-    snprintf(buf, sizeof(buf), "%s#%d", url, i * 60);
+    snprintf(buf, sizeof(buf), "%s#%d", url, i * FA_SEEK_INDEX_INTERVAL);
     prop_set_string(prop_create(p, "image"), buf);
-    prop_set_float(prop_create(p, "timestamp"), i * 60);
+    prop_set_float(prop_create(p, "timestamp"), i * FA_SEEK_INDEX_INTERVAL);
 
     item->si_prop = p;
-    item->si_start = i * 60;
+    item->si_start = i * FA_SEEK_INDEX_INTERVAL;
 
     if(prop_set_parent(p, parent))
       abort();
   }
+
+  if(video_settings.seek_thumbnails && items > 0) {
+    si->si_refcount++;
+    hts_thread_create_detached("seekthumbs", seek_thumbs_thread, si,
+			       THREAD_PRIO_LOW);
+  }
   return si;
 }
 
@@ -651,13 +746,30 @@ seek_index_destroy(seek_index_t *si)
 {
   if(si == NULL)
     return;
+
+  si->si_thumb_stop = 1;
   prop_destroy(si->si_root);
-  free(si);
+  seek_index_release(si);
 }
 
 
 
 
+/**
+ *
+ */
+static event_t *
+file_playdvd(const char *url, media_pipe_t *mp, char *errbuf, size_t errlen)
+{
+#if ENABLE_DVD
+  return dvd_play(url, mp, errbuf, errlen, 1);
+#else
+  snprintf(errbuf, errlen, "DVD playback is not supported");
+  return NULL;
+#endif
+}
+
+
 /**
  *
  */
@@ -668,25 +780,6 @@ be_file_playvideo(const char *url, media_pipe_t *mp,
 		  const char *mimetype,
 		  const char *canonical_url)
 {
-  AVFormatContext *fctx;
-  AVCodecContext *ctx;
-  media_format_t *fw;
-  int i;
-  media_codec_t **cwvec;
-  event_t *e;
-  uint8_t buf[64];
-
-  uint64_t hash;
-  int64_t fsize;
-
-  hts_thread_t sub_tid = 0;
-  sub_load_t sl;
-
-  int freetype_context = freetype_get_context();
-
-  struct attachment_list alist;
-  LIST_INIT(&alist);
-
   if(mimetype == NULL) {
     struct fa_stat fs;
 
@@ -703,19 +796,55 @@ be_file_playvideo(const char *url, media_pipe_t *mp,
       metadata_destroy(md);
 
       if(is_dvd)
-	goto isdvd;
+	return file_playdvd(url, mp, errbuf, errlen);
       return NULL;
     }
   }
 
-  /**
-   * Check file type
-   */
   fa_handle_t *fh;
   fh = fa_open_ex(url, errbuf, errlen, FA_BUFFERED_BIG, mp->mp_prop_io);
   if(fh == NULL)
     return NULL;
 
+  return be_file_playvideo_fh(url, mp, flags, priority, errbuf, errlen,
+			      mimetype, canonical_url, fh);
+}
+
+
+/**
+ * Play video from an already opened file handle. The handle is
+ * consumed (closed) in all cases
+ */
+event_t *
+be_file_playvideo_fh(const char *url, media_pipe_t *mp,
+		     int flags, int priority,
+		     char *errbuf, size_t errlen,
+		     const char *mimetype,
+		     const char *canonical_url,
+		     fa_handle_t *fh)
+{
+  AVFormatContext *fctx;
+  AVCodecContext *ctx;
+  media_format_t *fw;
+  int i;
+  media_codec_t **cwvec;
+  event_t *e;
+  uint8_t buf[64];
+
+  uint64_t hash;
+  int64_t fsize;
+
+  hts_thread_t sub_tid = 0;
+  sub_load_t sl;
+
+  int freetype_context = freetype_get_context();
+
+  struct attachment_list alist;
+  LIST_INIT(&alist);
+
+  /**
+   * Check file type
+   */
   if(fa_read(fh, buf, sizeof(buf)) == sizeof(buf)) {
     if(!memcmp(buf, "<showtimeplaylist", strlen("<showtimeplaylist"))) {
       return playlist_play(fh, mp, flags, priority, errbuf, errlen);
@@ -737,13 +866,7 @@ be_file_playvideo(const char *url, media_pipe_t *mp,
   if(seek_is_fast && mimetype == NULL) {
     if(fa_probe_iso(NULL, fh) == 0) {
       fa_close(fh);
-    isdvd:
-#if ENABLE_DVD
-      return dvd_play(url, mp, errbuf, errlen, 1);
-#else
-      snprintf(errbuf, errlen, "DVD playback is not supported");
-      return NULL;
-#endif
+      return file_playdvd(url, mp, errbuf, errlen);
     }
   }
 
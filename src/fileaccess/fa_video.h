@@ -20,10 +20,17 @@
 #define FA_VIDEO_H
 
 #include "media.h"
+#include "fileaccess.h"
 
 event_t *be_file_playvideo(const char *url, media_pipe_t *mp,
 			   int flags, int priority,
 			   char *errbuf, size_t errlen,
 			   const char *mimetype, const char *canonical_url);
 
+event_t *be_file_playvideo_fh(const char *url, media_pipe_t *mp,
+			      int flags, int priority,
+			      char *errbuf, size_t errlen,
+			      const char *mimetype, const char *canonical_url,
+			      fa_handle_t *fh);
+
 #endif /* FA_VIDEO_H */
@@ -552,6 +552,7 @@ fileaccess_init(void)
 {
   fa_protocol_t *fap;
   fa_imageloader_init();
+  fa_scanner_init();
 
   LIST_FOREACH(fap, &fileaccess_all_protocols, fap_link)
     if(fap->fap_init != NULL)
@@ -104,6 +104,10 @@ int fa_dir_entry_stat(fa_dir_entry_t *fde);
 LIST_HEAD(fa_protocol_list, fa_protocol);
 extern struct fa_protocol_list fileaccess_all_protocols;
 
+extern int http_prefetch_window;
+
+void http_prefetch_set_segment_size(int size);
+
 
 #define FA_DEBUG           0x1
 // #define FA_DUMP  0x2
@@ -115,6 +119,17 @@ extern struct fa_protocol_list fileaccess_all_protocols;
 #define FA_COMPRESSION     0x80
 #define FA_NOFOLLOW        0x100
 
+/**
+ * Spacing (in seconds) of video seek index thumbnails
+ */
+#define FA_SEEK_INDEX_INTERVAL 60
+
+/**
+ * Width of seek index thumbnails generated in the background. Used
+ * when the exact size asked for is not cached
+ */
+#define FA_SEEK_THUMB_WIDTH 320
+
 /**
  *
  */
@@ -172,6 +187,10 @@ void fa_scanner(const char *url, time_t mtime,
 		prop_t *model, const char *playme,
 		prop_t *direct_close, rstr_t *title);
 
+void fa_scanner_init(void);
+
+int fa_scanner_bench(void);
+
 void *fa_load(const char *url, size_t *sizep, const char **vpaths,
 	      char *errbuf, size_t errlen, int *cache_control, int flags,
 	      fa_load_cb_t *cb, void *opaque);
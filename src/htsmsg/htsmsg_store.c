@@ -262,8 +262,8 @@ htsmsg_store_save(htsmsg_t *record, const char *pathfmt, ...)
       break;
   
   if(!callout_isarmed(&pending_store_callout))
-    callout_arm(&pending_store_callout, pending_store_fire, NULL,
-		SETTINGS_STORE_DELAY);
+    callout_arm_worker(&pending_store_callout, pending_store_fire, NULL,
+		       SETTINGS_STORE_DELAY);
 
   if(ps == NULL) {
     ps = malloc(sizeof(pending_store_t));
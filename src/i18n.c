@@ -311,6 +311,21 @@ nls_get_prop(const char *string)
 }
 
 
+/**
+ * Return the key a prop from nls_get_prop() was created for
+ */
+rstr_t *
+nls_get_key(prop_t *p)
+{
+  nls_string_t *ns;
+
+  LIST_FOREACH(ns, &nls_strings, ns_link)
+    if(ns->ns_prop == p)
+      return rstr_dup(ns->ns_key);
+  return NULL;
+}
+
+
 /**
  *
  */
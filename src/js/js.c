@@ -946,7 +946,7 @@ js_init(void)
   JS_ClearContextThread(cx);
   js_global_pc = prop_courier_create_lockmgr("js", js_lockmgr, cx,
 					     js_global_pc_prologue,
-					     js_global_pc_epilogue);
+					     js_global_pc_epilogue, 0);
 
   js_event_sub = prop_subscribe(0,
 				PROP_TAG_CALLBACK, js_global_event, NULL,
@@ -155,7 +155,7 @@ JSBool
 js_wait_for_value(JSContext *cx, prop_t *root, const char *subname,
 		  jsval value, jsval *rval)
 {
-  prop_courier_t *pc = prop_courier_create_waitable();
+  prop_courier_t *pc = prop_courier_create_waitable(0);
   prop_sub_t *s;
   wfv_t wfv;
   wfv.value = value;
@@ -50,15 +50,24 @@
 #include "keymapper.h"
 #include "plugins.h"
 #include "blobcache.h"
+#include "fileaccess/fileaccess.h"
 #include "i18n.h"
 #include "misc/string.h"
 #include "misc/pixmap.h"
 #include "text/text.h"
 #include "video/video_settings.h"
+#include "video/hls.h"
 #include "metadata/metadata.h"
 #include "ext/sqlite/sqlite3.h"
 #include "js/js.h"
 #include "db/kvstore.h"
+#include "db/db_support.h"
+#if ENABLE_GLW
+#include "ui/glw/glw.h"
+#include "ui/glw/glw_text_bitmap.h"
+#include "ui/glw/glw_view.h"
+#include "ui/glw/glw_renderer.h"
+#endif
 
 #if ENABLE_HTTPSERVER
 #include "networking/http_server.h"
@@ -151,6 +160,49 @@ fflog(void *ptr, int level, const char *fmt, va_list vl)
 }
 
 
+/**
+ * Internal benchmarks, run with --bench <name>
+ */
+static const struct {
+  const char *name;
+  int (*fn)(void);
+} benchmarks[] = {
+  { "callout",       callout_bench },
+  { "fa_scanner",    fa_scanner_bench },
+  { "hls",           hls_bench },
+  { "prop_domain",   prop_domain_bench },
+#if ENABLE_GLW
+  { "glw_text",      glw_text_bench },
+  { "glw_view",      glw_view_bench },
+  { "glw_tesselate", glw_renderer_bench },
+#endif
+#if ENABLE_GLW_FRONTEND_HEADLESS
+  { "glw_frame",     glw_headless_bench },
+#endif
+};
+
+
+/**
+ *
+ */
+static int
+run_bench(const char *name)
+{
+  int i;
+  for(i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+    if(!strcmp(benchmarks[i].name, name)) {
+      TRACE(TRACE_INFO, "bench", "Running benchmark %s", name);
+      return benchmarks[i].fn();
+    }
+  }
+
+  TRACE(TRACE_ERROR, "bench", "Unknown benchmark %s, available:", name);
+  for(i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+    TRACE(TRACE_ERROR, "bench", "  %s", benchmarks[i].name);
+  return 1;
+}
+
+
 /**
  * Set some info in the global property tree that might be interesting
  */
@@ -181,6 +233,8 @@ main(int argc, char **argv)
   const char *devplugin = NULL;
   const char *plugin_repo = NULL;
   const char *jsfile = NULL;
+  const char *bench = NULL;
+  const char *precompile = NULL;
   int nuiargs = 0;
   int r;
 #if ENABLE_HTTPSERVER
@@ -230,20 +284,34 @@ main(int argc, char **argv)
 #endif
 #if ENABLE_HTTPSERVER
 	     "   --disable-upnp    - Disable UPNP/DLNA stack.\n"
+	     "   --http-workers <n>\n"
+	     "                     - Number of HTTP server worker threads.\n"
 #endif
+	     "   --http-prefetch <n>\n"
+	     "                     - Number of parallel HTTP range requests\n"
+	     "                       when streaming (0 or 1 to disable) [%d].\n"
+	     "   --http-prefetch-size <kB>\n"
+	     "                     - Size of each HTTP range request when\n"
+	     "                       prefetching [256].\n"
 	     "   --disable-sd      - Disable service discovery (mDNS, etc).\n"
 	     "   -p                - Path to plugin directory to load\n"
 	     "                       Intended for plugin development\n"
 	     "   --plugin-repo     - URL to plugin repository\n"
 	     "                       Intended for plugin development\n"
 	     "   -j <path>           Load javascript file\n"
+	     "   --bench <name>    - Run internal benchmark and exit\n"
+#if ENABLE_GLW
+	     "   --precompile-views <themedir>\n"
+	     "                     - Store parsed views in theme and exit\n"
+#endif
 	     "\n"
 	     "  URL is any URL-type supported by Showtime, "
 	     "e.g., \"file:///...\"\n"
 	     "\n",
 	     htsversion_full,
 	     argv0,
-	     showtime_cache_path);
+	     showtime_cache_path,
+	     http_prefetch_window);
       exit(0);
       argc--;
       argv++;
@@ -275,7 +343,19 @@ main(int argc, char **argv)
       do_upnp = 0;
       argc -= 1; argv += 1;
       continue;
+    } else if(!strcmp(argv[0], "--http-workers") && argc > 1) {
+      http_server_workers = atoi(argv[1]);
+      argc -= 2; argv += 2;
+      continue;
 #endif
+    } else if(!strcmp(argv[0], "--http-prefetch") && argc > 1) {
+      http_prefetch_window = atoi(argv[1]);
+      argc -= 2; argv += 2;
+      continue;
+    } else if(!strcmp(argv[0], "--http-prefetch-size") && argc > 1) {
+      http_prefetch_set_segment_size(atoi(argv[1]) * 1024);
+      argc -= 2; argv += 2;
+      continue;
     } else if(!strcmp(argv[0], "--disable-sd")) {
       do_sd = 0;
       argc -= 1; argv += 1;
@@ -317,6 +397,14 @@ main(int argc, char **argv)
       jsfile = argv[1];
       argc -= 2; argv += 2;
       continue;
+    } else if(!strcmp(argv[0], "--bench") && argc > 1) {
+      bench = argv[1];
+      argc -= 2; argv += 2;
+      continue;
+    } else if(!strcmp(argv[0], "--precompile-views") && argc > 1) {
+      precompile = argv[1];
+      argc -= 2; argv += 2;
+      continue;
     } else if (!strcmp(argv[0], "-v") && argc > 1) {
       forceview = argv[1];
       argc -= 2; argv += 2;
@@ -373,6 +461,7 @@ main(int argc, char **argv)
   sqlite3_config(SQLITE_CONFIG_MUTEX, &sqlite_mutexes);
 #endif
   sqlite3_initialize();
+  db_init();
 
   /* Initializte blob cache */
   blobcache_init();
@@ -450,6 +539,20 @@ main(int argc, char **argv)
   /* Initialize various external APIs */
   api_init();
 
+  if(bench != NULL) {
+    showtime_retcode = run_bench(bench);
+    finalize();
+    arch_exit(showtime_retcode);
+  }
+
+#if ENABLE_GLW
+  if(precompile != NULL) {
+    showtime_retcode = glw_view_precompile(precompile);
+    finalize();
+    arch_exit(showtime_retcode);
+  }
+#endif
+
   /* Open initial page(s) */
   nav_open(NAV_HOME, NULL);
   if(argc > 0)
@@ -558,6 +661,7 @@ finalize(void)
   TRACE(TRACE_DEBUG, "core", "Metadb finished");
   kvstore_fini();
   notifications_fini();
+  prop_print_lock_stats();
   TRACE(TRACE_DEBUG, "core", "Showtime terminated normally");
   trace_fini();
 }
@@ -116,28 +116,136 @@ media_init(void)
 }
 
 
+/**
+ * Packet payloads are allocated in power-of-two size classes starting
+ * at 256 bytes. Each allocation has room for FF_INPUT_BUFFER_PADDING_SIZE
+ * after the largest payload of its class. Freed payloads are put on a
+ * per media pipe free list and reused for subsequent packets, up to
+ * mp_buffer_limit bytes. Larger payloads are malloc()ed and free()d
+ * directly.
+ */
+#define MB_PAYLOAD_MIN_SHIFT 8
+
+typedef struct mb_payload {
+  union {
+    struct {
+      struct mb_payload *mbp_next;
+      int mbp_class;  // -1 if not part of any class
+    };
+    uint8_t mbp_align[16]; // Keep payload 16 byte aligned
+  };
+  uint8_t mbp_data[0];
+} mb_payload_t;
+
+
+/**
+ *
+ */
+static int
+mb_payload_class(size_t size)
+{
+  int c = 0;
+  while((size_t)1 << (c + MB_PAYLOAD_MIN_SHIFT) < size)
+    if(++c == MB_PAYLOAD_CLASSES)
+      return -1;
+  return c;
+}
+
+
 /**
  *
  */
 static void
-media_buf_dtor_freedata(media_buf_t *mb)
+media_buf_dtor_payload(media_pipe_t *mp, media_buf_t *mb)
 {
-  if(mb->mb_data != NULL)
-    free(mb->mb_data);
+  mb_payload_t *mbp = mb->mb_priv;
+  size_t classsize;
+
+  if(mbp->mbp_class == -1) {
+    free(mbp);
+    return;
+  }
+
+  classsize = (size_t)1 << (mbp->mbp_class + MB_PAYLOAD_MIN_SHIFT);
+  if(mp->mp_payload_cached + classsize > mp->mp_buffer_limit) {
+    free(mbp);
+    return;
+  }
+
+  mp->mp_payload_cached += classsize;
+  mbp->mbp_next = mp->mp_payload_free[mbp->mbp_class];
+  mp->mp_payload_free[mbp->mbp_class] = mbp;
 }
 
 
+/**
+ *
+ */
+static void
+media_buf_payload_flush(media_pipe_t *mp)
+{
+  mb_payload_t *mbp;
+  int i;
+
+  for(i = 0; i < MB_PAYLOAD_CLASSES; i++) {
+    while((mbp = mp->mp_payload_free[i]) != NULL) {
+      mp->mp_payload_free[i] = mbp->mbp_next;
+      free(mbp);
+    }
+  }
+  mp->mp_payload_cached = 0;
+}
+
+
+/**
+ *
+ */
+static void
+media_buf_alloc_payload(media_pipe_t *mp, media_buf_t *mb, size_t size)
+{
+  int c = mb_payload_class(size);
+  mb_payload_t *mbp;
+
+  if(c != -1 && (mbp = mp->mp_payload_free[c]) != NULL) {
+    mp->mp_payload_free[c] = mbp->mbp_next;
+    mp->mp_payload_cached -= (size_t)1 << (c + MB_PAYLOAD_MIN_SHIFT);
+    mp->mp_payload_hits++;
+  } else {
+    size_t alloc = c == -1 ? size : (size_t)1 << (c + MB_PAYLOAD_MIN_SHIFT);
+    mbp = malloc(sizeof(mb_payload_t) + alloc + FF_INPUT_BUFFER_PADDING_SIZE);
+    mbp->mbp_class = c;
+    mp->mp_payload_misses++;
+  }
+
+  memset(mbp->mbp_data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+
+  mb->mb_dtor = media_buf_dtor_payload;
+  mb->mb_priv = mbp;
+  mb->mb_data = mbp->mbp_data;
+  mb->mb_size = size;
+}
+
+
+/**
+ * For command buffers carrying a malloc()ed blob in mb_data
+ */
+static void
+media_buf_dtor_freedata(media_pipe_t *mp, media_buf_t *mb)
+{
+  free(mb->mb_data);
+}
+
+
+/**
+ *
+ */
 media_buf_t *
 media_buf_alloc_locked(media_pipe_t *mp, size_t size)
 {
   hts_mutex_assert(&mp->mp_mutex);
   media_buf_t *mb = pool_get(mp->mp_mb_pool);
-  mb->mb_dtor = media_buf_dtor_freedata;
-  mb->mb_size = size;
-  if(size > 0) {
-    mb->mb_data = malloc(size + FF_INPUT_BUFFER_PADDING_SIZE);
-    memset(mb->mb_data + size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
-  }
+  if(size > 0)
+    media_buf_alloc_payload(mp, mb, size);
 
   return mb;
 }
@@ -157,33 +265,60 @@ media_buf_alloc_unlocked(media_pipe_t *mp, size_t size)
 /**
  *
  */
+static void
+media_buf_dtor_avpkt(media_pipe_t *mp, media_buf_t *mb)
+{
+  AVPacket *pkt = mb->mb_priv;
+  av_free_packet(pkt);
+  pool_put(mp->mp_pkt_pool, pkt);
+}
+
+
+/**
+ * Create a media_buf from a libav packet.
+ *
+ * If the packet owns its data (av_destruct_packet) we take over the
+ * entire packet without copying anything. Anything else (including
+ * packets marked with libav's dummy destructor) only stays valid until
+ * the next av_read_frame() and must be copied.
+ *
+ * 'pkt' is reset in both cases but its timestamps are left intact
+ */
 media_buf_t *
 media_buf_from_avpkt_unlocked(media_pipe_t *mp, AVPacket *pkt)
 {
   media_buf_t *mb;
+  AVPacket *copy;
 
   hts_mutex_lock(&mp->mp_mutex);
   mb = pool_get(mp->mp_mb_pool);
-  hts_mutex_unlock(&mp->mp_mutex);
-
-  mb->mb_dtor = media_buf_dtor_freedata;
 
   if(pkt->destruct == av_destruct_packet) {
-    /* Move the data pointers from libav's packet */
-    mb->mb_data = pkt->data;
+    copy = pool_get(mp->mp_pkt_pool);
+    mp->mp_payload_adopted++;
+    hts_mutex_unlock(&mp->mp_mutex);
+
+    *copy = *pkt;
+    mb->mb_dtor = media_buf_dtor_avpkt;
+    mb->mb_priv = copy;
+    mb->mb_data = copy->data;
+    mb->mb_size = copy->size;
+
+    pkt->destruct = NULL;
     pkt->data = NULL;
-    
-    mb->mb_size = pkt->size;
     pkt->size = 0;
-    
-  } else {
-    
-    mb->mb_data = malloc(pkt->size +   FF_INPUT_BUFFER_PADDING_SIZE);
-    memset(mb->mb_data + pkt->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
-    memcpy(mb->mb_data, pkt->data, pkt->size);
-    mb->mb_size = pkt->size;
+    pkt->side_data = NULL;
+    pkt->side_data_elems = 0;
+    return mb;
   }
 
+  if(pkt->size > 0)
+    media_buf_alloc_payload(mp, mb, pkt->size);
+  mp->mp_payload_copied++;
+  hts_mutex_unlock(&mp->mp_mutex);
+
+  memcpy(mb->mb_data, pkt->data, pkt->size);
+
   av_free_packet(pkt);
   return mb;
 }
@@ -194,7 +329,8 @@ media_buf_from_avpkt_unlocked(media_pipe_t *mp, AVPacket *pkt)
 void
 media_buf_free_locked(media_pipe_t *mp, media_buf_t *mb)
 {
-  mb->mb_dtor(mb);
+  if(mb->mb_dtor != NULL)
+    mb->mb_dtor(mp, mb);
 
   if(mb->mb_cw != NULL)
     media_codec_deref(mb->mb_cw);
@@ -273,6 +409,8 @@ mp_create(const char *name, int flags, const char *type)
 			       sizeof(media_buf_t),
 			       POOL_ZERO_MEM);
 
+  mp->mp_pkt_pool = pool_create("adopted packets", sizeof(AVPacket), 0);
+
   mp->mp_flags = flags;
 
   TAILQ_INIT(&mp->mp_eq);
@@ -286,9 +424,13 @@ mp_create(const char *name, int flags, const char *type)
   hts_mutex_init(&mp->mp_mutex);
   hts_mutex_init(&mp->mp_clock_mutex);
   hts_cond_init(&mp->mp_backpressure, &mp->mp_mutex);
-  mp->mp_pc = prop_courier_create_thread(&mp->mp_mutex, "mp");
+  mp->mp_pc = prop_courier_create_thread(&mp->mp_mutex, "mp", 0);
 
-  mp->mp_prop_root = prop_create(media_prop_sources, NULL);
+  /* Each media pipe gets its own prop lock domain so that the
+     frequent status updates do not contend with the rest of the tree */
+  mp->mp_prop_root = prop_create_root_domain("mp");
+  if(prop_set_parent(mp->mp_prop_root, media_prop_sources))
+    abort();
   mp->mp_prop_metadata    = prop_create(mp->mp_prop_root, "metadata");
 
   mp->mp_prop_type = prop_create(mp->mp_prop_root, "type");
@@ -349,6 +491,11 @@ mp_create(const char *name, int flags, const char *type)
   mp->mp_prop_buffer_limit = prop_create(p, "limit");
   prop_set_int(mp->mp_prop_buffer_limit, mp->mp_buffer_limit);
 
+  mp->mp_prop_buffer_pool_hits   = prop_create(p, "poolhits");
+  mp->mp_prop_buffer_pool_misses = prop_create(p, "poolmisses");
+  mp->mp_prop_buffer_adopted     = prop_create(p, "adopted");
+  mp->mp_prop_buffer_copied      = prop_create(p, "copied");
+
 
   // 
 
@@ -479,6 +626,8 @@ mq_flush(media_pipe_t *mp, media_queue_t *mq)
 {
   media_buf_t *mb, *next;
 
+  mq_ring_drain(mp, mq);
+
   for(mb = TAILQ_FIRST(&mq->mq_q); mb != NULL; mb = next) {
     next = TAILQ_NEXT(mb, mb_link);
 
@@ -486,8 +635,8 @@ mq_flush(media_pipe_t *mp, media_queue_t *mq)
       continue;
 
     TAILQ_REMOVE(&mq->mq_q, mb, mb_link);
-    mq->mq_packets_current--;
-    mp->mp_buffer_current -= mb->mb_size;
+    atomic_add(&mq->mq_packets_current, -1);
+    atomic_add(&mp->mp_buffer_current, -mb->mb_size);
     media_buf_free_locked(mp, mb);
   }
   mq_update_stats(mp, mq);
@@ -539,7 +688,9 @@ mp_destroy(media_pipe_t *mp)
   hts_mutex_destroy(&mp->mp_mutex);
   hts_mutex_destroy(&mp->mp_clock_mutex);
 
+  media_buf_payload_flush(mp);
   pool_destroy(mp->mp_mb_pool);
+  pool_destroy(mp->mp_pkt_pool);
 
   if(mp->mp_satisfied == 0)
     atomic_add(&media_buffer_hungry, -1);
@@ -755,20 +906,116 @@ mq_update_stats(media_pipe_t *mp, media_queue_t *mq)
   if(mp->mp_stats) {
     prop_set_int(mq->mq_prop_qlen_cur, mq->mq_packets_current);
     prop_set_int(mp->mp_prop_buffer_current, mp->mp_buffer_current);
+    prop_set_int(mp->mp_prop_buffer_pool_hits, mp->mp_payload_hits);
+    prop_set_int(mp->mp_prop_buffer_pool_misses, mp->mp_payload_misses);
+    prop_set_int(mp->mp_prop_buffer_adopted, mp->mp_payload_adopted);
+    prop_set_int(mp->mp_prop_buffer_copied, mp->mp_payload_copied);
   }
 }
 
 
+/**
+ * Move everything the producer has pushed onto the ring over to mq_q
+ *
+ * Must be called with mp_mutex locked. Returns number of buffers moved
+ */
+int
+mq_ring_drain(media_pipe_t *mp, media_queue_t *mq)
+{
+  unsigned int tail = mq->mq_ring_tail;
+  unsigned int head = mq->mq_ring_head;
+  int n = head - tail;
+
+  hts_mutex_assert(&mp->mp_mutex);
+
+  if(n == 0)
+    return 0;
+
+  atomic_barrier(); // Don't read ring entries before head
+
+  for(; tail != head; tail++)
+    TAILQ_INSERT_TAIL(&mq->mq_q, mq->mq_ring[tail & (MQ_RING_SIZE - 1)],
+		      mb_link);
+
+  atomic_barrier(); // Entries must be read before producer can reuse them
+  mq->mq_ring_tail = tail;
+  mq_update_stats(mp, mq);
+  return n;
+}
+
+
+/**
+ * Wait for mq_avail to be signalled
+ *
+ * mq_waiting tells the producer that it needs to signal us when pushing
+ * onto the ring. We set it and then check the ring once more so a push
+ * racing with us going to sleep is never lost.
+ *
+ * Must be called with mp_mutex locked
+ */
+void
+mq_wait_avail(media_pipe_t *mp, media_queue_t *mq)
+{
+  mq->mq_waiting = 1;
+  atomic_barrier();
+  if(mq_ring_drain(mp, mq) == 0)
+    hts_cond_wait(&mq->mq_avail, &mp->mp_mutex);
+  mq->mq_waiting = 0;
+}
+
+
+/**
+ * Lock free enqueue of a buffer from the demuxer
+ *
+ * Returns 0 if the slow path must be taken instead, that is if the ring
+ * is full, if there are events that must be delivered or if we are
+ * about to block on backpressure. All checks that are racy against
+ * other threads are only used to decide whether to bail out, the
+ * slow path redoes them under mp_mutex.
+ */
+static int
+mq_ring_push(media_pipe_t *mp, media_queue_t *mq, media_buf_t *mb)
+{
+  unsigned int head = mq->mq_ring_head;
+
+  if(head - mq->mq_ring_tail >= MQ_RING_SIZE)
+    return 0;
+
+  if(TAILQ_FIRST(&mp->mp_eq) != NULL || mp->mp_max_realtime_delay != 0)
+    return 0;
+
+  if(mp->mp_buffer_current + mb->mb_size > mp->mp_buffer_limit)
+    return 0;
+
+  mb->mb_epoch = mp->mp_epoch;
+  atomic_add(&mq->mq_packets_current, 1);
+  atomic_add(&mp->mp_buffer_current, mb->mb_size);
+
+  mq->mq_ring[head & (MQ_RING_SIZE - 1)] = mb;
+  atomic_barrier(); // Publish entry before head
+  mq->mq_ring_head = head + 1;
+  atomic_barrier(); // Pairs with barrier in mq_wait_avail()
+
+  if(mq->mq_waiting) {
+    hts_mutex_lock(&mp->mp_mutex);
+    hts_cond_signal(&mq->mq_avail);
+    hts_mutex_unlock(&mp->mp_mutex);
+  }
+  return 1;
+}
+
+
 /**
  *
  */
 static void
 mb_enq_tail(media_pipe_t *mp, media_queue_t *mq, media_buf_t *mb)
 {
+  mq_ring_drain(mp, mq);
   TAILQ_INSERT_TAIL(&mq->mq_q, mb, mb_link);
-  mq->mq_packets_current++;
+  atomic_add(&mq->mq_packets_current, 1);
   mb->mb_epoch = mp->mp_epoch;
-  mp->mp_buffer_current += mb->mb_size;
+  atomic_add(&mp->mp_buffer_current, mb->mb_size);
   mq_update_stats(mp, mq);
   hts_cond_signal(&mq->mq_avail);
 }
@@ -780,9 +1027,9 @@ static void
 mb_enq_head(media_pipe_t *mp, media_queue_t *mq, media_buf_t *mb)
 {
   TAILQ_INSERT_HEAD(&mq->mq_q, mb, mb_link);
-  mq->mq_packets_current++;
+  atomic_add(&mq->mq_packets_current, 1);
   mb->mb_epoch = mp->mp_epoch;
-  mp->mp_buffer_current += mb->mb_size;
+  atomic_add(&mp->mp_buffer_current, mb->mb_size);
   mq_update_stats(mp, mq);
   hts_cond_signal(&mq->mq_avail);
 }
@@ -810,14 +1057,21 @@ mq_realtime_delay(media_queue_t *mq)
 
 
 /**
+ * Enqueue a buffer from the demuxer, blocking on backpressure
  *
+ * Must only be called from one thread per media pipe since the
+ * fast path is a single producer ring
  */
 event_t *
 mb_enqueue_with_events(media_pipe_t *mp, media_queue_t *mq, media_buf_t *mb)
 {
   event_t *e = NULL;
-  
+
+  if(mq_ring_push(mp, mq, mb))
+    return NULL;
+
   hts_mutex_lock(&mp->mp_mutex);
+  mq_ring_drain(mp, mq);
 #if 0
   printf("ENQ %s %d/%d %d/%d\n", mq == &mp->mp_video ? "video" : "audio",
 	 mq->mq_packets_current, mq->mq_packets_threshold,
@@ -859,6 +1113,8 @@ mb_enqueue_no_block(media_pipe_t *mp, media_queue_t *mq, media_buf_t *mb,
     return -1;
   }
 
+  mq_ring_drain(mp, mq);
+
   if(auxtype != -1) {
     media_buf_t *after;
     TAILQ_FOREACH_REVERSE(after, &mq->mq_q, media_buf_queue, mb_link) {
@@ -875,8 +1131,8 @@ mb_enqueue_no_block(media_pipe_t *mp, media_queue_t *mq, media_buf_t *mb,
     TAILQ_INSERT_TAIL(&mq->mq_q, mb, mb_link);
   }
 
-  mq->mq_packets_current++;
-  mp->mp_buffer_current += mb->mb_size;
+  atomic_add(&mq->mq_packets_current, 1);
+  atomic_add(&mp->mp_buffer_current, mb->mb_size);
   mb->mb_epoch = mp->mp_epoch;
   mq_update_stats(mp, mq);
   hts_cond_signal(&mq->mq_avail);
@@ -919,6 +1175,9 @@ mp_seek_in_queues(media_pipe_t *mp, int64_t pos)
   media_buf_t *abuf, *vbuf, *vk, *mb;
   int rval = 1;
 
+  mq_ring_drain(mp, &mp->mp_audio);
+  mq_ring_drain(mp, &mp->mp_video);
+
   TAILQ_FOREACH(abuf, &mp->mp_audio.mq_q, mb_link)
     if(abuf->mb_pts != AV_NOPTS_VALUE && abuf->mb_pts >= pos)
       break;
@@ -940,8 +1199,8 @@ mp_seek_in_queues(media_pipe_t *mp, int64_t pos)
 	if(mb == abuf)
 	  break;
 	TAILQ_REMOVE(&mp->mp_audio.mq_q, mb, mb_link);
-	mp->mp_audio.mq_packets_current--;
-	mp->mp_buffer_current -= mb->mb_size;
+	atomic_add(&mp->mp_audio.mq_packets_current, -1);
+	atomic_add(&mp->mp_buffer_current, -mb->mb_size);
 	media_buf_free_locked(mp, mb);
 	adrop++;
       }
@@ -952,8 +1211,8 @@ mp_seek_in_queues(media_pipe_t *mp, int64_t pos)
 	if(mb == vk)
 	  break;
 	TAILQ_REMOVE(&mp->mp_video.mq_q, mb, mb_link);
-	mp->mp_video.mq_packets_current--;
-	mp->mp_buffer_current -= mb->mb_size;
+	atomic_add(&mp->mp_video.mq_packets_current, -1);
+	atomic_add(&mp->mp_buffer_current, -mb->mb_size);
 	media_buf_free_locked(mp, mb);
 	vdrop++;
       }
@@ -1100,6 +1359,7 @@ mp_send_cmd_data(media_pipe_t *mp, media_queue_t *mq, int cmd, void *d)
   mb = media_buf_alloc_locked(mp, 0);
   mb->mb_data_type = cmd;
   mb->mb_data = d;
+  mb->mb_dtor = media_buf_dtor_freedata;
   mb_enq_tail(mp, mq, mb);
   hts_mutex_unlock(&mp->mp_mutex);
 }
@@ -2253,7 +2513,7 @@ mtm_select_track(media_track_mgr_t *mtm, event_select_track_t *est)
  *
  */
 static void
-ext_sub_dtor(media_buf_t *mb)
+ext_sub_dtor(media_pipe_t *mp, media_buf_t *mb)
 {
   if(mb->mb_data != NULL)
     subtitles_destroy(mb->mb_data);
@@ -124,7 +124,8 @@ typedef struct media_buf {
 
   void *mb_data;
   media_codec_t *mb_cw;
-  void (*mb_dtor)(struct media_buf *mb);
+  void (*mb_dtor)(struct media_pipe *mp, struct media_buf *mb);
+  void *mb_priv;  // Owner of mb_data, depends on mb_dtor
 
   int mb_size;
 
@@ -157,7 +158,23 @@ typedef struct media_buf {
 typedef struct media_queue {
   struct media_buf_queue mq_q;
 
-  unsigned int mq_packets_current;    /* Packets currently in queue */
+  int mq_packets_current;    /* Packets currently in queue (incl. ring) */
+
+  /**
+   * Lock free single producer / single consumer ring in front of mq_q.
+   *
+   * The demuxer (mb_enqueue_with_events()) is the only producer and
+   * pushes without taking mp_mutex. Whoever holds mp_mutex is the
+   * consumer and moves entries over to mq_q with mq_ring_drain().
+   * Thus everything that looks at mq_q (decoders, mq_flush(),
+   * mp_seek_in_queues(), etc) keeps working as before as long as the
+   * ring is drained first.
+   */
+#define MQ_RING_SIZE 64
+  struct media_buf *mq_ring[MQ_RING_SIZE];
+  volatile unsigned int mq_ring_head;  // Written by producer only
+  volatile unsigned int mq_ring_tail;  // Written under mp_mutex only
+  volatile int mq_waiting;             // Consumer is sleeping on mq_avail
 
   int mq_stream;             /* Stream id, or -1 if queue is inactive */
   int mq_stream2;            /* Complementary stream */
@@ -229,9 +246,22 @@ typedef struct media_pipe {
   int mp_eof;   // End of file: We don't expect to need to read more data
 
   pool_t *mp_mb_pool;
+  pool_t *mp_pkt_pool;
 
+  /**
+   * Size classed payload buffers, see media_buf_alloc_locked()
+   * Protected by mp_mutex
+   */
+#define MB_PAYLOAD_CLASSES 12
+  struct mb_payload *mp_payload_free[MB_PAYLOAD_CLASSES];
+  unsigned int mp_payload_cached; // Bytes on free lists
 
-  unsigned int mp_buffer_current; // Bytes current queued (total for all queues)
+  int mp_payload_hits;     // Payloads reused from free list
+  int mp_payload_misses;   // Payloads that needed a fresh malloc()
+  int mp_payload_adopted;  // Payloads adopted from AVPackets without copy
+  int mp_payload_copied;   // AVPackets copied since they did not own data
+
+  int mp_buffer_current; // Bytes current queued (total for all queues)
   unsigned int mp_buffer_limit;   // Max buffer size
   unsigned int mp_max_realtime_delay; // Max delay in a queue (real time)
   int mp_satisfied;        /* If true, means we are satisfied with buffer
@@ -295,6 +325,10 @@ typedef struct media_pipe {
 
   prop_t *mp_prop_buffer_current;
   prop_t *mp_prop_buffer_limit;
+  prop_t *mp_prop_buffer_pool_hits;
+  prop_t *mp_prop_buffer_pool_misses;
+  prop_t *mp_prop_buffer_adopted;
+  prop_t *mp_prop_buffer_copied;
 
 
   prop_courier_t *mp_pc;
@@ -436,6 +470,8 @@ void mp_set_current_time(media_pipe_t *mp, int64_t ts, int epoch,
 
 extern media_pipe_t *media_primary;
 
+extern int media_buffer_hungry;
+
 #define mp_is_primary(mp) ((mp) == media_primary)
 
 void mp_set_playstatus_by_hold(media_pipe_t *mp, int hold, const char *msg);
@@ -464,6 +500,10 @@ void mp_set_mq_meta(media_queue_t *mq, struct AVCodec *codec,
 
 void mq_update_stats(media_pipe_t *mp, media_queue_t *mq);
 
+int mq_ring_drain(media_pipe_t *mp, media_queue_t *mq);
+
+void mq_wait_avail(media_pipe_t *mp, media_queue_t *mq);
+
 void mp_add_track(prop_t *parent,
 		  const char *title,
 		  const char *url,
@@ -944,7 +944,7 @@ void
 decoration_init(void)
 {
   hts_mutex_init(&deco_mutex);
-  deco_courier = prop_courier_create_waitable();
+  deco_courier = prop_courier_create_waitable(0);
 
   hts_thread_create_detached("deco", deco_thread, NULL, THREAD_PRIO_LOW);
 }
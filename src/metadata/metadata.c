@@ -1850,7 +1850,7 @@ ms_set_enable(void *opaque, int value)
   sqlite3_bind_int(stmt, 2, ms->ms_enabled);
   
   rc = db_step(stmt);
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   metadb_close(db);
 }
 
@@ -1888,7 +1888,7 @@ metadata_add_source(const char *name, const char *description,
 
   rc = db_step(stmt);
   if(rc == SQLITE_LOCKED) {
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     db_rollback_deadlock(db);
     goto again;
   }
@@ -1900,11 +1900,11 @@ metadata_add_source(const char *name, const char *description,
     if(sqlite3_column_type(stmt, 1) == SQLITE_INTEGER)
       enabled = sqlite3_column_int(stmt, 2);
 
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
 
   } else {
 
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
 
     rc = db_prepare(db, 
 		    "INSERT INTO datasource "
@@ -1924,7 +1924,7 @@ metadata_add_source(const char *name, const char *description,
     sqlite3_bind_int(stmt, 4, enabled);
 
     rc = db_step(stmt);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     if(rc == SQLITE_LOCKED) {
       db_rollback_deadlock(db);
       goto again;
@@ -2037,7 +2037,7 @@ metadata_init(void)
 
   hts_mutex_init(&metadata_mutex);
 
-  metadata_courier = prop_courier_create_waitable();
+  metadata_courier = prop_courier_create_waitable(0);
   TAILQ_INIT(&mlpqueue);
 
   hts_thread_create_detached("metadata", metadata_thread, NULL, 
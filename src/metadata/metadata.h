@@ -230,10 +230,24 @@ void *metadb_get(void);
 
 void metadb_close(void *db);
 
+void *metadb_get_ro(void);
+
+void metadb_close_ro(void *db);
+
 void metadb_metadata_write(void *db, const char *url, time_t mtime,
 			   const metadata_t *md, const char *parent,
 			   time_t parent_mtime);
 
+typedef struct metadb_batch metadb_batch_t;
+
+metadb_batch_t *metadb_batch_begin(const char *name);
+
+void metadb_batch_write(metadb_batch_t *mb, const char *url, time_t mtime,
+			const metadata_t *md, const char *parent,
+			time_t parent_mtime);
+
+void metadb_batch_commit(metadb_batch_t *mb);
+
 metadata_t *metadb_metadata_get(void *db, const char *url, time_t mtime);
 
 struct fa_dir;
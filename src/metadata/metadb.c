@@ -21,6 +21,7 @@
 
 // If not set to true by metadb_init() no metadb actions will occur
 static db_pool_t *metadb_pool;
+static db_pool_t *metadb_ro_pool;
 static hts_mutex_t mip_mutex;
 
 static void mip_update_by_url(sqlite3 *db, const char *url);
@@ -44,16 +45,17 @@ metadb_init(void)
   sqlite3 *db;
   extern char *showtime_persistent_path;
   char buf[256];
+  char path[256];
 
   snprintf(buf, sizeof(buf), "%s/metadb", showtime_persistent_path);
   mkdir(buf, 0770);
-  snprintf(buf, sizeof(buf), "%s/metadb/meta.db", showtime_persistent_path);
+  snprintf(path, sizeof(path), "%s/metadb/meta.db", showtime_persistent_path);
 
-  //  unlink(buf);
+  //  unlink(path);
 
   hts_mutex_init(&mip_mutex);
 
-  metadb_pool = db_pool_create(buf, 2);
+  metadb_pool = db_pool_create(path, 2);
   db = metadb_get();
   if(db == NULL)
     return;
@@ -66,6 +68,8 @@ metadb_init(void)
 
   if(r)
     metadb_pool = NULL; // Disable
+  else
+    metadb_ro_pool = db_pool_create_readonly(path, 4);
 }
 
 
@@ -75,6 +79,7 @@ metadb_init(void)
 void
 metadb_fini(void)
 {
+  db_pool_close(metadb_ro_pool);
   db_pool_close(metadb_pool);
 }
 
@@ -99,6 +104,28 @@ metadb_close(void *db)
 }
 
 
+/**
+ * Get a read only connection. It does not share cache with the
+ * writer so (given WAL) it will not be blocked by write transactions
+ * from the scanner, etc. Must be returned using metadb_close_ro()
+ */
+void *
+metadb_get_ro(void)
+{
+  return db_pool_get(metadb_ro_pool);
+}
+
+
+/**
+ *
+ */
+void 
+metadb_close_ro(void *db)
+{
+  db_pool_put(metadb_ro_pool, db);
+}
+
+
 /**
  *
  */
@@ -125,7 +152,7 @@ db_item_get(sqlite3 *db, const char *url, time_t *mtimep)
   } else if(rc == SQLITE_LOCKED)
     rval = METADATA_DEADLOCK;
 
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   return rval;
 }
 
@@ -162,7 +189,7 @@ db_item_create(sqlite3 *db, const char *url, int contenttype, time_t mtime,
     sqlite3_bind_int64(stmt, 4, parentid);
 
   rc = db_step(stmt);
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
 
   if(rc == SQLITE_LOCKED)
     return METADATA_DEADLOCK;
@@ -225,7 +252,7 @@ metadb_artist_get_by_title(void *db, const char *title, int ds_id,
       if(ext_id)
 	sqlite3_bind_text(ins, 3, ext_id, -1, SQLITE_STATIC);
       rc = db_step(ins);
-      sqlite3_finalize(ins);
+      db_finalize(ins);
       if(rc == SQLITE_LOCKED)
 	rval = METADATA_DEADLOCK;
       if(rc == SQLITE_DONE)
@@ -238,7 +265,7 @@ metadb_artist_get_by_title(void *db, const char *title, int ds_id,
     rval = METADATA_DEADLOCK;
   }
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return rval;
 }
 
@@ -301,7 +328,7 @@ metadb_album_get_by_title(void *db, const char *album, int64_t artist_id,
 	sqlite3_bind_text(ins, 4, ext_id, -1, SQLITE_STATIC);
 
       rc = db_step(ins);
-      sqlite3_finalize(ins);
+      db_finalize(ins);
       if(rc == SQLITE_DONE)
 	rval = sqlite3_last_insert_rowid(db);
       if(rc == SQLITE_LOCKED)
@@ -313,7 +340,7 @@ metadb_album_get_by_title(void *db, const char *album, int64_t artist_id,
   } else if(rc == SQLITE_LOCKED)
     rval = METADATA_DEADLOCK;
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return rval;
 }
 
@@ -347,7 +374,7 @@ metadb_insert_albumart(void *db, int64_t album_id, const char *url,
   if(width) sqlite3_bind_int64(ins, 3, width);
   if(height) sqlite3_bind_int64(ins, 4, height);
   db_step(ins);
-  sqlite3_finalize(ins);
+  db_finalize(ins);
 }
 
 
@@ -379,7 +406,7 @@ metadb_insert_artistpic(void *db, int64_t artist_id, const char *url,
   if(width) sqlite3_bind_int64(ins, 3, width);
   if(height) sqlite3_bind_int64(ins, 4, height);
   db_step(ins);
-  sqlite3_finalize(ins);
+  db_finalize(ins);
 }
 
 /**
@@ -411,7 +438,7 @@ metadb_insert_videoart(void *db, int64_t videoitem_id, const char *url,
   if(height) sqlite3_bind_int(ins, 4, height);
   sqlite3_bind_int(ins, 5, type);
   db_step(ins);
-  sqlite3_finalize(ins);
+  db_finalize(ins);
 }
 
 
@@ -459,7 +486,7 @@ metadb_insert_videocast(void *db, int64_t videoitem_id,
   if(height) sqlite3_bind_int(ins, 9, height);
   sqlite3_bind_text(ins, 10, ext_id, -1, SQLITE_STATIC);
   db_step(ins);
-  sqlite3_finalize(ins);
+  db_finalize(ins);
 }
 
 
@@ -489,7 +516,7 @@ metadb_insert_videogenre(void *db, int64_t videoitem_id, const char *title)
   sqlite3_bind_int64(ins, 1, videoitem_id);
   sqlite3_bind_text(ins, 2, title, -1, SQLITE_STATIC);
   db_step(ins);
-  sqlite3_finalize(ins);
+  db_finalize(ins);
 }
 
 
@@ -562,7 +589,7 @@ metadb_insert_audioitem(sqlite3 *db, int64_t item_id, const metadata_t *md,
     sqlite3_bind_int(stmt, 6, md->md_track);
 
     rc = db_step(stmt);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     if(rc == SQLITE_CONSTRAINT && i == 0)
       continue;
     break;
@@ -628,7 +655,7 @@ metadb_get_album_art(void *db, const char *album, const char *artist)
   sqlite3_bind_text(sel, 1, artist, -1, SQLITE_STATIC);
   sqlite3_bind_text(sel, 2, album, -1, SQLITE_STATIC);
   rstr_t *r = metadb_construct_imageset(sel, 0, 1, 2);
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return r;
 }
 
@@ -657,7 +684,7 @@ metadb_get_video_art(void *db, int64_t videoitem_id, int type)
   sqlite3_bind_int64(sel, 1, videoitem_id);
   sqlite3_bind_int(sel, 2, type);
   rstr_t *r = metadb_construct_imageset(sel, 0, 1, 2);
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return r;
 }
 
@@ -705,7 +732,7 @@ metadb_get_video_genre(sqlite3 *db, int64_t videoitem_id)
 
   sqlite3_bind_int64(sel, 1, videoitem_id);
   rstr_t *r = metadb_construct_list(sel, 0);
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return r;
 }
 
@@ -734,7 +761,7 @@ metadb_get_video_cast(sqlite3 *db, int64_t videoitem_id, const char *job)
   sqlite3_bind_int64(sel, 1, videoitem_id);
   sqlite3_bind_text(sel, 2, job, -1, SQLITE_STATIC);
   rstr_t *r = metadb_construct_list(sel, 0);
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return r;
 }
 
@@ -773,7 +800,7 @@ metadb_get_artist_pics(void *db, const char *artist,
        sqlite3_column_int(sel, 2));
     rval = 0;
   }
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return rval;
 }
 
@@ -829,7 +856,7 @@ metadb_insert_stream(sqlite3 *db, int64_t videoitem_id,
     sqlite3_bind_text(stmt, 8, rstr_get(ms->ms_title), -1, SQLITE_STATIC);
 
   rc = db_step(stmt);
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   return rc2metadatacode(rc);
 }
 
@@ -857,7 +884,7 @@ metadb_set_streams(sqlite3 *db, int64_t videoitem_id, const metadata_t *md)
   sqlite3_bind_int64(stmt, 1, videoitem_id);
 
   rc = db_step(stmt);
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   if(rc == SQLITE_LOCKED)
     return METADATA_DEADLOCK;
   if(rc != SQLITE_DONE)
@@ -909,7 +936,7 @@ metadb_insert_videoitem0(sqlite3 *db, int64_t item_id, int ds_id,
       sqlite3_bind_text(stmt, 4, ext_id, -1, SQLITE_STATIC);
       rc = db_step(stmt);
       if(rc != SQLITE_ROW) {
-	sqlite3_finalize(stmt);
+	db_finalize(stmt);
 	if(rc == SQLITE_LOCKED)
 	  return METADATA_DEADLOCK;
 	TRACE(TRACE_ERROR, "SQLITE", "SQL Error 0x%x at %s:%d",
@@ -917,7 +944,7 @@ metadb_insert_videoitem0(sqlite3 *db, int64_t item_id, int ds_id,
 	return -1;
       }
       id = sqlite3_column_int64(stmt, 0);
-      sqlite3_finalize(stmt);
+      db_finalize(stmt);
     }
 
 
@@ -993,7 +1020,7 @@ metadb_insert_videoitem0(sqlite3 *db, int64_t item_id, int ds_id,
 
 
     rc = db_step(stmt);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     if(rc == SQLITE_CONSTRAINT && i == 0)
       continue;
     if(i == 0)
@@ -1085,7 +1112,7 @@ metadb_insert_imageitem(sqlite3 *db, int64_t item_id, const metadata_t *md)
 		      -1, SQLITE_STATIC);
     
     rc = db_step(stmt);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     if(rc == SQLITE_CONSTRAINT && i == 0)
       continue;
     break;
@@ -1099,57 +1126,46 @@ metadb_insert_imageitem(sqlite3 *db, int64_t item_id, const metadata_t *md)
 
 
 /**
+ * Write metadata for an item. Must be called within a transaction
  *
+ * Returns 0 on success, METADATA_DEADLOCK if the transaction must
+ * be restarted and -1 on other errors
  */
-void
-metadb_metadata_write(void *db, const char *url, time_t mtime,
-		      const metadata_t *md, const char *parent,
-		      time_t parent_mtime)
+static int
+metadb_metadata_write0(void *db, const char *url, time_t mtime,
+		       const metadata_t *md, const char *parent,
+		       time_t parent_mtime)
 {
   int64_t item_id;
   int64_t parent_id = 0;
   int rc;
   sqlite3_stmt *stmt;
 
- again:
-  if(db_begin(db))
-    return;
-
   if(parent != NULL) {
     parent_id = db_item_get(db, parent, NULL);
-    if(parent_id == METADATA_DEADLOCK) {
-      db_rollback_deadlock(db);
-      goto again;
-    }
+    if(parent_id == METADATA_DEADLOCK)
+      return METADATA_DEADLOCK;
 
     if(parent_id == -1)
       parent_id = db_item_create(db, parent, CONTENT_DIR, parent_mtime, 0);
 
-    if(parent_id == METADATA_DEADLOCK) {
-      db_rollback_deadlock(db);
-      goto again;
-    }
+    if(parent_id == METADATA_DEADLOCK)
+      return METADATA_DEADLOCK;
   }
 
   item_id = db_item_get(db, url, NULL);
-  if(item_id == METADATA_DEADLOCK) {
-    db_rollback_deadlock(db);
-    goto again;
-  }
+  if(item_id == METADATA_DEADLOCK)
+    return METADATA_DEADLOCK;
 
   if(item_id == -1) {
 
     item_id = db_item_create(db, url, md->md_contenttype, mtime, parent_id);
 
-    if(item_id == METADATA_DEADLOCK) {
-      db_rollback_deadlock(db);
-      goto again;
-    }
+    if(item_id == METADATA_DEADLOCK)
+      return METADATA_DEADLOCK;
 
-    if(item_id == -1) {
-      db_rollback(db);
-      return;
-    }
+    if(item_id == -1)
+      return -1;
 
   } else {
 
@@ -1170,10 +1186,9 @@ metadb_metadata_write(void *db, const char *url, time_t mtime,
 		    -1, &stmt, NULL);
 
     if(rc != SQLITE_OK) {
-      db_rollback(db);
       TRACE(TRACE_ERROR, "SQLITE", "SQL Error at %s:%d",
 	    __FUNCTION__, __LINE__);
-      return;
+      return -1;
     }
 
     if(md->md_contenttype)
@@ -1184,11 +1199,9 @@ metadb_metadata_write(void *db, const char *url, time_t mtime,
     sqlite3_bind_int64(stmt, 4, parent_id);
 
     rc = db_step(stmt);
-    sqlite3_finalize(stmt);
-    if(rc == METADATA_DEADLOCK) {
-      db_rollback_deadlock(db);
-      goto again;
-    }
+    db_finalize(stmt);
+    if(rc == METADATA_DEADLOCK)
+      return METADATA_DEADLOCK;
   }
 
   int r;
@@ -1216,6 +1229,28 @@ metadb_metadata_write(void *db, const char *url, time_t mtime,
     break;
   }
 
+  if(r == METADATA_DEADLOCK)
+    return METADATA_DEADLOCK;
+  return r ? -1 : 0;
+}
+
+
+/**
+ *
+ */
+void
+metadb_metadata_write(void *db, const char *url, time_t mtime,
+		      const metadata_t *md, const char *parent,
+		      time_t parent_mtime)
+{
+  int r;
+
+ again:
+  if(db_begin(db))
+    return;
+
+  r = metadb_metadata_write0(db, url, mtime, md, parent, parent_mtime);
+
   if(r == METADATA_DEADLOCK) {
     db_rollback_deadlock(db);
     goto again;
@@ -1228,6 +1263,180 @@ metadb_metadata_write(void *db, const char *url, time_t mtime,
 }
 
 
+/**
+ * Write batches
+ *
+ * Items are queued and written in a single transaction once
+ * METADB_BATCH_ITEMS have been queued or METADB_BATCH_TIME has passed
+ * since the first one was. Each item is wrapped in a savepoint so a
+ * failing item doesn't take the rest of the batch with it. On deadlock
+ * the entire batch is rolled back and replayed.
+ *
+ * The metadata_t passed to metadb_batch_write() is not copied and must
+ * stay valid until metadb_batch_commit() returns
+ */
+#define METADB_BATCH_ITEMS 64
+#define METADB_BATCH_TIME  2000000
+
+TAILQ_HEAD(metadb_batch_item_queue, metadb_batch_item);
+
+typedef struct metadb_batch_item {
+  TAILQ_ENTRY(metadb_batch_item) mbi_link;
+  char *mbi_url;
+  char *mbi_parent;
+  time_t mbi_mtime;
+  time_t mbi_parent_mtime;
+  const metadata_t *mbi_md;
+} metadb_batch_item_t;
+
+
+struct metadb_batch {
+  hts_mutex_t mb_mutex;
+  char *mb_name;
+  void *mb_db;
+  struct metadb_batch_item_queue mb_items;
+  int mb_num_items;
+  int64_t mb_first_ts;  // When first item in current batch was queued
+
+  int64_t mb_start;
+  int mb_written;
+  int mb_transactions;
+  int mb_deadlocks;
+};
+
+
+/**
+ *
+ */
+metadb_batch_t *
+metadb_batch_begin(const char *name)
+{
+  metadb_batch_t *mb = calloc(1, sizeof(metadb_batch_t));
+  hts_mutex_init(&mb->mb_mutex);
+  mb->mb_name = strdup(name);
+  TAILQ_INIT(&mb->mb_items);
+  mb->mb_start = showtime_get_ts();
+  return mb;
+}
+
+
+/**
+ * mb_mutex must be held
+ */
+static void
+metadb_batch_flush(metadb_batch_t *mb)
+{
+  metadb_batch_item_t *mbi;
+  int r, written;
+
+  if(mb->mb_num_items == 0)
+    return;
+
+  if(mb->mb_db == NULL)
+    mb->mb_db = metadb_get();
+
+ again:
+  written = 0;
+  if(db_begin(mb->mb_db))
+    goto out;
+
+  TAILQ_FOREACH(mbi, &mb->mb_items, mbi_link) {
+    db_one_statement(mb->mb_db, "SAVEPOINT item;", NULL);
+
+    r = metadb_metadata_write0(mb->mb_db, mbi->mbi_url, mbi->mbi_mtime,
+			       mbi->mbi_md, mbi->mbi_parent,
+			       mbi->mbi_parent_mtime);
+
+    if(r == METADATA_DEADLOCK) {
+      mb->mb_deadlocks++;
+      db_rollback_deadlock(mb->mb_db);
+      goto again;
+    }
+
+    if(r)
+      db_one_statement(mb->mb_db, "ROLLBACK TO item;", NULL);
+    else
+      written++;
+    db_one_statement(mb->mb_db, "RELEASE item;", NULL);
+  }
+
+  if(!db_commit(mb->mb_db)) {
+    // Only count what actually made it, items are replayed on deadlock
+    mb->mb_written += written;
+    mb->mb_transactions++;
+  }
+
+ out:
+  while((mbi = TAILQ_FIRST(&mb->mb_items)) != NULL) {
+    TAILQ_REMOVE(&mb->mb_items, mbi, mbi_link);
+    free(mbi->mbi_url);
+    free(mbi->mbi_parent);
+    free(mbi);
+  }
+  mb->mb_num_items = 0;
+}
+
+
+/**
+ *
+ */
+void
+metadb_batch_write(metadb_batch_t *mb, const char *url, time_t mtime,
+		   const metadata_t *md, const char *parent,
+		   time_t parent_mtime)
+{
+  metadb_batch_item_t *mbi = malloc(sizeof(metadb_batch_item_t));
+  int64_t now = showtime_get_ts();
+
+  mbi->mbi_url = strdup(url);
+  mbi->mbi_parent = parent ? strdup(parent) : NULL;
+  mbi->mbi_mtime = mtime;
+  mbi->mbi_parent_mtime = parent_mtime;
+  mbi->mbi_md = md;
+
+  hts_mutex_lock(&mb->mb_mutex);
+
+  if(mb->mb_num_items == 0)
+    mb->mb_first_ts = now;
+
+  TAILQ_INSERT_TAIL(&mb->mb_items, mbi, mbi_link);
+  mb->mb_num_items++;
+
+  if(mb->mb_num_items >= METADB_BATCH_ITEMS ||
+     now - mb->mb_first_ts > METADB_BATCH_TIME)
+    metadb_batch_flush(mb);
+
+  hts_mutex_unlock(&mb->mb_mutex);
+}
+
+
+/**
+ * Write all pending items and release the batch
+ */
+void
+metadb_batch_commit(metadb_batch_t *mb)
+{
+  hts_mutex_lock(&mb->mb_mutex);
+  metadb_batch_flush(mb);
+  hts_mutex_unlock(&mb->mb_mutex);
+
+  if(mb->mb_written) {
+    int64_t ts = showtime_get_ts() - mb->mb_start;
+    TRACE(TRACE_DEBUG, "METADB",
+	  "%s: Wrote %d items in %d transactions (%d deadlocks) "
+	  "in %d ms, %d items/s",
+	  mb->mb_name, mb->mb_written, mb->mb_transactions,
+	  mb->mb_deadlocks, (int)(ts / 1000),
+	  (int)(mb->mb_written * 1000000LL / MAX(ts, 1)));
+  }
+
+  metadb_close(mb->mb_db);
+  hts_mutex_destroy(&mb->mb_mutex);
+  free(mb->mb_name);
+  free(mb);
+}
+
+
 typedef struct get_cache {
   int64_t gc_album_id;
   rstr_t *gc_album_title;
@@ -1280,7 +1489,7 @@ metadb_metadata_get_artist(sqlite3 *db, get_cache_t *gc, int64_t id)
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return -1;
   }
 
@@ -1288,7 +1497,7 @@ metadb_metadata_get_artist(sqlite3 *db, get_cache_t *gc, int64_t id)
 
   rstr_release(gc->gc_artist_title);
   gc->gc_artist_title = rstr_alloc((void *)sqlite3_column_text(sel, 0));
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return 0;
 }
 
@@ -1324,14 +1533,14 @@ metadb_metadata_get_album(sqlite3 *db, get_cache_t *gc, int64_t id)
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return -1;
   }
 
   gc->gc_album_id = id;
   rstr_release(gc->gc_album_title);
   gc->gc_album_title = rstr_alloc((void *)sqlite3_column_text(sel, 0));
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return 0;
 }
 
@@ -1362,7 +1571,7 @@ metadb_metadata_get_audio(sqlite3 *db, metadata_t *md, int64_t item_id,
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return -1;
   }
 
@@ -1377,7 +1586,7 @@ metadb_metadata_get_audio(sqlite3 *db, metadata_t *md, int64_t item_id,
   md->md_duration = sqlite3_column_int(sel, 3) / 1000.0f;
   md->md_track = sqlite3_column_int(sel, 4);
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return 0;
 }
 
@@ -1410,7 +1619,7 @@ metadb_metadata_get_video(sqlite3 *db, metadata_t *md, int64_t item_id,
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return -1;
   }
 
@@ -1421,7 +1630,7 @@ metadb_metadata_get_video(sqlite3 *db, metadata_t *md, int64_t item_id,
   md->md_format = rstr_alloc((void *)sqlite3_column_text(sel, 3));
   md->md_year = sqlite3_column_int(sel, 4);
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return id;
 }
 
@@ -1555,7 +1764,7 @@ metadb_videoitem_alternatives0(void *db, prop_t *p, const char *url, int dsid,
   prop_ref_dec(active);
 
   prop_vec_release(pv);
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return 0;
 }
 
@@ -1568,12 +1777,12 @@ metadb_videoitem_alternatives(prop_t *p, const char *url, int dsid,
 {
   void *db;
 
-  if((db = metadb_get()) == NULL)
+  if((db = metadb_get_ro()) == NULL)
     return;
 
  again:
   if(db_begin(db)) {
-    metadb_close(db);
+    metadb_close_ro(db);
     return;
   }
 
@@ -1581,7 +1790,7 @@ metadb_videoitem_alternatives(prop_t *p, const char *url, int dsid,
     goto again;
   
   db_rollback(db);
-  metadb_close(db);
+  metadb_close_ro(db);
 }
 
 
@@ -1612,7 +1821,7 @@ metadb_item_set_preferred_ds(void *db, const char *url, int ds_id)
     sqlite3_bind_null(stmt, 2);
 
   rc = db_step(stmt);
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   if(rc == SQLITE_LOCKED)
     return METADATA_DEADLOCK;
   return 0;
@@ -1629,7 +1838,7 @@ metadb_item_get_preferred_ds(const char *url)
   int rc, id = 0;
   sqlite3_stmt *stmt;
 
-  if((db = metadb_get()) == NULL)
+  if((db = metadb_get_ro()) == NULL)
     return METADATA_ERROR;
 
   rc = db_prepare(db, 
@@ -1641,7 +1850,7 @@ metadb_item_get_preferred_ds(const char *url)
   if(rc != SQLITE_OK) {
     TRACE(TRACE_ERROR, "SQLITE", "SQL Error at %s:%d",
 	  __FUNCTION__, __LINE__);
-    metadb_close(db);
+    metadb_close_ro(db);
     return METADATA_ERROR;
   }
 
@@ -1650,8 +1859,8 @@ metadb_item_get_preferred_ds(const char *url)
   rc = db_step(stmt);
   if(rc == SQLITE_ROW)
     id = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
-  metadb_close(db);
+  db_finalize(stmt);
+  metadb_close_ro(db);
   return id;
 }
 
@@ -1685,19 +1894,19 @@ metadb_get_videoinfo(void *db, const char *url,
 
   rc = db_step(sel);
   if(rc == SQLITE_LOCKED) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return METADATA_DEADLOCK;
 
   }
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return 0;
   }
 
   int64_t item_id = sqlite3_column_int64(sel, 0);
   int ds_id = sqlite3_column_int(sel, 1);
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
 
   *fixed_ds = ds_id;
 
@@ -1786,7 +1995,7 @@ metadb_get_videoinfo(void *db, const char *url,
     md->md_producer = metadb_get_video_cast(db, vid, "Producer");
     md->md_qtype = qtype;
   }
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   *mdp = md;
   return 0;
 }
@@ -1843,7 +2052,7 @@ metadb_metadata_get_streams(sqlite3 *db, metadata_t *md, int64_t videoitem_id)
 			sqlite3_column_int(sel, 5),
 			tn);
   }
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return 0;
 }
 
@@ -1873,14 +2082,14 @@ metadb_metadata_get_image(sqlite3 *db, metadata_t *md, int64_t item_id)
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     return -1;
   }
 
   md->md_time = sqlite3_column_int(sel, 0);
   md->md_manufacturer = rstr_alloc((void *)sqlite3_column_text(sel, 1));
   md->md_equipment = rstr_alloc((void *)sqlite3_column_text(sel, 2));
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   return 0;
 }
 
@@ -1964,7 +2173,7 @@ metadb_metadata_get(void *db, const char *url, time_t mtime)
   rc = db_step(sel);
 
   if(rc != SQLITE_ROW) {
-    sqlite3_finalize(sel);
+    db_finalize(sel);
     db_rollback(db);
     return NULL;
   }
@@ -1977,7 +2186,7 @@ metadb_metadata_get(void *db, const char *url, time_t mtime)
 				&gc);
   get_cache_release(&gc);
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
   db_rollback(db);
   return md;
 }
@@ -2049,7 +2258,7 @@ metadb_metadata_scandir(void *db, const char *url, time_t *mtime)
     }
   }
 
-  sqlite3_finalize(sel);
+  db_finalize(sel);
 
   get_cache_release(&gc);
 
@@ -2097,7 +2306,7 @@ metadb_unparent_item(void *db, const char *url)
     goto again;
   }
 
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   db_commit(db);
 }
 
@@ -2152,7 +2361,7 @@ metadb_register_play(const char *url, int inc, int content_type)
     sqlite3_bind_int(stmt, 3, inc);
     sqlite3_bind_int(stmt, 4, content_type);
     rc = db_step(stmt);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     if(rc == SQLITE_LOCKED) {
       db_rollback_deadlock(db);
       goto again;
@@ -2214,7 +2423,7 @@ metadb_set_video_restartpos(const char *url, int64_t pos_ms)
     sqlite3_bind_int64(stmt, 2, pos_ms);
     sqlite3_bind_int(stmt, 3, CONTENT_VIDEO);
     rc = db_step(stmt);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
     if(rc == SQLITE_LOCKED) {
       db_rollback_deadlock(db);
       goto again;
@@ -2239,7 +2448,7 @@ video_get_restartpos(const char *url)
   sqlite3_stmt *stmt;
   int64_t rval = 0;
 
-  if((db = metadb_get()) == NULL)
+  if((db = metadb_get_ro()) == NULL)
     return 0;
 
   rc = db_prepare(db, 
@@ -2257,9 +2466,9 @@ video_get_restartpos(const char *url)
 
     if(rc == SQLITE_ROW)
       rval = sqlite3_column_int64(stmt, 0);
-    sqlite3_finalize(stmt);
+    db_finalize(stmt);
   }
-  metadb_close(db);
+  metadb_close_ro(db);
   return rval;
 }
 
@@ -2323,7 +2532,7 @@ mip_get(sqlite3 *db, const char *url, metadb_item_info_t *mii)
     rc = 0;
   }
 
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   return rc;
 }
 
@@ -2448,7 +2657,7 @@ metadb_set_playcount(void *opaque, prop_event_t event, ...)
   sqlite3_bind_text(stmt, 1, mip->mip_url, -1, SQLITE_STATIC);
   sqlite3_bind_int64(stmt, 2, v);
   rc = db_step(stmt);
-  sqlite3_finalize(stmt);
+  db_finalize(stmt);
   if(rc == SQLITE_LOCKED) {
     db_rollback_deadlock(db);
     goto again;
@@ -2513,7 +2722,7 @@ metadb_bind_url_to_prop(void *db, const char *url, prop_t *parent)
   if(db != NULL)
     return metadb_bind_url_to_prop0(db, url, parent);
 
-  if((db = metadb_get()) != NULL)
+  if((db = metadb_get_ro()) != NULL)
     metadb_bind_url_to_prop0(db, url, parent);
-  metadb_close(db);
+  metadb_close_ro(db);
 }
@@ -17,27 +17,222 @@
  */
 
 #include <time.h>
+#include <unistd.h>
 #include "showtime.h"
 #include "prop/prop.h"
 #include "callout.h"
 #include "arch/arch.h"
+#include "arch/atomic.h"
 
-static LIST_HEAD(, callout) callouts;
+/**
+ * Hierarchical timer wheel
+ *
+ * Time is quantized into ticks of 1024µs. The first level has one slot
+ * per tick for the next 256 ticks. Each further level has 64 slots,
+ * each slot covering one full revolution of the level below it. When
+ * the first level wraps, the current slot of the next level is cascaded
+ * (its callouts are reinserted into the lower levels), and so on.
+ *
+ * Arming and disarming is O(1). Callouts beyond the range of the wheel
+ * (~19 hours) are parked in the last slot and reinserted when cascaded.
+ */
+#define CW_TICK_SHIFT 10
+#define CW_L0_BITS    8
+#define CW_LN_BITS    6
+#define CW_LN_LEVELS  3
+
+#define CW_L0_SIZE    (1 << CW_L0_BITS)
+#define CW_LN_SIZE    (1 << CW_LN_BITS)
+#define CW_RANGE_BITS (CW_L0_BITS + CW_LN_BITS * CW_LN_LEVELS)
+
+LIST_HEAD(callout_list, callout);
+
+static struct callout_list cw_l0[CW_L0_SIZE];
+static struct callout_list cw_ln[CW_LN_LEVELS][CW_LN_SIZE];
+static uint64_t cw_tick;     // Current tick, everything before is expired
+
+static struct callout_list callout_pending; // Expired, for callout thread
+static struct callout_list callout_workq;   // Expired, for worker pool
 
 static hts_mutex_t callout_mutex;
 static hts_cond_t callout_cond;
+static hts_cond_t callout_worker_cond;
+static uint64_t callout_wakeup; // When callout thread will wake up by itself
+static int callout_workers;
+
+#define CALLOUT_MAX_WORKERS 2
+
+
+/**
+ *
+ */
+static void
+cw_insert(callout_t *c)
+{
+  uint64_t t = c->c_deadline >> CW_TICK_SHIFT;
+  uint64_t d;
+  int i, shift;
+
+  if(t < cw_tick)
+    t = cw_tick;
+
+  d = t - cw_tick;
+
+  if(d < CW_L0_SIZE) {
+    LIST_INSERT_HEAD(&cw_l0[t & (CW_L0_SIZE - 1)], c, c_link);
+    return;
+  }
+
+  if(d >= 1ULL << CW_RANGE_BITS)
+    t = cw_tick + (1ULL << CW_RANGE_BITS) - 1;
+
+  for(i = 0; i < CW_LN_LEVELS - 1; i++) {
+    shift = CW_L0_BITS + CW_LN_BITS * i;
+    if(d < 1ULL << (shift + CW_LN_BITS))
+      break;
+  }
+  shift = CW_L0_BITS + CW_LN_BITS * i;
+  LIST_INSERT_HEAD(&cw_ln[i][(t >> shift) & (CW_LN_SIZE - 1)], c, c_link);
+}
+
 
 /**
- *htsmsg_t *props
+ * Reinsert all callouts in the given slot, they will end up further
+ * down in the hierarchy
  */
 static int
-calloutcmp(callout_t *a, callout_t *b)
+cw_cascade(int level)
+{
+  int shift = CW_L0_BITS + CW_LN_BITS * level;
+  int idx = (cw_tick >> shift) & (CW_LN_SIZE - 1);
+  struct callout_list l;
+  callout_t *c;
+
+  LIST_MOVE(&l, &cw_ln[level][idx], c_link);
+  LIST_INIT(&cw_ln[level][idx]);
+  while((c = LIST_FIRST(&l)) != NULL) {
+    LIST_REMOVE(c, c_link);
+    cw_insert(c);
+  }
+  return idx;
+}
+
+
+/**
+ * Move all callouts that have expired at 'now' to the pending lists
+ */
+static void
+cw_advance(uint64_t now)
+{
+  uint64_t nt = now >> CW_TICK_SHIFT;
+  callout_t *c, *next;
+  int i, n = 0;
+
+  while(1) {
+    struct callout_list *l = &cw_l0[cw_tick & (CW_L0_SIZE - 1)];
+
+    for(c = LIST_FIRST(l); c != NULL; c = next) {
+      next = LIST_NEXT(c, c_link);
+      if(c->c_deadline > now)
+	continue; // Only possible in current tick
+
+      LIST_REMOVE(c, c_link);
+      if(c->c_flags & CALLOUT_WORKER) {
+	LIST_INSERT_HEAD(&callout_workq, c, c_link);
+	n++;
+      } else {
+	LIST_INSERT_HEAD(&callout_pending, c, c_link);
+      }
+    }
+
+    if(cw_tick >= nt)
+      break;
+
+    cw_tick++;
+    if(cw_tick & (CW_L0_SIZE - 1))
+      continue;
+
+    for(i = 0; i < CW_LN_LEVELS; i++)
+      if(cw_cascade(i))
+	break;
+  }
+
+  if(n)
+    hts_cond_broadcast(&callout_worker_cond);
+}
+
+
+/**
+ * Compute when we next need to look at the wheel, 0 if it's empty
+ */
+static uint64_t
+cw_next_deadline(void)
+{
+  uint64_t best = 0, b;
+  callout_t *c;
+  int i, j, shift;
+
+  // First level is exact, but only up to the next cascade
+  for(i = 0; i < CW_L0_SIZE; i++) {
+    uint64_t t = cw_tick + i;
+    if(i > 0 && (t & (CW_L0_SIZE - 1)) == 0) {
+      /* Callouts past the wrap may be preceded by callouts cascaded
+	 down from the next level, so wake up at the wrap and look again */
+      for(; i < CW_L0_SIZE; i++)
+	if(LIST_FIRST(&cw_l0[(cw_tick + i) & (CW_L0_SIZE - 1)]) != NULL)
+	  return t << CW_TICK_SHIFT;
+      break;
+    }
+    LIST_FOREACH(c, &cw_l0[t & (CW_L0_SIZE - 1)], c_link)
+      if(best == 0 || c->c_deadline < best)
+	best = c->c_deadline;
+    if(best)
+      return best;
+  }
+
+  // Upper levels, wake up at the boundary where a slot is cascaded
+  for(i = 0; i < CW_LN_LEVELS; i++) {
+    shift = CW_L0_BITS + CW_LN_BITS * i;
+    for(j = 1; j <= CW_LN_SIZE; j++) {
+      uint64_t slot = (cw_tick >> shift) + j;
+      if(LIST_FIRST(&cw_ln[i][slot & (CW_LN_SIZE - 1)]) == NULL)
+	continue;
+      b = (slot << shift) << CW_TICK_SHIFT;
+      if(best == 0 || b < best)
+	best = b;
+      break;
+    }
+  }
+  return best;
+}
+
+
+/**
+ *
+ */
+static void *
+callout_worker(void *aux)
 {
-  if(a->c_deadline < b->c_deadline)
-    return -1;
-  else if(a->c_deadline > b->c_deadline)
-    return 1;
- return 0;
+  callout_t *c;
+  callout_callback_t *cc;
+  void *opaque;
+
+  hts_mutex_lock(&callout_mutex);
+
+  while(1) {
+    if((c = LIST_FIRST(&callout_workq)) == NULL) {
+      hts_cond_wait(&callout_worker_cond, &callout_mutex);
+      continue;
+    }
+    cc = c->c_callback;
+    opaque = c->c_opaque;
+    LIST_REMOVE(c, c_link);
+    c->c_callback = NULL;
+    hts_mutex_unlock(&callout_mutex);
+    cc(c, opaque);
+    hts_mutex_lock(&callout_mutex);
+  }
+  return NULL;
 }
 
 
@@ -46,7 +241,7 @@ calloutcmp(callout_t *a, callout_t *b)
  */
 static void
 callout_arm_abs(callout_t *d, callout_callback_t *callback, void *opaque,
-		uint64_t deadline)
+		uint64_t deadline, int flags)
 {
   hts_mutex_lock(&callout_mutex);
 
@@ -58,9 +253,18 @@ callout_arm_abs(callout_t *d, callout_callback_t *callback, void *opaque,
   d->c_callback = callback;
   d->c_opaque = opaque;
   d->c_deadline = deadline;
+  d->c_flags = flags;
+
+  cw_insert(d);
+
+  if(flags & CALLOUT_WORKER && callout_workers < CALLOUT_MAX_WORKERS) {
+    callout_workers++;
+    hts_thread_create_detached("callout worker", callout_worker, NULL,
+			       THREAD_PRIO_LOW);
+  }
 
-  LIST_INSERT_SORTED(&callouts, d, c_link, calloutcmp);
-  hts_cond_signal(&callout_cond);
+  if(deadline < callout_wakeup)
+    hts_cond_signal(&callout_cond);
   hts_mutex_unlock(&callout_mutex);
 }
 
@@ -72,7 +276,7 @@ callout_arm(callout_t *d, callout_callback_t *callback,
 	     void *opaque, int delta)
 {
   uint64_t deadline = showtime_get_ts() + delta * 1000000LL;
-  callout_arm_abs(d, callback, opaque, deadline);
+  callout_arm_abs(d, callback, opaque, deadline, 0);
 }
 
 /**
@@ -83,7 +287,19 @@ callout_arm_hires(callout_t *d, callout_callback_t *callback,
 		  void *opaque, uint64_t delta)
 {
   uint64_t deadline = showtime_get_ts() + delta;
-  callout_arm_abs(d, callback, opaque, deadline);
+  callout_arm_abs(d, callback, opaque, deadline, 0);
+}
+
+/**
+ * Arm a callout whose callback may block for a long time (disk IO, etc)
+ * It will be dispatched on a worker thread instead of the callout thread
+ */
+void
+callout_arm_worker(callout_t *d, callout_callback_t *callback,
+		   void *opaque, int delta)
+{
+  uint64_t deadline = showtime_get_ts() + delta * 1000000LL;
+  callout_arm_abs(d, callback, opaque, deadline, CALLOUT_WORKER);
 }
 
 /**
@@ -107,38 +323,143 @@ callout_disarm(callout_t *d)
 static void *
 callout_loop(void *aux)
 {
-  uint64_t now;
+  uint64_t now, next;
   callout_t *c;
   callout_callback_t *cc;
+  void *opaque;
 
   hts_mutex_lock(&callout_mutex);
 
   while(1) {
 
     now = showtime_get_ts();
-  
-    while((c = LIST_FIRST(&callouts)) != NULL && c->c_deadline <= now) {
+    cw_advance(now);
+
+    if((c = LIST_FIRST(&callout_pending)) != NULL) {
       cc = c->c_callback;
+      opaque = c->c_opaque;
       LIST_REMOVE(c, c_link);
       c->c_callback = NULL;
       hts_mutex_unlock(&callout_mutex);
-      cc(c, c->c_opaque);
+      cc(c, opaque);
       hts_mutex_lock(&callout_mutex);
+      continue;
     }
 
-    if((c = LIST_FIRST(&callouts)) != NULL) {
+    next = cw_next_deadline();
 
-      int timeout = (c->c_deadline - now + 999) / 1000;
+    if(next != 0) {
+      int timeout = next > now ? (next - now + 999) / 1000 : 0;
+      callout_wakeup = next;
       hts_cond_wait_timeout(&callout_cond, &callout_mutex, timeout);
     } else {
+      callout_wakeup = UINT64_MAX;
       hts_cond_wait(&callout_cond, &callout_mutex);
     }
+    callout_wakeup = 0;
   }
 
   return NULL;
 }
 
 
+static int callout_bench_fired;
+static int64_t callout_bench_ts;
+
+/**
+ *
+ */
+static void
+callout_bench_cb(struct callout *c, void *aux)
+{
+  atomic_add(&callout_bench_fired, 1);
+}
+
+
+/**
+ *
+ */
+static void
+callout_bench_wrap_cb(struct callout *c, void *aux)
+{
+  callout_bench_ts = showtime_get_ts();
+}
+
+
+/**
+ * Arm, rearm, disarm and finally expire a large number of callouts
+ */
+int
+callout_bench(void)
+{
+  const int num = 100000;
+  callout_t *v = calloc(num, sizeof(callout_t));
+  int64_t ts;
+  int i;
+
+  ts = showtime_get_ts();
+  for(i = 0; i < num; i++)
+    callout_arm_hires(&v[i], callout_bench_cb, NULL,
+		      1000000 + (rand() % 100000000));
+  ts = showtime_get_ts() - ts;
+  TRACE(TRACE_INFO, "callout", "Armed %d callouts in %d ms (%d ns/callout)",
+	num, (int)(ts / 1000), (int)(ts * 1000 / num));
+
+  ts = showtime_get_ts();
+  for(i = 0; i < num; i++)
+    callout_arm_hires(&v[i], callout_bench_cb, NULL,
+		      1000000 + (rand() % 100000000));
+  ts = showtime_get_ts() - ts;
+  TRACE(TRACE_INFO, "callout", "Rearmed %d callouts in %d ms (%d ns/callout)",
+	num, (int)(ts / 1000), (int)(ts * 1000 / num));
+
+  ts = showtime_get_ts();
+  for(i = 0; i < num; i++)
+    callout_disarm(&v[i]);
+  ts = showtime_get_ts() - ts;
+  TRACE(TRACE_INFO, "callout", "Disarmed %d callouts in %d ms (%d ns/callout)",
+	num, (int)(ts / 1000), (int)(ts * 1000 / num));
+
+  callout_bench_fired = 0;
+  ts = showtime_get_ts();
+  for(i = 0; i < num; i++)
+    callout_arm_hires(&v[i], callout_bench_cb, NULL, rand() % 100000);
+
+  while(callout_bench_fired < num)
+    usleep(1000);
+
+  ts = showtime_get_ts() - ts;
+  TRACE(TRACE_INFO, "callout",
+	"Expired %d callouts spread over 100 ms in %d ms", 
+	num, (int)(ts / 1000));
+
+  // A lone callout that expires just after the first level wraps
+  while(((showtime_get_ts() >> CW_TICK_SHIFT) & (CW_L0_SIZE - 1)) <
+	CW_L0_SIZE - 10)
+    usleep(500);
+
+  callout_bench_ts = 0;
+  ts = showtime_get_ts();
+  callout_arm_hires(&v[0], callout_bench_wrap_cb, NULL, 20000);
+
+  for(i = 0; i < 1000 && callout_bench_ts == 0; i++)
+    usleep(1000);
+
+  if(callout_bench_ts == 0) {
+    callout_disarm(&v[0]);
+    TRACE(TRACE_ERROR, "callout",
+	  "Callout across first level wrap did not fire within 1s");
+  } else {
+    TRACE(TRACE_INFO, "callout",
+	  "Callout across first level wrap fired after %d ms (armed 20 ms)",
+	  (int)((callout_bench_ts - ts) / 1000));
+  }
+
+  free(v);
+  return 0;
+}
+
+
 static callout_t callout_clock;
 
 static prop_t *prop_hour;
@@ -178,6 +499,9 @@ callout_init(void)
 
   hts_mutex_init(&callout_mutex);
   hts_cond_init(&callout_cond, &callout_mutex);
+  hts_cond_init(&callout_worker_cond, &callout_mutex);
+
+  cw_tick = showtime_get_ts() >> CW_TICK_SHIFT;
 
   hts_thread_create_detached("callout", callout_loop, NULL, THREAD_PRIO_LOW);
 
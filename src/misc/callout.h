@@ -30,6 +30,8 @@ typedef struct callout {
   callout_callback_t *c_callback;
   void *c_opaque;
   uint64_t c_deadline;
+  int c_flags;
+#define CALLOUT_WORKER 0x1 // Run callback on worker thread
 } callout_t;
 
 void callout_arm(callout_t *c, callout_callback_t *callback,
@@ -38,10 +40,15 @@ void callout_arm(callout_t *c, callout_callback_t *callback,
 void callout_arm_hires(callout_t *d, callout_callback_t *callback,
 		       void *opaque, uint64_t delta);
 
+void callout_arm_worker(callout_t *d, callout_callback_t *callback,
+			void *opaque, int delta);
+
 void callout_disarm(callout_t *c);
 
 void callout_init(void);
 
+int callout_bench(void);
+
 #define callout_isarmed(c) ((c)->c_callback != NULL)
 
 #endif /* CALLOUT_H__ */
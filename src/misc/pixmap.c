@@ -151,8 +151,12 @@ pixmap_release(pixmap_t *pm)
     return;
 
   if(!pixmap_is_coded(pm)) {
+    int i;
     free(pm->pm_pixels);
     free(pm->pm_charpos);
+    for(i = 0; i < pm->pm_numglyphs; i++)
+      pixmap_release(pm->pm_glyphs[i].pg_pm);
+    free(pm->pm_glyphs);
   } else {
     free(pm->pm_data);
   }
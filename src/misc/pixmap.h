@@ -56,6 +56,18 @@ typedef struct image_meta {
   char im_32bit_swizzle; // can do full 32bit swizzle in hardware
 } image_meta_t;
 
+/**
+ * A positioned glyph bitmap. Used when text is delivered as a list of
+ * glyphs instead of being composited into the pixmap itself
+ */
+typedef struct pixmap_glyph {
+  struct pixmap *pg_pm;   // PIXMAP_I coverage bitmap
+  int16_t pg_x;           // Left edge in pixmap coordinates
+  int16_t pg_y;           // Top edge in pixmap coordinates
+  uint32_t pg_color;      // 0xAABBGGRR
+} pixmap_glyph_t;
+
+
 /**
  * Internal struct for passing images
  */
@@ -86,6 +98,8 @@ typedef struct pixmap {
       int *charpos;
       int linesize;
       int charposlen;
+      pixmap_glyph_t *glyphs;
+      int numglyphs;
     } raw;
 
     struct {
@@ -103,6 +117,8 @@ typedef struct pixmap {
 #define pm_linesize   raw.linesize
 #define pm_charpos    raw.charpos
 #define pm_charposlen raw.charposlen
+#define pm_glyphs     raw.glyphs
+#define pm_numglyphs  raw.numglyphs
 
 pixmap_t *pixmap_alloc_coded(const void *data, size_t size,
 			     pixmap_type_t type);
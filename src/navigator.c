@@ -233,7 +233,7 @@ nav_spawn(void)
 void
 nav_init(void)
 {
-  nav_courier = prop_courier_create_thread(NULL, "navigator");
+  nav_courier = prop_courier_create_thread(NULL, "navigator", 0);
   bookmarks_init();
   nav_create(prop_create(prop_get_global(), "nav"));
 }
@@ -24,6 +24,8 @@
 #include <fcntl.h>
 #include <poll.h>
 #include <errno.h>
+#include <sys/stat.h>
+#include <inttypes.h>
 
 #include <netinet/in.h>
 
@@ -36,9 +38,23 @@
 #include "http.h"
 #include "http_server.h"
 
+#include "fileaccess/fileaccess.h"
+
+#if ENABLE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#if ENABLE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
+#define HTTP_FILE_CHUNK (64 * 1024)
+
 int http_server_port;
+int http_server_workers = 4;
 static LIST_HEAD(, http_path) http_paths;
 LIST_HEAD(http_connection_list, http_connection); 
+TAILQ_HEAD(http_connection_queue, http_connection); 
 
 /**
  *
@@ -46,8 +62,10 @@ LIST_HEAD(http_connection_list, http_connection);
 struct http_connection {
   
   LIST_ENTRY(http_connection) hc_link;
+  TAILQ_ENTRY(http_connection) hc_work_link;
   int hc_fd;
   int hc_events;
+  int hc_revents;  // Events to process when dispatched to a worker
 
   int hc_state;
 #define HCS_COMMAND 0
@@ -79,6 +97,17 @@ struct http_connection {
   size_t hc_post_len;
   size_t hc_post_offset;
 
+  /**
+   * File response body. Sent once hc_output has drained, either
+   * straight from hc_file_fd (using sendfile() if available) or
+   * read chunk by chunk from a fileaccess handle.
+   */
+  int hc_file_fd;
+  void *hc_file_fh;
+  int64_t hc_file_offset;
+  int64_t hc_file_remain;
+  char hc_input_stalled;  // Pipelined requests waiting for file response
+
   char hc_myaddr[32];
 };
 
@@ -124,8 +153,22 @@ typedef struct http_server {
   int hs_numcon;
   int hs_fd;
 
+#if ENABLE_EPOLL
+  /**
+   * The I/O thread only waits for events and accepts connections.
+   * Connections are registered with EPOLLONESHOT so once an event
+   * fires the connection is owned by a single worker (which reads,
+   * runs handlers for all pipelined requests and writes) until it's
+   * rearmed or closed by that worker.
+   */
+  int hs_epollfd;
+  hts_mutex_t hs_mutex;
+  hts_cond_t hs_work_cond;
+  struct http_connection_queue hs_workq;
+#else
   int hs_fds_size;
   struct pollfd *hs_fds;
+#endif
 
   struct http_connection_list hs_connections;
 
@@ -166,6 +209,20 @@ http_path_add(const char *path, void *opaque, http_callback_t *callback,
 }
 
 
+/**
+ * Remove a path added with http_path_add()
+ */
+void
+http_path_remove(void *opaque)
+{
+  http_path_t *hp = opaque;
+
+  LIST_REMOVE(hp, hp_link);
+  free((void *)hp->hp_path);
+  free(hp);
+}
+
+
 /**
  *
  */
@@ -229,6 +286,7 @@ http_rc2str(int code)
 {
   switch(code) {
   case HTTP_STATUS_OK:              return "Ok";
+  case HTTP_STATUS_PARTIAL_CONTENT: return "Partial Content";
   case HTTP_STATUS_NOT_FOUND:       return "Not found";
   case HTTP_STATUS_UNAUTHORIZED:    return "Unauthorized";
   case HTTP_STATUS_BAD_REQUEST:     return "Bad request";
@@ -236,6 +294,7 @@ http_rc2str(int code)
   case HTTP_STATUS_METHOD_NOT_ALLOWED: return "Method not allowed";
   case HTTP_STATUS_PRECONDITION_FAILED: return "Precondition failed";
   case HTTP_STATUS_UNSUPPORTED_MEDIA_TYPE: return "Unsupported media type";
+  case HTTP_STATUS_RANGE_NOT_SATISFIABLE: return "Range not satisfiable";
   case HTTP_NOT_IMPLEMENTED: return "Not implemented";
   case 500: return "Internal Server Error";
   default:
@@ -249,7 +308,7 @@ http_rc2str(int code)
  */
 static void
 http_send_header(http_connection_t *hc, int rc, const char *content, 
-		 int contentlen, const char *encoding, const char *location, 
+		 int64_t contentlen, const char *encoding, const char *location, 
 		 int maxage, const char *range)
 {
   htsbuf_queue_t hdrs;
@@ -297,7 +356,10 @@ http_send_header(http_connection_t *hc, int rc, const char *content,
   if(content != NULL)
     htsbuf_qprintf(&hdrs, "Content-Type: %s\r\n", content);
 
-  htsbuf_qprintf(&hdrs, "Content-Length: %d\r\n", contentlen);
+  htsbuf_qprintf(&hdrs, "Content-Length: %"PRId64"\r\n", contentlen);
+
+  if(range != NULL)
+    htsbuf_qprintf(&hdrs, "Content-Range: %s\r\n", range);
 
   LIST_FOREACH(hh, &hc->hc_response_headers, hh_link)
     htsbuf_qprintf(&hdrs, "%s: %s\r\n", hh->hh_key, hh->hh_value);
@@ -369,6 +431,172 @@ http_send_reply(http_connection_t *hc, int rc, const char *content,
 }
 
 
+/**
+ * Parse a "Range: bytes=..." header
+ *
+ * Returns 1 if a valid range was found, 0 if the header should be
+ * ignored (we only do single ranges) and -1 if not satisfiable
+ */
+static int
+http_parse_range(const char *r, int64_t size, int64_t *startp, int64_t *endp)
+{
+  int64_t start, end;
+  char *e;
+
+  if(strncasecmp(r, "bytes=", 6))
+    return 0;
+  r += 6;
+
+  if(strchr(r, ',') != NULL)
+    return 0;
+
+  while(*r == ' ')
+    r++;
+
+  if(*r == '-') {
+    // Suffix range, last N bytes
+    end = strtoll(r + 1, &e, 10);
+    if(e == r + 1)
+      return 0;
+    if(end == 0 || size == 0)
+      return -1;
+    start = end > size ? 0 : size - end;
+    end = size - 1;
+  } else {
+    start = strtoll(r, &e, 10);
+    if(e == r || *e != '-')
+      return 0;
+    r = e + 1;
+    end = strtoll(r, &e, 10);
+    if(e == r)
+      end = size - 1;
+    else if(end < start)
+      return 0;
+
+    if(start >= size)
+      return -1;
+    if(end >= size)
+      end = size - 1;
+  }
+
+  *startp = start;
+  *endp = end;
+  return 1;
+}
+
+
+/**
+ *
+ */
+static void
+http_file_close(http_connection_t *hc)
+{
+  if(hc->hc_file_fd != -1)
+    close(hc->hc_file_fd);
+  if(hc->hc_file_fh != NULL)
+    fa_close(hc->hc_file_fh);
+  hc->hc_file_fd = -1;
+  hc->hc_file_fh = NULL;
+  hc->hc_file_remain = 0;
+}
+
+
+/**
+ * Send a file response, the body is sent directly from the source
+ * once the headers have been written. Honours single byte ranges.
+ * Takes ownership of 'fd' or 'fh'
+ */
+static int
+http_send_stream(http_connection_t *hc, int fd, void *fh, int64_t size,
+		 const char *content, int maxage)
+{
+  int64_t start = 0, end = size - 1;
+  const char *r = http_header_get(&hc->hc_request_headers, "range");
+  int rc = HTTP_STATUS_OK;
+  char range[128];
+
+  http_file_close(hc);
+
+  http_set_response_hdr(hc, "Accept-Ranges", "bytes");
+
+  if(r != NULL) {
+    switch(http_parse_range(r, size, &start, &end)) {
+    case -1:
+      snprintf(range, sizeof(range), "bytes */%"PRId64, size);
+      http_send_header(hc, HTTP_STATUS_RANGE_NOT_SATISFIABLE, NULL, 0,
+		       NULL, NULL, 0, range);
+      goto done;
+
+    case 1:
+      rc = HTTP_STATUS_PARTIAL_CONTENT;
+      snprintf(range, sizeof(range), "bytes %"PRId64"-%"PRId64"/%"PRId64,
+	       start, end, size);
+      break;
+    }
+  }
+
+  http_send_header(hc, rc, content, end - start + 1, NULL, NULL, maxage,
+		   rc == HTTP_STATUS_PARTIAL_CONTENT ? range : NULL);
+
+  if(hc->hc_no_output || end < start)
+    goto done;
+
+  if(fh != NULL && start != 0 && fa_seek(fh, start, SEEK_SET) != start) {
+    // Headers are already queued, all we can do is to drop the connection
+    hc->hc_keep_alive = 0;
+    goto done;
+  }
+
+  hc->hc_file_fd = fd;
+  hc->hc_file_fh = fh;
+  hc->hc_file_offset = start;
+  hc->hc_file_remain = end - start + 1;
+  return 0;
+
+ done:
+  if(fd != -1)
+    close(fd);
+  if(fh != NULL)
+    fa_close(fh);
+  return 0;
+}
+
+
+/**
+ * Send an open local file. Takes ownership of the file descriptor
+ */
+int
+http_send_file(http_connection_t *hc, int fd, const char *content,
+	       int maxage)
+{
+  struct stat st;
+
+  if(fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return HTTP_STATUS_NOT_FOUND;
+  }
+  return http_send_stream(hc, fd, NULL, st.st_size, content, maxage);
+}
+
+
+/**
+ * Send from a fileaccess handle (for non-local or cached files).
+ * Takes ownership of the handle
+ */
+int
+http_send_fh(http_connection_t *hc, void *fh, const char *content,
+	     int maxage)
+{
+  int64_t size = fa_fsize(fh);
+
+  if(size < 0) {
+    fa_close(fh);
+    return HTTP_STATUS_NOT_FOUND;
+  }
+  return http_send_stream(hc, -1, fh, size, content, maxage);
+}
+
+
 /**
  * Send HTTP error back
  */
@@ -806,6 +1034,12 @@ http_handle_input(http_connection_t *hc)
       free(hc->hc_post_data);
       hc->hc_post_data = NULL;
 
+      if(hc->hc_file_remain) {
+	// Keep response order, continue once the file has been sent
+	hc->hc_input_stalled = 1;
+	return 0;
+      }
+
       if((r = http_read_line(hc, buf, sizeof(buf))) == -1)
 	return 1;
 
@@ -874,10 +1108,10 @@ http_handle_input(http_connection_t *hc)
 
 
 /**
- *
+ * Returns -1 on error, 1 if socket is full, 0 if queue is drained
  */
 static int
-http_write(http_connection_t *hc)
+http_write_queue(http_connection_t *hc)
 {
   htsbuf_data_t *hd;
   int l, r = 0;
@@ -900,16 +1134,61 @@ http_write(http_connection_t *hc)
     if(r != l) {
       // Failed to write it all
       hd->hd_data_off += r;
-      hc->hc_events |= POLLOUT;
-      return 0;
+      return 1;
     }
 
     TAILQ_REMOVE(&q->hq_q, hd, hd_link);
     free(hd->hd_data);
     free(hd);
   }
-  hc->hc_events &= ~POLLOUT;
-  return !hc->hc_keep_alive;
+  return 0;
+}
+
+
+/**
+ * Move next part of file response to the socket
+ *
+ * Returns -1 on error, 1 if socket is full, 0 if we made progress
+ */
+static int
+http_write_file(http_connection_t *hc)
+{
+  size_t len = MIN(hc->hc_file_remain, HTTP_FILE_CHUNK);
+  ssize_t r;
+
+#if ENABLE_SENDFILE
+  if(hc->hc_file_fd != -1) {
+    off_t off = hc->hc_file_offset;
+
+    r = sendfile(hc->hc_fd, hc->hc_file_fd, &off, len);
+    if(r == -1)
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 1 : -1;
+    if(r == 0)
+      return -1; // File truncated under our feet
+
+    hc->hc_file_offset += r;
+    hc->hc_file_remain -= r;
+    return 0;
+  }
+#endif
+
+  // Read a chunk into the output queue, it's written by the caller
+
+  char *mem = malloc(len);
+
+  if(hc->hc_file_fh != NULL)
+    r = fa_read(hc->hc_file_fh, mem, len);
+  else
+    r = pread(hc->hc_file_fd, mem, len, hc->hc_file_offset);
+
+  if(r <= 0) {
+    free(mem);
+    return -1;
+  }
+  htsbuf_append_prealloc(&hc->hc_output, mem, r);
+  hc->hc_file_offset += r;
+  hc->hc_file_remain -= r;
+  return 0;
 }
 
 
@@ -917,6 +1196,36 @@ http_write(http_connection_t *hc)
  *
  */
 static int
+http_write(http_connection_t *hc)
+{
+  int r;
+
+  while(1) {
+    if((r = http_write_queue(hc)) != 0)
+      break;
+
+    if(hc->hc_file_remain == 0) {
+      http_file_close(hc);
+      hc->hc_events &= ~POLLOUT;
+      return !hc->hc_keep_alive;
+    }
+
+    if((r = http_write_file(hc)) != 0)
+      break;
+  }
+
+  if(r == -1)
+    return -1;
+
+  hc->hc_events |= POLLOUT;
+  return 0;
+}
+
+
+/**
+ * Read whatever is available and process all complete requests
+ */
+static int
 http_io(http_connection_t *hc, int revents)
 {
   int r;
@@ -933,10 +1242,16 @@ http_io(http_connection_t *hc, int revents)
 	return 1;
     } else {
       free(mem);
-      return 1;
+      if(r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+	return 1;
     }
   }
-  r = http_write(hc);
+  while((r = http_write(hc)) == 0 && hc->hc_input_stalled &&
+	hc->hc_file_remain == 0) {
+    hc->hc_input_stalled = 0;
+    if(http_handle_input(hc))
+      return 1;
+  }
   return r;
 }
 
@@ -950,11 +1265,19 @@ http_close(http_server_t *hs, http_connection_t *hc)
   hsprintf("%p: ----------------- CLOSED CONNECTION\n", hc);
   htsbuf_queue_flush(&hc->hc_input);
   htsbuf_queue_flush(&hc->hc_output);
+  http_file_close(hc);
   http_headers_free(&hc->hc_req_args);
   http_headers_free(&hc->hc_request_headers);
   http_headers_free(&hc->hc_response_headers);
+#if ENABLE_EPOLL
+  epoll_ctl(hs->hs_epollfd, EPOLL_CTL_DEL, hc->hc_fd, NULL);
+  hts_mutex_lock(&hs->hs_mutex);
+#endif
   LIST_REMOVE(hc, hc_link);
   hs->hs_numcon--;
+#if ENABLE_EPOLL
+  hts_mutex_unlock(&hs->hs_mutex);
+#endif
   close(hc->hc_fd);
   free(hc->hc_url);
   free(hc->hc_url_orig);
@@ -995,6 +1318,8 @@ http_accept(http_server_t *hs)
   fd = accept(hs->hs_fd, (struct sockaddr *)&si, &sl);
 
   if(fd == -1) {
+    if(errno == EAGAIN || errno == EWOULDBLOCK)
+      return;
     TRACE(TRACE_ERROR, "HTTPSRV", "Accept error: %s", strerror(errno));
     sleep(1);
     return;
@@ -1003,8 +1328,7 @@ http_accept(http_server_t *hs)
   hc = calloc(1, sizeof(http_connection_t));
   hc->hc_fd = fd;
   hc->hc_events = POLLIN | POLLHUP | POLLERR;
-  LIST_INSERT_HEAD(&hs->hs_connections, hc, hc_link);
-  hs->hs_numcon++;
+  hc->hc_file_fd = -1;
   htsbuf_queue_init(&hc->hc_input, 0);
   htsbuf_queue_init(&hc->hc_output, 0);
 
@@ -1046,6 +1370,61 @@ http_accept(http_server_t *hs)
     hc->hc_myaddr[0] = 0;
   }
   hsprintf("%p: ----------------- NEW CONNECTION\n", hc);
+
+#if ENABLE_EPOLL
+  struct epoll_event ev = {0};
+
+  hts_mutex_lock(&hs->hs_mutex);
+  LIST_INSERT_HEAD(&hs->hs_connections, hc, hc_link);
+  hs->hs_numcon++;
+  hts_mutex_unlock(&hs->hs_mutex);
+
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+  ev.data.ptr = hc;
+  if(epoll_ctl(hs->hs_epollfd, EPOLL_CTL_ADD, fd, &ev))
+    http_close(hs, hc);
+#else
+  LIST_INSERT_HEAD(&hs->hs_connections, hc, hc_link);
+  hs->hs_numcon++;
+#endif
+}
+
+
+#if ENABLE_EPOLL
+
+/**
+ *
+ */
+static void *
+http_worker(void *aux)
+{
+  http_server_t *hs = aux;
+  http_connection_t *hc;
+  struct epoll_event ev = {0};
+
+  hts_mutex_lock(&hs->hs_mutex);
+
+  while(1) {
+    if((hc = TAILQ_FIRST(&hs->hs_workq)) == NULL) {
+      hts_cond_wait(&hs->hs_work_cond, &hs->hs_mutex);
+      continue;
+    }
+    TAILQ_REMOVE(&hs->hs_workq, hc, hc_work_link);
+    hts_mutex_unlock(&hs->hs_mutex);
+
+    if(http_io(hc, hc->hc_revents)) {
+      http_close(hs, hc);
+    } else {
+      ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+      if(hc->hc_events & POLLOUT)
+	ev.events |= EPOLLOUT;
+      ev.data.ptr = hc;
+      if(epoll_ctl(hs->hs_epollfd, EPOLL_CTL_MOD, hc->hc_fd, &ev))
+	http_close(hs, hc);
+    }
+    hts_mutex_lock(&hs->hs_mutex);
+  }
+  return NULL;
 }
 
 
@@ -1054,6 +1433,82 @@ http_accept(http_server_t *hs)
  */
 static void *
 http_server(void *aux)
+{
+  http_server_t *hs = aux;
+  struct epoll_event ev[16];
+  http_connection_t *hc;
+  int i, n;
+
+  while(1) {
+    n = epoll_wait(hs->hs_epollfd, ev, 16, -1);
+    if(n == -1)
+      continue;
+
+    for(i = 0; i < n; i++) {
+      if((hc = ev[i].data.ptr) == NULL) {
+	http_accept(hs);
+	continue;
+      }
+
+      hc->hc_revents = 
+	(ev[i].events & EPOLLIN  ? POLLIN  : 0) |
+	(ev[i].events & EPOLLOUT ? POLLOUT : 0) |
+	(ev[i].events & (EPOLLHUP | EPOLLERR) ? POLLERR : 0);
+
+      if(ev[i].events & EPOLLRDHUP && !(ev[i].events & EPOLLIN))
+	hc->hc_revents |= POLLHUP;
+
+      hts_mutex_lock(&hs->hs_mutex);
+      TAILQ_INSERT_TAIL(&hs->hs_workq, hc, hc_work_link);
+      hts_cond_signal(&hs->hs_work_cond);
+      hts_mutex_unlock(&hs->hs_mutex);
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static int
+http_server_start(http_server_t *hs)
+{
+  struct epoll_event ev = {0};
+  int i;
+
+  if((hs->hs_epollfd = epoll_create(16)) == -1) {
+    TRACE(TRACE_ERROR, "HTTPSRV", "Unable to create epoll fd -- %s",
+	  strerror(errno));
+    return -1;
+  }
+
+  hts_mutex_init(&hs->hs_mutex);
+  hts_cond_init(&hs->hs_work_cond, &hs->hs_mutex);
+  TAILQ_INIT(&hs->hs_workq);
+
+  fcntl(hs->hs_fd, F_SETFL, fcntl(hs->hs_fd, F_GETFL) | O_NONBLOCK);
+
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  epoll_ctl(hs->hs_epollfd, EPOLL_CTL_ADD, hs->hs_fd, &ev);
+
+  for(i = 0; i < MAX(1, http_server_workers); i++)
+    hts_thread_create_detached("httpworker", http_worker, hs,
+			       THREAD_PRIO_NORMAL);
+
+  hts_thread_create_detached("httpsrv", http_server, hs,
+			     THREAD_PRIO_NORMAL);
+  return 0;
+}
+
+#else
+
+/**
+ * Single threaded poll() based server
+ */
+static void *
+http_server(void *aux)
 {
   http_server_t *hs = aux;
   int n, r;
@@ -1098,6 +1553,20 @@ http_server(void *aux)
 }
 
 
+/**
+ *
+ */
+static int
+http_server_start(http_server_t *hs)
+{
+  hts_thread_create_detached("httpsrv", http_server, hs,
+			     THREAD_PRIO_NORMAL);
+  return 0;
+}
+
+#endif
+
+
 /**
  *
  */
@@ -1142,10 +1611,12 @@ http_server_init(void)
 
   TRACE(TRACE_INFO, "HTTPSRV", "Listening on port %d", http_server_port);
 
-  listen(fd, 1);
+  listen(fd, 16);
     
   hs = calloc(1, sizeof(http_server_t));
   hs->hs_fd = fd;  
-  hts_thread_create_detached("httpsrv", http_server, hs,
-			     THREAD_PRIO_NORMAL);
+  if(http_server_start(hs)) {
+    close(fd);
+    free(hs);
+  }
 }
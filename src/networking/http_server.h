@@ -35,6 +35,8 @@ void http_server_init(void);
 void *http_path_add(const char *path, void *opaque, http_callback_t *callback,
 		    int leaf);
 
+void http_path_remove(void *hp);
+
 int http_send_reply(http_connection_t *hc, int rc, const char *content, 
 		    const char *encoding, const char *location, int maxage,
 		    htsbuf_queue_t *output);
@@ -56,9 +58,17 @@ int http_get_my_port(http_connection_t *hc);
 
 void *http_get_post_data(http_connection_t *hc, size_t *sizep, int steal);
 
+int http_send_file(http_connection_t *hc, int fd, const char *content,
+		   int maxage);
+
+int http_send_fh(http_connection_t *hc, void *fh, const char *content,
+		 int maxage);
+
 void http_set_response_hdr(http_connection_t *hc, const char *name,
 			   const char *value);
 
 extern int http_server_port;
 
+extern int http_server_workers;
+
 #endif // HTTP_SERVER_H__
@@ -168,7 +168,7 @@ eventsink(void *opaque, prop_event_t event, ...)
 event_t *
 popup_display(prop_t *p)
 {
-  prop_courier_t *pc = prop_courier_create_waitable();
+  prop_courier_t *pc = prop_courier_create_waitable(0);
   event_t *e = NULL;
 
   prop_t *r = prop_create(p, "eventSink");
@@ -781,7 +781,7 @@ void
 plugins_init(const char *loadme, const char *repo, int sync_init)
 {
   hts_mutex_init(&plugin_mutex);
-  plugin_courier = prop_courier_create_waitable();
+  plugin_courier = prop_courier_create_waitable(0);
 
   plugins_setup_root_props();
 
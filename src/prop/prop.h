@@ -171,6 +171,9 @@ prop_t *prop_create_root_ex(const char *name, int noalloc)
 #define prop_create_root(name) \
   prop_create_root_ex(name, __builtin_constant_p(name))
 
+prop_t *prop_create_root_domain(const char *domainname)
+  __attribute__ ((malloc));
+
 void prop_destroy(prop_t *p);
 
 void prop_destroy_by_name(prop_t *parent, const char *name);
@@ -328,20 +331,29 @@ void prop_request_delete(prop_t *p);
 
 void prop_request_delete_multi(prop_vec_t *pv);
 
+/**
+ * Only deliver the most recent value for each subscription if multiple
+ * value changes are pending in the courier
+ */
+#define PROP_COURIER_COALESCE 0x1
+
 prop_courier_t *prop_courier_create_thread(hts_mutex_t *entrymutex,
-					   const char *name);
+					   const char *name, int flags);
 
-prop_courier_t *prop_courier_create_passive(void);
+prop_courier_t *prop_courier_create_passive(int flags);
 
 prop_courier_t *prop_courier_create_notify(void (*notify)(void *opaque),
-					   void *opaque);
+					   void *opaque, int flags);
 
-prop_courier_t *prop_courier_create_waitable(void);
+prop_courier_t *prop_courier_create_waitable(int flags);
 
 prop_courier_t *prop_courier_create_lockmgr(const char *name, 
 					    prop_lockmgr_t *mgr, void *lock,
 					    void (*prologue)(void),
-					    void (*epilogue)(void));
+					    void (*epilogue)(void),
+					    int flags);
+
+int prop_courier_get_dropped(prop_courier_t *pc);
 
 int prop_courier_wait(prop_courier_t *pc,
 		      struct prop_notify_queue *exp,
@@ -415,6 +427,10 @@ const char *propname(prop_t *p);
 
 void prop_print_tree(prop_t *p, int followlinks);
 
+void prop_print_lock_stats(void);
+
+int prop_domain_bench(void);
+
 void prop_test(void);
 
 #ifdef PROP_DEBUG
@@ -150,6 +150,8 @@ src_cb(void *opaque, prop_event_t event, ...)
   case PROP_DEL_CHILD:
     p = va_arg(ap, prop_t *);
     out = prop_tag_clear(p, pcs);
+    prop_enter(out);
+    prop_enter(out->hp_parent);
     before = TAILQ_NEXT(out, hp_parent_link);
     prop_destroy0(out);
 
@@ -203,7 +205,7 @@ prop_concat_add_source(prop_concat_t *pc, prop_t *src, prop_t *header)
   pcs->pcs_header = header;
   pcs->pcs_pc = pc;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
 
   TAILQ_INSERT_TAIL(&pc->pc_queue, pcs, pcs_link);
 
@@ -213,7 +215,7 @@ prop_concat_add_source(prop_concat_t *pc, prop_t *src, prop_t *header)
 				   PROP_TAG_ROOT, src,
 				   NULL);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -35,10 +35,19 @@
 int prop_trace;
 #endif
 
-hts_mutex_t prop_mutex;
 hts_mutex_t prop_tag_mutex;
+prop_lock_domain_t prop_global_domain;
 static prop_t *prop_global;
 
+/**
+ * Domains acquired by the current holder of the global lock.
+ * Protected by the global lock
+ */
+static prop_lock_domain_t *prop_entered_domains;
+
+static hts_mutex_t prop_lock_domains_mutex;
+static LIST_HEAD(, prop_lock_domain) prop_lock_domains;
+
 static prop_courier_t *global_courier;
 
 static void prop_unlink0(prop_t *p, prop_sub_t *skipme, const char *origin,
@@ -46,9 +55,254 @@ static void prop_unlink0(prop_t *p, prop_sub_t *skipme, const char *origin,
 
 static void prop_flood_flag(prop_t *p, int set, int clr);
 
+static prop_t *prop_create_child0(prop_t *parent, const char *name,
+				  prop_sub_t *skipme, int noalloc);
+
+static void courier_dequeue(prop_courier_t *pc, struct prop_notify_queue *dst,
+			    struct prop_notify_queue *src);
+
 #define PROPTRACE(fmt...) trace(TRACE_NO_PROP, TRACE_DEBUG, "prop", fmt)
 
 
+/**
+ *
+ */
+static void
+prop_lock_domain_lock(prop_lock_domain_t *pld)
+{
+  int contended = atomic_add(&pld->pld_waiters, 1) > 0;
+
+  hts_mutex_lock(&pld->pld_mutex);
+  pld->pld_acquired++;
+  pld->pld_contended += contended;
+}
+
+
+/**
+ *
+ */
+static void
+prop_lock_domain_unlock(prop_lock_domain_t *pld)
+{
+  atomic_add(&pld->pld_waiters, -1);
+  hts_mutex_unlock(&pld->pld_mutex);
+}
+
+
+/**
+ *
+ */
+static prop_lock_domain_t *
+prop_lock_domain_retain(prop_lock_domain_t *pld)
+{
+  if(pld != &prop_global_domain)
+    atomic_add(&pld->pld_refcount, 1);
+  return pld;
+}
+
+
+/**
+ *
+ */
+static void
+prop_lock_domain_release(prop_lock_domain_t *pld)
+{
+  if(pld == &prop_global_domain || atomic_add(&pld->pld_refcount, -1) > 1)
+    return;
+
+  hts_mutex_lock(&prop_lock_domains_mutex);
+  LIST_REMOVE(pld, pld_link);
+  hts_mutex_unlock(&prop_lock_domains_mutex);
+
+  PROPTRACE("Lock domain %s destroyed, %d locks, %d contended",
+	    pld->pld_name, pld->pld_acquired, pld->pld_contended);
+
+  hts_mutex_destroy(&pld->pld_mutex);
+  free(pld->pld_name);
+  free(pld);
+}
+
+
+/**
+ *
+ */
+static void
+prop_lock_domain_init(prop_lock_domain_t *pld, const char *name)
+{
+  hts_mutex_init(&pld->pld_mutex);
+  pld->pld_refcount = 1;
+  pld->pld_name = strdup(name);
+
+  hts_mutex_lock(&prop_lock_domains_mutex);
+  LIST_INSERT_HEAD(&prop_lock_domains, pld, pld_link);
+  hts_mutex_unlock(&prop_lock_domains_mutex);
+}
+
+
+/**
+ *
+ */
+void
+prop_global_lock(void)
+{
+  prop_lock_domain_lock(&prop_global_domain);
+}
+
+
+/**
+ *
+ */
+void
+prop_global_unlock(void)
+{
+  prop_lock_domain_t *pld;
+
+  while((pld = prop_entered_domains) != NULL) {
+    prop_entered_domains = pld->pld_entered_next;
+    pld->pld_entered = 0;
+    prop_lock_domain_unlock(pld);
+    prop_lock_domain_release(pld);
+  }
+  prop_lock_domain_unlock(&prop_global_domain);
+}
+
+
+/**
+ * Acquire another domain while holding the global lock.
+ * Use prop_enter() instead of calling this directly
+ */
+void
+prop_lock_domain_enter(prop_lock_domain_t *pld)
+{
+  assert(pld != &prop_global_domain);
+  prop_lock_domain_retain(pld);
+  prop_lock_domain_lock(pld);
+  pld->pld_entered = 1;
+  pld->pld_entered_next = prop_entered_domains;
+  prop_entered_domains = pld;
+}
+
+
+/**
+ * Lock for an operation on 'p' that only touches 'p' and its
+ * children and subscribers.
+ *
+ * If 'p' lives in a domain of its own (and none of the 'flags' are set
+ * on it) only that domain is locked and returned. Otherwise we fall
+ * back to the global lock and NULL is returned.
+ *
+ * Release using prop_unlock()
+ */
+static prop_lock_domain_t *
+prop_lock(prop_t *p, int flags)
+{
+  prop_lock_domain_t *pld = p->hp_domain;
+
+  if(pld != &prop_global_domain) {
+    prop_lock_domain_lock(pld);
+    if(!pld->pld_slow && !(p->hp_flags & flags))
+      return pld;
+    prop_lock_domain_unlock(pld);
+  }
+  prop_global_lock();
+  prop_enter(p);
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static void
+prop_unlock(prop_lock_domain_t *pld)
+{
+  if(pld != NULL)
+    prop_lock_domain_unlock(pld);
+  else
+    prop_global_unlock();
+}
+
+
+/**
+ *
+ */
+void
+prop_print_lock_stats(void)
+{
+  prop_lock_domain_t *pld;
+
+  hts_mutex_lock(&prop_lock_domains_mutex);
+  LIST_FOREACH(pld, &prop_lock_domains, pld_link)
+    PROPTRACE("Lock domain %s: %d locks, %d contended",
+	      pld->pld_name, pld->pld_acquired, pld->pld_contended);
+  hts_mutex_unlock(&prop_lock_domains_mutex);
+}
+
+
+/**
+ * Update a property in a private domain before, while and after
+ * children from the global domain are attached to it and check that
+ * updates go back to the domain fast path once they are gone
+ */
+int
+prop_domain_bench(void)
+{
+  static const char *phases[] = {
+    "No foreign child", "Foreign children attached", "Foreign children removed"
+  };
+  const int rounds = 100000;
+  prop_t *root = prop_create_root_domain("bench");
+  prop_t *v = prop_create(root, "value");
+  prop_lock_domain_t *pld = root->hp_domain;
+  prop_t *f1 = NULL, *f2 = NULL;
+  int phase, i, global, slow, r = 0;
+  int64_t ts;
+
+  for(phase = 0; phase < 3; phase++) {
+
+    if(phase == 1) {
+      f1 = prop_create_root(NULL);
+      f2 = prop_create_root(NULL);
+      if(prop_set_parent(f1, root) || prop_set_parent(f2, root))
+	r = 1;
+    } else if(phase == 2) {
+      prop_unparent(f1);
+      prop_destroy(f2);
+    }
+
+    // Racy read, other threads may take the global lock too
+    global = prop_global_domain.pld_acquired;
+    ts = showtime_get_ts();
+    for(i = 0; i < rounds; i++)
+      prop_set_int(v, i);
+    ts = showtime_get_ts() - ts;
+    global = prop_global_domain.pld_acquired - global;
+
+    TRACE(TRACE_INFO, "bench", "%s: %.1f ns/update, %d global locks",
+	  phases[phase], ts * 1000.0 / rounds, global);
+
+    if(phase != 1 && global > rounds / 2) {
+      TRACE(TRACE_ERROR, "bench", "%s: Fast path not taken", phases[phase]);
+      r = 1;
+    }
+  }
+
+  hts_mutex_lock(&pld->pld_mutex);
+  slow = pld->pld_slow;
+  hts_mutex_unlock(&pld->pld_mutex);
+
+  if(slow) {
+    TRACE(TRACE_ERROR, "bench", "Domain still has %d slow path references",
+	  slow);
+    r = 1;
+  }
+
+  prop_destroy(f1);
+  prop_destroy(root);
+  return r;
+}
+
+
 /**
  *
  */
@@ -90,12 +344,12 @@ rstr_t *
 prop_get_name(prop_t *p)
 {
   rstr_t *r;
-  hts_mutex_lock(&prop_mutex);
+  prop_lock_domain_t *pld = prop_lock(p, 0);
   if(p->hp_name != NULL)
     r = rstr_alloc(p->hp_name);
   else
     r = NULL;
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
   return r;
 }
 
@@ -206,6 +460,7 @@ prop_ref_dec_traced(prop_t *p, const char *file, int line)
   prop_tag_dump(p);
 
   assert(p->hp_tags == NULL);
+  prop_lock_domain_release(p->hp_domain);
   free(p);
 }
 
@@ -272,6 +527,7 @@ prop_ref_dec(prop_t *p)
     return;
   assert(p->hp_type == PROP_ZOMBIE);
   assert(p->hp_tags == NULL);
+  prop_lock_domain_release(p->hp_domain);
 #ifdef PROP_DEBUG
   memset(p, 0xdd, sizeof(prop_t));
 #endif
@@ -301,10 +557,10 @@ prop_t *
 prop_xref_addref(prop_t *p)
 {
   if(p != NULL) {
-    hts_mutex_lock(&prop_mutex);
+    prop_lock_domain_t *pld = prop_lock(p, 0);
     assert(p->hp_xref < 255);
     p->hp_xref++;
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
   }
   return p;
 }
@@ -319,16 +575,62 @@ prop_sub_ref_dec(prop_sub_t *s)
   if(atomic_add(&s->hps_refcount, -1) > 1)
     return;
 
+  prop_lock_domain_release(s->hps_domain);
   free(s);
 }
 
 
+/**
+ * Insert subscription on the value subscription list of 'p'
+ */
+static void
+prop_sub_value_link(prop_sub_t *s, prop_t *p)
+{
+  LIST_INSERT_HEAD(&p->hp_value_subscriptions, s, hps_value_prop_link);
+  s->hps_value_prop = p;
+
+  if(s->hps_flags & PROP_SUB_INTERNAL)
+    p->hp_domain->pld_slow++;
+}
+
+
+/**
+ *
+ */
+static void
+prop_sub_value_unlink(prop_sub_t *s)
+{
+  prop_t *p = s->hps_value_prop;
+
+  LIST_REMOVE(s, hps_value_prop_link);
+  s->hps_value_prop = NULL;
+
+  if(s->hps_flags & PROP_SUB_INTERNAL)
+    p->hp_domain->pld_slow--;
+}
+
+
+/**
+ * Figure out if the subscription spans multiple domains
+ */
+static void
+prop_sub_update_xdomain(prop_sub_t *s)
+{
+  prop_lock_domain_t *pld = s->hps_domain;
+
+  s->hps_xdomain =
+    (s->hps_value_prop != NULL && s->hps_value_prop->hp_domain != pld) ||
+    (s->hps_canonical_prop != NULL && s->hps_canonical_prop->hp_domain != pld);
+}
+
+
 /**
  *
  */
 static void
 prop_remove_from_originator(prop_t *p)
 {
+  prop_enter(p->hp_originator);
   LIST_REMOVE(p, hp_originator_link);
 
   if(p->hp_flags & PROP_XREFED_ORIGINATOR)
@@ -749,52 +1051,61 @@ prop_courier(void *aux)
   prop_courier_t *pc = aux;
   struct prop_notify_queue q_exp, q_nor;
   prop_notify_t *n;
+  void (*epilogue)(void) = pc->pc_epilogue;
+  int detached;
 
   if(pc->pc_prologue)
     pc->pc_prologue();
   
-  hts_mutex_lock(&prop_mutex);
+  hts_mutex_lock(&pc->pc_mutex);
 
   while(pc->pc_run) {
 
     if(TAILQ_FIRST(&pc->pc_queue_exp) == NULL &&
        TAILQ_FIRST(&pc->pc_queue_nor) == NULL) {
-      hts_cond_wait(&pc->pc_cond, &prop_mutex);
+      hts_cond_wait(&pc->pc_cond, &pc->pc_mutex);
       continue;
     }
 
-    TAILQ_MOVE(&q_exp, &pc->pc_queue_exp, hpn_link);
-    TAILQ_INIT(&pc->pc_queue_exp);
+    courier_dequeue(pc, &q_exp, &pc->pc_queue_exp);
 
     TAILQ_INIT(&q_nor);
     if((n = TAILQ_FIRST(&pc->pc_queue_nor)) != NULL) {
       TAILQ_REMOVE(&pc->pc_queue_nor, n, hpn_link);
       TAILQ_INSERT_TAIL(&q_nor, n, hpn_link);
+      if(n->hpn_sub->hps_pending_value == n)
+	n->hpn_sub->hps_pending_value = NULL;
     }
 
-    hts_mutex_unlock(&prop_mutex);
+    hts_mutex_unlock(&pc->pc_mutex);
     prop_notify_dispatch(&q_exp);
     prop_notify_dispatch(&q_nor);
-    hts_mutex_lock(&prop_mutex);
+    hts_mutex_lock(&pc->pc_mutex);
   }
 
   while((n = TAILQ_FIRST(&pc->pc_queue_exp)) != NULL) {
     TAILQ_REMOVE(&pc->pc_queue_exp, n, hpn_link);
+    n->hpn_sub->hps_pending_value = NULL;
     prop_notify_free(n);
   }
 
   while((n = TAILQ_FIRST(&pc->pc_queue_nor)) != NULL) {
     TAILQ_REMOVE(&pc->pc_queue_nor, n, hpn_link);
+    n->hpn_sub->hps_pending_value = NULL;
     prop_notify_free(n);
   }
 
-  if(pc->pc_detached)
-    free(pc);
+  detached = pc->pc_detached;
+  hts_mutex_unlock(&pc->pc_mutex);
 
-  hts_mutex_unlock(&prop_mutex);
+  if(detached) {
+    hts_cond_destroy(&pc->pc_cond);
+    hts_mutex_destroy(&pc->pc_mutex);
+    free(pc);
+  }
 
-  if(pc->pc_epilogue)
-    pc->pc_epilogue();
+  if(epilogue)
+    epilogue();
 
   return NULL;
 }
@@ -812,19 +1123,102 @@ courier_notify(prop_courier_t *pc)
 }
 
 
+/**
+ *
+ */
+static int
+prop_notify_is_value(const prop_notify_t *n)
+{
+  switch(n->hpn_event) {
+  case PROP_SET_DIR:
+  case PROP_SET_VOID:
+  case PROP_SET_RSTRING:
+  case PROP_SET_CSTRING:
+  case PROP_SET_RLINK:
+  case PROP_SET_INT:
+  case PROP_SET_FLOAT:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+
+/**
+ * If the last notification queued for the subscription is a value
+ * update, replace it with the new one. Since it is the last one for
+ * the subscription, ordering versus other events is kept intact
+ *
+ * Return 1 if 'n' was coalesced
+ */
+static int
+courier_coalesce(prop_courier_t *pc, struct prop_notify_queue *q,
+		 prop_notify_t *n)
+{
+  prop_sub_t *s = n->hpn_sub;
+  prop_notify_t *o = s->hps_pending_value;
+
+  if(!prop_notify_is_value(n)) {
+    s->hps_pending_value = NULL;
+    return 0;
+  }
+
+  s->hps_pending_value = n;
+  if(o == NULL)
+    return 0;
+
+  TAILQ_INSERT_AFTER(q, o, n, hpn_link);
+  TAILQ_REMOVE(q, o, hpn_link);
+  prop_notify_free(o);
+  pc->pc_dropped++;
+  return 1;
+}
+
+
+/**
+ * Move all pending notifications from the courier to 'dst'
+ */
+static void
+courier_dequeue(prop_courier_t *pc, struct prop_notify_queue *dst,
+		struct prop_notify_queue *src)
+{
+  prop_notify_t *n;
+
+  TAILQ_MOVE(dst, src, hpn_link);
+  TAILQ_INIT(src);
+
+  if(pc->pc_flags & PROP_COURIER_COALESCE)
+    TAILQ_FOREACH(n, dst, hpn_link)
+      n->hpn_sub->hps_pending_value = NULL;
+}
+
+
+/**
+ *
+ */
+static void
+courier_enqueue0(prop_courier_t *pc, prop_notify_t *n, int expedite)
+{
+  struct prop_notify_queue *q =
+    expedite ? &pc->pc_queue_exp : &pc->pc_queue_nor;
+
+  hts_mutex_lock(&pc->pc_mutex);
+
+  if(!(pc->pc_flags & PROP_COURIER_COALESCE) || !courier_coalesce(pc, q, n)) {
+    TAILQ_INSERT_TAIL(q, n, hpn_link);
+    courier_notify(pc);
+  }
+  hts_mutex_unlock(&pc->pc_mutex);
+}
+
+
 /**
  *
  */
 static void
 courier_enqueue(prop_sub_t *s, prop_notify_t *n)
 {
-  prop_courier_t *pc = s->hps_courier;
-  
-  if(s->hps_flags & PROP_SUB_EXPEDITE)
-    TAILQ_INSERT_TAIL(&pc->pc_queue_exp, n, hpn_link);
-  else
-    TAILQ_INSERT_TAIL(&pc->pc_queue_nor, n, hpn_link);
-  courier_notify(pc);
+  courier_enqueue0(s->hps_courier, n, s->hps_flags & PROP_SUB_EXPEDITE);
 }
 
 
@@ -1060,12 +1454,8 @@ prop_notify_destroyed(prop_sub_t *s)
 
   n->hpn_event = PROP_DESTROYED;
 
-  prop_courier_t *pc = s->hps_courier;  
-  if(s->hps_flags & (PROP_SUB_EXPEDITE | PROP_SUB_TRACK_DESTROY_EXP))
-    TAILQ_INSERT_TAIL(&pc->pc_queue_exp, n, hpn_link);
-  else
-    TAILQ_INSERT_TAIL(&pc->pc_queue_nor, n, hpn_link);
-  courier_notify(pc);
+  courier_enqueue0(s->hps_courier, n, s->hps_flags &
+		   (PROP_SUB_EXPEDITE | PROP_SUB_TRACK_DESTROY_EXP));
 }
 
 
@@ -1083,8 +1473,9 @@ prop_notify_value(prop_t *p, prop_sub_t *skipme, const char *origin,
       prop_build_notify_value(s, 0, origin, s->hps_value_prop, NULL,
 			      how);
 
+  /* Never reached from the domain fast path, see prop_lock() */
   if(p->hp_flags & PROP_MULTI_NOTIFY)
-    while((p = p->hp_parent) != NULL)
+    while((p = p->hp_parent) != NULL && (prop_enter(p), 1))
       if(p->hp_flags & PROP_MULTI_SUB)
 	LIST_FOREACH(s, &p->hp_value_subscriptions, hps_value_prop_link)
 	  if(s->hps_flags & PROP_SUB_MULTI)
@@ -1241,8 +1632,10 @@ prop_send_ext_event0(prop_t *p, event_t *e)
   prop_sub_t *s;
   prop_notify_t *n;
 
-  while(p->hp_originator != NULL)
+  while(p->hp_originator != NULL) {
     p = p->hp_originator;
+    prop_enter(p);
+  }
 
   LIST_FOREACH(s, &p->hp_value_subscriptions, hps_value_prop_link) {
     n = get_notify(s);
@@ -1265,6 +1658,8 @@ prop_send_event(prop_t *p, prop_event_t e)
   prop_sub_t *s;
   prop_notify_t *n;
 
+  prop_enter(p);
+
   LIST_FOREACH(s, &p->hp_value_subscriptions, hps_value_prop_link) {
     if(s->hps_flags & PROP_SUB_INTERNAL) {
       prop_callback_t *cb = s->hps_callback;
@@ -1308,9 +1703,10 @@ prop_send_subscription_monitor_active(prop_t *p)
 void
 prop_send_ext_event(prop_t *p, event_t *e)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
   prop_send_ext_event0(p, e);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -1411,15 +1807,18 @@ prop_make(const char *name, int noalloc, prop_t *parent)
   LIST_INIT(&hp->hp_canonical_subscriptions);
 
   hp->hp_parent = parent;
+  hp->hp_domain = prop_lock_domain_retain(parent != NULL ? parent->hp_domain :
+					  &prop_global_domain);
   return hp;
 }
 
 
 /**
- *
+ * Must be called with the domain of 'parent' held
  */
-prop_t *
-prop_create0(prop_t *parent, const char *name, prop_sub_t *skipme, int noalloc)
+static prop_t *
+prop_create_child0(prop_t *parent, const char *name, prop_sub_t *skipme,
+		   int noalloc)
 {
   prop_t *hp;
 
@@ -1431,7 +1830,8 @@ prop_create0(prop_t *parent, const char *name, prop_sub_t *skipme, int noalloc)
     TAILQ_FOREACH(hp, &parent->hp_childs, hp_parent_link) {
       if(hp->hp_name != NULL && !strcmp(hp->hp_name, name)) {
 
-	if(!(hp->hp_flags & PROP_NAME_NOT_ALLOCATED) && noalloc) {
+	if(!(hp->hp_flags & PROP_NAME_NOT_ALLOCATED) && noalloc &&
+	   hp->hp_domain == parent->hp_domain) {
 	  // Trick: We have a pointer to a compile time constant string
 	  // and the current prop does not have that, we could switch to
 	  // it and thus save some memory allocation
@@ -1454,6 +1854,20 @@ prop_create0(prop_t *parent, const char *name, prop_sub_t *skipme, int noalloc)
 }
 
 
+/**
+ *
+ */
+prop_t *
+prop_create0(prop_t *parent, const char *name, prop_sub_t *skipme, int noalloc)
+{
+  prop_t *p;
+
+  prop_enter(parent);
+  p = prop_create_child0(parent, name, skipme, noalloc);
+  prop_enter(p);
+  return p;
+}
+
 
 /**
  *
@@ -1463,15 +1877,24 @@ prop_create_ex(prop_t *parent, const char *name, prop_sub_t *skipme,
 	       int noalloc, int incref)
 {
   prop_t *p;
-  hts_mutex_lock(&prop_mutex);
-  if(parent != NULL && parent->hp_type != PROP_ZOMBIE) {
-    p = prop_create0(parent, name, skipme, noalloc);
+  prop_lock_domain_t *pld;
+
+  if(parent == NULL)
+    return NULL;
+
+  pld = prop_lock(parent, PROP_MULTI_SUB | PROP_MULTI_NOTIFY);
+
+  if(parent->hp_type != PROP_ZOMBIE) {
+    if(pld != NULL)
+      p = prop_create_child0(parent, name, skipme, noalloc);
+    else
+      p = prop_create0(parent, name, skipme, noalloc);
   } else {
     p = NULL;
   }
   if(incref)
     p = prop_ref_inc(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
   return p;
 }
 
@@ -1485,6 +1908,54 @@ prop_create_root_ex(const char *name, int noalloc)
 }
 
 
+/**
+ * Create a root property living in a lock domain of its own.
+ *
+ * All properties created below it will be in the same domain, so
+ * updates to them will not contend with the rest of the tree
+ */
+prop_t *
+prop_create_root_domain(const char *domainname)
+{
+  prop_lock_domain_t *pld = calloc(1, sizeof(prop_lock_domain_t));
+  prop_t *p;
+
+  prop_lock_domain_init(pld, domainname);
+  p = prop_make(NULL, 0, NULL);
+  prop_lock_domain_release(p->hp_domain);
+  p->hp_domain = pld; // Steal initial reference
+  return p;
+}
+
+
+
+/**
+ * A child from another domain means the parent's domain can no longer
+ * be updated in isolation. Both domains must be entered
+ */
+static void
+prop_xdomain_link(prop_t *p, prop_t *parent)
+{
+  if(parent->hp_domain != &prop_global_domain &&
+     parent->hp_domain != p->hp_domain) {
+    parent->hp_domain->pld_slow++;
+    p->hp_flags |= PROP_XDOMAIN_CHILD;
+  }
+}
+
+
+/**
+ *
+ */
+static void
+prop_xdomain_unlink(prop_t *p, prop_t *parent)
+{
+  if(p->hp_flags & PROP_XDOMAIN_CHILD) {
+    parent->hp_domain->pld_slow--;
+    p->hp_flags &= ~PROP_XDOMAIN_CHILD;
+  }
+}
+
 
 /**
  *
@@ -1492,6 +1963,9 @@ prop_create_root_ex(const char *name, int noalloc)
 int
 prop_set_parent0(prop_t *p, prop_t *parent, prop_t *before, prop_sub_t *skipme)
 {
+  prop_enter(p);
+  prop_enter(parent);
+
   if(parent->hp_type == PROP_ZOMBIE)
     return -1;
 
@@ -1499,7 +1973,7 @@ prop_set_parent0(prop_t *p, prop_t *parent, prop_t *before, prop_sub_t *skipme)
 
   if(p->hp_parent != parent) {
     prop_unparent0(p, skipme);
-
+    prop_xdomain_link(p, parent);
     p->hp_parent = parent;
     if(parent->hp_flags & (PROP_MULTI_SUB | PROP_MULTI_NOTIFY))
       prop_flood_flag(p, PROP_MULTI_NOTIFY, 0);
@@ -1522,9 +1996,9 @@ prop_set_parent_ex(prop_t *p, prop_t *parent, prop_t *before,
   if(parent == NULL)
     return -1;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   r = prop_set_parent0(p, parent, before, skipme);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   return r;
 }
 
@@ -1538,7 +2012,8 @@ prop_set_parent_vector(prop_vec_t *pv, prop_t *parent, prop_t *before,
 {
   int i;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(parent);
 
   if(parent == NULL || parent->hp_type == PROP_ZOMBIE) {
 
@@ -1553,6 +2028,8 @@ prop_set_parent_vector(prop_vec_t *pv, prop_t *parent, prop_t *before,
 
     for(i = 0; i < pv->pv_length; i++) {
       p = pv->pv_vec[i];
+      prop_enter(p);
+      prop_xdomain_link(p, parent);
       p->hp_parent = parent;
       if(parent->hp_flags & (PROP_MULTI_SUB | PROP_MULTI_NOTIFY))
 	prop_flood_flag(p, PROP_MULTI_NOTIFY, 0);
@@ -1566,7 +2043,7 @@ prop_set_parent_vector(prop_vec_t *pv, prop_t *parent, prop_t *before,
     prop_notify_childv(pv, parent, before ? PROP_ADD_CHILD_VECTOR_BEFORE : 
 		       PROP_ADD_CHILD_VECTOR, skipme, before);
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -1576,16 +2053,21 @@ prop_set_parent_vector(prop_vec_t *pv, prop_t *parent, prop_t *before,
 void
 prop_unparent0(prop_t *p, prop_sub_t *skipme)
 {
-  prop_t *parent = p->hp_parent;
+  prop_t *parent;
+
+  prop_enter(p);
+  parent = p->hp_parent;
   if(parent == NULL)
     return;
 
+  prop_enter(parent);
   assert((p->hp_flags & PROP_MULTI_NOTIFY) == 0); // fixme
 
   prop_notify_child(p, parent, PROP_DEL_CHILD, NULL, 0);
   
   TAILQ_REMOVE(&parent->hp_childs, p, hp_parent_link);
   p->hp_parent = NULL;
+  prop_xdomain_unlink(p, parent);
   
   if(parent->hp_selected == p)
     parent->hp_selected = NULL;
@@ -1597,9 +2079,9 @@ prop_unparent0(prop_t *p, prop_sub_t *skipme)
 void
 prop_unparent_ex(prop_t *p, prop_sub_t *skipme)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   prop_unparent0(p, skipme);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 /**
@@ -1608,7 +2090,8 @@ prop_unparent_ex(prop_t *p, prop_sub_t *skipme)
 void
 prop_unparent_childs(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
   if(p->hp_type == PROP_DIR) {
     prop_t *c, *next;
     for(c = TAILQ_FIRST(&p->hp_childs); c != NULL; c = next) {
@@ -1616,7 +2099,7 @@ prop_unparent_childs(prop_t *p)
       prop_unparent0(p, NULL);
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -1630,6 +2113,7 @@ prop_destroy_child(prop_t *p, prop_t *c)
     prop_notify_child(c, p, PROP_DEL_CHILD, NULL, 0);
     TAILQ_REMOVE(&p->hp_childs, c, hp_parent_link);
     c->hp_parent = NULL;
+    prop_xdomain_unlink(c, p);
   }
 }
 
@@ -1643,6 +2127,8 @@ prop_destroy0(prop_t *p)
   prop_t *c, *next, *parent;
   prop_sub_t *s;
 
+  prop_enter(p);
+
 #ifdef PROP_DEBUG
   if(prop_trace) {
     int csubs = 0, psubs = 0;
@@ -1704,9 +2190,7 @@ prop_destroy0(prop_t *p)
 
   while((s = LIST_FIRST(&p->hp_value_subscriptions)) != NULL) {
     prop_notify_void(s);
-
-    LIST_REMOVE(s, hps_value_prop_link);
-    s->hps_value_prop = NULL;
+    prop_sub_value_unlink(s);
   }
 
   while((c = LIST_FIRST(&p->hp_targets)) != NULL)
@@ -1722,11 +2206,13 @@ prop_destroy0(prop_t *p)
 #endif
 
   if(p->hp_parent != NULL) {
+    prop_enter(p->hp_parent);
     prop_notify_child(p, p->hp_parent, PROP_DEL_CHILD, NULL, 0);
     parent = p->hp_parent;
 
     TAILQ_REMOVE(&parent->hp_childs, p, hp_parent_link);
     p->hp_parent = NULL;
+    prop_xdomain_unlink(p, parent);
 
     if(parent->hp_selected == p)
       parent->hp_selected = NULL;
@@ -1749,9 +2235,9 @@ prop_destroy(prop_t *p)
 {
   if(p == NULL)
     return;
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   prop_destroy0(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -1763,7 +2249,8 @@ prop_destroy_childs(prop_t *p)
 {
   if(p == NULL)
     return;
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
   if(p->hp_type == PROP_DIR) {
     prop_t *c, *next;
     for(c = TAILQ_FIRST(&p->hp_childs); c != NULL; c = next) {
@@ -1771,7 +2258,7 @@ prop_destroy_childs(prop_t *p)
       prop_destroy_child(p, c);
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 /**
@@ -1780,7 +2267,8 @@ prop_destroy_childs(prop_t *p)
 void
 prop_destroy_by_name(prop_t *p, const char *name)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
   if(p->hp_type == PROP_DIR) {
     prop_t *c;
     if(name == NULL) {
@@ -1799,7 +2287,7 @@ prop_destroy_by_name(prop_t *p, const char *name)
       }
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -1809,13 +2297,14 @@ prop_destroy_by_name(prop_t *p, const char *name)
 void
 prop_destroy_first(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
   if(p->hp_type == PROP_DIR) {
     prop_t *c = TAILQ_FIRST(&p->hp_childs);
     if(c != NULL)
       prop_destroy_child(p, c);
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -1828,6 +2317,7 @@ prop_flood_flag(prop_t *p, int set, int clr)
 {
   prop_t *c;
 
+  prop_enter(p);
   p->hp_flags = (p->hp_flags | set) & ~clr;
   if(p->hp_type == PROP_DIR)
     TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link)
@@ -1890,6 +2380,7 @@ prop_move0(prop_t *p, prop_t *before, prop_sub_t *skipme)
   if(TAILQ_NEXT(p, hp_parent_link) != before) {
 
     parent = p->hp_parent;
+    prop_enter(parent);
     TAILQ_REMOVE(&parent->hp_childs, p, hp_parent_link);
   
     if(before != NULL) {
@@ -1908,9 +2399,9 @@ prop_move0(prop_t *p, prop_t *before, prop_sub_t *skipme)
 void
 prop_move(prop_t *p, prop_t *before)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   prop_move0(p, before, NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -1926,6 +2417,7 @@ prop_req_move0(prop_t *p, prop_t *before, prop_sub_t *skipme)
 
   if(TAILQ_NEXT(p, hp_parent_link) != before) {
     parent = p->hp_parent;
+    prop_enter(parent);
     prop_notify_child2(p, parent, before, PROP_REQ_MOVE_CHILD, skipme, 0);
   }
 }
@@ -1939,9 +2431,9 @@ prop_req_move(prop_t *p, prop_t *before)
 {
   if(p == before)
     return;
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   prop_req_move0(p, before, NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -1953,9 +2445,13 @@ prop_subfind(prop_t *p, const char **name, int follow_symlinks, int allow_indexi
 {
   prop_t *c;
 
+  prop_enter(p);
+
   while(name[0] != NULL) {
-    while(follow_symlinks && p->hp_originator != NULL)
+    while(follow_symlinks && p->hp_originator != NULL) {
       p = p->hp_originator;
+      prop_enter(p);
+    }
 
     if(p->hp_type != PROP_DIR) {
 
@@ -1989,11 +2485,14 @@ prop_subfind(prop_t *p, const char **name, int follow_symlinks, int allow_indexi
       }
     }
     p = c ?: prop_create0(p, name[0], NULL, 0);    
+    prop_enter(p);
     name++;
   }
 
-  while(follow_symlinks && p->hp_originator != NULL)
+  while(follow_symlinks && p->hp_originator != NULL) {
     p = p->hp_originator;
+    prop_enter(p);
+  }
 
   return p;
 }
@@ -2087,12 +2586,12 @@ prop_get_by_name(const char **name, int follow_symlinks, ...)
     return NULL;
 
   name++;
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   p = prop_subfind(p, name, follow_symlinks, 1);
 
   p = prop_ref_inc(p);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   return p;
 }
 
@@ -2129,6 +2628,7 @@ prop_subscribe(int flags, ...)
   prop_trampoline_t *trampoline = NULL;
   int dolock = !(flags & PROP_SUB_DONTLOCK);
   int activate_on_canonical = 0;
+  prop_lock_domain_t *pld = NULL;
   va_list ap;
   va_start(ap, flags);
 
@@ -2262,8 +2762,17 @@ prop_subscribe(int flags, ...)
     pr = LIST_FIRST(&proproots);
 
     canonical = value = pr ? pr->p : NULL;
-    if(dolock)
-      hts_mutex_lock(&prop_mutex);
+    if(!dolock) {
+      prop_enter(value);
+    } else if(value != NULL &&
+	      !(flags & (PROP_SUB_INTERNAL | PROP_SUB_MULTI |
+			 PROP_SUB_DIRECT_UPDATE |
+			 PROP_SUB_SUBSCRIPTION_MONITOR))) {
+      pld = prop_lock(value, PROP_MONITORED);
+    } else {
+      prop_global_lock();
+      prop_enter(value);
+    }
 
   } else {
 
@@ -2272,7 +2781,7 @@ prop_subscribe(int flags, ...)
     name++;
 
     if(dolock)
-      hts_mutex_lock(&prop_mutex);
+      prop_global_lock();
 
     if(p != NULL) {
       /* Canonical name is the resolved props without following symlinks */
@@ -2288,7 +2797,8 @@ prop_subscribe(int flags, ...)
   if(flags & PROP_SUB_SINGLETON) {
     LIST_FOREACH(s, &value->hp_value_subscriptions, hps_value_prop_link) {
       if(s->hps_callback == cb && s->hps_opaque == opaque) {
-	hts_mutex_unlock(&prop_mutex);
+	if(dolock)
+	  prop_unlock(pld);
 	return NULL;
       }
     }
@@ -2303,6 +2813,7 @@ prop_subscribe(int flags, ...)
   s = malloc(sizeof(prop_sub_t));
 
   s->hps_zombie = 0;
+  s->hps_pending_value = NULL;
   s->hps_flags = flags;
   s->hps_trampoline = trampoline;
   s->hps_callback = cb;
@@ -2319,6 +2830,10 @@ prop_subscribe(int flags, ...)
     s->hps_lockmgr = lockmgr;
   }
 
+  s->hps_domain = prop_lock_domain_retain(canonical ? canonical->hp_domain :
+					   value ? value->hp_domain :
+					   &prop_global_domain);
+
   s->hps_canonical_prop = canonical;
   if(canonical != NULL) {
     LIST_INSERT_HEAD(&canonical->hp_canonical_subscriptions, s, 
@@ -2345,9 +2860,7 @@ prop_subscribe(int flags, ...)
   s->hps_value_prop = value;
   if(value != NULL) {
 
-    LIST_INSERT_HEAD(&value->hp_value_subscriptions, s, 
-		     hps_value_prop_link);
-
+    prop_sub_value_link(s, value);
 
     if(notify_now) {
 
@@ -2384,6 +2897,8 @@ prop_subscribe(int flags, ...)
       prop_send_subscription_monitor_active(value);
   }
 
+  prop_sub_update_xdomain(s);
+
   if(activate_on_canonical)
     prop_send_subscription_monitor_active(canonical);
 
@@ -2404,24 +2919,22 @@ prop_subscribe(int flags, ...)
     }
   }
   if(dolock)
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
   return s;
 }
 
 
 
 /**
- *
+ * Must be called with the domains of the subscribed props held
  */
-void
-prop_unsubscribe0(prop_sub_t *s)
+static void
+prop_sub_unlink0(prop_sub_t *s)
 {
   s->hps_zombie = 1;
   
-  if(s->hps_value_prop != NULL) {
-    LIST_REMOVE(s, hps_value_prop_link);
-    s->hps_value_prop = NULL;
-  }
+  if(s->hps_value_prop != NULL)
+    prop_sub_value_unlink(s);
 
   if(s->hps_canonical_prop != NULL) {
     LIST_REMOVE(s, hps_canonical_prop_link);
@@ -2459,18 +2972,51 @@ prop_unsubscribe0(prop_sub_t *s)
 
 
 
+/**
+ *
+ */
+void
+prop_unsubscribe0(prop_sub_t *s)
+{
+  prop_enter(s->hps_value_prop);
+  prop_enter(s->hps_canonical_prop);
+  prop_sub_unlink0(s);
+}
+
+
 /**
  *
  */
 void
 prop_unsubscribe(prop_sub_t *s)
 {
+  prop_lock_domain_t *pld;
+
   if(s == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  pld = s->hps_domain;
+
+  if(pld != &prop_global_domain &&
+     !(s->hps_flags & (PROP_SUB_INTERNAL | PROP_SUB_MULTI |
+		       PROP_SUB_SUBSCRIPTION_MONITOR))) {
+
+    /* The subscription may hold the last reference to the domain */
+    prop_lock_domain_retain(pld);
+    prop_lock_domain_lock(pld);
+    if(!s->hps_xdomain) {
+      prop_sub_unlink0(s);
+      prop_lock_domain_unlock(pld);
+      prop_lock_domain_release(pld);
+      return;
+    }
+    prop_lock_domain_unlock(pld);
+    prop_lock_domain_release(pld);
+  }
+
+  prop_global_lock();
   prop_unsubscribe0(s);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -2481,11 +3027,14 @@ prop_unsubscribe(prop_sub_t *s)
 void
 prop_init(void)
 {
-  hts_mutex_init(&prop_mutex);
+  hts_mutex_init(&prop_lock_domains_mutex);
+  prop_lock_domain_init(&prop_global_domain, "global");
+  prop_global_domain.pld_entered = 1; // Always held with the global lock
+
   hts_mutex_init(&prop_tag_mutex);
   prop_global = prop_make("global", 1, NULL);
 
-  global_courier = prop_courier_create_thread(NULL, "global");
+  global_courier = prop_courier_create_thread(NULL, "global", 0);
 }
 
 
@@ -2503,11 +3052,12 @@ prop_get_global(void)
  *
  */
 static void
-prop_set_epilogue(prop_sub_t *skipme, prop_t *p, const char *origin)
+prop_set_epilogue(prop_sub_t *skipme, prop_t *p, const char *origin,
+		  prop_lock_domain_t *pld)
 {
   prop_notify_value(p, skipme, origin, 0);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
 }
 
 
@@ -2543,6 +3093,8 @@ void
 prop_set_string_ex(prop_t *p, prop_sub_t *skipme, const char *str,
 		   prop_str_type_t type)
 {
+  prop_lock_domain_t *pld;
+
   if(p == NULL)
     return;
 
@@ -2551,9 +3103,9 @@ prop_set_string_ex(prop_t *p, prop_sub_t *skipme, const char *str,
     return;
   }
 
-  hts_mutex_lock(&prop_mutex);
+  pld = prop_lock(p, PROP_MULTI_NOTIFY);
   prop_set_string_exl(p, skipme, str, type);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
 }
 
 
@@ -2592,6 +3144,8 @@ prop_set_rstring_exl(prop_t *p, prop_sub_t *skipme, rstr_t *rstr)
 void
 prop_set_rstring_ex(prop_t *p, prop_sub_t *skipme, rstr_t *rstr)
 {
+  prop_lock_domain_t *pld;
+
   if(p == NULL)
     return;
 
@@ -2600,9 +3154,9 @@ prop_set_rstring_ex(prop_t *p, prop_sub_t *skipme, rstr_t *rstr)
     return;
   }
 
-  hts_mutex_lock(&prop_mutex);
+  pld = prop_lock(p, PROP_MULTI_NOTIFY);
   prop_set_rstring_exl(p, skipme, rstr);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
 }
 
 
@@ -2612,6 +3166,8 @@ prop_set_rstring_ex(prop_t *p, prop_sub_t *skipme, rstr_t *rstr)
 void
 prop_set_cstring_ex(prop_t *p, prop_sub_t *skipme, const char *cstr)
 {
+  prop_lock_domain_t *pld;
+
   if(p == NULL)
     return;
 
@@ -2620,22 +3176,22 @@ prop_set_cstring_ex(prop_t *p, prop_sub_t *skipme, const char *cstr)
     return;
   }
 
-  hts_mutex_lock(&prop_mutex);
+  pld = prop_lock(p, PROP_MULTI_NOTIFY);
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
     return;
   }
 
   if(p->hp_type != PROP_CSTRING) {
 
     if(prop_clean(p)) {
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock(pld);
       return;
     }
 
   } else if(!strcmp(p->hp_cstring, cstr)) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
     return;
   }
 
@@ -2643,7 +3199,7 @@ prop_set_cstring_ex(prop_t *p, prop_sub_t *skipme, const char *cstr)
   p->hp_type = PROP_CSTRING;
   p->hp_rstrtype = 0;
 
-  prop_set_epilogue(skipme, p, "prop_set_cstring()");
+  prop_set_epilogue(skipme, p, "prop_set_cstring()", pld);
 }
 
 /**
@@ -2653,6 +3209,8 @@ void
 prop_set_link_ex(prop_t *p, prop_sub_t *skipme, const char *title, 
 		 const char *url)
 {
+  prop_lock_domain_t *pld;
+
   if(p == NULL)
     return;
 
@@ -2661,23 +3219,23 @@ prop_set_link_ex(prop_t *p, prop_sub_t *skipme, const char *title,
     return;
   }
 
-  hts_mutex_lock(&prop_mutex);
+  pld = prop_lock(p, PROP_MULTI_NOTIFY);
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
     return;
   }
 
   if(p->hp_type != PROP_LINK) {
 
     if(prop_clean(p)) {
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock(pld);
       return;
     }
 
   } else if(!strcmp(rstr_get(p->hp_link_rtitle) ?: "", title ?: "") &&
 	    !strcmp(rstr_get(p->hp_link_rurl)   ?: "", url   ?: "")) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
     return;
   } else {
     rstr_release(p->hp_link_rtitle);
@@ -2688,7 +3246,7 @@ prop_set_link_ex(prop_t *p, prop_sub_t *skipme, const char *title,
   p->hp_link_rurl   = rstr_alloc(url);
   p->hp_type = PROP_LINK;
 
-  prop_set_epilogue(skipme, p, "prop_set_link()");
+  prop_set_epilogue(skipme, p, "prop_set_link()", pld);
 }
 
 
@@ -2753,15 +3311,17 @@ prop_float_to_int(prop_t *p)
  *
  */
 static prop_t *
-prop_get_float(prop_t *p, int *forceupdate)
+prop_get_float(prop_t *p, int *forceupdate, prop_lock_domain_t **pldp)
 {
+  prop_lock_domain_t *pld;
+
   if(p == NULL)
     return NULL;
 
-  hts_mutex_lock(&prop_mutex);
+  pld = *pldp = prop_lock(p, PROP_MULTI_NOTIFY);
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
     return NULL;
   }
 
@@ -2775,7 +3335,7 @@ prop_get_float(prop_t *p, int *forceupdate)
   if(p->hp_type != PROP_FLOAT) {
 
     if(prop_clean(p)) {
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock(pld);
       return NULL;
     }
     if(forceupdate != NULL)
@@ -2792,13 +3352,14 @@ prop_get_float(prop_t *p, int *forceupdate)
 void
 prop_set_float_ex(prop_t *p, prop_sub_t *skipme, float v, int how)
 {
+  prop_lock_domain_t *pld;
   int forceupdate = !!how;
 
-  if((p = prop_get_float(p, &forceupdate)) == NULL)
+  if((p = prop_get_float(p, &forceupdate, &pld)) == NULL)
     return;
   
   if(!forceupdate && p->hp_float == v) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
     return;
   }
 
@@ -2812,7 +3373,7 @@ prop_set_float_ex(prop_t *p, prop_sub_t *skipme, float v, int how)
   p->hp_float = v;
 
   prop_notify_value(p, skipme, "prop_set_float_ex()", how);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
 }
 
 
@@ -2822,8 +3383,9 @@ prop_set_float_ex(prop_t *p, prop_sub_t *skipme, float v, int how)
 void
 prop_add_float_ex(prop_t *p, prop_sub_t *skipme, float v)
 {
+  prop_lock_domain_t *pld;
   float n;
-  if((p = prop_get_float(p, NULL)) == NULL)
+  if((p = prop_get_float(p, NULL, &pld)) == NULL)
     return;
 
   n = p->hp_float + v;
@@ -2839,7 +3401,7 @@ prop_add_float_ex(prop_t *p, prop_sub_t *skipme, float v)
     p->hp_float = n;
     prop_notify_value(p, skipme, "prop_add_float()", 0);
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
 }
 
 
@@ -2849,9 +3411,10 @@ prop_add_float_ex(prop_t *p, prop_sub_t *skipme, float v)
 void
 prop_set_float_clipping_range(prop_t *p, float min, float max)
 {
+  prop_lock_domain_t *pld;
   float n;
 
-  if((p = prop_get_float(p, NULL)) == NULL)
+  if((p = prop_get_float(p, NULL, &pld)) == NULL)
     return;
 
   p->hp_flags |= PROP_CLIPPED_VALUE;
@@ -2871,7 +3434,7 @@ prop_set_float_clipping_range(prop_t *p, float min, float max)
     prop_notify_value(p, NULL, "prop_set_float_clipping_range()", 0);
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
 }
 
 
@@ -2915,12 +3478,14 @@ prop_set_int_exl(prop_t *p, prop_sub_t *skipme, int v)
 void
 prop_set_int_ex(prop_t *p, prop_sub_t *skipme, int v)
 {
+  prop_lock_domain_t *pld;
+
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  pld = prop_lock(p, PROP_MULTI_NOTIFY);
   prop_set_int_exl(p, skipme, v);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
 }
 
 
@@ -2930,14 +3495,15 @@ prop_set_int_ex(prop_t *p, prop_sub_t *skipme, int v)
 void
 prop_add_int_ex(prop_t *p, prop_sub_t *skipme, int v)
 {
+  prop_lock_domain_t *pld;
   int n;
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  pld = prop_lock(p, PROP_MULTI_NOTIFY);
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
     return;
   }
 
@@ -2946,7 +3512,7 @@ prop_add_int_ex(prop_t *p, prop_sub_t *skipme, int v)
     if(p->hp_type == PROP_FLOAT) {
       prop_float_to_int(p);
     } else if(prop_clean(p)) {
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock(pld);
       return;
     } else {
       p->hp_int = 0;
@@ -2968,7 +3534,7 @@ prop_add_int_ex(prop_t *p, prop_sub_t *skipme, int v)
     p->hp_int = n;
     prop_notify_value(p, skipme, "prop_add_int()", 0);
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
 }
 
 
@@ -2978,13 +3544,15 @@ prop_add_int_ex(prop_t *p, prop_sub_t *skipme, int v)
 void
 prop_toggle_int_ex(prop_t *p, prop_sub_t *skipme)
 {
+  prop_lock_domain_t *pld;
+
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  pld = prop_lock(p, PROP_MULTI_NOTIFY);
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
     return;
   }
 
@@ -2993,7 +3561,7 @@ prop_toggle_int_ex(prop_t *p, prop_sub_t *skipme)
     if(p->hp_type == PROP_FLOAT) {
       prop_float_to_int(p);
     } else if(prop_clean(p)) {
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock(pld);
       return;
     } else {
       p->hp_int = 0;
@@ -3003,7 +3571,7 @@ prop_toggle_int_ex(prop_t *p, prop_sub_t *skipme)
 
   p->hp_int = !p->hp_int;
 
-  prop_set_epilogue(skipme, p, "prop_toggle_int()");
+  prop_set_epilogue(skipme, p, "prop_toggle_int()", pld);
 }
 
 /**
@@ -3012,15 +3580,16 @@ prop_toggle_int_ex(prop_t *p, prop_sub_t *skipme)
 void
 prop_set_int_clipping_range(prop_t *p, int min, int max)
 {
+  prop_lock_domain_t *pld;
   int n;
 
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  pld = prop_lock(p, PROP_MULTI_NOTIFY);
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_unlock(pld);
     return;
   }
 
@@ -3029,7 +3598,7 @@ prop_set_int_clipping_range(prop_t *p, int min, int max)
     if(p->hp_type == PROP_FLOAT) {
       prop_float_to_int(p);
     } else if(prop_clean(p)) {
-      hts_mutex_unlock(&prop_mutex);
+      prop_unlock(pld);
       return;
     } else {
       p->hp_int = 0;
@@ -3054,7 +3623,7 @@ prop_set_int_clipping_range(prop_t *p, int min, int max)
     prop_notify_value(p, NULL, "prop_set_int_clipping_range()", 0);
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
 }
 
 
@@ -3084,12 +3653,14 @@ prop_set_void_exl(prop_t *p, prop_sub_t *skipme)
 void
 prop_set_void_ex(prop_t *p, prop_sub_t *skipme)
 {
+  prop_lock_domain_t *pld;
+
   if(p == NULL)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  pld = prop_lock(p, PROP_MULTI_NOTIFY);
   prop_set_void_exl(p, skipme);
-  hts_mutex_unlock(&prop_mutex);
+  prop_unlock(pld);
 }
 
 
@@ -3146,9 +3717,14 @@ relink_subscriptions(prop_t *src, prop_t *dst, prop_sub_t *skipme,
   prop_t *c, *z;
   int equal;
 
+  prop_enter(src);
+  prop_enter(dst);
+
   /* Follow any symlinks should we bump into 'em */
-  while(src->hp_originator != NULL)
+  while(src->hp_originator != NULL) {
     src = src->hp_originator;
+    prop_enter(src);
+  }
 
   LIST_FOREACH(s, &dst->hp_canonical_subscriptions, hps_canonical_prop_link) {
 
@@ -3156,19 +3732,21 @@ relink_subscriptions(prop_t *src, prop_t *dst, prop_sub_t *skipme,
 
       if(s->hps_value_prop == src)
 	continue;
+
+      prop_enter(s->hps_value_prop);
       /* If we previously was a directory, flush it out */
       if(s->hps_value_prop->hp_type == PROP_DIR) {
 	if(s != skipme) 
 	  prop_notify_void(s);
       }
-      LIST_REMOVE(s, hps_value_prop_link);
       equal = prop_value_compare(s->hps_value_prop, src);
+      prop_sub_value_unlink(s);
     } else {
       equal = 0;
     }
 
-    LIST_INSERT_HEAD(&src->hp_value_subscriptions, s, hps_value_prop_link);
-    s->hps_value_prop = src;
+    prop_sub_value_link(s, src);
+    prop_sub_update_xdomain(s);
 
     /* Monitors, activate ! */
     if(src->hp_flags & PROP_MONITORED)
@@ -3194,6 +3772,7 @@ relink_subscriptions(prop_t *src, prop_t *dst, prop_sub_t *skipme,
 
     TAILQ_FOREACH(c, &dst->hp_childs, hp_parent_link) {
       
+      prop_enter(c);
       if(c->hp_name == NULL || c == no_descend)
 	continue;
 
@@ -3232,6 +3811,9 @@ prop_link0(prop_t *src, prop_t *dst, prop_sub_t *skipme, int hard)
 
   assert(src != dst);
 
+  prop_enter(src);
+  prop_enter(dst);
+
   if(src->hp_type == PROP_ZOMBIE || dst->hp_type == PROP_ZOMBIE)
     return;
 
@@ -3254,12 +3836,14 @@ prop_link0(prop_t *src, prop_t *dst, prop_sub_t *skipme, int hard)
   while(src->hp_originator != NULL) {
     assert(src != dst);
     src = src->hp_originator;
+    prop_enter(src);
   }
 
   relink_subscriptions(src, dst, skipme, "prop_link()/linkchilds", NULL, NULL);
 
   while((dst = dst->hp_parent) != NULL) {
     prop_t *t;
+    prop_enter(dst);
     LIST_FOREACH(t, &dst->hp_targets, hp_originator_link)
       relink_subscriptions(dst, t, skipme, "prop_link()/linkparents", NULL,
 			   no_descend);
@@ -3288,9 +3872,9 @@ prop_link0(prop_t *src, prop_t *dst, prop_sub_t *skipme, int hard)
 void
 prop_link_ex(prop_t *src, prop_t *dst, prop_sub_t *skipme, int hard)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   prop_link0(src, dst, skipme, hard);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -3304,10 +3888,11 @@ prop_unlink_ex(prop_t *p, prop_sub_t *skipme)
 {
   prop_t *t;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_global_unlock();
     return;
   }
 
@@ -3315,11 +3900,12 @@ prop_unlink_ex(prop_t *p, prop_sub_t *skipme)
     prop_unlink0(p, skipme, "prop_unlink()/childs", NULL);
 
   while((p = p->hp_parent) != NULL) {
+    prop_enter(p);
     LIST_FOREACH(t, &p->hp_targets, hp_originator_link)
       relink_subscriptions(p, t, skipme, "prop_unlink()/parents", NULL, NULL);
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -3329,13 +3915,16 @@ prop_unlink_ex(prop_t *p, prop_sub_t *skipme)
 prop_t *
 prop_follow(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
 
-  while(p->hp_originator != NULL)
+  while(p->hp_originator != NULL) {
     p = p->hp_originator;
+    prop_enter(p);
+  }
   
   p = prop_ref_inc(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   return p;
 }
 
@@ -3346,15 +3935,21 @@ prop_follow(prop_t *p)
 int
 prop_compare(const prop_t *a, const prop_t *b)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter((prop_t *)a);
+  prop_enter((prop_t *)b);
 
-  while(a->hp_originator != NULL)
+  while(a->hp_originator != NULL) {
     a = a->hp_originator;
+    prop_enter((prop_t *)a);
+  }
 
-  while(b->hp_originator != NULL)
+  while(b->hp_originator != NULL) {
     b = b->hp_originator;
+    prop_enter((prop_t *)b);
+  }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   return a == b;
 }
 
@@ -3367,22 +3962,24 @@ prop_select_ex(prop_t *p, prop_t *extra, prop_sub_t *skipme)
 {
   prop_t *parent;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_global_unlock();
     return;
   }
 
   parent = p->hp_parent;
 
   if(parent != NULL) {
+    prop_enter(parent);
     assert(parent->hp_type == PROP_DIR);
     prop_notify_child2(p, parent, extra, PROP_SELECT_CHILD, skipme, 0);
     parent->hp_selected = p;
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -3392,14 +3989,15 @@ prop_select_ex(prop_t *p, prop_t *extra, prop_sub_t *skipme)
 void
 prop_unselect_ex(prop_t *parent, prop_sub_t *skipme)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(parent);
 
   if(parent->hp_type == PROP_DIR) {
     prop_notify_child(NULL, parent, PROP_SELECT_CHILD, skipme, 0);
     parent->hp_selected = NULL;
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -3411,21 +4009,23 @@ prop_suggest_focus(prop_t *p)
 {
   prop_t *parent;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
 
   if(p->hp_type == PROP_ZOMBIE) {
-    hts_mutex_unlock(&prop_mutex);
+    prop_global_unlock();
     return;
   }
 
   parent = p->hp_parent;
 
   if(parent != NULL) {
+    prop_enter(parent);
     assert(parent->hp_type == PROP_DIR);
     prop_notify_child(p, parent, PROP_SUGGEST_FOCUS, NULL, 0);
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 /**
@@ -3437,6 +4037,8 @@ prop_find0(prop_t *p, va_list ap)
   prop_t *c = p;
   const char *n;
 
+  prop_enter(p);
+
   while((n = va_arg(ap, const char *)) != NULL) {
 
     if(p->hp_type != PROP_DIR) {
@@ -3450,6 +4052,7 @@ prop_find0(prop_t *p, va_list ap)
     if(c == NULL)
 	return NULL;
     p = c;
+    prop_enter(p);
   }
   return c;
 }
@@ -3464,9 +4067,9 @@ prop_find(prop_t *p, ...)
   va_list ap;
   va_start(ap, p);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   prop_t *c = prop_ref_inc(prop_find0(p, ap));
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   va_end(ap);
   return c;
 }
@@ -3478,12 +4081,13 @@ prop_find(prop_t *p, ...)
 void
 prop_request_new_child(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
 
   if(p->hp_type == PROP_DIR || p->hp_type == PROP_VOID)
     prop_notify_child(NULL, p, PROP_REQ_NEW_CHILD, NULL, 0);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -3494,10 +4098,12 @@ void
 prop_request_delete(prop_t *c)
 {
   prop_t *p;
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(c);
 
   if(c->hp_type != PROP_ZOMBIE) {
     p = c->hp_parent;
+    prop_enter(p);
 
     if(p->hp_type == PROP_DIR) {
       prop_vec_t *pv = prop_vec_create(1);
@@ -3506,7 +4112,7 @@ prop_request_delete(prop_t *c)
       prop_vec_release(pv);
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -3516,19 +4122,23 @@ prop_request_delete(prop_t *c)
 void
 prop_request_delete_multi(prop_vec_t *pv)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(pv->pv_vec[0]);
+  prop_enter(pv->pv_vec[0]->hp_parent);
   prop_notify_childv(pv, pv->pv_vec[0]->hp_parent,
 		     PROP_REQ_DELETE_VECTOR, NULL, NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 /**
  *
  */
 static prop_courier_t *
-prop_courier_create(void)
+prop_courier_create(int flags)
 {
   prop_courier_t *pc = calloc(1, sizeof(prop_courier_t));
+  pc->pc_flags = flags;
+  hts_mutex_init(&pc->pc_mutex);
   TAILQ_INIT(&pc->pc_queue_nor);
   TAILQ_INIT(&pc->pc_queue_exp);
   return pc;
@@ -3539,15 +4149,16 @@ prop_courier_create(void)
  *
  */
 prop_courier_t *
-prop_courier_create_thread(hts_mutex_t *entrymutex, const char *name)
+prop_courier_create_thread(hts_mutex_t *entrymutex, const char *name,
+			   int flags)
 {
-  prop_courier_t *pc = prop_courier_create();
+  prop_courier_t *pc = prop_courier_create(flags);
   char buf[URL_MAX];
   pc->pc_entry_lock = entrymutex;
   snprintf(buf, sizeof(buf), "PC:%s", name);
 
   pc->pc_has_cond = 1;
-  hts_cond_init(&pc->pc_cond, &prop_mutex);
+  hts_cond_init(&pc->pc_cond, &pc->pc_mutex);
 
   pc->pc_run = 1;
   hts_thread_create_joinable(buf, &pc->pc_thread, prop_courier, pc,
@@ -3560,9 +4171,9 @@ prop_courier_create_thread(hts_mutex_t *entrymutex, const char *name)
  *
  */
 prop_courier_t *
-prop_courier_create_passive(void)
+prop_courier_create_passive(int flags)
 {
-  return prop_courier_create();
+  return prop_courier_create(flags);
 }
 
 
@@ -3571,9 +4182,9 @@ prop_courier_create_passive(void)
  */
 prop_courier_t *
 prop_courier_create_notify(void (*notify)(void *opaque),
-			   void *opaque)
+			   void *opaque, int flags)
 {
-  prop_courier_t *pc = prop_courier_create();
+  prop_courier_t *pc = prop_courier_create(flags);
 
   pc->pc_notify = notify;
   pc->pc_opaque = opaque;
@@ -3586,12 +4197,12 @@ prop_courier_create_notify(void (*notify)(void *opaque),
  *
  */
 prop_courier_t *
-prop_courier_create_waitable(void)
+prop_courier_create_waitable(int flags)
 {
-  prop_courier_t *pc = prop_courier_create();
+  prop_courier_t *pc = prop_courier_create(flags);
   
   pc->pc_has_cond = 1;
-  hts_cond_init(&pc->pc_cond, &prop_mutex);
+  hts_cond_init(&pc->pc_cond, &pc->pc_mutex);
 
   return pc;
 }
@@ -3604,9 +4215,9 @@ prop_courier_create_waitable(void)
 prop_courier_t *
 prop_courier_create_lockmgr(const char *name, prop_lockmgr_t *mgr, void *lock,
 			    void (*prologue)(void),
-			    void (*epilogue)(void))
+			    void (*epilogue)(void), int flags)
 {
-  prop_courier_t *pc = prop_courier_create();
+  prop_courier_t *pc = prop_courier_create(flags);
   char buf[URL_MAX];
   pc->pc_entry_lock = lock;
   pc->pc_lockmgr = mgr;
@@ -3616,7 +4227,7 @@ prop_courier_create_lockmgr(const char *name, prop_lockmgr_t *mgr, void *lock,
   snprintf(buf, sizeof(buf), "PC:%s", name);
 
   pc->pc_has_cond = 1;
-  hts_cond_init(&pc->pc_cond, &prop_mutex);
+  hts_cond_init(&pc->pc_cond, &pc->pc_mutex);
 
   pc->pc_run = 1;
   hts_thread_create_joinable(buf, &pc->pc_thread, prop_courier, pc,
@@ -3635,20 +4246,18 @@ prop_courier_wait(prop_courier_t *pc,
 		  int timeout)
 {
   int r = 0;
-  hts_mutex_lock(&prop_mutex);
+  hts_mutex_lock(&pc->pc_mutex);
   if(TAILQ_FIRST(&pc->pc_queue_exp) == NULL &&
      TAILQ_FIRST(&pc->pc_queue_nor) == NULL) {
     if(timeout)
-      r = hts_cond_wait_timeout(&pc->pc_cond, &prop_mutex, timeout);
+      r = hts_cond_wait_timeout(&pc->pc_cond, &pc->pc_mutex, timeout);
     else
-      hts_cond_wait(&pc->pc_cond, &prop_mutex);
+      hts_cond_wait(&pc->pc_cond, &pc->pc_mutex);
   }
 
-  TAILQ_MOVE(exp, &pc->pc_queue_exp, hpn_link);
-  TAILQ_INIT(&pc->pc_queue_exp);
-  TAILQ_MOVE(nor, &pc->pc_queue_nor, hpn_link);
-  TAILQ_INIT(&pc->pc_queue_nor);
-  hts_mutex_unlock(&prop_mutex);
+  courier_dequeue(pc, exp, &pc->pc_queue_exp);
+  courier_dequeue(pc, nor, &pc->pc_queue_nor);
+  hts_mutex_unlock(&pc->pc_mutex);
   return r;
 }
 
@@ -3673,10 +4282,10 @@ void
 prop_courier_destroy(prop_courier_t *pc)
 {
   if(pc->pc_run) {
-    hts_mutex_lock(&prop_mutex);
+    hts_mutex_lock(&pc->pc_mutex);
     pc->pc_run = 0;
     hts_cond_signal(&pc->pc_cond);
-    hts_mutex_unlock(&prop_mutex);
+    hts_mutex_unlock(&pc->pc_mutex);
 
     hts_thread_join(&pc->pc_thread);
   }
@@ -3684,10 +4293,29 @@ prop_courier_destroy(prop_courier_t *pc)
   if(pc->pc_has_cond)
     hts_cond_destroy(&pc->pc_cond);
 
+  if(pc->pc_dropped)
+    PROPTRACE("Courier destroyed, %d notifications coalesced",
+	      pc->pc_dropped);
+
+  hts_mutex_destroy(&pc->pc_mutex);
   free(pc);
 }
 
 
+/**
+ *
+ */
+int
+prop_courier_get_dropped(prop_courier_t *pc)
+{
+  int r;
+  hts_mutex_lock(&pc->pc_mutex);
+  r = pc->pc_dropped;
+  hts_mutex_unlock(&pc->pc_mutex);
+  return r;
+}
+
+
 /**
  *
  */
@@ -3695,8 +4323,10 @@ void
 prop_courier_stop(prop_courier_t *pc)
 {
   hts_thread_detach(&pc->pc_thread);
+  hts_mutex_lock(&pc->pc_mutex);
   pc->pc_run = 0;
   pc->pc_detached = 1;
+  hts_mutex_unlock(&pc->pc_mutex);
 }
 
 
@@ -3707,12 +4337,10 @@ void
 prop_courier_poll(prop_courier_t *pc)
 {
   struct prop_notify_queue q_exp, q_nor;
-  hts_mutex_lock(&prop_mutex);
-  TAILQ_MOVE(&q_exp, &pc->pc_queue_exp, hpn_link);
-  TAILQ_INIT(&pc->pc_queue_exp);
-  TAILQ_MOVE(&q_nor, &pc->pc_queue_nor, hpn_link);
-  TAILQ_INIT(&pc->pc_queue_nor);
-  hts_mutex_unlock(&prop_mutex);
+  hts_mutex_lock(&pc->pc_mutex);
+  courier_dequeue(pc, &q_exp, &pc->pc_queue_exp);
+  courier_dequeue(pc, &q_nor, &pc->pc_queue_nor);
+  hts_mutex_unlock(&pc->pc_mutex);
   prop_notify_dispatch(&q_exp);
   prop_notify_dispatch(&q_nor);
 }
@@ -3730,7 +4358,7 @@ prop_get_string(prop_t *p, ...)
 
   va_start(ap, p);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
 
   p = prop_find0(p, ap);
 
@@ -3757,7 +4385,7 @@ prop_get_string(prop_t *p, ...)
       break;
     }
   }
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   va_end(ap);
   return r;
 }
@@ -3779,7 +4407,8 @@ prop_set_ex(prop_sub_t *skipme, prop_t *p, ...)
 
   va_start(ap, p);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
 
   while((n = va_arg(ap, const char *)) != NULL) {
     if(p->hp_type == PROP_ZOMBIE)
@@ -3793,6 +4422,7 @@ prop_set_ex(prop_sub_t *skipme, prop_t *p, ...)
     if(c == NULL)
       c = prop_create0(p, n, skipme, 0);
     p = c;
+    prop_enter(p);
   }
 
   int ev = va_arg(ap, prop_event_t);
@@ -3820,7 +4450,7 @@ prop_set_ex(prop_sub_t *skipme, prop_t *p, ...)
    break;
   }
  bad:
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   va_end(ap);
 }
 
@@ -3838,9 +4468,11 @@ prop_get_name_of_childs(prop_t *p)
   if(p->hp_type != PROP_DIR)
     return NULL;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
+  prop_enter(p);
 
   TAILQ_FOREACH(c, &p->hp_childs, hp_parent_link) {
+    prop_enter(c);
     if(c->hp_type == PROP_VOID || c->hp_type == PROP_ZOMBIE)
       continue;
 
@@ -3854,7 +4486,7 @@ prop_get_name_of_childs(prop_t *p)
     i++;
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 
   return rval;
 }
@@ -3877,9 +4509,9 @@ prop_want_more_childs0(prop_sub_t *s)
 void
 prop_want_more_childs(prop_sub_t *s)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   prop_want_more_childs0(s);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -3899,9 +4531,9 @@ prop_have_more_childs0(prop_t *p)
 void
 prop_have_more_childs(prop_t *p)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   prop_have_more_childs0(p);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -3913,6 +4545,7 @@ prop_print_tree0(prop_t *p, int indent, int followlinks)
 {
   prop_t *c;
 
+  prop_enter(p);
   fprintf(stderr, "%*.s%s[%p %d %c%c]: ", indent, "", 
 	  p->hp_name, p, p->hp_xref,
 	  p->hp_flags & PROP_MULTI_SUB ? 'M' : ' ',
@@ -3973,9 +4606,9 @@ prop_print_tree0(prop_t *p, int indent, int followlinks)
 void
 prop_print_tree(prop_t *p, int followlinks)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   prop_print_tree0(p, 0, followlinks);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -4003,7 +4636,7 @@ prop_test(void)
 
   for(i = 0; i < TEST_COURIERS; i++) {
     hts_mutex_init(&mtx[i]);
-    couriers[i] = prop_courier_create_thread(&mtx[i], "test");
+    couriers[i] = prop_courier_create_thread(&mtx[i], "test", 0);
 
     prop_subscribe(0,
 		   PROP_TAG_CALLBACK, prop_test_subscriber, NULL,
@@ -319,13 +319,13 @@ prop_grouper_create(prop_t *dst, prop_t *src, const char *groupkey,
 
   pg->pg_groupingpath = strvec_split(groupkey, '.');
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
 
   pg->pg_srcsub = prop_subscribe(PROP_SUB_INTERNAL | PROP_SUB_DONTLOCK,
 				 PROP_TAG_CALLBACK, src_cb, pg,
 				 PROP_TAG_ROOT, src,
 				 NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   return pg;
 }
 
@@ -337,7 +337,7 @@ prop_grouper_create(prop_t *dst, prop_t *src, const char *groupkey,
 void
 prop_grouper_destroy(prop_grouper_t *pg)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
 
   pg_clear(pg);
   prop_unsubscribe0(pg->pg_srcsub);
@@ -345,7 +345,7 @@ prop_grouper_destroy(prop_grouper_t *pg)
 
   assert(LIST_FIRST(&pg->pg_nodes) == NULL);
   assert(LIST_FIRST(&pg->pg_groups) == NULL);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 
   strvec_free(pg->pg_groupingpath);
   free(pg);
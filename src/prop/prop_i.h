@@ -22,7 +22,6 @@
 
 #include "prop.h"
 
-extern hts_mutex_t prop_mutex;
 extern hts_mutex_t prop_tag_mutex;
 
 
@@ -32,12 +31,95 @@ LIST_HEAD(prop_list, prop);
 LIST_HEAD(prop_sub_list, prop_sub);
 
 
+/**
+ * A lock domain protects a set of properties.
+ *
+ * Every property belongs to exactly one domain. Most properties live in
+ * the global domain (prop_global_domain). A root created with
+ * prop_create_root_domain() starts a new domain and all properties
+ * created below it inherit it.
+ *
+ * Locking rules:
+ *
+ * - Operations that can only affect properties in a single domain
+ *   (setting values, creating children, plain subscribe/unsubscribe)
+ *   lock just that domain. This is the fast path.
+ *
+ * - Everything else (links, reparenting, destruction, name resolution,
+ *   and all operations on properties in the global domain) hold the
+ *   global domain lock and acquire other domains as they walk into
+ *   them (see prop_enter()). Those domains are released in
+ *   prop_global_unlock().
+ *
+ * Lock order is always global domain first, then other domains.
+ * Since only the global lock holder may hold more than one domain,
+ * this can not deadlock.
+ */
+typedef struct prop_lock_domain {
+  hts_mutex_t pld_mutex;
+
+  /**
+   * Refcount. Modified using atomic ops. Each prop and subscription
+   * in the domain holds a reference
+   */
+  int pld_refcount;
+
+  /**
+   * Number of threads holding or waiting for pld_mutex. Atomic ops
+   */
+  int pld_waiters;
+
+  /**
+   * Statistics. Protected by pld_mutex
+   */
+  int pld_acquired;
+  int pld_contended;
+
+  /**
+   * If non-zero, the fast path can not be used for this domain
+   * and all operations must go via the global lock.
+   * Incremented for each PROP_SUB_INTERNAL subscription attached
+   * to a property in the domain (their callbacks may modify other
+   * domains) and for each property from another domain parented
+   * into this domain (see PROP_XDOMAIN_CHILD).
+   * Protected by pld_mutex
+   */
+  int pld_slow;
+
+  /**
+   * Set when the current holder of the global lock has acquired
+   * this domain. Protected by the global domain lock
+   */
+  int pld_entered;
+  struct prop_lock_domain *pld_entered_next;
+
+  char *pld_name;
+  LIST_ENTRY(prop_lock_domain) pld_link;
+
+} prop_lock_domain_t;
+
+extern prop_lock_domain_t prop_global_domain;
+
+void prop_global_lock(void);
+
+void prop_global_unlock(void);
+
+void prop_lock_domain_enter(prop_lock_domain_t *pld);
+
+
 
 /**
  *
  */
 struct prop_courier {
 
+  /**
+   * Protects the queues. Notifications are enqueued from whatever
+   * lock domain the change happened in so we can't rely on the
+   * domain locks here
+   */
+  hts_mutex_t pc_mutex;
+
   struct prop_notify_queue pc_queue_nor;
   struct prop_notify_queue pc_queue_exp;
 
@@ -57,6 +139,13 @@ struct prop_courier {
   void (*pc_prologue)(void);
   void (*pc_epilogue)(void);
 
+  int pc_flags;
+
+  /**
+   * Number of value notifications dropped due to coalescing.
+   * Protected by pc_mutex
+   */
+  int pc_dropped;
 };
 
 
@@ -82,6 +171,12 @@ typedef enum {
  */
 struct prop {
 
+  /**
+   * Lock domain this property belongs to. Never changes once the
+   * property is created. Holds a reference on the domain
+   */
+  struct prop_lock_domain *hp_domain;
+
   /**
    * Refcount. Not protected by mutex. Modification needs to be issued
    * using atomic ops. This refcount only protects the memory allocated
@@ -172,6 +267,12 @@ struct prop {
 
 #define PROP_REF_TRACED            0x40
 
+  /**
+   * This property lives in another lock domain than its parent and
+   * holds a pld_slow count on the parent's domain
+   */
+#define PROP_XDOMAIN_CHILD         0x80
+
 
 
   /**
@@ -294,6 +395,26 @@ struct prop_sub {
    */
   uint16_t hps_flags;
 
+  /**
+   * Lock domain of the property we subscribed to. Holds a reference
+   * on the domain. May never be changed
+   */
+  struct prop_lock_domain *hps_domain;
+
+  /**
+   * Set if hps_value_prop or hps_canonical_prop lives in another
+   * domain than hps_domain (due to links). Such subscriptions can only
+   * be modified with the global lock held. Protected by hps_domain
+   */
+  uint8_t hps_xdomain;
+
+  /**
+   * Last queued notification for this subscription if it is a value
+   * update that can be replaced by a newer one.
+   * Only used with PROP_COURIER_COALESCE. Protected by courier's pc_mutex
+   */
+  struct prop_notify *hps_pending_value;
+
   /**
    * Linkage to property. Protected by global mutex
    */
@@ -341,4 +462,16 @@ void prop_want_more_childs0(prop_sub_t *s);
 void prop_set_string_exl(prop_t *p, prop_sub_t *skipme, const char *str,
 			 prop_str_type_t type);
 
+
+/**
+ * Must be called with the global lock held before touching a property
+ * that might belong to another lock domain
+ */
+static inline void
+prop_enter(prop_t *p)
+{
+  if(p != NULL && !p->hp_domain->pld_entered)
+    prop_lock_domain_enter(p->hp_domain);
+}
+
 #endif // PROP_I_H__
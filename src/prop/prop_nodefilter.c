@@ -266,8 +266,11 @@ nf_filtercheck(prop_t *p, const char *q)
 {
   prop_t *c;
 
-  while(p->hp_originator != NULL)
+  prop_enter(p);
+  while(p->hp_originator != NULL) {
     p = p->hp_originator;
+    prop_enter(p);
+  }
 
   switch(p->hp_type) {
   case PROP_RSTRING:
@@ -1063,11 +1066,15 @@ nf_translate_del_multi(prop_nf_t *nf, prop_vec_t *in)
 
   for(i = 0; i < len; i++) {
     p = prop_vec_get(in, i);
-    while(p->hp_originator != NULL)
+    prop_enter(p);
+    while(p->hp_originator != NULL) {
       p = p->hp_originator;
+      prop_enter(p);
+    }
     out = prop_vec_append(out, p);
   }
 
+  prop_enter(nf->src);
   prop_notify_childv(out, nf->src, PROP_REQ_DELETE_VECTOR, nf->srcsub, NULL);
   prop_vec_release(out);
 }
@@ -1146,7 +1153,7 @@ prop_nf_create(prop_t *dst, prop_t *src, prop_t *filter, int flags)
   nf->dst = flags & PROP_NF_TAKE_DST_OWNERSHIP ? dst : prop_xref_addref(dst);
   nf->src = src;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
 
   if(filter != NULL)
     nf->filtersub = prop_subscribe(PROP_SUB_INTERNAL | PROP_SUB_DONTLOCK,
@@ -1168,7 +1175,7 @@ prop_nf_create(prop_t *dst, prop_t *src, prop_t *filter, int flags)
 
   nf->pnf_refcount = 1 + (flags & PROP_NF_AUTODESTROY ? 1 : 0);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 
   return nf;
 }
@@ -1180,9 +1187,9 @@ prop_nf_create(prop_t *dst, prop_t *src, prop_t *filter, int flags)
 void
 prop_nf_release(struct prop_nf *pnf)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   prop_nf_release0(pnf);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -1192,9 +1199,9 @@ prop_nf_release(struct prop_nf *pnf)
 struct prop_nf *
 prop_nf_retain(struct prop_nf *pnf)
 {
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   pnf->pnf_refcount++;
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   return pnf;
 }
 
@@ -1267,9 +1274,9 @@ prop_nf_pred_str_add(struct prop_nf *nf,
 {
   struct prop_nf_pred *pnp = calloc(1, sizeof(struct prop_nf_pred));
   pnp->pnp_str = strdup(str);
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   int id = prop_nf_pred_add(nf, path, cf, enable, mode, pnp);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   return id;
 }
 
@@ -1285,9 +1292,9 @@ prop_nf_pred_int_add(struct prop_nf *nf,
 {
   struct prop_nf_pred *pnp = calloc(1, sizeof(struct prop_nf_pred));
   pnp->pnp_int = value;
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   int id = prop_nf_pred_add(nf, path, cf, enable, mode, pnp);
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
   return id;
 }
 
@@ -1305,7 +1312,7 @@ prop_nf_pred_remove(struct prop_nf *nf, int id)
   if(id == 0)
     return;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   LIST_FOREACH(pnp, &nf->preds, pnp_link)
     if(pnp->pnp_id == id)
       break;
@@ -1324,7 +1331,7 @@ prop_nf_pred_remove(struct prop_nf *nf, int id)
     nf_destroy_pred(pnp);
   }
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
 
 
@@ -1337,7 +1344,7 @@ prop_nf_sort(struct prop_nf *nf, const char *path, int desc, unsigned int idx,
 {
   nfnode_t *nfn;
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
   
   assert(idx < MAX_SORT_KEYS);
 
@@ -1367,5 +1374,5 @@ prop_nf_sort(struct prop_nf *nf, const char *path, int desc, unsigned int idx,
   TAILQ_FOREACH(nfn, &nf->in, in_link)
     nf_update_order_x(nf, nfn, idx);
  done:
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
@@ -41,8 +41,11 @@ typedef struct prop_reorder {
 static const char *
 get_id(const prop_t *p)
 {
-  while(p->hp_originator != NULL)
+  prop_enter((prop_t *)p);
+  while(p->hp_originator != NULL) {
     p = p->hp_originator;
+    prop_enter((prop_t *)p);
+  }
   return p->hp_name;
 }
 
@@ -56,6 +59,7 @@ save_order(prop_reorder_t *pr)
   htsmsg_t *out = htsmsg_create_list();
   prop_t *p;
 
+  prop_enter(pr->pr_dst);
   if(pr->pr_dst->hp_type == PROP_DIR)
     TAILQ_FOREACH(p, &pr->pr_dst->hp_childs, hp_parent_link)
       htsmsg_add_str(out, NULL, get_id(p));
@@ -84,6 +88,7 @@ get_before(prop_reorder_t *pr, const char *id)
   if(f == NULL)
     return NULL;
 
+  prop_enter(pr->pr_dst);
   if(pr->pr_dst->hp_type != PROP_DIR)
     return NULL;
 
@@ -208,7 +213,7 @@ prop_reorder_create(prop_t *dst, prop_t *src, int flags, const char *id)
   pr->pr_dst = flags & PROP_REORDER_TAKE_DST_OWNERSHIP ?
     dst : prop_xref_addref(dst);
 
-  hts_mutex_lock(&prop_mutex);
+  prop_global_lock();
 
   pr->pr_srcsub = prop_subscribe(PROP_SUB_INTERNAL | PROP_SUB_DONTLOCK | 
 				 PROP_SUB_TRACK_DESTROY,
@@ -222,5 +227,5 @@ prop_reorder_create(prop_t *dst, prop_t *src, int flags, const char *id)
 				 PROP_TAG_ROOT, dst,
 				 NULL);
 
-  hts_mutex_unlock(&prop_mutex);
+  prop_global_unlock();
 }
@@ -53,6 +53,8 @@ rstr_t *nls_get_rstring(const char *string);
 struct prop;
 struct prop *nls_get_prop(const char *string);
 
+rstr_t *nls_get_key(struct prop *p);
+
 rstr_t *nls_get_rstringp(const char *string, const char *singularis, int val);
 
 #ifndef MIN
@@ -109,8 +109,19 @@ typedef struct glyph {
 
   FT_BBox bbox;
 
+  /**
+   * Bitmaps handed out in glyph runs (TR_RENDER_GLYPH_RUN).
+   * Created on demand from bmp / outline
+   */
+#define GLYPH_PM_FILL    0
+#define GLYPH_PM_OUTLINE 1
+#define GLYPH_PM_SHADOW  2
+  pixmap_t *pm[3];
+
 } glyph_t;
 
+#define GLYPH_SHADOW_BLUR 4  // Same box blur as the composited shadow pass
+
 static struct glyph_list glyph_hash[GLYPH_HASH_SIZE];
 static struct glyph_queue allglyphs;
 static int num_glyphs;
@@ -185,12 +196,29 @@ family_get_name_by_id(int id)
 
 
 
+/**
+ *
+ */
+static void
+glyph_release_pixmaps(glyph_t *g, int first)
+{
+  int i;
+  for(i = first; i < 3; i++) {
+    if(g->pm[i] != NULL) {
+      pixmap_release(g->pm[i]);
+      g->pm[i] = NULL;
+    }
+  }
+}
+
+
 /**
  *
  */
 static void
 glyph_destroy(glyph_t *g)
 {
+  glyph_release_pixmaps(g, GLYPH_PM_FILL);
   LIST_REMOVE(g, face_link);
   TAILQ_REMOVE(&allglyphs, g, lru_link);
   LIST_REMOVE(g, hash_link);
@@ -616,18 +644,54 @@ glyph_flush_one(void)
 
 
 /**
- *
+ * Copy a FT bitmap into a (refcounted) pixmap that can outlive the glyph
+ */
+static pixmap_t *
+glyph_make_pixmap(FT_BitmapGlyph bg, int pad)
+{
+  const FT_Bitmap *bmp = &bg->bitmap;
+  pixmap_t *pm;
+  int y;
+
+  if(bmp->width == 0 || bmp->rows == 0)
+    return NULL;
+
+  pm = pixmap_create(bmp->width + pad * 2, bmp->rows + pad * 2, PIXMAP_I, 1);
+  if(pm == NULL)
+    return NULL;
+
+  for(y = 0; y < bmp->rows; y++)
+    memcpy(pm->pm_pixels + (y + pad) * pm->pm_linesize + pad,
+	   bmp->buffer + y * bmp->pitch, bmp->width);
+
+  if(pad)
+    pixmap_box_blur(pm, pad, pad);
+  return pm;
+}
+
+
+/**
+ * Output one glyph bitmap, either composited into the pixmap or
+ * appended to its glyph run
  */
 static void
-draw_glyph(pixmap_t *pm, int left, int top, FT_Bitmap *bmp, int color)
+put_glyph(pixmap_t *pm, pixmap_t *src, int left, int top, uint32_t color)
 {
-  pixmap_t src;
-  src.pm_type = PIXMAP_I;
-  src.pm_pixels = bmp->buffer;
-  src.pm_width = bmp->width;
-  src.pm_height = bmp->rows;
-  src.pm_linesize = bmp->width;
-  pixmap_composite(pm, &src, left, top, color);
+  pixmap_glyph_t *pg;
+
+  if(src == NULL)
+    return;
+
+  if(pm->pm_glyphs == NULL) {
+    pixmap_composite(pm, src, left, top, color);
+    return;
+  }
+
+  pg = &pm->pm_glyphs[pm->pm_numglyphs++];
+  pg->pg_pm = pixmap_dup(src);
+  pg->pg_x = left;
+  pg->pg_y = top;
+  pg->pg_color = color;
 }
 
 
@@ -669,6 +733,14 @@ typedef struct item {
   uint16_t outline;
   uint16_t shadow;
   char set_margin;
+
+  /**
+   * Bitmaps (indexed by GLYPH_PM_*) referenced while text_mutex is
+   * held so the item can be drawn without it
+   */
+  pixmap_t *bmp[3];
+  int16_t bmp_left[3];
+  int16_t bmp_top[3];
 } item_t;
 
 
@@ -794,60 +866,32 @@ draw_glyphs(pixmap_t *pm, struct line_queue *lq, int target_height,
       pen.x >>= 6;
       pen.y >>= 6;
 
+      const item_t *it = &items[i];
 
-      
-      if(items[i].outline > 0 && (g->outline == NULL ||
-				  g->outline_amt != items[i].outline)) {
-	if(g->outline)
-	  FT_Done_Glyph(g->outline);
-	
-	g->outline = g->orig_glyph;
-	FT_Stroker_Set(text_stroker,
-		       items[i].outline,
-		       FT_STROKER_LINECAP_ROUND,
-		       FT_STROKER_LINEJOIN_ROUND,
-		       0);
-	g->outline_amt = items[i].outline;
-	if(FT_Glyph_StrokeBorder(&g->outline, text_stroker, 0, 0))
-	  g->outline = NULL;
-	else if(FT_Glyph_To_Bitmap(&g->outline, FT_RENDER_MODE_NORMAL, NULL, 1))
-	  g->outline = NULL;
-      }
-      
-      if(g->bmp == NULL) {
-	g->bmp = g->orig_glyph;
-	if(FT_Glyph_To_Bitmap(&g->bmp, FT_RENDER_MODE_NORMAL, NULL, 0))
-	  g->bmp = NULL;
-      }
-      if(pass == 0 && items[i].shadow && (g->outline != NULL || g->bmp != NULL)) {
-	FT_BitmapGlyph bmp = (FT_BitmapGlyph)(g->outline ?: g->bmp);
-	draw_glyph(pm,
-		   bmp->left + items[i].shadow + margin + pen.x,
-		   target_height - bmp->top + items[i].shadow + margin - pen.y,
-		   &bmp->bitmap, 
-		   items[i].shadow_color);
-      }
+      if(pass == 0 && it->shadow)
+	put_glyph(pm, it->bmp[GLYPH_PM_SHADOW],
+		  it->bmp_left[GLYPH_PM_SHADOW] + it->shadow + margin + pen.x,
+		  target_height - it->bmp_top[GLYPH_PM_SHADOW] + it->shadow +
+		  margin - pen.y,
+		  it->shadow_color);
 
-      if(pass == 1 && items[i].outline > 0 && g->outline != NULL) {
-	FT_BitmapGlyph bmp = (FT_BitmapGlyph)g->outline;
-	draw_glyph(pm,
-		   bmp->left + margin + pen.x,
-		   target_height - bmp->top + margin - pen.y,
-		   &bmp->bitmap, 
-		   items[i].outline_color);
-      }
+      if(pass == 1 && it->outline > 0)
+	put_glyph(pm, it->bmp[GLYPH_PM_OUTLINE],
+		  it->bmp_left[GLYPH_PM_OUTLINE] + margin + pen.x,
+		  target_height - it->bmp_top[GLYPH_PM_OUTLINE] + margin - pen.y,
+		  it->outline_color);
 
-      if(pass == 2 && g->bmp != NULL) {
-	FT_BitmapGlyph bmp = (FT_BitmapGlyph)g->bmp;
-	draw_glyph(pm,
-		   bmp->left + margin + pen.x,
-		   target_height - bmp->top + margin - pen.y,
-		   &bmp->bitmap, 
-		   items[i].color);
+      if(pass == 2) {
+	const pixmap_t *fill = it->bmp[GLYPH_PM_FILL];
+	put_glyph(pm, it->bmp[GLYPH_PM_FILL],
+		  it->bmp_left[GLYPH_PM_FILL] + margin + pen.x,
+		  target_height - it->bmp_top[GLYPH_PM_FILL] + margin - pen.y,
+		  it->color);
 
 	if(pm->pm_charpos != NULL) {
-	  pm->pm_charpos[i * 2 + 0] = bmp->left + pen.x;
-	  pm->pm_charpos[i * 2 + 1] = bmp->left + bmp->bitmap.width + pen.x;
+	  pm->pm_charpos[i * 2 + 0] = it->bmp_left[GLYPH_PM_FILL] + pen.x;
+	  pm->pm_charpos[i * 2 + 1] = it->bmp_left[GLYPH_PM_FILL] +
+	    (fill != NULL ? fill->pm_width : 0) + pen.x;
 	}
       }
 
@@ -864,17 +908,134 @@ draw_glyphs(pixmap_t *pm, struct line_queue *lq, int target_height,
   }
 }
 
+/**
+ * Reference one of the glyph's bitmaps from the item, creating the
+ * bitmap if this is the first time it's used
+ */
+static void
+item_set_bitmap(item_t *it, int slot, glyph_t *g, FT_Glyph src,
+		int kind, int pad)
+{
+  FT_BitmapGlyph bg = (FT_BitmapGlyph)src;
+
+  it->bmp_left[slot] = bg->left - pad;
+  it->bmp_top[slot]  = bg->top + pad;
+
+  if(g->pm[kind] == NULL &&
+     (g->pm[kind] = glyph_make_pixmap(bg, pad)) == NULL)
+    return;
+
+  it->bmp[slot] = pixmap_dup(g->pm[kind]);
+}
+
+
+/**
+ * Rasterize (if needed) and reference all bitmaps required by the
+ * drawing passes. Must be called with text_mutex held, after that the
+ * items can be drawn unlocked even if the glyphs are flushed or
+ * restroked by someone else
+ */
+static void
+items_prepare(item_t *items, int count, int shadow, int outline,
+	      int glyph_run)
+{
+  item_t *it;
+  glyph_t *g;
+  int i;
+
+  for(i = 0; i < count; i++) {
+    it = &items[i];
+    if((g = it->g) == NULL)
+      continue;
+
+    if(it->outline > 0 && (g->outline == NULL ||
+			   g->outline_amt != it->outline)) {
+      if(g->outline)
+	FT_Done_Glyph(g->outline);
+      glyph_release_pixmaps(g, GLYPH_PM_OUTLINE);
+
+      g->outline = g->orig_glyph;
+      FT_Stroker_Set(text_stroker,
+		     it->outline,
+		     FT_STROKER_LINECAP_ROUND,
+		     FT_STROKER_LINEJOIN_ROUND,
+		     0);
+      g->outline_amt = it->outline;
+      if(FT_Glyph_StrokeBorder(&g->outline, text_stroker, 0, 0))
+	g->outline = NULL;
+      else if(FT_Glyph_To_Bitmap(&g->outline, FT_RENDER_MODE_NORMAL, NULL, 1))
+	g->outline = NULL;
+    }
+
+    if(g->bmp == NULL) {
+      g->bmp = g->orig_glyph;
+      if(FT_Glyph_To_Bitmap(&g->bmp, FT_RENDER_MODE_NORMAL, NULL, 0))
+	g->bmp = NULL;
+    }
+
+    if(g->bmp != NULL)
+      item_set_bitmap(it, GLYPH_PM_FILL, g, g->bmp, GLYPH_PM_FILL, 0);
+
+    if(outline && it->outline > 0 && g->outline != NULL)
+      item_set_bitmap(it, GLYPH_PM_OUTLINE, g, g->outline,
+		      GLYPH_PM_OUTLINE, 0);
+
+    if(shadow && it->shadow && (g->outline != NULL || g->bmp != NULL)) {
+      FT_Glyph src = g->outline ?: g->bmp;
+      if(glyph_run)
+	// Glyph runs can't be blurred as a whole, use pre-blurred bitmaps
+	item_set_bitmap(it, GLYPH_PM_SHADOW, g, src,
+			GLYPH_PM_SHADOW, GLYPH_SHADOW_BLUR);
+      else
+	item_set_bitmap(it, GLYPH_PM_SHADOW, g, src,
+			g->outline ? GLYPH_PM_OUTLINE : GLYPH_PM_FILL, 0);
+    }
+  }
+}
+
+
 /**
  *
  */
+static void
+items_release(item_t *items, int count)
+{
+  int i, j;
+  for(i = 0; i < count; i++)
+    for(j = 0; j < 3; j++)
+      if(items[i].bmp[j] != NULL)
+	pixmap_release(items[i].bmp[j]);
+}
+
+
+/**
+ * Trim caches and drop text_mutex
+ */
+static void
+text_render_unlock(void)
+{
+  while(num_glyphs > 512)
+    glyph_flush_one();
+
+  faces_purge();
+
+  hts_mutex_unlock(&text_mutex);
+}
+
+
+/**
+ * Layout and glyph lookup are done with text_mutex held. All the
+ * pixel pushing (compositing and blurring) is done unlocked so
+ * several threads can render texts at the same time
+ */
 static struct pixmap *
 text_render0(const uint32_t *uc, const int len,
 	     int flags, int default_size, float scale,
 	     int global_alignment, int max_width, int max_lines,
 	     const char *family, int context, int min_size)
 {
-  const int default_family_id = family_get(family ?: "Sans", context);
-  int family_id = default_family_id;
+  int default_family_id;
+  int family_id;
   pixmap_t *pm;
   FT_UInt prev = 0;
   FT_BBox bbox;
@@ -907,6 +1068,9 @@ text_render0(const uint32_t *uc, const int len,
 
   int need_shadow_pass = 0;
   int need_outline_pass = 0;
+  int glyph_run =
+    (flags & (TR_RENDER_GLYPH_RUN | TR_RENDER_NO_OUTPUT | TR_RENDER_DEBUG)) ==
+    TR_RENDER_GLYPH_RUN;
 
   if(min_size > 0 && current_size < min_size) {
     scale = (float)min_size / current_size;
@@ -916,6 +1080,11 @@ text_render0(const uint32_t *uc, const int len,
   if(current_size < 3 || scale < 0.001)
     return NULL;
 
+  hts_mutex_lock(&text_mutex);
+
+  default_family_id = family_get(family ?: "Sans", context);
+  family_id = default_family_id;
+
   bbox.xMin = 0;
   bbox.yMin = 0;
   max_width *= 64;
@@ -941,7 +1110,7 @@ text_render0(const uint32_t *uc, const int len,
   prev = 0;
   li = NULL;
 
-  items = malloc(sizeof(item_t) * len);
+  items = calloc(len, sizeof(item_t));
 
   int out = 0;
   int alignment = global_alignment;
@@ -974,6 +1143,7 @@ text_render0(const uint32_t *uc, const int len,
       continue;
 
     case TR_CODE_HR:
+      glyph_run = 0; // Rules are only drawn into pixmaps
       li = alloca(sizeof(line_t));
       li->default_height = current_size;
       li->type = LINE_TYPE_HR;
@@ -1234,6 +1404,7 @@ text_render0(const uint32_t *uc, const int len,
   }
 
   if(siz_x < 5) {
+    text_render_unlock();
     free(items);
     return NULL;
   }
@@ -1302,10 +1473,15 @@ text_render0(const uint32_t *uc, const int len,
 
   margin = (margin + 63) / 64;
 
+  if(!(flags & TR_RENDER_NO_OUTPUT))
+    items_prepare(items, out, need_shadow_pass, need_outline_pass, glyph_run);
+
+  text_render_unlock();
+
   // --- allocate and init pixmap
 
   pm = pixmap_create(target_width + margin*2, target_height + margin*2,
-		     flags & TR_RENDER_NO_OUTPUT ? PIXMAP_NULL :
+		     flags & TR_RENDER_NO_OUTPUT || glyph_run ? PIXMAP_NULL :
 		     color_output ? PIXMAP_BGR32 : PIXMAP_IA, 1);
 
   if(pm != NULL) {
@@ -1313,7 +1489,12 @@ text_render0(const uint32_t *uc, const int len,
     pm->pm_flags = pmflags;
     pm->pm_margin = margin;
 
-    if(pm->pm_data != NULL) {
+    if(glyph_run && out > 0) {
+      // Each item yields at most one glyph per pass
+      pm->pm_glyphs = malloc(sizeof(pixmap_glyph_t) * out * 3);
+    }
+
+    if(pm->pm_data != NULL || pm->pm_glyphs != NULL) {
   
       if(flags & TR_RENDER_DEBUG) {
 	uint8_t *data = pm->pm_pixels;
@@ -1335,7 +1516,8 @@ text_render0(const uint32_t *uc, const int len,
       if(need_shadow_pass) {
 	draw_glyphs(pm, &lq, target_height, siz_x, items, start_x, start_y,
 		    origin_y, margin, 0);
-	pixmap_box_blur(pm, 4, 4);
+	if(pm->pm_glyphs == NULL)
+	  pixmap_box_blur(pm, GLYPH_SHADOW_BLUR, GLYPH_SHADOW_BLUR);
       }
 
       if(need_outline_pass)
@@ -1347,6 +1529,7 @@ text_render0(const uint32_t *uc, const int len,
 		  origin_y, margin, 2);
     }
   }
+  items_release(items, out);
   free(items);
 
   if(stroker != NULL)
@@ -1364,20 +1547,8 @@ text_render(const uint32_t *uc, const int len, int flags, int default_size,
 	    float scale, int alignment, int max_width, int max_lines,
 	    const char *family, int context, int min_size)
 {
-  struct pixmap *pm;
-
-  hts_mutex_lock(&text_mutex);
-
-  pm = text_render0(uc, len, flags, default_size, scale, alignment, 
-		    max_width, max_lines, family, context, min_size);
-  while(num_glyphs > 512)
-    glyph_flush_one();
-
-  faces_purge();
-
-  hts_mutex_unlock(&text_mutex);
-
-  return pm;
+  return text_render0(uc, len, flags, default_size, scale, alignment,
+		      max_width, max_lines, family, context, min_size);
 }
 
 
@@ -71,6 +71,7 @@ struct rstr;
 #define TR_RENDER_SHADOW        0x20
 #define TR_RENDER_OUTLINE       0x40
 #define TR_RENDER_NO_OUTPUT     0x80
+#define TR_RENDER_GLYPH_RUN     0x100 // Return glyphs in pm_glyphs, no pixels
 
 #define TR_ALIGN_AUTO      0
 #define TR_ALIGN_LEFT      1
@@ -188,6 +188,28 @@ glw_change_underscan_v(void *opaque, int v)
 
 
 
+/**
+ *
+ */
+static void
+glw_set_text_atlas(void *opaque, int v)
+{
+  glw_root_t *gr = opaque;
+  gr->gr_text_atlas_enabled = v;
+  glw_text_flush(gr);
+}
+
+
+/**
+ *
+ */
+static void
+glw_set_text_workers(void *opaque, int v)
+{
+  glw_text_set_workers(opaque, v);
+}
+
+
 /**
  *
  */
@@ -260,6 +282,23 @@ glw_init_settings(glw_root_t *gr, const char *instance,
 			SETTINGS_INITIAL_UPDATE, " min", gr->gr_courier,
 			glw_settings_save, gr);
 
+  gr->gr_setting_text_atlas =
+    settings_create_bool(gr->gr_settings, "textatlas",
+			 _p("Render text using a shared glyph texture"), 0,
+			 gr->gr_settings_store,
+			 glw_set_text_atlas, gr,
+			 SETTINGS_INITIAL_UPDATE, gr->gr_courier,
+			 glw_settings_save, gr);
+
+  gr->gr_setting_text_workers =
+    settings_create_int(gr->gr_settings, "textworkers",
+			_p("Text rendering threads"),
+			MIN(get_system_concurrency(), 4),
+			gr->gr_settings_store, 1, 8, 1,
+			glw_set_text_workers, gr,
+			SETTINGS_INITIAL_UPDATE, NULL, gr->gr_courier,
+			glw_settings_save, gr);
+
 
   gr->gr_pointer_visible    = prop_create(r, "pointerVisible");
   gr->gr_is_fullscreen      = prop_create(r, "fullscreen");
@@ -285,7 +324,7 @@ glw_init(glw_root_t *gr, const char *theme,
     theme = themebuf;
   }
   hts_mutex_init(&gr->gr_mutex);
-  gr->gr_courier = prop_courier_create_passive();
+  gr->gr_courier = prop_courier_create_passive(PROP_COURIER_COALESCE);
   gr->gr_token_pool = pool_create("glwtokens", sizeof(token_t), POOL_ZERO_MEM);
   gr->gr_clone_pool = pool_create("glwclone", sizeof(glw_clone_t),
 				  POOL_ZERO_MEM);
@@ -318,6 +357,21 @@ glw_init(glw_root_t *gr, const char *theme,
 void
 glw_fini(glw_root_t *gr)
 {
+  uii_unregister(&gr->gr_uii);
+
+  setting_destroy(gr->gr_setting_size);
+  setting_destroy(gr->gr_setting_underscan_h);
+  setting_destroy(gr->gr_setting_underscan_v);
+  setting_destroy(gr->gr_setting_screensaver);
+  setting_destroy(gr->gr_setting_text_workers);
+  setting_destroy(gr->gr_setting_text_atlas);
+  prop_destroy(gr->gr_settings);
+  htsmsg_destroy(gr->gr_settings_store);
+  free(gr->gr_settings_instance);
+
+  glw_text_bitmap_fini(gr);
+
+  free((void *)gr->gr_vpaths[1]);
   pool_destroy(gr->gr_token_pool);
   pool_destroy(gr->gr_clone_pool);
 }
@@ -344,6 +398,12 @@ void
 glw_load_universe(glw_root_t *gr)
 {
   prop_t *page = prop_create(gr->gr_uii.uii_prop, "root");
+  int parsed = gr->gr_views_parsed;
+  int precompiled = gr->gr_views_precompiled;
+  int64_t parse_time = gr->gr_views_parse_time;
+  int64_t precompiled_time = gr->gr_views_precompiled_time;
+  int64_t ts = showtime_get_ts();
+
   glw_unload_universe(gr);
 
   rstr_t *universe = rstr_alloc("theme://universe.view");
@@ -354,6 +414,15 @@ glw_load_universe(glw_root_t *gr)
 
   rstr_release(universe);
 
+  TRACE(TRACE_INFO, "GLW",
+	"Universe loaded in %d ms. Views parsed: %d in %d ms, "
+	"precompiled: %d in %d ms",
+	(int)((showtime_get_ts() - ts) / 1000),
+	gr->gr_views_parsed - parsed,
+	(int)((gr->gr_views_parse_time - parse_time) / 1000),
+	gr->gr_views_precompiled - precompiled,
+	(int)((gr->gr_views_precompiled_time - precompiled_time) / 1000));
+
   glw_signal_handler_register(gr->gr_universe, top_event_handler, gr, 1000);
 }
 
@@ -539,6 +608,13 @@ glw_prepare_frame(glw_root_t *gr, int flags)
       gr->gr_framerate = hz;
     }
     gr->gr_hz_sample = gr->gr_frame_start;
+
+    prop_set_int(prop_create(gr->gr_uii.uii_prop, "coalescedNotifications"),
+		 prop_courier_get_dropped(gr->gr_courier));
+
+    glw_text_update_stats(gr);
+    glw_tex_update_stats(gr);
+    glw_view_update_stats(gr);
   }
 
   gr->gr_frames++;
@@ -1463,6 +1539,22 @@ glw_focus_suggest(glw_t *w)
 }
 
 
+/**
+ * Return how far (in pixels) a widget is from being visible, as
+ * recorded by scrollable containers when they clip it. 0 if visible
+ */
+int
+glw_get_clip_distance(const glw_t *w)
+{
+  int d = 0;
+
+  for(; w != NULL; w = w->glw_parent)
+    if(w->glw_flags & GLW_CLIPPED)
+      d = MAX(d, w->glw_clip_distance + 1);
+  return d;
+}
+
+
 /**
  *
  */
@@ -50,6 +50,16 @@ LIST_HEAD(glw_loadable_texture_list, glw_loadable_texture);
 TAILQ_HEAD(glw_loadable_texture_queue, glw_loadable_texture);
 LIST_HEAD(glw_video_list, glw_video);
 
+/**
+ * Binary heap of textures waiting to be loaded, ordered by distance
+ * from the viewport and then by time of request
+ */
+typedef struct glw_tex_heap {
+  struct glw_loadable_texture **gth_vec;
+  int gth_num;
+  int gth_size;
+} glw_tex_heap_t;
+
 // ------------------- Backends -----------------
 
 #if CONFIG_GLW_BACKEND_OPENGL || CONFIG_GLW_BACKEND_OPENGL_ES
@@ -58,6 +68,8 @@ LIST_HEAD(glw_video_list, glw_video);
 #include "glw_gx.h"
 #elif CONFIG_GLW_BACKEND_RSX
 #include "glw_rsx.h"
+#elif CONFIG_GLW_BACKEND_NULL
+#include "glw_null.h"
 #else
 #error No backend for glw
 #endif
@@ -629,12 +641,20 @@ typedef struct glw_root {
 
   pool_t *gr_token_pool;
   pool_t *gr_clone_pool;
+  int gr_token_allocs;
 
   int gr_frames;
 
   struct glw *gr_universe;
 
-  LIST_HEAD(, glw_cached_view) gr_views;
+#define GLW_VIEW_HASH_SIZE 64
+  LIST_HEAD(, glw_cached_view) gr_views[GLW_VIEW_HASH_SIZE];
+
+  struct glw_view_deps *gr_view_deps; // Files loaded are added here if set
+  int gr_views_parsed;
+  int gr_views_precompiled;
+  int64_t gr_views_parse_time;
+  int64_t gr_views_precompiled_time;
 
   const char *gr_vpaths[5];
 
@@ -683,9 +703,20 @@ typedef struct glw_root {
   TAILQ_HEAD(, glw_text_bitmap) gr_gtb_render_queue;
   TAILQ_HEAD(, glw_text_bitmap) gr_gtb_dim_queue;
   hts_cond_t gr_gtb_work_cond;
+  int gr_gtb_workers;           // Wanted number of render threads
+  int gr_gtb_threads;           // Running render threads
+  setting_t *gr_setting_text_workers;
+
+  int64_t gr_gtb_latency_sum;   // Time from enqueue to render start
+  int gr_gtb_latency_max;
+  int gr_gtb_latency_count;
 
   int gr_font_domain;
 
+  struct glw_text_atlas *gr_text_atlas;
+  int gr_text_atlas_enabled;
+  setting_t *gr_setting_text_atlas;
+
   /**
    * Image/Texture loader
    */
@@ -699,7 +730,16 @@ typedef struct glw_root {
 #define LQ_REFRESH    4
 #define LQ_num        5
 
-  struct glw_loadable_texture_queue gr_tex_load_queue[LQ_num];
+  glw_tex_heap_t gr_tex_load_queue[LQ_num];
+  unsigned int gr_tex_seq;
+  int gr_tex_loaders;
+
+  int gr_tex_loading;
+  int gr_tex_loaded;
+  int gr_tex_cancelled;
+  int64_t gr_tex_ttfp_sum;      // Time to first pixel, from first request
+  int gr_tex_ttfp_max;
+  int gr_tex_ttfp_count;
 
   struct glw_loadable_texture_list gr_tex_active_list;
   struct glw_loadable_texture_list gr_tex_flush_list;
@@ -808,8 +848,16 @@ typedef struct glw_root {
 					 */
 
 
-  float *gr_vtmp_buffer;  // temporary buffer for emitting vertices
-  int gr_vtmp_cur;
+  /**
+   * Frame profiling, only enabled by the headless frame benchmark
+   */
+  int gr_profile;
+  int64_t gr_profile_eval;       // Re-evaluation of view expressions (µs)
+  int64_t gr_profile_tesselate;  // Software transform and clipping (µs)
+  int gr_profile_tesselations;
+
+  float *gr_vtmp_buffer;  // temporary buffer for transformed vertices
+  int gr_vtmp_cur;        // Vertices emitted by the tesselator
   int gr_vtmp_capacity;
 
   void (*gr_open_osk)(struct glw_root *gr, 
@@ -909,6 +957,8 @@ typedef struct glw {
   int16_t glw_req_size_y;
   float glw_req_weight;
 
+  int glw_clip_distance;      // Pixels outside parent's view if GLW_CLIPPED
+
   int glw_flags;
 
 #define GLW_ACTIVE               0x1
@@ -1023,6 +1073,10 @@ void glw_load_universe(glw_root_t *gr);
 
 void glw_unload_universe(glw_root_t *gr);
 
+#if ENABLE_GLW_FRONTEND_HEADLESS
+int glw_headless_bench(void);
+#endif
+
 void glw_flush(glw_root_t *gr);
 
 void *glw_get_opaque(glw_t *w, glw_callback_t *func);
@@ -1087,6 +1141,8 @@ void glw_set_focus_weight(glw_t *w, float f);
 
 int glw_is_child_focusable(glw_t *w);
 
+int glw_get_clip_distance(const glw_t *w);
+
 
 /**
  * Clipping
@@ -322,6 +322,7 @@ glw_array_render_one(glw_array_t *a, glw_t *c, int height,
 
   if(y + a->child_height_px < 0 || y > height) {
     c->glw_flags |= GLW_CLIPPED;
+    c->glw_clip_distance = y < 0 ? -(y + a->child_height_px) : y - height;
     return;
   } else {
     c->glw_flags &= ~GLW_CLIPPED;
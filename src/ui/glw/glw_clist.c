@@ -152,6 +152,8 @@ render(glw_t *w, const glw_rctx_t *rc)
     y = c->glw_parent_pos;
     if(y + c->glw_parent_height < 0 || y > rc->rc_height) {
       c->glw_flags |= GLW_CLIPPED;
+      c->glw_clip_distance = y < 0 ? -(y + c->glw_parent_height) :
+	y - rc->rc_height;
       continue;
     } else {
       c->glw_flags &= ~GLW_CLIPPED;
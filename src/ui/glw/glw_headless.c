@@ -0,0 +1,478 @@
+/*
+ *  GL Widgets, Headless frontend
+ *  Copyright (C) 2012 Andreas Öman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "showtime.h"
+#include "navigator.h"
+#include "fileaccess/filebundle.h"
+#include "glw.h"
+
+/**
+ * Runs the GLW frame loop without any display using the null backend.
+ * Everything up to the point where vertices would be sent to a GPU
+ * is done as usual. Mostly useful for benchmarking, see
+ * glw_headless_bench() below
+ */
+
+typedef struct glw_headless {
+
+  glw_root_t gr;
+
+  int stop;
+
+} glw_headless_t;
+
+
+/**
+ *
+ */
+static glw_headless_t *
+glw_headless_create(ui_t *ui, prop_t *root, const char *theme,
+		    const char *confname, int width, int height, int primary)
+{
+  glw_headless_t *gh = calloc(1, sizeof(glw_headless_t));
+  glw_root_t *gr = &gh->gr;
+
+  gr->gr_uii.uii_prop = root;
+  gr->gr_width  = width;
+  gr->gr_height = height;
+
+  glw_null_init_context(gr);
+
+  if(glw_init(gr, theme, ui, primary, confname, NULL)) {
+    free(gh);
+    return NULL;
+  }
+  return gh;
+}
+
+
+/**
+ *
+ */
+static void
+glw_headless_frame(glw_root_t *gr, glw_t *w)
+{
+  glw_rctx_t rc;
+
+  glw_prepare_frame(gr, 0);
+  glw_rctx_init(&rc, gr->gr_width, gr->gr_height, 1);
+  if(w != NULL) {
+    glw_layout0(w, &rc);
+    glw_render0(w, &rc);
+  }
+}
+
+
+/**
+ *
+ */
+static void
+glw_headless_mainloop(glw_headless_t *gh)
+{
+  glw_root_t *gr = &gh->gr;
+  int64_t start = showtime_get_ts(), d;
+  int64_t frame = 0;
+
+  while(!gh->stop) {
+    glw_lock(gr);
+    glw_headless_frame(gr, gr->gr_universe);
+    glw_unlock(gr);
+    glw_post_scene(gr);
+
+    frame++;
+    d = start + frame * gr->gr_frameduration - showtime_get_ts();
+    if(d > 0)
+      usleep(d);
+  }
+}
+
+
+/**
+ *
+ */
+static int
+glw_headless_start(ui_t *ui, prop_t *root, int argc, char *argv[],
+		   int primary)
+{
+  const char *theme_path = NULL;
+  int width = 1280, height = 720;
+  glw_headless_t *gh;
+  glw_root_t *gr;
+
+  /* Parse options */
+
+  argv++;
+  argc--;
+
+  while(argc > 0) {
+    if(!strcmp(argv[0], "--theme") && argc > 1) {
+      theme_path = argv[1];
+      argc -= 2; argv += 2;
+      continue;
+    } else if(!strcmp(argv[0], "--width") && argc > 1) {
+      width = atoi(argv[1]);
+      argc -= 2; argv += 2;
+      continue;
+    } else if(!strcmp(argv[0], "--height") && argc > 1) {
+      height = atoi(argv[1]);
+      argc -= 2; argv += 2;
+      continue;
+    } else {
+      break;
+    }
+  }
+
+  gh = glw_headless_create(ui, root, theme_path, "glw/headless",
+			   width, height, primary);
+  if(gh == NULL)
+    return 1;
+
+  gr = &gh->gr;
+
+  glw_lock(gr);
+  glw_load_universe(gr);
+  glw_unlock(gr);
+  glw_headless_mainloop(gh);
+  glw_lock(gr);
+  glw_unload_universe(gr);
+  glw_unlock(gr);
+  glw_reap(gr);
+  glw_reap(gr);
+  glw_fini(gr);
+  return 0;
+}
+
+
+/**
+ *
+ */
+static void
+glw_headless_dispatch_event(uii_t *uii, event_t *e)
+{
+  glw_dispatch_event(uii, e);
+  event_release(e);
+}
+
+
+/**
+ *
+ */
+static void
+glw_headless_stop(uii_t *uii)
+{
+  glw_headless_t *gh = (glw_headless_t *)uii;
+  gh->stop = 1;
+}
+
+
+/**
+ *
+ */
+ui_t glw_ui = {
+  .ui_title = "glw",
+  .ui_start = glw_headless_start,
+  .ui_dispatch_event = glw_headless_dispatch_event,
+  .ui_stop = glw_headless_stop,
+};
+
+
+/**
+ * Scripted scenes for the frame benchmark
+ */
+#define BENCH_WIDTH     1280
+#define BENCH_HEIGHT    720
+#define BENCH_SETTLE    30   // Frames (paced) to let async loading finish
+#define BENCH_FRAMES    300
+
+static const char *bench_pages[] = {
+  NAV_HOME,
+  "settings:",
+  "settings:general",
+  "page:about",
+};
+
+static const int bench_list_items[] = {
+  100,
+  1000,
+};
+
+static const char bench_list_view[] =
+  "widget(list_y, {\n"
+  "  spacing: 3;\n"
+  "  cloner($self.items, loader, {\n"
+  "    source: \"theme://pages/listitems/audio.view\";\n"
+  "  });\n"
+  "});\n";
+
+/**
+ * Served as bundle://glwbench/list.view so nothing is written to disk
+ */
+static const struct filebundle_entry bench_bundle_entries[] = {
+  { "list.view", (const unsigned char *)bench_list_view,
+    sizeof(bench_list_view) - 1, -1 },
+  { NULL, NULL, 0, 0 }
+};
+
+static struct filebundle bench_bundle = {
+  .entries = bench_bundle_entries,
+  .prefix = "glwbench",
+};
+
+
+/**
+ *
+ */
+typedef struct bench_stats {
+  int frames;
+  int64_t total;
+  int64_t max;
+  int64_t prepare;
+  int64_t layout;
+  int64_t render;
+  int64_t eval;
+  int64_t tesselate;
+  int tesselations;
+  int render_calls;
+  int vertices;
+} bench_stats_t;
+
+
+/**
+ *
+ */
+static void
+bench_frame(glw_root_t *gr, glw_t *w, bench_stats_t *bs)
+{
+  glw_backend_root_t *gbr = &gr->gr_be;
+  glw_rctx_t rc;
+  int64_t t0, t1, t2, t3;
+
+  glw_lock(gr);
+
+  gr->gr_profile_eval = 0;
+  gr->gr_profile_tesselate = 0;
+  gr->gr_profile_tesselations = 0;
+  gbr->gbr_render_calls = 0;
+  gbr->gbr_vertices = 0;
+
+  t0 = showtime_get_ts();
+  glw_prepare_frame(gr, 0);
+  t1 = showtime_get_ts();
+  glw_rctx_init(&rc, gr->gr_width, gr->gr_height, 1);
+  glw_layout0(w, &rc);
+  t2 = showtime_get_ts();
+  glw_render0(w, &rc);
+  t3 = showtime_get_ts();
+
+  glw_unlock(gr);
+  glw_post_scene(gr);
+
+  if(bs == NULL)
+    return;
+
+  bs->frames++;
+  bs->total += t3 - t0;
+  bs->max = MAX(bs->max, t3 - t0);
+  bs->prepare += t1 - t0;
+  bs->layout += t2 - t1;
+  bs->render += t3 - t2;
+  bs->eval += gr->gr_profile_eval;
+  bs->tesselate += gr->gr_profile_tesselate;
+  bs->tesselations += gr->gr_profile_tesselations;
+  bs->render_calls += gbr->gbr_render_calls;
+  bs->vertices += gbr->gbr_vertices;
+}
+
+
+/**
+ * Run frames in real time to let pages open, textures load, etc
+ */
+static void
+bench_settle(glw_root_t *gr, glw_t *w)
+{
+  int i;
+  for(i = 0; i < BENCH_SETTLE; i++) {
+    bench_frame(gr, w, NULL);
+    usleep(gr->gr_frameduration);
+  }
+}
+
+
+/**
+ *
+ */
+static void
+bench_report(const char *scene, const bench_stats_t *bs)
+{
+  const double f = bs->frames * 1000.0;
+
+  if(bs->frames == 0)
+    return;
+
+  TRACE(TRACE_INFO, "bench",
+	"%s: %d frames, %.3f ms/frame (max %.3f), "
+	"prepare: %.3f, layout: %.3f, render: %.3f, "
+	"eval: %.3f, tesselate: %.3f ms/frame",
+	scene, bs->frames, bs->total / f, bs->max / 1000.0,
+	bs->prepare / f, bs->layout / f, bs->render / f,
+	bs->eval / f, bs->tesselate / f);
+
+  TRACE(TRACE_INFO, "bench",
+	"%s: %d tesselations, %d render calls, %d vertices per frame",
+	scene, bs->tesselations / bs->frames,
+	bs->render_calls / bs->frames, bs->vertices / bs->frames);
+}
+
+
+/**
+ * Step through a few pages in the theme
+ */
+static void
+bench_pages_scene(glw_root_t *gr)
+{
+  bench_stats_t bs;
+  char scene[64];
+  int i, j;
+
+  glw_lock(gr);
+  glw_load_universe(gr);
+  glw_unlock(gr);
+
+  for(i = 0; i < sizeof(bench_pages) / sizeof(bench_pages[0]); i++) {
+    nav_open(bench_pages[i], NULL);
+    bench_settle(gr, gr->gr_universe);
+
+    memset(&bs, 0, sizeof(bs));
+    for(j = 0; j < BENCH_FRAMES; j++)
+      bench_frame(gr, gr->gr_universe, &bs);
+
+    snprintf(scene, sizeof(scene), "Page %s", bench_pages[i]);
+    bench_report(scene, &bs);
+  }
+
+  glw_lock(gr);
+  glw_unload_universe(gr);
+  gr->gr_universe = NULL;
+  glw_unlock(gr);
+}
+
+
+/**
+ * A list of 'num' items, scrolled one item per frame from top to
+ * bottom and back again
+ */
+static void
+bench_list_scene(glw_root_t *gr, const char *url, int num)
+{
+  prop_t *root = prop_create_root(NULL);
+  prop_t *items = prop_create(root, "items");
+  bench_stats_t bs;
+  char buf[64];
+  rstr_t *r;
+  int i;
+
+  for(i = 0; i < num; i++) {
+    prop_t *p = prop_create_root(NULL);
+    prop_t *m = prop_create(p, "metadata");
+    prop_set_string(prop_create(p, "type"), "audio");
+    snprintf(buf, sizeof(buf), "Track number %d", i + 1);
+    prop_set_string(prop_create(m, "title"), buf);
+    snprintf(buf, sizeof(buf), "Artist %d", i % 17);
+    prop_set_string(prop_create(m, "artist"), buf);
+    prop_set_float(prop_create(m, "duration"), 120 + i % 240);
+    if(prop_set_parent(p, items))
+      abort();
+  }
+
+  glw_lock(gr);
+  r = rstr_alloc(url);
+  gr->gr_universe = glw_view_create(gr, r, NULL, root, NULL, NULL, NULL, 0);
+  rstr_release(r);
+  glw_unlock(gr);
+
+  bench_settle(gr, gr->gr_universe);
+
+  memset(&bs, 0, sizeof(bs));
+  for(i = 0; i < num * 2; i++) {
+    event_t *e = event_create_action(i < num ? ACTION_DOWN : ACTION_UP);
+    glw_lock(gr);
+    glw_event(gr, e);
+    glw_unlock(gr);
+    event_release(e);
+
+    bench_frame(gr, gr->gr_universe, &bs);
+  }
+
+  snprintf(buf, sizeof(buf), "List of %d items", num);
+  bench_report(buf, &bs);
+
+  glw_lock(gr);
+  glw_unload_universe(gr);
+  gr->gr_universe = NULL;
+  glw_unlock(gr);
+
+  prop_destroy(root);
+}
+
+
+/**
+ * Layout and tesselation cost of some representative scenes
+ */
+int
+glw_headless_bench(void)
+{
+  extern struct filebundle *filebundles;
+  static int registered;
+  glw_headless_t *gh;
+  glw_root_t *gr;
+  int i;
+
+  if(!registered) {
+    bench_bundle.next = filebundles;
+    filebundles = &bench_bundle;
+    registered = 1;
+  }
+
+  // Not primary, we don't want to receive events from anywhere else
+  gh = glw_headless_create(&glw_ui, prop_create_root("ui"), NULL,
+			   "glw/bench", BENCH_WIDTH, BENCH_HEIGHT, 0);
+  if(gh == NULL)
+    return 1;
+
+  gr = &gh->gr;
+  gr->gr_profile = 1;
+
+  bench_pages_scene(gr);
+
+  for(i = 0; i < sizeof(bench_list_items) / sizeof(bench_list_items[0]); i++)
+    bench_list_scene(gr, "bundle://glwbench/list.view",
+		     bench_list_items[i]);
+
+  glw_reap(gr);
+  glw_reap(gr);
+  glw_fini(gr);
+  prop_destroy(gr->gr_uii.uii_prop);
+  free(gh);
+  return 0;
+}
@@ -665,8 +665,10 @@ glw_image_layout(glw_t *w, glw_rctx_t *rc)
     }
   }
   
+  const int distance = glw_get_clip_distance(w);
+
   if((glt = gi->gi_pending) != NULL) {
-    glw_tex_layout(gr, glt);
+    glw_tex_layout_ex(gr, glt, distance);
 
     if(glw_is_tex_inited(&glt->glt_texture) ||
        glt->glt_state == GLT_STATE_ERROR) {
@@ -691,7 +693,7 @@ glw_image_layout(glw_t *w, glw_rctx_t *rc)
     gi->gi_autofade = GLW_LP(8, gi->gi_autofade, 1);
   }
 
-  glw_tex_layout(gr, glt);
+  glw_tex_layout_ex(gr, glt, distance);
 
   if(glt->glt_state == GLT_STATE_ERROR) {
     if(!gi->gi_is_ready) {
@@ -329,6 +329,7 @@ glw_list_render_y(glw_t *w, const glw_rctx_t *rc)
     y = c->glw_parent_pos - l->filtered_pos;
     if(!l->noclip && (y + c->glw_parent_height < 0 || y > height)) {
       c->glw_flags |= GLW_CLIPPED;
+      c->glw_clip_distance = y < 0 ? -(y + c->glw_parent_height) : y - height;
       continue;
     } else {
       c->glw_flags &= ~GLW_CLIPPED;
@@ -414,6 +415,7 @@ glw_list_render_x(glw_t *w, const glw_rctx_t *rc)
     x = c->glw_parent_pos - l->filtered_pos;
     if(!l->noclip && (x + c->glw_parent_width < 0 || x > width)) {
       c->glw_flags |= GLW_CLIPPED;
+      c->glw_clip_distance = x < 0 ? -(x + c->glw_parent_width) : x - width;
       continue;
     } else {
       c->glw_flags &= ~GLW_CLIPPED;
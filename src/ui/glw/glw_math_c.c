@@ -129,3 +129,36 @@ glw_LoadIdentity(glw_rctx_t *rc)
   rc->rc_mtx[10] = 1;
   rc->rc_mtx[15] = 1;
 }
+
+
+/**
+ * Transform 'num' vertices, 'stride' floats apart, with 'm' and store
+ * them as packed Vec4s in 'dst'. Same as glw_pmtx_mul_vec4_i()
+ */
+void
+glw_mtx_mul_vec4_batch(float *dst, const Mtx m, const float *src,
+		       int num, int stride)
+{
+  for(; num > 0; num--, src += stride, dst += 4) {
+    const float x = src[0], y = src[1], z = src[2];
+    dst[0] = m[0] * x + m[4] * y + m[ 8] * z + m[12];
+    dst[1] = m[1] * x + m[5] * y + m[ 9] * z + m[13];
+    dst[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+    dst[3] = src[3];
+  }
+}
+
+
+/**
+ * Set 'bit' in dst[i] for each packed Vec4 in 'src' that is on the
+ * negative side of 'plane'
+ */
+void
+glw_plane_classify_batch(uint8_t *dst, const float *src, int num,
+			 const Vec4 plane, int bit)
+{
+  int i;
+  for(i = 0; i < num; i++, src += 4)
+    if(glw_vec34_dot(src, plane) < 0)
+      dst[i] |= bit;
+}
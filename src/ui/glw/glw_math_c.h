@@ -174,6 +174,12 @@ glw_mtx_trans_mul_vec4(Vec4 dst, const Mtx mt, const Vec4 v)
 
 extern int glw_mtx_invert(Mtx dst, const Mtx src);
 
+extern void glw_mtx_mul_vec4_batch(float *dst, const Mtx m, const float *src,
+				   int num, int stride);
+
+extern void glw_plane_classify_batch(uint8_t *dst, const float *src, int num,
+				     const Vec4 plane, int bit);
+
 #define glw_vec2_extract(v, i) v[i]
 #define glw_vec3_extract(v, i) v[i]
 #define glw_vec4_extract(v, i) v[i]
@@ -132,3 +132,69 @@ glw_LoadIdentity(glw_rctx_t *rc)
   rc->rc_mtx[2]  = (__m128){0, 0, 1, 0};
   rc->rc_mtx[3]  = (__m128){0, 0, 0, 1};
 }
+
+
+/**
+ * Transform 'num' vertices, 'stride' floats apart, with 'm' and store
+ * them as packed Vec4s in 'dst'.
+ *
+ * Each column is scaled by the broadcasted vertex component and summed
+ * so there is no per-vertex transpose as in glw_pmtx_mul_vec4()
+ */
+void
+glw_mtx_mul_vec4_batch(float *dst, const Mtx m, const float *src,
+		       int num, int stride)
+{
+  const __m128 c0 = m[0];
+  const __m128 c1 = m[1];
+  const __m128 c2 = m[2];
+  const __m128 c3 = m[3];
+
+  for(; num > 0; num--, src += stride, dst += 4) {
+    const __m128 v = _mm_loadu_ps(src);
+    const __m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0,0,0,0));
+    const __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1,1,1,1));
+    const __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,2,2,2));
+    const __m128 w = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,3,3,3));
+
+    _mm_storeu_ps(dst, _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, x),
+					     _mm_mul_ps(c1, y)),
+				  _mm_add_ps(_mm_mul_ps(c2, z),
+					     _mm_mul_ps(c3, w))));
+  }
+}
+
+
+/**
+ * Set 'bit' in dst[i] for each packed Vec4 in 'src' that is on the
+ * negative side of 'plane'. Four vertices are tested per iteration
+ */
+void
+glw_plane_classify_batch(uint8_t *dst, const float *src, int num,
+			 const Vec4 plane, int bit)
+{
+  const __m128 p = _mm_mul_ps(plane, (__m128){1, 1, 1, 0});
+  const __m128 d = _mm_set1_ps(__builtin_ia32_vec_ext_v4sf(plane, 3));
+  const __m128 zero = _mm_setzero_ps();
+  int i, mask;
+
+  for(i = 0; i + 4 <= num; i += 4, src += 16) {
+    __m128 a0 = _mm_mul_ps(_mm_loadu_ps(src +  0), p);
+    __m128 a1 = _mm_mul_ps(_mm_loadu_ps(src +  4), p);
+    __m128 a2 = _mm_mul_ps(_mm_loadu_ps(src +  8), p);
+    __m128 a3 = _mm_mul_ps(_mm_loadu_ps(src + 12), p);
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+
+    // a3 is all zeroes now (w is masked off in p)
+    mask = _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(_mm_add_ps(a0, a1),
+						   _mm_add_ps(a2, d)), zero));
+    if(mask & 1) dst[i + 0] |= bit;
+    if(mask & 2) dst[i + 1] |= bit;
+    if(mask & 4) dst[i + 2] |= bit;
+    if(mask & 8) dst[i + 3] |= bit;
+  }
+
+  for(; i < num; i++, src += 4)
+    if(glw_vec34_dot(_mm_loadu_ps(src), plane) < 0)
+      dst[i] |= bit;
+}
@@ -150,6 +150,12 @@ glw_mtx_copy(Mtx dst, const Mtx src)
 
 extern int glw_mtx_invert(Mtx dst, const Mtx src);
 
+extern void glw_mtx_mul_vec4_batch(float *dst, const Mtx m, const float *src,
+				   int num, int stride);
+
+extern void glw_plane_classify_batch(uint8_t *dst, const float *src, int num,
+				     const Vec4 plane, int bit);
+
 #define glw_vec3_extract(a, pos) __builtin_ia32_vec_ext_v4sf(a, pos)
 
 #define glw_vec4_extract(a, pos) __builtin_ia32_vec_ext_v4sf(a, pos)
@@ -0,0 +1,150 @@
+/*
+ *  GL Widgets, Null backend
+ *  Copyright (C) 2012 Andreas Öman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glw.h"
+#include "glw_video_common.h"
+
+
+/**
+ *
+ */
+void
+glw_wirebox(glw_root_t *gr, const glw_rctx_t *rc)
+{
+}
+
+
+/**
+ *
+ */
+void
+glw_wirecube(glw_root_t *gr, const glw_rctx_t *rc)
+{
+}
+
+
+/**
+ * Vertices are already transformed/clipped (if needed) by the
+ * renderer so all there is left to do is to account for them
+ */
+static void
+null_render(struct glw_root *gr,
+	    const Mtx m,
+	    const struct glw_backend_texture *t0,
+	    const struct glw_backend_texture *t1,
+	    const struct glw_rgb *rgb_mul,
+	    const struct glw_rgb *rgb_off,
+	    float alpha, float blur,
+	    const float *vertices,
+	    int num_vertices,
+	    const uint16_t *indices,
+	    int num_triangles,
+	    int flags)
+{
+  glw_backend_root_t *gbr = &gr->gr_be;
+
+  gbr->gbr_render_calls++;
+  gbr->gbr_vertices += num_vertices;
+  gbr->gbr_triangles += indices ? num_triangles : num_vertices / 3;
+}
+
+
+/**
+ * No hardware clippers so glw_renderer will clip in software,
+ * same as the shader based OpenGL backend
+ */
+int
+glw_null_init_context(glw_root_t *gr)
+{
+  gr->gr_normalized_texture_coords = 1;
+  gr->gr_render = null_render;
+  return 0;
+}
+
+
+/**
+ *
+ */
+void
+glw_rtt_init(glw_root_t *gr, glw_rtt_t *grtt, int width, int height,
+	     int alpha)
+{
+  grtt->grtt_width  = width;
+  grtt->grtt_height = height;
+  grtt->grtt_texture.width  = width;
+  grtt->grtt_texture.height = height;
+  grtt->grtt_texture.inited = 1;
+}
+
+
+/**
+ *
+ */
+void
+glw_rtt_enter(glw_root_t *gr, glw_rtt_t *grtt, glw_rctx_t *rc)
+{
+  glw_rctx_init(rc, grtt->grtt_width, grtt->grtt_height, 0);
+}
+
+
+/**
+ *
+ */
+void
+glw_rtt_restore(glw_root_t *gr, glw_rtt_t *grtt)
+{
+}
+
+
+/**
+ *
+ */
+void
+glw_rtt_destroy(glw_root_t *gr, glw_rtt_t *grtt)
+{
+  grtt->grtt_texture.inited = 0;
+}
+
+
+/**
+ *
+ */
+void
+glw_blendmode(struct glw_root *gr, int mode)
+{
+}
+
+
+/**
+ *
+ */
+void
+glw_frontface(struct glw_root *gr, int how)
+{
+}
+
+
+/**
+ * There is nowhere to display video so decoded frames are just dropped
+ */
+void
+glw_video_input_yuvp(glw_video_t *gv,
+		     uint8_t * const data[], const int pitch[],
+		     const frame_info_t *fi)
+{
+}
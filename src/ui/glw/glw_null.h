@@ -0,0 +1,90 @@
+/*
+ *  GL Widgets, Null backend
+ *  Copyright (C) 2012 Andreas Öman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * The null backend does everything the other backends do except
+ * talking to a GPU. Clipping, stenciling and fading are done in software
+ * so all the tesselation work is still there. Used for headless
+ * operation and benchmarking.
+ */
+
+struct glw_rctx;
+struct glw_root;
+
+
+/**
+ *
+ */
+typedef struct glw_backend_root {
+
+  // Statistics, reset by whoever consumes them
+  int gbr_render_calls;
+  int gbr_vertices;
+  int gbr_triangles;
+  int gbr_uploads;
+  int64_t gbr_upload_bytes;
+
+} glw_backend_root_t;
+
+
+/**
+ *
+ */
+typedef struct glw_backend_texture {
+  uint16_t width;
+  uint16_t height;
+  char type;
+#define GLW_TEXTURE_TYPE_NORMAL   0
+#define GLW_TEXTURE_TYPE_NO_ALPHA 1
+  char inited;
+} glw_backend_texture_t;
+
+#define glw_tex_width(gbt) ((gbt)->width)
+#define glw_tex_height(gbt) ((gbt)->height)
+
+#define glw_can_tnpo2(gr) 1
+
+#define glw_is_tex_inited(n) ((n)->inited)
+
+int glw_null_init_context(struct glw_root *gr);
+
+
+/**
+ * Render to texture support
+ */
+typedef struct {
+
+  glw_backend_texture_t grtt_texture;
+
+  int grtt_width;
+  int grtt_height;
+
+} glw_rtt_t;
+
+void glw_rtt_init(struct glw_root *gr, glw_rtt_t *grtt, int width, int height,
+		  int alpha);
+
+void glw_rtt_enter(struct glw_root *gr, glw_rtt_t *grtt, struct glw_rctx *rc0);
+
+void glw_rtt_restore(struct glw_root *gr, glw_rtt_t *grtt);
+
+void glw_rtt_destroy(struct glw_root *gr, glw_rtt_t *grtt);
+
+#define glw_rtt_texture(grtt) ((grtt)->grtt_texture)
@@ -190,18 +190,35 @@ glw_renderer_vtx_col(glw_renderer_t *gr, int vertex,
 }
 
 
+/**
+ * Reserve 'num' vertices at the end of the cache's vertex array
+ */
+static float *
+grc_alloc_vertices(glw_root_t *gr, glw_renderer_cache_t *grc, int num)
+{
+  float *f;
+
+  if(gr->gr_vtmp_cur + num > grc->grc_capacity) {
+    grc->grc_capacity = (gr->gr_vtmp_cur + num) * 2;
+    grc->grc_vertices = realloc(grc->grc_vertices, grc->grc_capacity *
+				sizeof(float) * VERTEX_SIZE);
+  }
+  f = grc->grc_vertices + gr->gr_vtmp_cur * VERTEX_SIZE;
+  gr->gr_vtmp_cur += num;
+  return f;
+}
+
+
 /**
  *
  */
 static void
-emit_triangle(glw_root_t *gr,
+emit_triangle(glw_root_t *gr, glw_renderer_cache_t *grc,
 	      const Vec4 V1, const Vec4 V2, const Vec4 V3,
 	      const Vec4 C1, const Vec4 C2, const Vec4 C3,
 	      const Vec4 T1, const Vec4 T2, const Vec4 T3)
 {
-  glw_vtmp_resize(gr, (gr->gr_vtmp_cur + 3) * VERTEX_SIZE + 4);
-
-  float *f = gr->gr_vtmp_buffer + gr->gr_vtmp_cur * VERTEX_SIZE;
+  float *f = grc_alloc_vertices(gr, grc, 3);
 
   glw_vec4_store(f,   V1);
   glw_vec4_store(f+4, C1);
@@ -214,8 +231,29 @@ emit_triangle(glw_root_t *gr,
   glw_vec4_store(f+VERTEX_SIZE*2,   V3);
   glw_vec4_store(f+VERTEX_SIZE*2+4, C3);
   glw_vec4_store(f+VERTEX_SIZE*2+8, T3);
+}
+
 
-  gr->gr_vtmp_cur += 3;
+/**
+ * Emit a triangle that needs no clipping, stenciling or fading.
+ * Position comes from the transformed vertex, the rest is copied
+ * straight from the source vertex
+ */
+static void
+emit_triangle_direct(glw_root_t *gr, glw_renderer_cache_t *grc,
+		     const float *P1, const float *P2, const float *P3,
+		     const float *A1, const float *A2, const float *A3)
+{
+  float *f = grc_alloc_vertices(gr, grc, 3);
+
+  memcpy(f,     P1,     sizeof(float) * 4);
+  memcpy(f + 4, A1 + 4, sizeof(float) * 8);
+  f += VERTEX_SIZE;
+  memcpy(f,     P2,     sizeof(float) * 4);
+  memcpy(f + 4, A2 + 4, sizeof(float) * 8);
+  f += VERTEX_SIZE;
+  memcpy(f,     P3,     sizeof(float) * 4);
+  memcpy(f + 4, A3 + 4, sizeof(float) * 8);
 }
 
 
@@ -276,7 +314,7 @@ fader(glw_root_t *gr, glw_renderer_cache_t *grc,
       }
     }
   }
-  emit_triangle(gr, v1, v2, v3, c1, c2, c3, T1, T2, T3);
+  emit_triangle(gr, grc, v1, v2, v3, c1, c2, c3, T1, T2, T3);
 }
 
 #include "misc/sha.h"
@@ -724,17 +762,23 @@ stenciler(glw_root_t *gr, glw_renderer_cache_t *grc,
 
 
 /**
- *
+ * Each vertex is transformed and classified against the active clip
+ * planes exactly once. Triangles entirely outside a plane are dropped,
+ * triangles entirely inside all planes are written straight into the
+ * cache (unless they need stenciling or fading). Only triangles that
+ * straddle a plane take the recursive clipper path.
  */
 static void
 glw_renderer_tesselate(glw_renderer_t *gr, glw_root_t *root,
 		       const glw_rctx_t *rc, glw_renderer_cache_t *grc)
 {
   int i;
-  uint16_t *ip = gr->gr_indices;
+  const uint16_t *ip = gr->gr_indices;
   const float *a = gr->gr_vertices;
-  PMtx pmtx;
-  
+  const int nv = gr->gr_num_vertices;
+  float *tv;
+  uint8_t *oc;
+
   root->gr_vtmp_cur = 0;
 
   memcpy(grc->grc_mtx, rc->rc_mtx, sizeof(Mtx));
@@ -768,39 +812,71 @@ glw_renderer_tesselate(glw_renderer_t *gr, glw_root_t *root,
       grc->grc_fader_blur[i] = root->gr_fader_blur[i];
     }
 
-  glw_pmtx_mul_prepare(pmtx, rc->rc_mtx);
+  const int slow = grc->grc_stencil_width || grc->grc_active_faders;
 
-  for(i = 0; i < gr->gr_num_triangles; i++) {
-    int v1 = *ip++;
-    int v2 = *ip++;
-    int v3 = *ip++;
-
-    Vec4 V1, V2, V3;
-
-    glw_pmtx_mul_vec4_i(V1, pmtx, glw_vec4_get(a + v1*VERTEX_SIZE));
-    glw_pmtx_mul_vec4_i(V2, pmtx, glw_vec4_get(a + v2*VERTEX_SIZE));
-    glw_pmtx_mul_vec4_i(V3, pmtx, glw_vec4_get(a + v3*VERTEX_SIZE));
-
-    stenciler(root, grc,
-	      V1, V2, V3,
-	      glw_vec4_get(a + v1 * VERTEX_SIZE + 4),
-	      glw_vec4_get(a + v2 * VERTEX_SIZE + 4),
-	      glw_vec4_get(a + v3 * VERTEX_SIZE + 4),
-	      glw_vec4_get(a + v1 * VERTEX_SIZE + 8),
-	      glw_vec4_get(a + v2 * VERTEX_SIZE + 8),
-	      glw_vec4_get(a + v3 * VERTEX_SIZE + 8),
-	      0);
+  // Transformed positions (packed Vec4) followed by one outcode per vertex
+  glw_vtmp_resize(root, nv * 4 + (nv + sizeof(float) - 1) / sizeof(float));
+  tv = root->gr_vtmp_buffer;
+  oc = (uint8_t *)(tv + nv * 4);
+
+  glw_mtx_mul_vec4_batch(tv, rc->rc_mtx, a, nv, VERTEX_SIZE);
+
+  memset(oc, 0, nv);
+  for(i = 0; i < NUM_CLIPPLANES; i++)
+    if(grc->grc_active_clippers & (1 << i))
+      glw_plane_classify_batch(oc, tv, nv, grc->grc_clip[i], 1 << i);
+
+  if(gr->gr_num_triangles * 3 > grc->grc_capacity) {
+    grc->grc_capacity = gr->gr_num_triangles * 3;
+    grc->grc_vertices = realloc(grc->grc_vertices, grc->grc_capacity *
+				sizeof(float) * VERTEX_SIZE);
   }
 
-  int size = root->gr_vtmp_cur * sizeof(float) * VERTEX_SIZE;
+  for(i = 0; i < gr->gr_num_triangles; i++) {
+    const int v1 = *ip++;
+    const int v2 = *ip++;
+    const int v3 = *ip++;
+
+    if(oc[v1] & oc[v2] & oc[v3])
+      continue; // All vertices outside the same plane
+
+    const float *P1 = tv + v1 * 4;
+    const float *P2 = tv + v2 * 4;
+    const float *P3 = tv + v3 * 4;
+
+    const float *A1 = a + v1 * VERTEX_SIZE;
+    const float *A2 = a + v2 * VERTEX_SIZE;
+    const float *A3 = a + v3 * VERTEX_SIZE;
+
+    const int clip = oc[v1] | oc[v2] | oc[v3];
 
-  if(root->gr_vtmp_cur != grc->grc_num_vertices) {
-    grc->grc_num_vertices = root->gr_vtmp_cur;
-    grc->grc_vertices = realloc(grc->grc_vertices, size);
+    if(!clip && !slow) {
+      emit_triangle_direct(root, grc, P1, P2, P3, A1, A2, A3);
+      continue;
+    }
+
+    if(grc->grc_stencil_width) {
+      stenciler(root, grc,
+		glw_vec4_get(P1), glw_vec4_get(P2), glw_vec4_get(P3),
+		glw_vec4_get(A1 + 4), glw_vec4_get(A2 + 4), glw_vec4_get(A3 + 4),
+		glw_vec4_get(A1 + 8), glw_vec4_get(A2 + 8), glw_vec4_get(A3 + 8),
+		0);
+    } else if(clip) {
+      clipper(root, grc,
+	      glw_vec4_get(P1), glw_vec4_get(P2), glw_vec4_get(P3),
+	      glw_vec4_get(A1 + 4), glw_vec4_get(A2 + 4), glw_vec4_get(A3 + 4),
+	      glw_vec4_get(A1 + 8), glw_vec4_get(A2 + 8), glw_vec4_get(A3 + 8),
+	      __builtin_ctz(clip)); // Skip planes the triangle is inside of
+    } else {
+      fader(root, grc,
+	    glw_vec4_get(P1), glw_vec4_get(P2), glw_vec4_get(P3),
+	    glw_vec4_get(A1 + 4), glw_vec4_get(A2 + 4), glw_vec4_get(A3 + 4),
+	    glw_vec4_get(A1 + 8), glw_vec4_get(A2 + 8), glw_vec4_get(A3 + 8),
+	    0);
+    }
   }
 
-  if(size)
-    memcpy(grc->grc_vertices, root->gr_vtmp_buffer, size);
+  grc->grc_num_vertices = root->gr_vtmp_cur;
 }
 
 
@@ -917,7 +993,14 @@ glw_renderer_draw(glw_renderer_t *gr, glw_root_t *root,
        glw_renderer_clippers_cmp(grc, root) ||
        glw_renderer_stencilers_cmp(grc, root) ||
        glw_renderer_faders_cmp(grc, root)) {
-      glw_renderer_tesselate(gr, root, rc, grc);
+      if(root->gr_profile) {
+	int64_t ts = showtime_get_ts();
+	glw_renderer_tesselate(gr, root, rc, grc);
+	root->gr_profile_tesselate += showtime_get_ts() - ts;
+	root->gr_profile_tesselations++;
+      } else {
+	glw_renderer_tesselate(gr, root, rc, grc);
+      }
     }
 
     if(grc->grc_blurred)
@@ -1106,3 +1189,158 @@ glw_fader_disable(glw_root_t *gr, int which)
   gr->gr_active_faders &= ~(1 << which);
 }
 
+
+
+/**
+ * Benchmark
+ */
+static int bench_vertices;
+
+static void
+bench_render(struct glw_root *gr,
+	     const Mtx m,
+	     const struct glw_backend_texture *t0,
+	     const struct glw_backend_texture *t1,
+	     const struct glw_rgb *rgb_mul,
+	     const struct glw_rgb *rgb_off,
+	     float alpha, float blur,
+	     const float *vertices,
+	     int num_vertices,
+	     const uint16_t *indices,
+	     int num_triangles,
+	     int flags)
+{
+  bench_vertices += num_vertices;
+}
+
+
+/**
+ * Build 'quads' textured quads side by side across the widget,
+ * like a label rendered from the glyph atlas
+ */
+static void
+bench_init_quads(glw_renderer_t *r, int quads)
+{
+  int i;
+  const float w = 2.0f / quads;
+
+  glw_renderer_init(r, quads * 4, quads * 2, NULL);
+
+  for(i = 0; i < quads; i++) {
+    const float x = -1 + i * w;
+    const int v = i * 4;
+
+    glw_renderer_vtx_pos(r, v + 0, x,     -1, 0);
+    glw_renderer_vtx_pos(r, v + 1, x + w, -1, 0);
+    glw_renderer_vtx_pos(r, v + 2, x + w,  1, 0);
+    glw_renderer_vtx_pos(r, v + 3, x,      1, 0);
+
+    glw_renderer_vtx_st(r, v + 0, 0, 1);
+    glw_renderer_vtx_st(r, v + 1, 1, 1);
+    glw_renderer_vtx_st(r, v + 2, 1, 0);
+    glw_renderer_vtx_st(r, v + 3, 0, 0);
+
+    glw_renderer_triangle(r, i * 2 + 0, v, v + 1, v + 2);
+    glw_renderer_triangle(r, i * 2 + 1, v, v + 2, v + 3);
+  }
+}
+
+
+/**
+ * Scroll a list of textured items (a background quad plus a label
+ * made of glyph quads) through a software clipped viewport. The
+ * modelview changes every frame so every visible item is tesselated
+ * again, which is what happens while a list is scrolling
+ */
+int
+glw_renderer_bench(void)
+{
+  static const float top_plane[4]    = {0, -1, 0, 1};
+  static const float bottom_plane[4] = {0,  1, 0, 1};
+  static const char *modes[] = {"Clipped", "Clipped+faded"};
+  const int items = 100;
+  const int visible = 12;
+  const int glyphs = 24;
+  const int frames = 1000;
+  const float h = 2.0f / visible;
+  glw_root_t *root = calloc(1, sizeof(glw_root_t));
+  glw_renderer_t *bg    = calloc(items, sizeof(glw_renderer_t));
+  glw_renderer_t *label = calloc(items, sizeof(glw_renderer_t));
+  glw_rctx_t rc0, rc;
+  int mode, f, i, ct, cb, ft, fb, drawn;
+
+  root->gr_render = bench_render;
+  root->gr_profile = 1;
+
+  for(i = 0; i < items; i++) {
+    bench_init_quads(&bg[i], 1);
+    bench_init_quads(&label[i], glyphs);
+  }
+
+  glw_rctx_init(&rc0, 1280, 720, 0);
+
+  for(mode = 0; mode < 2; mode++) {
+    root->gr_profile_tesselate = 0;
+    root->gr_profile_tesselations = 0;
+    bench_vertices = 0;
+    drawn = 0;
+
+    int64_t ts = showtime_get_ts();
+
+    for(f = 0; f < frames; f++) {
+      const float scroll = fmodf(f * 0.013f, (items - visible) * h);
+
+      root->gr_frames = f;
+
+      ct = glw_clip_enable(root, &rc0, GLW_CLIP_TOP, 0);
+      cb = glw_clip_enable(root, &rc0, GLW_CLIP_BOTTOM, 0);
+      ft = fb = -1;
+      if(mode == 1) {
+	ft = glw_fader_enable(root, &rc0, top_plane, 0.1, 0);
+	fb = glw_fader_enable(root, &rc0, bottom_plane, 0.1, 0);
+      }
+
+      for(i = 0; i < items; i++) {
+	const float y = 1 - h / 2 - i * h + scroll;
+
+	if(y - h / 2 > 1 || y + h / 2 < -1)
+	  continue;
+
+	rc = rc0;
+	glw_Translatef(&rc, 0, y, 0);
+	glw_Scalef(&rc, 1, h / 2, 1);
+	glw_renderer_draw(&bg[i], root, &rc, NULL, NULL, NULL, 1, 0);
+
+	glw_Scalef(&rc, 0.9, 0.5, 1);
+	glw_renderer_draw(&label[i], root, &rc, NULL, NULL, NULL, 1, 0);
+	drawn++;
+      }
+
+      glw_fader_disable(root, fb);
+      glw_fader_disable(root, ft);
+      glw_clip_disable(root, cb);
+      glw_clip_disable(root, ct);
+    }
+
+    ts = showtime_get_ts() - ts;
+
+    TRACE(TRACE_INFO, "bench",
+	  "%s: %d frames, %.1f items/frame, %.3f ms/frame, "
+	  "tesselate %.3f ms/frame, %d tesselations, %.1f vertices/frame",
+	  modes[mode], frames, (float)drawn / frames,
+	  ts / 1000.0 / frames,
+	  root->gr_profile_tesselate / 1000.0 / frames,
+	  root->gr_profile_tesselations,
+	  (float)bench_vertices / frames);
+  }
+
+  for(i = 0; i < items; i++) {
+    glw_renderer_free(&bg[i]);
+    glw_renderer_free(&label[i]);
+  }
+  free(bg);
+  free(label);
+  free(root->gr_vtmp_buffer);
+  free(root);
+  return 0;
+}
@@ -61,6 +61,7 @@ typedef struct glw_renderer_cache {
 
   float *grc_vertices;
   uint16_t grc_num_vertices;
+  int grc_capacity; // Number of vertices allocated in grc_vertices
 } glw_renderer_cache_t;
 
 /**
@@ -124,3 +125,5 @@ void glw_renderer_draw(glw_renderer_t *gr, glw_root_t *root,
 		       float alpha, float blur);
 
 void glw_vtmp_resize(glw_root_t *gr, int num_float);
+
+int glw_renderer_bench(void);
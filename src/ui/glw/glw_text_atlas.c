@@ -0,0 +1,271 @@
+/*
+ *  GL Widgets, Shared glyph atlas
+ *  Copyright (C) 2012 Andreas Öman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "glw.h"
+#include "glw_texture.h"
+#include "glw_text_bitmap.h"
+
+/**
+ * Glyph bitmaps (as produced by text_render() with TR_RENDER_GLYPH_RUN)
+ * are packed into shelves of a single I8A8 texture. Entries are keyed
+ * on the glyph pixmap pointer; the atlas holds a reference so the
+ * pointer can not be reused while it's in here.
+ *
+ * When the atlas is full everything is thrown out and gta_generation
+ * is bumped. Users must check the generation and relayout if it differs
+ * from the one their texture coordinates were computed for. To avoid
+ * thrashing when a single frame needs more glyphs than fit, the atlas
+ * is reset at most once per frame; further misses in that frame fail.
+ *
+ * Only the band of rows touched since the last upload is sent to
+ * the texture.
+ */
+
+#define GTA_HASH_SIZE 256
+#define GTA_GUTTER    1  // Keep linear filtering from bleeding between glyphs
+
+typedef struct glw_text_atlas_entry {
+  LIST_ENTRY(glw_text_atlas_entry) gtae_link;
+  pixmap_t *gtae_pm;
+  int16_t gtae_x;
+  int16_t gtae_y;
+} glw_text_atlas_entry_t;
+
+
+/**
+ *
+ */
+static unsigned int
+gta_hash(const pixmap_t *pm)
+{
+  return ((intptr_t)pm >> 4) % GTA_HASH_SIZE;
+}
+
+
+/**
+ *
+ */
+static void
+gta_mark_dirty(glw_text_atlas_t *gta, int y0, int y1)
+{
+  if(gta->gta_dirty_y1 <= gta->gta_dirty_y0) {
+    gta->gta_dirty_y0 = y0;
+    gta->gta_dirty_y1 = y1;
+  } else {
+    gta->gta_dirty_y0 = MIN(gta->gta_dirty_y0, y0);
+    gta->gta_dirty_y1 = MAX(gta->gta_dirty_y1, y1);
+  }
+}
+
+
+/**
+ *
+ */
+glw_text_atlas_t *
+glw_text_atlas_create(int size)
+{
+  glw_text_atlas_t *gta = calloc(1, sizeof(glw_text_atlas_t));
+
+  gta->gta_pm = pixmap_create(size, size, PIXMAP_IA, 1);
+  if(gta->gta_pm == NULL) {
+    free(gta);
+    return NULL;
+  }
+  gta->gta_size = size;
+  gta->gta_hash = calloc(GTA_HASH_SIZE,
+			  sizeof(struct glw_text_atlas_entry_list));
+  gta->gta_reset_frame = -1;
+  gta_mark_dirty(gta, 0, size);
+  return gta;
+}
+
+
+/**
+ *
+ */
+static void
+gta_clear(glw_text_atlas_t *gta)
+{
+  glw_text_atlas_entry_t *gtae;
+  int i;
+
+  for(i = 0; i < GTA_HASH_SIZE; i++) {
+    while((gtae = LIST_FIRST(&gta->gta_hash[i])) != NULL) {
+      LIST_REMOVE(gtae, gtae_link);
+      pixmap_release(gtae->gtae_pm);
+      free(gtae);
+    }
+  }
+  gta->gta_entries = 0;
+  gta->gta_shelf_x = 0;
+  gta->gta_shelf_y = 0;
+  gta->gta_shelf_h = 0;
+}
+
+
+/**
+ *
+ */
+void
+glw_text_atlas_destroy(glw_root_t *gr, glw_text_atlas_t *gta)
+{
+  gta_clear(gta);
+  if(gr != NULL)
+    glw_tex_destroy(gr, &gta->gta_texture);
+  pixmap_release(gta->gta_pm);
+  free(gta->gta_hash);
+  free(gta);
+}
+
+
+/**
+ *
+ */
+static void
+gta_reset(glw_text_atlas_t *gta, int frame)
+{
+  int used = MIN(gta->gta_shelf_y + gta->gta_shelf_h, gta->gta_size);
+
+  gta_clear(gta);
+  // Only rows that were handed out can be non-zero
+  memset(gta->gta_pm->pm_pixels, 0, gta->gta_pm->pm_linesize * used);
+  gta_mark_dirty(gta, 0, used);
+  gta->gta_generation++;
+  gta->gta_resets++;
+  gta->gta_reset_frame = frame;
+}
+
+
+/**
+ * Find room for a w * h rectangle, returns -1 if full
+ */
+static int
+gta_alloc(glw_text_atlas_t *gta, int w, int h, int *xp, int *yp)
+{
+  if(gta->gta_shelf_x + w > gta->gta_size) {
+    gta->gta_shelf_y += gta->gta_shelf_h + GTA_GUTTER;
+    gta->gta_shelf_x = 0;
+    gta->gta_shelf_h = 0;
+  }
+
+  if(gta->gta_shelf_y + h > gta->gta_size)
+    return -1;
+
+  *xp = gta->gta_shelf_x;
+  *yp = gta->gta_shelf_y;
+  gta->gta_shelf_x += w + GTA_GUTTER;
+  gta->gta_shelf_h = MAX(gta->gta_shelf_h, h);
+  return 0;
+}
+
+
+/**
+ * Copy coverage into the atlas. Intensity is always white, the
+ * glyph color comes from the vertex colors
+ */
+static void
+gta_copy(glw_text_atlas_t *gta, const pixmap_t *src, int x, int y)
+{
+  const pixmap_t *dst = gta->gta_pm;
+  int i, j;
+
+  for(i = 0; i < src->pm_height; i++) {
+    const uint8_t *s = src->pm_pixels + i * src->pm_linesize;
+    uint8_t *d = dst->pm_pixels + (y + i) * dst->pm_linesize + x * 2;
+    for(j = 0; j < src->pm_width; j++) {
+      *d++ = 0xff;
+      *d++ = *s++;
+    }
+  }
+}
+
+
+/**
+ * Get position of glyph bitmap in the atlas, adding it if needed.
+ * May reset the atlas (bumping gta_generation) to make room.
+ *
+ * Returns -1 if the bitmap can never fit and 1 if the atlas is full
+ * and has already been reset during 'frame'
+ */
+int
+glw_text_atlas_add(glw_text_atlas_t *gta, pixmap_t *pm, int frame,
+		   int *xp, int *yp)
+{
+  glw_text_atlas_entry_t *gtae;
+  unsigned int h = gta_hash(pm);
+  int x, y;
+
+  LIST_FOREACH(gtae, &gta->gta_hash[h], gtae_link)
+    if(gtae->gtae_pm == pm)
+      break;
+
+  if(gtae != NULL) {
+    gta->gta_hits++;
+    *xp = gtae->gtae_x;
+    *yp = gtae->gtae_y;
+    return 0;
+  }
+
+  if(pm->pm_type != PIXMAP_I ||
+     pm->pm_width > gta->gta_size || pm->pm_height > gta->gta_size)
+    return -1;
+
+  if(gta_alloc(gta, pm->pm_width, pm->pm_height, &x, &y)) {
+    if(gta->gta_reset_frame == frame)
+      return 1;
+    gta_reset(gta, frame);
+    if(gta_alloc(gta, pm->pm_width, pm->pm_height, &x, &y))
+      return -1;
+  }
+
+  gta_copy(gta, pm, x, y);
+  gta_mark_dirty(gta, y, y + pm->pm_height);
+  gta->gta_misses++;
+
+  gtae = malloc(sizeof(glw_text_atlas_entry_t));
+  gtae->gtae_pm = pixmap_dup(pm);
+  gtae->gtae_x = x;
+  gtae->gtae_y = y;
+  LIST_INSERT_HEAD(&gta->gta_hash[h], gtae, gtae_link);
+  gta->gta_entries++;
+
+  *xp = x;
+  *yp = y;
+  return 0;
+}
+
+
+/**
+ * Upload atlas to texture if it has changed. Called once per frame
+ * from the render pass, after all labels have been laid out
+ */
+void
+glw_text_atlas_upload(glw_root_t *gr, glw_text_atlas_t *gta)
+{
+  if(gta->gta_dirty_y1 <= gta->gta_dirty_y0)
+    return;
+
+  glw_tex_upload_rows(gr, &gta->gta_texture, gta->gta_pm->pm_pixels,
+		      GLW_TEXTURE_FORMAT_I8A8, gta->gta_size, gta->gta_size,
+		      gta->gta_dirty_y0, gta->gta_dirty_y1);
+  gta->gta_dirty_y0 = gta->gta_dirty_y1 = 0;
+  gta->gta_uploads++;
+}
@@ -56,7 +56,12 @@ typedef struct glw_text_bitmap {
   glw_renderer_t gtb_text_renderer;
   glw_renderer_t gtb_cursor_renderer;
 
+  glw_renderer_t gtb_glyph_renderer;  // Used when pixmap is a glyph run
+  int gtb_glyph_quads;
+  int gtb_atlas_generation;
+
   TAILQ_ENTRY(glw_text_bitmap) gtb_workq_link;
+  int64_t gtb_queued_at;
   LIST_ENTRY(glw_text_bitmap) gtb_global_link;
 
   pixmap_t *gtb_pixmap;
@@ -78,6 +83,7 @@ typedef struct glw_text_bitmap {
   uint8_t gtb_paint_cursor;
   uint8_t gtb_update_cursor;
   uint8_t gtb_need_layout;
+  uint8_t gtb_atlas_partial;  // Atlas ran out of room, retry next frame
   uint8_t gtb_deferred_realize;
 
   int16_t gtb_edit_ptr;
@@ -114,6 +120,222 @@ static void gtb_realize(glw_text_bitmap_t *gtb);
 static glw_class_t glw_text, glw_label;
 
 
+/**
+ * Where the text goes inside the widget
+ */
+typedef struct gtb_box {
+  int left, top, right, bottom;
+  int text_width, text_height;  // Possibly cut
+} gtb_box_t;
+
+
+/**
+ * Returns 1 if text is too wide and had to be cut
+ */
+static int
+gtb_text_box(glw_text_bitmap_t *gtb, const glw_rctx_t *rc, const pixmap_t *pm,
+	     gtb_box_t *b)
+{
+  int oversized = 0;
+
+  b->left   =                 gtb->gtb_padding_left   - pm->pm_margin;
+  b->top    = rc->rc_height - gtb->gtb_padding_top    + pm->pm_margin;
+  b->right  = rc->rc_width  - gtb->gtb_padding_right  + pm->pm_margin;
+  b->bottom =                 gtb->gtb_padding_bottom - pm->pm_margin;
+    
+  b->text_width  = pm->pm_width;
+  b->text_height = pm->pm_height;
+
+  // Horizontal 
+  if(b->text_width > b->right - b->left) {
+    // Oversized, must cut
+    b->text_width = b->right - b->left;
+    oversized = 1;
+  } else { 
+
+    switch(gtb->w.glw_alignment) {
+    case LAYOUT_ALIGN_JUSTIFIED:
+    case LAYOUT_ALIGN_CENTER:
+    case LAYOUT_ALIGN_BOTTOM:
+    case LAYOUT_ALIGN_TOP:
+      b->left = (b->left + b->right - b->text_width) / 2;
+      b->right = b->left + b->text_width;
+      break;
+
+    case LAYOUT_ALIGN_LEFT:
+    case LAYOUT_ALIGN_TOP_LEFT:
+    case LAYOUT_ALIGN_BOTTOM_LEFT:
+      b->right = b->left + pm->pm_width;
+      break;
+
+    case LAYOUT_ALIGN_RIGHT:
+    case LAYOUT_ALIGN_TOP_RIGHT:
+    case LAYOUT_ALIGN_BOTTOM_RIGHT:
+      b->left = b->right - pm->pm_width;
+      break;
+    }
+  }
+
+  // Vertical 
+  if(b->text_height > b->top - b->bottom) {
+    // Oversized, must cut
+    b->text_height = b->top - b->bottom;
+  } else { 
+    switch(gtb->w.glw_alignment) {
+    case LAYOUT_ALIGN_CENTER:
+    case LAYOUT_ALIGN_LEFT:
+    case LAYOUT_ALIGN_RIGHT:
+      b->bottom = (b->bottom + b->top - b->text_height) / 2;
+      b->top = b->bottom + b->text_height;
+      break;
+
+    case LAYOUT_ALIGN_TOP_LEFT:
+    case LAYOUT_ALIGN_TOP_RIGHT:
+    case LAYOUT_ALIGN_TOP:
+    case LAYOUT_ALIGN_JUSTIFIED:
+      b->bottom = b->top - pm->pm_height;
+      break;
+
+    case LAYOUT_ALIGN_BOTTOM:
+    case LAYOUT_ALIGN_BOTTOM_LEFT:
+    case LAYOUT_ALIGN_BOTTOM_RIGHT:
+      b->top = b->bottom + pm->pm_height;
+      break;
+    }
+  }
+  return oversized;
+}
+
+
+/**
+ * Build one textured quad per glyph, all referring to the shared atlas
+ */
+static void
+gtb_layout_glyphs(glw_text_bitmap_t *gtb, glw_root_t *gr,
+		  const glw_rctx_t *rc)
+{
+  const pixmap_t *pm = gtb->gtb_pixmap;
+  glw_renderer_t *r = &gtb->gtb_glyph_renderer;
+  glw_text_atlas_t *gta = gr->gr_text_atlas;
+  gtb_box_t b;
+  int i, n, x, y, generation, retry = 0, oversized, xmax, ymin;
+
+  oversized = gtb_text_box(gtb, rc, pm, &b);
+  xmax = b.left + b.text_width;
+  ymin = b.top - b.text_height;
+  gtb->gtb_atlas_partial = 0;
+
+  if(pm->pm_numglyphs == 0) {
+    glw_renderer_free(r);
+    gtb->gtb_glyph_quads = 0;
+    gtb->gtb_atlas_generation = gta->gta_generation;
+    return;
+  }
+
+  if(gtb->gtb_glyph_quads != pm->pm_numglyphs) {
+    glw_renderer_free(r);
+    glw_renderer_init(r, pm->pm_numglyphs * 4, pm->pm_numglyphs * 2, NULL);
+    gtb->gtb_glyph_quads = pm->pm_numglyphs;
+  }
+
+ again:
+  generation = gta->gta_generation;
+  n = 0;
+
+  for(i = 0; i < pm->pm_numglyphs; i++) {
+    const pixmap_glyph_t *pg = &pm->pm_glyphs[i];
+    const uint32_t c = pg->pg_color;
+    float x1, y1, x2, y2, s1, t1, s2, t2, a1 = 1, a2 = 1;
+
+    int left   = b.left + pg->pg_x;
+    int right  = left + pg->pg_pm->pm_width;
+    int top    = b.top - pg->pg_y;
+    int bottom = top - pg->pg_pm->pm_height;
+
+    if(left >= xmax || top <= ymin)
+      continue; // Cut
+
+    switch(glw_text_atlas_add(gta, pg->pg_pm, gr->gr_frames, &x, &y)) {
+    case 0:
+      break;
+    case 1:
+      gtb->gtb_atlas_partial = 1;
+      continue;
+    default:
+      continue;
+    }
+
+    if(gta->gta_generation != generation) {
+      // Atlas was flushed, previous texture coordinates are invalid
+      if(retry++)
+	break;
+      goto again;
+    }
+
+    s1 = x;
+    t1 = y;
+    s2 = x + pg->pg_pm->pm_width;
+    t2 = y + pg->pg_pm->pm_height;
+
+    // Crop glyphs that straddle the edge of the box
+    if(right > xmax) {
+      s2 -= right - xmax;
+      right = xmax;
+    }
+    if(bottom < ymin) {
+      t2 -= ymin - bottom;
+      bottom = ymin;
+    }
+
+    if(oversized) {
+      // Fade out towards the right edge, same as the pixmap path
+      a1 = MIN((1 + b.text_width / 20) *
+	       (xmax - left) / (float)b.text_width, 1.0f);
+      a2 = MIN((1 + b.text_width / 20) *
+	       (xmax - right) / (float)b.text_width, 1.0f);
+    }
+
+    x1 = -1.0f + 2.0f * left   / (float)rc->rc_width;
+    y1 = -1.0f + 2.0f * bottom / (float)rc->rc_height;
+    x2 = -1.0f + 2.0f * right  / (float)rc->rc_width;
+    y2 = -1.0f + 2.0f * top    / (float)rc->rc_height;
+
+    if(gr->gr_normalized_texture_coords) {
+      s1 /= gta->gta_size;
+      t1 /= gta->gta_size;
+      s2 /= gta->gta_size;
+      t2 /= gta->gta_size;
+    }
+
+    glw_renderer_vtx_pos(r, n * 4 + 0, x1, y1, 0.0);
+    glw_renderer_vtx_st (r, n * 4 + 0, s1, t2);
+
+    glw_renderer_vtx_pos(r, n * 4 + 1, x2, y1, 0.0);
+    glw_renderer_vtx_st (r, n * 4 + 1, s2, t2);
+
+    glw_renderer_vtx_pos(r, n * 4 + 2, x2, y2, 0.0);
+    glw_renderer_vtx_st (r, n * 4 + 2, s2, t1);
+
+    glw_renderer_vtx_pos(r, n * 4 + 3, x1, y2, 0.0);
+    glw_renderer_vtx_st (r, n * 4 + 3, s1, t1);
+
+    for(x = 0; x < 4; x++)
+      glw_renderer_vtx_col(r, n * 4 + x,
+			   (c & 0xff) / 255.0f,
+			   ((c >> 8) & 0xff) / 255.0f,
+			   ((c >> 16) & 0xff) / 255.0f,
+			   (c >> 24) / 255.0f * (x == 0 || x == 3 ? a1 : a2));
+
+    glw_renderer_triangle(r, n * 2 + 0, n * 4 + 0, n * 4 + 1, n * 4 + 2);
+    glw_renderer_triangle(r, n * 2 + 1, n * 4 + 0, n * 4 + 2, n * 4 + 3);
+    n++;
+  }
+
+  r->gr_num_triangles = n * 2;
+  gtb->gtb_atlas_generation = gta->gta_generation;
+}
+
+
 /**
  *
  */
@@ -188,99 +410,47 @@ glw_text_bitmap_layout(glw_t *w, glw_rctx_t *rc)
 
   }
 
-  if(pm != NULL && gtb->gtb_need_layout) {
+  if(pm != NULL && pm->pm_glyphs != NULL) {
 
-    int left   =                 gtb->gtb_padding_left   - pm->pm_margin;
-    int top    = rc->rc_height - gtb->gtb_padding_top    + pm->pm_margin;
-    int right  = rc->rc_width  - gtb->gtb_padding_right  + pm->pm_margin;
-    int bottom =                 gtb->gtb_padding_bottom - pm->pm_margin;
-    
-    int text_width  = pm->pm_width;
-    int text_height = pm->pm_height;
-    
-    float x1, y1, x2, y2;
+    if(gr->gr_text_atlas == NULL)
+      gr->gr_text_atlas = glw_text_atlas_create(1024);
 
-    // Horizontal 
-    if(text_width > right - left) {
-      // Oversized, must cut
-      text_width = right - left;
+    if(gr->gr_text_atlas != NULL &&
+       (gtb->gtb_need_layout || gtb->gtb_atlas_partial ||
+	gtb->gtb_atlas_generation != gr->gr_text_atlas->gta_generation))
+      gtb_layout_glyphs(gtb, gr, rc);
 
-      glw_renderer_vtx_col(&gtb->gtb_text_renderer, 0, 1,1,1,1+text_width/20);
-      glw_renderer_vtx_col(&gtb->gtb_text_renderer, 1, 1,1,1,0);
-      glw_renderer_vtx_col(&gtb->gtb_text_renderer, 2, 1,1,1,0);
-      glw_renderer_vtx_col(&gtb->gtb_text_renderer, 3, 1,1,1,1+text_width/20);
+  } else if(pm != NULL && gtb->gtb_need_layout) {
 
-    } else { 
+    gtb_box_t b;
+    float x1, y1, x2, y2;
 
+    if(gtb_text_box(gtb, rc, pm, &b)) {
+      int tw = b.text_width;
+      glw_renderer_vtx_col(&gtb->gtb_text_renderer, 0, 1,1,1,1+tw/20);
+      glw_renderer_vtx_col(&gtb->gtb_text_renderer, 1, 1,1,1,0);
+      glw_renderer_vtx_col(&gtb->gtb_text_renderer, 2, 1,1,1,0);
+      glw_renderer_vtx_col(&gtb->gtb_text_renderer, 3, 1,1,1,1+tw/20);
+    } else {
       glw_renderer_vtx_col(&gtb->gtb_text_renderer, 0, 1,1,1,1);
       glw_renderer_vtx_col(&gtb->gtb_text_renderer, 1, 1,1,1,1);
       glw_renderer_vtx_col(&gtb->gtb_text_renderer, 2, 1,1,1,1);
       glw_renderer_vtx_col(&gtb->gtb_text_renderer, 3, 1,1,1,1);
-
-      switch(w->glw_alignment) {
-      case LAYOUT_ALIGN_JUSTIFIED:
-      case LAYOUT_ALIGN_CENTER:
-      case LAYOUT_ALIGN_BOTTOM:
-      case LAYOUT_ALIGN_TOP:
-	left = (left + right - text_width) / 2;
-	right = left + text_width;
-	break;
-
-      case LAYOUT_ALIGN_LEFT:
-      case LAYOUT_ALIGN_TOP_LEFT:
-      case LAYOUT_ALIGN_BOTTOM_LEFT:
-	right = left + pm->pm_width;
-	break;
-
-      case LAYOUT_ALIGN_RIGHT:
-      case LAYOUT_ALIGN_TOP_RIGHT:
-      case LAYOUT_ALIGN_BOTTOM_RIGHT:
-	left = right - pm->pm_width;
-	break;
-      }
     }
 
-    // Vertical 
-    if(text_height > top - bottom) {
-      // Oversized, must cut
-      text_height = top - bottom;
-    } else { 
-      switch(w->glw_alignment) {
-      case LAYOUT_ALIGN_CENTER:
-      case LAYOUT_ALIGN_LEFT:
-      case LAYOUT_ALIGN_RIGHT:
-	bottom = (bottom + top - text_height) / 2;
-	top = bottom + text_height;
-	break;
-
-      case LAYOUT_ALIGN_TOP_LEFT:
-      case LAYOUT_ALIGN_TOP_RIGHT:
-      case LAYOUT_ALIGN_TOP:
-      case LAYOUT_ALIGN_JUSTIFIED:
-	bottom = top - pm->pm_height;
-	break;
-
-      case LAYOUT_ALIGN_BOTTOM:
-      case LAYOUT_ALIGN_BOTTOM_LEFT:
-      case LAYOUT_ALIGN_BOTTOM_RIGHT:
-	top = bottom + pm->pm_height;
-	break;
-      }
-    }
-
-    x1 = -1.0f + 2.0f * left   / (float)rc->rc_width;
-    y1 = -1.0f + 2.0f * bottom / (float)rc->rc_height;
-    x2 = -1.0f + 2.0f * right  / (float)rc->rc_width;
-    y2 = -1.0f + 2.0f * top    / (float)rc->rc_height;
+    x1 = -1.0f + 2.0f * b.left   / (float)rc->rc_width;
+    y1 = -1.0f + 2.0f * b.bottom / (float)rc->rc_height;
+    x2 = -1.0f + 2.0f * b.right  / (float)rc->rc_width;
+    y2 = -1.0f + 2.0f * b.top    / (float)rc->rc_height;
 
     float s, t;
 
     if(gr->gr_normalized_texture_coords) {
-      s = text_width  / (float)pm->pm_width;
-      t = text_height / (float)pm->pm_height;
+      s = b.text_width  / (float)pm->pm_width;
+      t = b.text_height / (float)pm->pm_height;
     } else {
-      s = text_width;
-      t = text_height;
+      s = b.text_width;
+      t = b.text_height;
     }
 
     glw_renderer_vtx_pos(&gtb->gtb_text_renderer, 0, x1, y1, 0.0);
@@ -348,7 +518,8 @@ glw_text_bitmap_layout(glw_t *w, glw_rctx_t *rc)
 
   TAILQ_INSERT_TAIL(&gr->gr_gtb_render_queue, gtb, gtb_workq_link);
   gtb->gtb_state = GTB_QUEUED_FOR_RENDERING;
-  
+  gtb->gtb_queued_at = showtime_get_ts();
+
   hts_cond_signal(&gr->gr_gtb_work_cond);
 }
 
@@ -375,7 +546,24 @@ glw_text_bitmap_render(glw_t *w, const glw_rctx_t *rc)
   if(w->glw_flags & GLW_DEBUG)
     glw_wirebox(w->glw_root, rc);
 
-  if(glw_is_tex_inited(&gtb->gtb_texture) && pm != NULL) {
+  if(pm != NULL && pm->pm_glyphs != NULL) {
+    glw_root_t *gr = w->glw_root;
+    glw_text_atlas_t *gta = gr->gr_text_atlas;
+
+    if(gta != NULL && gtb->gtb_atlas_generation != gta->gta_generation) {
+      // Atlas flushed after we were laid out, our texture coordinates
+      // are stale so redo them now rather than skip a frame
+      gtb_layout_glyphs(gtb, gr, rc);
+    }
+
+    if(gta != NULL && gtb->gtb_glyph_quads) {
+      glw_text_atlas_upload(gr, gta);
+      glw_renderer_draw(&gtb->gtb_glyph_renderer, gr, rc,
+			&gta->gta_texture,
+			&gtb->gtb_color, NULL, alpha, blur);
+    }
+
+  } else if(glw_is_tex_inited(&gtb->gtb_texture) && pm != NULL) {
     glw_renderer_draw(&gtb->gtb_text_renderer, w->glw_root, rc, 
 		      &gtb->gtb_texture,
 		      &gtb->gtb_color, NULL, alpha, blur);
@@ -412,6 +600,7 @@ glw_text_bitmap_dtor(glw_t *w)
 
   glw_renderer_free(&gtb->gtb_text_renderer);
   glw_renderer_free(&gtb->gtb_cursor_renderer);
+  glw_renderer_free(&gtb->gtb_glyph_renderer);
 
   switch(gtb->gtb_state) {
   case GTB_IDLE:
@@ -681,6 +870,7 @@ gtb_realize(glw_text_bitmap_t *gtb)
   } else {
     TAILQ_INSERT_TAIL(&gr->gr_gtb_dim_queue, gtb, gtb_workq_link);
     gtb->gtb_state = GTB_QUEUED_FOR_DIMENSIONING;
+    gtb->gtb_queued_at = showtime_get_ts();
     hts_cond_signal(&gr->gr_gtb_work_cond);
   }
 }
@@ -1095,6 +1285,9 @@ do_render(glw_text_bitmap_t *gtb, glw_root_t *gr, int no_output)
   if(gtb->w.glw_flags2 & GLW2_SHADOW)
     flags |= TR_RENDER_SHADOW;
 
+  if(gr->gr_text_atlas_enabled)
+    flags |= TR_RENDER_GLYPH_RUN;
+
   switch(gtb->w.glw_alignment) {
   case LAYOUT_ALIGN_CENTER:
   case LAYOUT_ALIGN_BOTTOM:
@@ -1156,6 +1349,7 @@ do_render(glw_text_bitmap_t *gtb, glw_root_t *gr, int no_output)
     if(gtb->gtb_pixmap != NULL)
       pixmap_release(gtb->gtb_pixmap);
     gtb->gtb_pixmap = pm;
+    gtb->gtb_need_layout = 1;
     if(pm != NULL && gtb->gtb_maxlines > 1) {
       gtb_set_constraints(gr, gtb, pm);
     }
@@ -1179,6 +1373,24 @@ do_render(glw_text_bitmap_t *gtb, glw_root_t *gr, int no_output)
 /**
  *
  */
+static void
+gtb_account_latency(glw_root_t *gr, glw_text_bitmap_t *gtb)
+{
+  int64_t d = showtime_get_ts() - gtb->gtb_queued_at;
+
+  if(d < 0)
+    d = 0;
+  gr->gr_gtb_latency_sum += d;
+  gr->gr_gtb_latency_max = MAX(gr->gr_gtb_latency_max, d);
+  gr->gr_gtb_latency_count++;
+}
+
+
+/**
+ * Any number of these may run. They only touch the queues and the
+ * widgets with the GLW lock held, do_render() drops it while the
+ * actual text rendering is done
+ */
 static void *
 font_render_thread(void *aux)
 {
@@ -1187,13 +1399,14 @@ font_render_thread(void *aux)
 
   glw_lock(gr);
 
-  while(1) {
+  while(gr->gr_gtb_threads <= gr->gr_gtb_workers) {
     
     if((gtb = TAILQ_FIRST(&gr->gr_gtb_dim_queue)) != NULL) {
 
       assert(gtb->gtb_state == GTB_QUEUED_FOR_DIMENSIONING);
       TAILQ_REMOVE(&gr->gr_gtb_dim_queue, gtb, gtb_workq_link);
       gtb->gtb_state = GTB_DIMENSIONING;
+      gtb_account_latency(gr, gtb);
       do_render(gtb, gr, 1);
       continue;
     }
@@ -1204,14 +1417,68 @@ font_render_thread(void *aux)
       assert(gtb->gtb_state == GTB_QUEUED_FOR_RENDERING);
       TAILQ_REMOVE(&gr->gr_gtb_render_queue, gtb, gtb_workq_link);
       gtb->gtb_state = GTB_RENDERING;
+      gtb_account_latency(gr, gtb);
       do_render(gtb, gr, 0);
       continue;
     }
     glw_cond_wait(gr, &gr->gr_gtb_work_cond);
   }
+  gr->gr_gtb_threads--;
+  hts_cond_broadcast(&gr->gr_gtb_work_cond);
+  glw_unlock(gr);
   return NULL;
 }
 
+
+/**
+ * Change number of text render threads. Surplus threads exit
+ * once they are done with what they are currently rendering
+ */
+void
+glw_text_set_workers(glw_root_t *gr, int workers)
+{
+  gr->gr_gtb_workers = MAX(workers, 1);
+
+  while(gr->gr_gtb_threads < gr->gr_gtb_workers) {
+    gr->gr_gtb_threads++;
+    hts_thread_create_detached("GLW font renderer", font_render_thread, gr,
+			       THREAD_PRIO_NORMAL);
+  }
+  hts_cond_broadcast(&gr->gr_gtb_work_cond);
+}
+
+
+/**
+ * Publish text queue latency, called periodically from
+ * glw_prepare_frame()
+ */
+void
+glw_text_update_stats(glw_root_t *gr)
+{
+  glw_text_bitmap_t *gtb;
+  prop_t *p = prop_create(gr->gr_uii.uii_prop, "text");
+  int queued = 0;
+
+  TAILQ_FOREACH(gtb, &gr->gr_gtb_dim_queue, gtb_workq_link)
+    queued++;
+  TAILQ_FOREACH(gtb, &gr->gr_gtb_render_queue, gtb_workq_link)
+    queued++;
+
+  prop_set_int(prop_create(p, "workers"), gr->gr_gtb_threads);
+  prop_set_int(prop_create(p, "queued"), queued);
+  prop_set_int(prop_create(p, "rendered"), gr->gr_gtb_latency_count);
+  prop_set_float(prop_create(p, "queueLatency"),
+		 gr->gr_gtb_latency_count ?
+		 gr->gr_gtb_latency_sum / 1000.0 / gr->gr_gtb_latency_count :
+		 0);
+  prop_set_float(prop_create(p, "queueLatencyMax"),
+		 gr->gr_gtb_latency_max / 1000.0);
+
+  gr->gr_gtb_latency_sum = 0;
+  gr->gr_gtb_latency_max = 0;
+  gr->gr_gtb_latency_count = 0;
+}
+
 /**
  *
  */
@@ -1272,9 +1539,100 @@ glw_text_bitmap_init(glw_root_t *gr)
   TAILQ_INIT(&gr->gr_gtb_render_queue);
 
   hts_cond_init(&gr->gr_gtb_work_cond, &gr->gr_mutex);
+}
 
-  hts_thread_create_detached("GLW font renderer", font_render_thread, gr,
-			     THREAD_PRIO_NORMAL);
+
+/**
+ * Stop all text render threads and drop the glyph atlas
+ */
+void
+glw_text_bitmap_fini(glw_root_t *gr)
+{
+  glw_lock(gr);
+  gr->gr_gtb_workers = 0;
+  hts_cond_broadcast(&gr->gr_gtb_work_cond);
+  while(gr->gr_gtb_threads > 0)
+    glw_cond_wait(gr, &gr->gr_gtb_work_cond);
+
+  if(gr->gr_text_atlas != NULL) {
+    glw_text_atlas_destroy(gr, gr->gr_text_atlas);
+    gr->gr_text_atlas = NULL;
+  }
+  glw_unlock(gr);
+}
+
+
+/**
+ * Render pages of list items using both the per label pixmap path
+ * and the glyph atlas path. No GL context is needed, so texture
+ * uploads are reported as byte counts
+ */
+int
+glw_text_bench(void)
+{
+  const int items = 40;
+  const int pages = 50;
+  const int domain = freetype_get_context();
+  int path, p, i, j, x, y, len;
+  char buf[128];
+
+  for(path = 0; path < 2; path++) {
+    glw_text_atlas_t *gta = path ? glw_text_atlas_create(1024) : NULL;
+    int64_t upload = 0;
+    int textures = 0, quads = 0;
+    int64_t ts = showtime_get_ts();
+
+    for(p = 0; p < pages; p++) {
+      for(i = 0; i < items; i++) {
+	snprintf(buf, sizeof(buf), "%d. Track number %d - Artist %d",
+		 i + 1, p * items + i, p);
+	uint32_t *uc = text_parse(buf, &len, 0, NULL, 0, 0);
+	pixmap_t *pm = text_render(uc, len,
+				   TR_RENDER_SHADOW |
+				   (path ? TR_RENDER_GLYPH_RUN : 0),
+				   20, 1.0, TR_ALIGN_LEFT, 600, 1, NULL,
+				   domain, 0);
+	free(uc);
+	if(pm == NULL)
+	  continue;
+
+	if(path) {
+	  for(j = 0; j < pm->pm_numglyphs; j++)
+	    if(!glw_text_atlas_add(gta, pm->pm_glyphs[j].pg_pm, p, &x, &y))
+	      quads++;
+	} else {
+	  upload += pm->pm_linesize * pm->pm_height;
+	  textures++;
+	}
+	pixmap_release(pm);
+      }
+
+      if(gta != NULL && gta->gta_dirty_y1 > gta->gta_dirty_y0) {
+	// What glw_text_atlas_upload() would send once per frame
+	upload += gta->gta_pm->pm_linesize *
+	  (gta->gta_dirty_y1 - gta->gta_dirty_y0);
+	gta->gta_dirty_y0 = gta->gta_dirty_y1 = 0;
+	gta->gta_uploads++;
+      }
+    }
+
+    ts = showtime_get_ts() - ts;
+
+    TRACE(TRACE_INFO, "bench",
+	  "%s: %d pages of %d items, %.2f ms/page, "
+	  "%d textures, %d quads, %"PRId64" kB uploaded",
+	  path ? "Glyph atlas" : "Pixmap", pages, items,
+	  ts / 1000.0 / pages, textures, quads, upload / 1024);
+
+    if(gta != NULL) {
+      TRACE(TRACE_INFO, "bench",
+	    "Glyph atlas: %d glyphs, %d hits, %d uploads, %d resets",
+	    gta->gta_entries, gta->gta_hits, gta->gta_uploads,
+	    gta->gta_resets);
+      glw_text_atlas_destroy(NULL, gta);
+    }
+  }
+  return 0;
 }
 
 
@@ -19,8 +19,55 @@
 #ifndef GLW_TEXT_BITMAP_H
 #define GLW_TEXT_BITMAP_H
 
+#include "misc/pixmap.h"
+
 void glw_text_bitmap_init(glw_root_t *gr);
 
+void glw_text_bitmap_fini(glw_root_t *gr);
+
 void glw_text_flush(glw_root_t *gr);
 
+void glw_text_set_workers(glw_root_t *gr, int workers);
+
+void glw_text_update_stats(glw_root_t *gr);
+
+int glw_text_bench(void);
+
+
+/**
+ * Shared glyph atlas
+ */
+LIST_HEAD(glw_text_atlas_entry_list, glw_text_atlas_entry);
+
+typedef struct glw_text_atlas {
+  pixmap_t *gta_pm;                  // I8A8 backing store
+  glw_backend_texture_t gta_texture;
+  struct glw_text_atlas_entry_list *gta_hash;
+
+  int gta_size;
+  int gta_shelf_x;
+  int gta_shelf_y;
+  int gta_shelf_h;
+
+  int gta_generation;
+  int gta_reset_frame;               // Frame of last reset
+  int gta_dirty_y0;                  // Rows that need upload, empty if
+  int gta_dirty_y1;                  // y1 <= y0
+
+  int gta_entries;
+  int gta_hits;
+  int gta_misses;
+  int gta_resets;
+  int gta_uploads;
+} glw_text_atlas_t;
+
+glw_text_atlas_t *glw_text_atlas_create(int size);
+
+void glw_text_atlas_destroy(glw_root_t *gr, glw_text_atlas_t *gta);
+
+int glw_text_atlas_add(glw_text_atlas_t *gta, pixmap_t *pm, int frame,
+		       int *xp, int *yp);
+
+void glw_text_atlas_upload(glw_root_t *gr, glw_text_atlas_t *gta);
+
 #endif /* GLW_TEXT_BITMAP_H */
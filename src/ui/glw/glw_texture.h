@@ -27,8 +27,16 @@ typedef struct glw_loadable_texture {
 
   LIST_ENTRY(glw_loadable_texture) glt_global_link;
   LIST_ENTRY(glw_loadable_texture) glt_flush_link;
-  TAILQ_ENTRY(glw_loadable_texture) glt_work_link;
-  struct glw_loadable_texture_queue *glt_q;
+  TAILQ_ENTRY(glw_loadable_texture) glt_work_link;  // Release queue
+
+  int glt_q;            // LQ_* load queue when queued or loading
+  int glt_heap_idx;
+  unsigned int glt_seq;
+
+  int glt_distance;     // Closest user's distance from the viewport
+  int glt_distance_frame;
+
+  int64_t glt_req_time;
 
   int glt_flags;
 
@@ -78,6 +86,11 @@ void glw_tex_deref(glw_root_t *gr, glw_loadable_texture_t *ht);
 
 void glw_tex_layout(glw_root_t *gr, glw_loadable_texture_t *glt);
 
+void glw_tex_layout_ex(glw_root_t *gr, glw_loadable_texture_t *glt,
+		       int distance);
+
+void glw_tex_update_stats(glw_root_t *gr);
+
 void glw_tex_purge(glw_root_t *gr);
 
 void glw_tex_autoflush(glw_root_t *gr);
@@ -106,6 +119,14 @@ void glw_tex_upload(glw_root_t *gr, glw_backend_texture_t *tex,
 		    const void *src, int format, int width, int height,
 		    int flags);
 
+/**
+ * Update rows y0 to y1 (exclusive) of a texture previously uploaded
+ * with the same format and size. 'src' points to the full image
+ */
+void glw_tex_upload_rows(glw_root_t *gr, glw_backend_texture_t *tex,
+			 const void *src, int format, int width, int height,
+			 int y0, int y1);
+
 void glw_tex_destroy(glw_root_t *gr, glw_backend_texture_t *tex);
 
 #endif /* GLW_TEXTURE_H */
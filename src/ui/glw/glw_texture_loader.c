@@ -27,6 +27,159 @@
 
 #include "backend/backend.h"
 
+
+/**
+ * Return true if a should be loaded before b
+ */
+static int
+glt_before(const glw_loadable_texture_t *a, const glw_loadable_texture_t *b)
+{
+  if(a->glt_distance != b->glt_distance)
+    return a->glt_distance < b->glt_distance;
+  return (int)(a->glt_seq - b->glt_seq) < 0;
+}
+
+
+/**
+ *
+ */
+static void
+heap_set(glw_tex_heap_t *h, int i, glw_loadable_texture_t *glt)
+{
+  h->gth_vec[i] = glt;
+  glt->glt_heap_idx = i;
+}
+
+
+/**
+ *
+ */
+static void
+heap_up(glw_tex_heap_t *h, int i)
+{
+  glw_loadable_texture_t *glt = h->gth_vec[i];
+
+  while(i > 0) {
+    int p = (i - 1) / 2;
+    if(!glt_before(glt, h->gth_vec[p]))
+      break;
+    heap_set(h, i, h->gth_vec[p]);
+    i = p;
+  }
+  heap_set(h, i, glt);
+}
+
+
+/**
+ *
+ */
+static void
+heap_down(glw_tex_heap_t *h, int i)
+{
+  glw_loadable_texture_t *glt = h->gth_vec[i];
+
+  while(1) {
+    int c = i * 2 + 1;
+    if(c >= h->gth_num)
+      break;
+    if(c + 1 < h->gth_num && glt_before(h->gth_vec[c + 1], h->gth_vec[c]))
+      c++;
+    if(!glt_before(h->gth_vec[c], glt))
+      break;
+    heap_set(h, i, h->gth_vec[c]);
+    i = c;
+  }
+  heap_set(h, i, glt);
+}
+
+
+/**
+ *
+ */
+static void
+heap_insert(glw_tex_heap_t *h, glw_loadable_texture_t *glt)
+{
+  if(h->gth_num == h->gth_size) {
+    h->gth_size = MAX(64, h->gth_size * 2);
+    h->gth_vec = realloc(h->gth_vec, h->gth_size * sizeof(void *));
+  }
+  heap_set(h, h->gth_num++, glt);
+  heap_up(h, glt->glt_heap_idx);
+}
+
+
+/**
+ *
+ */
+static void
+heap_remove(glw_tex_heap_t *h, glw_loadable_texture_t *glt)
+{
+  glw_loadable_texture_t *last;
+  int i = glt->glt_heap_idx;
+
+  assert(h->gth_vec[i] == glt);
+  h->gth_num--;
+  if(i == h->gth_num)
+    return;
+
+  last = h->gth_vec[h->gth_num];
+  heap_set(h, i, last);
+  heap_up(h, i);
+  heap_down(h, last->glt_heap_idx);
+}
+
+
+/**
+ * Reposition after glt_distance has changed
+ */
+static void
+heap_update(glw_tex_heap_t *h, glw_loadable_texture_t *glt)
+{
+  heap_up(h, glt->glt_heap_idx);
+  heap_down(h, glt->glt_heap_idx);
+}
+
+
+/**
+ *
+ */
+static void
+glt_dequeue(glw_root_t *gr, glw_loadable_texture_t *glt)
+{
+  heap_remove(&gr->gr_tex_load_queue[glt->glt_q], glt);
+}
+
+
+/**
+ * Abort loads of textures that has been scrolled out of view if
+ * there are visible textures waiting for a loader
+ */
+static void
+glw_tex_cancel_invisible(glw_root_t *gr)
+{
+  glw_loadable_texture_t *glt, *next;
+  const glw_tex_heap_t *h = &gr->gr_tex_load_queue[LQ_OTHER];
+
+  if(h->gth_num == 0 || h->gth_vec[0]->glt_distance > 0)
+    return;
+
+  for(glt = LIST_FIRST(&gr->gr_tex_active_list); glt != NULL; glt = next) {
+    next = LIST_NEXT(glt, glt_flush_link);
+
+    if(glt->glt_state != GLT_STATE_LOADING || glt->glt_q != LQ_OTHER ||
+       glt->glt_distance == 0)
+      continue;
+
+    LIST_REMOVE(glt, glt_flush_link);
+    glt->glt_state = GLT_STATE_LOAD_ABORT;
+    gr->gr_tex_cancelled++;
+  }
+}
+
+
+/**
+ *
+ */
 void
 glw_tex_autoflush(glw_root_t *gr)
 {
@@ -43,7 +196,7 @@ glw_tex_autoflush(glw_root_t *gr)
 
     case GLT_STATE_QUEUED:
       glt->glt_state = GLT_STATE_INACTIVE;
-      TAILQ_REMOVE(glt->glt_q, glt, glt_work_link);
+      glt_dequeue(gr, glt);
       glw_tex_deref(gr, glt);  // beware! glt may be free'd here
       break;
 
@@ -60,6 +213,8 @@ glw_tex_autoflush(glw_root_t *gr)
     }
   }
 
+  glw_tex_cancel_invisible(gr);
+
   LIST_MOVE(&gr->gr_tex_flush_list, &gr->gr_tex_active_list, glt_flush_link);
   LIST_INIT(&gr->gr_tex_active_list);
 }
@@ -82,13 +237,12 @@ loader_get_work(loaderaux_t *la)
 {
   glw_root_t *gr = la->la_gr;
   int i;
-  glw_loadable_texture_t *glt;
   int last_queue = la->la_only_fast ? LQ_TENTATIVE : LQ_REFRESH;
   
   while(1) {
     for(i = 0; i <= last_queue; i++)
-      if((glt = TAILQ_FIRST(&gr->gr_tex_load_queue[i])) != NULL)
-	return glt;
+      if(gr->gr_tex_load_queue[i].gth_num > 0)
+	return gr->gr_tex_load_queue[i].gth_vec[0];
 
     hts_cond_wait(&gr->gr_tex_load_cond, &gr->gr_mutex);
   }
@@ -103,8 +257,9 @@ glt_enqueue(glw_root_t *gr, glw_loadable_texture_t *glt, int q)
 {
   glt->glt_refcnt++;
 
-  glt->glt_q = &gr->gr_tex_load_queue[q];
-  TAILQ_INSERT_TAIL(&gr->gr_tex_load_queue[q], glt, glt_work_link);
+  glt->glt_q = q;
+  glt->glt_seq = gr->gr_tex_seq++;
+  heap_insert(&gr->gr_tex_load_queue[q], glt);
   glt->glt_state = GLT_STATE_QUEUED;
 
   if(q > LQ_TENTATIVE)
@@ -114,6 +269,31 @@ glt_enqueue(glw_root_t *gr, glw_loadable_texture_t *glt, int q)
 }
 
 
+/**
+ * Time from first request until pixels are available, only counted
+ * for textures that are on screen when they arrive
+ */
+static void
+glt_account_ttfp(glw_root_t *gr, glw_loadable_texture_t *glt)
+{
+  int64_t d;
+
+  if(glt->glt_req_time == 0)
+    return;
+
+  d = showtime_get_ts() - glt->glt_req_time;
+  glt->glt_req_time = 0;
+  gr->gr_tex_loaded++;
+
+  if(glt->glt_distance > 0)
+    return;
+
+  gr->gr_tex_ttfp_sum += d;
+  gr->gr_tex_ttfp_max = MAX(gr->gr_tex_ttfp_max, d);
+  gr->gr_tex_ttfp_count++;
+}
+
+
 /**
  *
  */
@@ -146,7 +326,7 @@ loader_thread(void *aux)
     
     glt = loader_get_work(la);
 
-    TAILQ_REMOVE(glt->glt_q, glt, glt_work_link);
+    glt_dequeue(gr, glt);
     glt->glt_state = GLT_STATE_LOADING;
     
     if(glt->glt_refcnt > 1) {
@@ -158,22 +338,23 @@ loader_thread(void *aux)
       im.im_max_height = gr->gr_height;
       im.im_can_mono = 1;
 
-      if(glt->glt_q == &gr->gr_tex_load_queue[LQ_TENTATIVE]) {
+      if(glt->glt_q == LQ_TENTATIVE) {
 	cache_control = 0;
 	ccptr = &cache_control;
 	
-      } else if(glt->glt_q == &gr->gr_tex_load_queue[LQ_OTHER] ||
-		glt->glt_q == &gr->gr_tex_load_queue[LQ_REFRESH]) {
+      } else if(glt->glt_q == LQ_OTHER || glt->glt_q == LQ_REFRESH) {
 	ccptr = BYPASS_CACHE;
       } else {
 	ccptr = NULL;
       }
 
+      gr->gr_tex_loading++;
       glw_unlock(gr);
       pm = backend_imageloader(url, &im, gr->gr_vpaths, errbuf, sizeof(errbuf),
 			       ccptr, img_load_cb, glt);
 
       glw_lock(gr);
+      gr->gr_tex_loading--;
 
 #if 0
       if(pm != NULL && pm != NOT_MODIFIED) {
@@ -195,9 +376,9 @@ loader_thread(void *aux)
 	glt->glt_state = GLT_STATE_INACTIVE;
       } else if(pm == NULL) {
 
-	if(glt->glt_q == &gr->gr_tex_load_queue[LQ_TENTATIVE]) {
+	if(glt->glt_q == LQ_TENTATIVE) {
 	  glt_enqueue(gr, glt, LQ_OTHER);
-	} else if(glt->glt_q == &gr->gr_tex_load_queue[LQ_REFRESH]) {
+	} else if(glt->glt_q == LQ_REFRESH) {
 	  TRACE(TRACE_INFO, "GLW",
 		"Unable to load %s -- %s -- using cached copy", 
 		rstr_get(url), errbuf);
@@ -219,8 +400,7 @@ loader_thread(void *aux)
 
 	if(glt->glt_state == GLT_STATE_LOADING) {
 
-	  if(glt->glt_q == &gr->gr_tex_load_queue[LQ_TENTATIVE] &&
-	     cache_control == 1) {
+	  if(glt->glt_q == LQ_TENTATIVE && cache_control == 1) {
 	    glt_enqueue(gr, glt, LQ_REFRESH);
 	  } else {
 	    glt->glt_state = GLT_STATE_VALID;
@@ -231,6 +411,7 @@ loader_thread(void *aux)
 	    glt->glt_orientation = pm->pm_orientation;
 	    glt->glt_aspect = pm->pm_aspect;
 	    glw_tex_backend_load(gr, glt, pm);
+	    glt_account_ttfp(gr, glt);
 	  }
 	}
 
@@ -266,10 +447,11 @@ glw_tex_init(glw_root_t *gr)
   hts_cond_init(&gr->gr_tex_load_cond, &gr->gr_mutex);
   
   TAILQ_INIT(&gr->gr_tex_rel_queue);
-  for(i = 0; i < LQ_num; i++) 
-    TAILQ_INIT(&gr->gr_tex_load_queue[i]);
+  // Decoding is CPU bound so use all cores, but keep a few threads
+  // around to hide network latency on single core machines
+  gr->gr_tex_loaders = GLW_CLAMP(get_system_concurrency(), 2, 8);
 
-  for(i = 0; i < 4; i++)
+  for(i = 0; i < gr->gr_tex_loaders; i++)
     spawn_loader(gr, 0);
 
   for(i = 0; i < 2; i++)
@@ -298,7 +480,7 @@ glw_tex_flush_all(glw_root_t *gr)
 
     case GLT_STATE_QUEUED:
       LIST_REMOVE(glt, glt_flush_link);
-      TAILQ_REMOVE(glt->glt_q, glt, glt_work_link);
+      glt_dequeue(gr, glt);
       glt->glt_state = GLT_STATE_INACTIVE;
       glw_tex_deref(gr, glt);
       break;
@@ -413,6 +595,9 @@ gl_tex_req_load(glw_root_t *gr, glw_loadable_texture_t *glt)
     q = LQ_TENTATIVE;
   }
 
+  if(glt->glt_req_time == 0)
+    glt->glt_req_time = showtime_get_ts();
+
   glt_enqueue(gr, glt, q);
 }
 
@@ -423,6 +608,30 @@ gl_tex_req_load(glw_root_t *gr, glw_loadable_texture_t *glt)
 void
 glw_tex_layout(glw_root_t *gr, glw_loadable_texture_t *glt)
 {
+  glw_tex_layout_ex(gr, glt, 0);
+}
+
+
+/**
+ * 'distance' is how far (in pixels) the user of the texture is from
+ * being visible. A texture shared by several widgets gets the
+ * distance of the closest one
+ */
+void
+glw_tex_layout_ex(glw_root_t *gr, glw_loadable_texture_t *glt, int distance)
+{
+  if(glt->glt_distance_frame != gr->gr_frames) {
+    glt->glt_distance_frame = gr->gr_frames;
+  } else {
+    distance = MIN(distance, glt->glt_distance);
+  }
+
+  if(glt->glt_distance != distance) {
+    glt->glt_distance = distance;
+    if(glt->glt_state == GLT_STATE_QUEUED)
+      heap_update(&gr->gr_tex_load_queue[glt->glt_q], glt);
+  }
+
   if(glt->glt_pixmap != NULL)
     glw_tex_backend_layout(gr, glt);
 
@@ -446,3 +655,35 @@ glw_tex_layout(glw_root_t *gr, glw_loadable_texture_t *glt)
   }
   LIST_INSERT_HEAD(&gr->gr_tex_active_list, glt, glt_flush_link);
 }
+
+
+/**
+ * Publish loader statistics, called periodically from
+ * glw_prepare_frame()
+ */
+void
+glw_tex_update_stats(glw_root_t *gr)
+{
+  prop_t *p = prop_create(gr->gr_uii.uii_prop, "textures");
+  int i, queued = 0;
+
+  for(i = 0; i < LQ_num; i++)
+    queued += gr->gr_tex_load_queue[i].gth_num;
+
+  prop_set_int(prop_create(p, "loaders"), gr->gr_tex_loaders);
+  prop_set_int(prop_create(p, "queued"), queued);
+  prop_set_int(prop_create(p, "loading"), gr->gr_tex_loading);
+  prop_set_int(prop_create(p, "loaded"), gr->gr_tex_loaded);
+  prop_set_int(prop_create(p, "cancelled"), gr->gr_tex_cancelled);
+  prop_set_float(prop_create(p, "timeToFirstPixel"),
+		 gr->gr_tex_ttfp_count ?
+		 gr->gr_tex_ttfp_sum / 1000.0 / gr->gr_tex_ttfp_count : 0);
+  prop_set_float(prop_create(p, "timeToFirstPixelMax"),
+		 gr->gr_tex_ttfp_max / 1000.0);
+
+  gr->gr_tex_loaded = 0;
+  gr->gr_tex_cancelled = 0;
+  gr->gr_tex_ttfp_sum = 0;
+  gr->gr_tex_ttfp_max = 0;
+  gr->gr_tex_ttfp_count = 0;
+}
@@ -0,0 +1,182 @@
+/*
+ *  GL Widgets, Null backend, Texture loading
+ *  Copyright (C) 2012 Andreas Öman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glw.h"
+#include "glw_texture.h"
+
+/**
+ * Free texture (always invoked in main rendering thread)
+ */
+void
+glw_tex_backend_free_render_resources(glw_root_t *gr,
+				      glw_loadable_texture_t *glt)
+{
+  glw_tex_destroy(gr, &glt->glt_texture);
+}
+
+
+/**
+ * Free resources created by glw_tex_backend_decode()
+ */
+void
+glw_tex_backend_free_loader_resources(glw_loadable_texture_t *glt)
+{
+  if(glt->glt_pixmap != NULL) {
+    pixmap_release(glt->glt_pixmap);
+    glt->glt_pixmap = NULL;
+  }
+}
+
+
+/**
+ * Invoked on every frame when status == VALID
+ *
+ * Pretend to upload the pixmap so upload cost (in bytes) is
+ * still accounted for
+ */
+void
+glw_tex_backend_layout(glw_root_t *gr, glw_loadable_texture_t *glt)
+{
+  const pixmap_t *pm = glt->glt_pixmap;
+
+  if(glt->glt_texture.inited || pm == NULL)
+    return;
+
+  glt->glt_texture.type = pm->pm_type == PIXMAP_RGB24 ?
+    GLW_TEXTURE_TYPE_NO_ALPHA : GLW_TEXTURE_TYPE_NORMAL;
+  glt->glt_texture.width  = glt->glt_xs;
+  glt->glt_texture.height = glt->glt_ys;
+  glt->glt_texture.inited = 1;
+  glt->glt_s = 1;
+  glt->glt_t = 1;
+
+  gr->gr_be.gbr_uploads++;
+  gr->gr_be.gbr_upload_bytes += pm->pm_linesize * pm->pm_height;
+
+  glw_tex_backend_free_loader_resources(glt);
+}
+
+
+/**
+ *
+ */
+int
+glw_tex_backend_load(glw_root_t *gr, glw_loadable_texture_t *glt,
+		     pixmap_t *pm)
+{
+  switch(pm->pm_type) {
+  case PIXMAP_RGB24:
+  case PIXMAP_BGR32:
+  case PIXMAP_IA:
+  case PIXMAP_I:
+    break;
+  default:
+    return 1;
+  }
+
+  if(glt->glt_pixmap != NULL)
+    pixmap_release(glt->glt_pixmap);
+
+  glt->glt_pixmap = pixmap_dup(pm);
+
+  glt->glt_xs = pm->pm_width;
+  glt->glt_ys = pm->pm_height;
+  return 0;
+}
+
+
+/**
+ *
+ */
+void
+glw_tex_upload(glw_root_t *gr, glw_backend_texture_t *tex,
+	       const void *src, int fmt, int width, int height, int flags)
+{
+  int bpp;
+
+  switch(fmt) {
+  case GLW_TEXTURE_FORMAT_BGR32:
+    bpp = 4;
+    tex->type = GLW_TEXTURE_TYPE_NORMAL;
+    break;
+
+  case GLW_TEXTURE_FORMAT_RGB:
+    bpp = 3;
+    tex->type = GLW_TEXTURE_TYPE_NO_ALPHA;
+    break;
+
+  case GLW_TEXTURE_FORMAT_I8A8:
+    bpp = 2;
+    tex->type = GLW_TEXTURE_TYPE_NORMAL;
+    break;
+
+  default:
+    return;
+  }
+
+  tex->width = width;
+  tex->height = height;
+  tex->inited = 1;
+
+  gr->gr_be.gbr_uploads++;
+  gr->gr_be.gbr_upload_bytes += width * height * bpp;
+}
+
+
+/**
+ *
+ */
+void
+glw_tex_upload_rows(glw_root_t *gr, glw_backend_texture_t *tex,
+		    const void *src, int fmt, int width, int height,
+		    int y0, int y1)
+{
+  int bpp;
+
+  if(!tex->inited || tex->width != width || tex->height != height) {
+    glw_tex_upload(gr, tex, src, fmt, width, height, 0);
+    return;
+  }
+
+  switch(fmt) {
+  case GLW_TEXTURE_FORMAT_BGR32:
+    bpp = 4;
+    break;
+  case GLW_TEXTURE_FORMAT_RGB:
+    bpp = 3;
+    break;
+  case GLW_TEXTURE_FORMAT_I8A8:
+    bpp = 2;
+    break;
+  default:
+    return;
+  }
+
+  gr->gr_be.gbr_uploads++;
+  gr->gr_be.gbr_upload_bytes += width * (y1 - y0) * bpp;
+}
+
+
+/**
+ *
+ */
+void
+glw_tex_destroy(glw_root_t *gr, glw_backend_texture_t *tex)
+{
+  tex->inited = 0;
+}
@@ -217,6 +217,48 @@ glw_tex_upload(glw_root_t *gr, glw_backend_texture_t *tex,
 }
 
 
+/**
+ *
+ */
+void
+glw_tex_upload_rows(glw_root_t *gr, glw_backend_texture_t *tex,
+		    const void *src, int fmt, int width, int height,
+		    int y0, int y1)
+{
+  int format, bpp;
+  int m = gr->gr_be.gbr_primary_texture_mode;
+
+  if(tex->tex == 0 || tex->width != width || tex->height != height) {
+    glw_tex_upload(gr, tex, src, fmt, width, height, 0);
+    return;
+  }
+
+  switch(fmt) {
+  case GLW_TEXTURE_FORMAT_BGR32:
+    format = GL_RGBA;
+    bpp = 4;
+    break;
+
+  case GLW_TEXTURE_FORMAT_RGB:
+    format = GL_RGB;
+    bpp = 3;
+    break;
+
+  case GLW_TEXTURE_FORMAT_I8A8:
+    format = GL_LUMINANCE_ALPHA;
+    bpp = 2;
+    break;
+
+  default:
+    return;
+  }
+
+  glBindTexture(m, tex->tex);
+  glTexSubImage2D(m, 0, 0, y0, width, y1 - y0, format, GL_UNSIGNED_BYTE,
+		  (const uint8_t *)src + y0 * width * bpp);
+}
+
+
 /**
  *
  */
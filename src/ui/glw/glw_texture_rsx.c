@@ -297,6 +297,18 @@ glw_tex_upload(glw_root_t *gr, glw_backend_texture_t *tex,
 }
 
 
+/**
+ * Textures are reallocated on every upload, so just do a full one
+ */
+void
+glw_tex_upload_rows(glw_root_t *gr, glw_backend_texture_t *tex,
+		    const void *src, int fmt, int width, int height,
+		    int y0, int y1)
+{
+  glw_tex_upload(gr, tex, src, fmt, width, height, 0);
+}
+
+
 /**
  *
  */
@@ -118,14 +118,137 @@ glw_view_error(glw_root_t *gr, errorinfo_t *ei, glw_t *parent)
 
 
 /**
- *
+ * Parsed views are cached and shared by all instances. Only
+ * statements that might turn dynamic are cloned when instantiating,
+ * see glw_view_eval_shared_rpn()
  */
 typedef struct glw_cached_view {
   LIST_ENTRY(glw_cached_view) gcv_link;
   token_t *gcv_sof;
   rstr_t *gcv_url;
+
+  prop_t *gcv_prop;
+  int gcv_instances;
+  int gcv_tokens;      // Tokens allocated while instantiating
+  int64_t gcv_time;    // Time spent instantiating (µs)
 } glw_cached_view_t;
 
+
+/**
+ *
+ */
+static glw_cached_view_t *
+glw_view_cache_find(glw_root_t *gr, rstr_t *url)
+{
+  glw_cached_view_t *gcv;
+  unsigned int h = mystrhash(rstr_get(url)) % GLW_VIEW_HASH_SIZE;
+
+  LIST_FOREACH(gcv, &gr->gr_views[h], gcv_link)
+    if(!strcmp(rstr_get(gcv->gcv_url), rstr_get(url)))
+      break;
+  return gcv;
+}
+
+
+/**
+ *
+ */
+static glw_cached_view_t *
+glw_view_cache_insert(glw_root_t *gr, rstr_t *url, token_t *sof)
+{
+  glw_cached_view_t *gcv = calloc(1, sizeof(glw_cached_view_t));
+  unsigned int h = mystrhash(rstr_get(url)) % GLW_VIEW_HASH_SIZE;
+
+  glw_view_mark_shareable(sof);
+  gcv->gcv_sof = sof;
+  gcv->gcv_url = rstr_dup(url);
+  gcv->gcv_prop = prop_create_root(NULL);
+  prop_set_rstring(prop_create(gcv->gcv_prop, "url"), url);
+
+  if(prop_set_parent(gcv->gcv_prop,
+		     prop_create(prop_create(gr->gr_uii.uii_prop, "views"),
+				 "nodes")))
+    abort();
+
+  LIST_INSERT_HEAD(&gr->gr_views[h], gcv, gcv_link);
+  return gcv;
+}
+
+
+/**
+ * Load, preprocess, parse and compile a view. Every file loaded is
+ * added to 'deps'
+ */
+token_t *
+glw_view_parse_file(glw_root_t *gr, rstr_t *url, errorinfo_t *ei,
+		    glw_view_deps_t *deps)
+{
+  token_t *sof = glw_view_token_alloc(gr), *eof, *l;
+  int r = -1;
+
+  sof->type = TOKEN_START;
+  sof->file = rstr_dup(url);
+
+  gr->gr_view_deps = deps;
+
+  if((l = glw_view_load1(gr, url, ei, sof)) != NULL) {
+    eof = glw_view_token_alloc(gr);
+    eof->type = TOKEN_END;
+    eof->file = rstr_dup(url);
+    l->next = eof;
+
+    r = glw_view_preproc(gr, sof, ei) || glw_view_parse(sof, ei, gr);
+  }
+
+  gr->gr_view_deps = NULL;
+
+  if(r) {
+    glw_view_free_chain(gr, sof);
+    return NULL;
+  }
+
+  glw_view_compile(gr, sof);
+  return sof;
+}
+
+
+/**
+ * Get a parsed view from the precompiled cache or parse it (and store
+ * the result in the cache)
+ */
+static token_t *
+glw_view_load(glw_root_t *gr, rstr_t *url, errorinfo_t *ei)
+{
+  glw_view_deps_t deps;
+  token_t *sof;
+  int64_t ts = showtime_get_ts();
+
+  if((sof = glw_view_bincache_load(gr, url)) != NULL) {
+    ts = showtime_get_ts() - ts;
+    gr->gr_views_precompiled++;
+    gr->gr_views_precompiled_time += ts;
+    TRACE(TRACE_DEBUG, "GLW", "%s: Loaded precompiled view in %d µs",
+	  rstr_get(url), (int)ts);
+    return sof;
+  }
+
+  memset(&deps, 0, sizeof(deps));
+
+  if((sof = glw_view_parse_file(gr, url, ei, &deps)) != NULL) {
+    ts = showtime_get_ts() - ts;
+    gr->gr_views_parsed++;
+    gr->gr_views_parse_time += ts;
+    TRACE(TRACE_DEBUG, "GLW", "%s: Parsed view in %d µs",
+	  rstr_get(url), (int)ts);
+
+    glw_view_bincache_store(url, sof, &deps);
+  }
+
+  glw_view_deps_free(&deps);
+  return sof;
+}
+
+
 /**
  *
  */
@@ -134,50 +257,32 @@ glw_view_create(glw_root_t *gr, rstr_t *url,
 		glw_t *parent, prop_t *prop, prop_t *prop_parent, prop_t *args,
 		prop_t *prop_clone, int cache)
 {
-  token_t *eof, *l, *t;
+  token_t *sof, *t;
   errorinfo_t ei;
   glw_t *r;
   glw_view_eval_context_t ec;
   glw_cached_view_t *gcv;
   glw_view_t *v;
+  int64_t ts;
+  int allocs;
 
-  LIST_FOREACH(gcv, &gr->gr_views, gcv_link) {
-    if(!strcmp(rstr_get(gcv->gcv_url), rstr_get(url)))
-      break;
-  }
-
-  if(gcv == NULL) {
-    token_t *sof = glw_view_token_alloc(gr);
-    sof->type = TOKEN_START;
-    sof->file = rstr_dup(url);
+  if((gcv = glw_view_cache_find(gr, url)) == NULL) {
 
-    if((l = glw_view_load1(gr, url, &ei, sof)) == NULL) {
-      glw_view_free_chain(gr, sof);
-      return glw_view_error(gr, &ei, parent);
-    }
-    eof = glw_view_token_alloc(gr);
-    eof->type = TOKEN_END;
-    eof->file = rstr_dup(url);
-    l->next = eof;
-  
-    if(glw_view_preproc(gr, sof, &ei) || glw_view_parse(sof, &ei, gr)) {
-      glw_view_free_chain(gr, sof);
+    if((sof = glw_view_load(gr, url, &ei)) == NULL)
       return glw_view_error(gr, &ei, parent);
-    }
 
     if(cache) {
-      gcv = malloc(sizeof(glw_cached_view_t));
-      gcv->gcv_sof = sof;
-      gcv->gcv_url = rstr_dup(url);
-      LIST_INSERT_HEAD(&gr->gr_views, gcv, gcv_link);
-      t = glw_view_clone_chain(gr, gcv->gcv_sof);
+      gcv = glw_view_cache_insert(gr, url, sof);
+      t = gcv->gcv_sof;
     } else {
       t = sof;
     }
   } else {
-    t = glw_view_clone_chain(gr, gcv->gcv_sof);
+    t = gcv->gcv_sof;
   }
 
+  ts = showtime_get_ts();
+  allocs = gr->gr_token_allocs;
 
   memset(&ec, 0, sizeof(ec));
 
@@ -195,13 +300,22 @@ glw_view_create(glw_root_t *gr, rstr_t *url,
   ec.prop_clone = prop_clone;
   v->viewprop = ec.prop_viewx = prop_create_root(NULL);
   ec.sublist = &ec.w->glw_prop_subscriptions;
+  ec.shared = gcv != NULL;
 
   if(glw_view_eval_block(t, &ec)) {
     glw_destroy(ec.w);
-    glw_view_free_chain(gr, t);
+    if(gcv == NULL)
+      glw_view_free_chain(gr, t);
     return glw_view_error(gr, &ei, parent);
   }
-  glw_view_free_chain(gr, t);
+
+  if(gcv == NULL) {
+    glw_view_free_chain(gr, t);
+  } else {
+    gcv->gcv_instances++;
+    gcv->gcv_tokens += gr->gr_token_allocs - allocs;
+    gcv->gcv_time += showtime_get_ts() - ts;
+  }
   return r;
 }
 
@@ -213,11 +327,47 @@ void
 glw_view_cache_flush(glw_root_t *gr)
 {
   glw_cached_view_t *gcv;
+  int i;
+
+  for(i = 0; i < GLW_VIEW_HASH_SIZE; i++) {
+    while((gcv = LIST_FIRST(&gr->gr_views[i])) != NULL) {
+      glw_view_free_chain(gr, gcv->gcv_sof);
+      rstr_release(gcv->gcv_url);
+      prop_destroy(gcv->gcv_prop);
+      LIST_REMOVE(gcv, gcv_link);
+      free(gcv);
+    }
+  }
+}
 
-  while((gcv = LIST_FIRST(&gr->gr_views)) != NULL) {
-    glw_view_free_chain(gr, gcv->gcv_sof);
-    rstr_release(gcv->gcv_url);
-    LIST_REMOVE(gcv, gcv_link);
-    free(gcv);
+
+/**
+ * Publish load and per view instantiation stats
+ */
+void
+glw_view_update_stats(glw_root_t *gr)
+{
+  glw_cached_view_t *gcv;
+  prop_t *p = prop_create(gr->gr_uii.uii_prop, "views");
+  int i;
+
+  prop_set_int(prop_create(p, "parsed"), gr->gr_views_parsed);
+  prop_set_float(prop_create(p, "parseTime"),
+		 gr->gr_views_parse_time / 1000.0);
+  prop_set_int(prop_create(p, "precompiled"), gr->gr_views_precompiled);
+  prop_set_float(prop_create(p, "precompiledLoadTime"),
+		 gr->gr_views_precompiled_time / 1000.0);
+
+  for(i = 0; i < GLW_VIEW_HASH_SIZE; i++) {
+    LIST_FOREACH(gcv, &gr->gr_views[i], gcv_link) {
+      prop_set_int(prop_create(gcv->gcv_prop, "instances"),
+		   gcv->gcv_instances);
+      prop_set_int(prop_create(gcv->gcv_prop, "tokens"), gcv->gcv_tokens);
+      prop_set_float(prop_create(gcv->gcv_prop, "tokensPerInstance"),
+		     gcv->gcv_instances ?
+		     (float)gcv->gcv_tokens / gcv->gcv_instances : 0);
+      prop_set_float(prop_create(gcv->gcv_prop, "instantiateTime"),
+		     gcv->gcv_time / 1000.0);
+    }
   }
 }
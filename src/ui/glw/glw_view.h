@@ -90,6 +90,17 @@ typedef enum {
 } token_type_t;
 
 
+/**
+ * Compiled form of an RPN expression, one opcode per token in its
+ * chain. Shared between an expression and its clones
+ */
+typedef struct glw_view_code {
+  int gvc_refcount;
+  int gvc_depth;       // Max depth of value stack
+  uint8_t gvc_ops[0];
+} glw_view_code_t;
+
+
 /**
  *
  */
@@ -106,9 +117,13 @@ typedef struct token {
   token_type_t type;
   int t_num_args;
 
+  int t_flags;
+#define TOKEN_F_SHAREABLE 0x1 // Can be evaluated straight from a cached view
+
   union {
     int elements;
     void *extra;
+    struct glw_view_code *code;  // TOKEN_RPN
     double f;
     int args;
     int i;
@@ -116,6 +131,7 @@ typedef struct token {
 
 #define t_elements    arg.elements
 #define t_extra       arg.extra
+#define t_code        arg.code
 #define t_extra_float arg.f
 #define t_extra_int   arg.i
 
@@ -184,11 +200,27 @@ typedef struct errorinfo {
 
 
 
+/**
+ * Files that went into a parsed view, see glw_view_bincache.c
+ */
+typedef struct glw_view_dep {
+  rstr_t *gvd_url;
+  uint8_t gvd_digest[20];
+} glw_view_dep_t;
+
+typedef struct glw_view_deps {
+  int gvds_num;
+  glw_view_dep_t *gvds_vec;
+} glw_view_deps_t;
+
+
 /**
  *
  */
 typedef struct glw_view_eval_context {
-  token_t *stack;
+  token_t **stack;
+  int stack_depth;
+  int stack_size;
   errorinfo_t *ei;
   token_t *alloc;
   struct glw *w;
@@ -216,6 +248,8 @@ typedef struct glw_view_eval_context {
 
   int debug;
 
+  int shared;  // Tokens belong to a cached view and must not be modified
+
 } glw_view_eval_context_t;
 
 
@@ -246,6 +280,8 @@ typedef struct token_func {
 	    struct token **argv, unsigned int argc);
   void (*ctor)(struct token *self);
   void (*dtor)(glw_root_t *gr, struct token *self);
+  int flags;
+#define GLW_VIEW_FUNC_PURE 0x1 // No per token state, never dynamic
 } token_func_t;
 
 
@@ -267,8 +303,8 @@ void glw_view_token_free(glw_root_t *gr, token_t *t);
 
 token_t *glw_view_token_copy(glw_root_t *gr, token_t *src);
 
-token_t *glw_view_lexer(const char *src, errorinfo_t *ei, 
-			 rstr_t *f, token_t *prev);
+token_t *glw_view_lexer(glw_root_t *gr, const char *src, errorinfo_t *ei,
+			rstr_t *f, token_t *prev);
 
 
 token_t *glw_view_load1(glw_root_t *gr, rstr_t *url,
@@ -296,6 +332,31 @@ token_t *glw_view_clone_chain(glw_root_t *gr, token_t *src);
 
 void glw_view_cache_flush(glw_root_t *gr);
 
+void glw_view_update_stats(glw_root_t *gr);
+
+void glw_view_mark_shareable(token_t *t);
+
+void glw_view_compile(glw_root_t *gr, token_t *t);
+
+void glw_view_code_release(glw_view_code_t *gvc);
+
+int glw_view_bench(void);
+
+token_t *glw_view_parse_file(glw_root_t *gr, rstr_t *url, errorinfo_t *ei,
+			     glw_view_deps_t *deps);
+
+void glw_view_deps_add(glw_view_deps_t *gvds, rstr_t *url,
+		       const void *data, size_t len);
+
+void glw_view_deps_free(glw_view_deps_t *gvds);
+
+token_t *glw_view_bincache_load(glw_root_t *gr, rstr_t *url);
+
+void glw_view_bincache_store(rstr_t *url, const token_t *sof,
+			     const glw_view_deps_t *deps);
+
+int glw_view_precompile(const char *theme);
+
 struct glw_prop_sub_list;
 void glw_prop_subscription_destroy_list(glw_root_t *gr, 
 					struct glw_prop_sub_list *l);
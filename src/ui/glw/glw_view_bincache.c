@@ -0,0 +1,874 @@
+/*
+ *  GL Widgets, Precompiled views
+ *  Copyright (C) 2012 Andreas Öman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "showtime.h"
+#include "glw.h"
+#include "glw_view.h"
+#include "blobcache.h"
+#include "fileaccess/fileaccess.h"
+#include "htsmsg/htsbuf.h"
+#include "metadata/metadata.h"
+#include "misc/sha.h"
+#include "misc/fs.h"
+
+/**
+ * Views are stored fully preprocessed and parsed together with the
+ * digest of every file that went into them (the view itself and
+ * everything it #include's or #import's). An entry is only used if
+ * it was written by the same format and theme version and none of
+ * those files have changed.
+ *
+ * Entries are looked for in the theme itself, put there at build time
+ * by 'showtime --precompile-views <themedir>', and in the blobcache
+ * where views that had to be parsed at runtime end up.
+ *
+ * The theme ships with the binary so its version is the same as ours.
+ *
+ * All integers are little endian
+ */
+
+#define GVB_MAGIC    0x56574c47  // 'GLWV'
+#define GVB_VERSION  1
+#define GVB_STASH    "glwviews"
+#define GVB_DIR      "viewcache"
+#define GVB_MAXAGE   (86400 * 365)
+#define GVB_NOFILE   0xffffffff
+
+
+/**
+ *
+ */
+void
+glw_view_deps_add(glw_view_deps_t *gvds, rstr_t *url,
+		  const void *data, size_t len)
+{
+  glw_view_dep_t *gvd;
+  sha1_decl(shactx);
+
+  gvds->gvds_vec = realloc(gvds->gvds_vec,
+			   (gvds->gvds_num + 1) * sizeof(glw_view_dep_t));
+  gvd = &gvds->gvds_vec[gvds->gvds_num++];
+  gvd->gvd_url = rstr_dup(url);
+
+  sha1_init(shactx);
+  sha1_update(shactx, data, len);
+  sha1_final(shactx, gvd->gvd_digest);
+}
+
+
+/**
+ *
+ */
+void
+glw_view_deps_free(glw_view_deps_t *gvds)
+{
+  int i;
+  for(i = 0; i < gvds->gvds_num; i++)
+    rstr_release(gvds->gvds_vec[i].gvd_url);
+  free(gvds->gvds_vec);
+  gvds->gvds_vec = NULL;
+  gvds->gvds_num = 0;
+}
+
+
+/**
+ * Name of entry in the theme's cache directory
+ */
+static void
+gvb_filename(char *out, size_t outlen, rstr_t *url)
+{
+  uint8_t d[20];
+  sha1_decl(shactx);
+  int i;
+
+  sha1_init(shactx);
+  sha1_update(shactx, (const void *)rstr_get(url), strlen(rstr_get(url)));
+  sha1_final(shactx, d);
+
+  for(i = 0; i < 20 && outlen > 2; i++, outlen -= 2, out += 2)
+    snprintf(out, outlen, "%02x", d[i]);
+}
+
+
+/**
+ *
+ */
+typedef struct gvb_writer {
+  htsbuf_queue_t w_hq;
+  rstr_t **w_files;
+  int w_num_files;
+  int w_error;
+} gvb_writer_t;
+
+
+/**
+ *
+ */
+static void
+gvb_put_u8(htsbuf_queue_t *hq, int v)
+{
+  uint8_t b = v;
+  htsbuf_append(hq, &b, 1);
+}
+
+
+/**
+ *
+ */
+static void
+gvb_put_u32(htsbuf_queue_t *hq, uint32_t v)
+{
+  uint8_t b[4] = {v, v >> 8, v >> 16, v >> 24};
+  htsbuf_append(hq, b, 4);
+}
+
+
+/**
+ *
+ */
+static void
+gvb_put_float(htsbuf_queue_t *hq, float f)
+{
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  gvb_put_u32(hq, u);
+}
+
+
+/**
+ *
+ */
+static void
+gvb_put_str(htsbuf_queue_t *hq, const char *s)
+{
+  int len = strlen(s);
+  gvb_put_u32(hq, len);
+  htsbuf_append(hq, s, len);
+}
+
+
+/**
+ * All tokens from a file share the same rstr so this is mostly
+ * pointer compares
+ */
+static int
+gvb_file_index(gvb_writer_t *w, rstr_t *file)
+{
+  int i;
+
+  if(file == NULL)
+    return GVB_NOFILE;
+
+  for(i = 0; i < w->w_num_files; i++)
+    if(w->w_files[i] == file ||
+       !strcmp(rstr_get(w->w_files[i]), rstr_get(file)))
+      return i;
+
+  w->w_files = realloc(w->w_files, (i + 1) * sizeof(rstr_t *));
+  w->w_files[i] = file;
+  w->w_num_files++;
+  return i;
+}
+
+
+/**
+ *
+ */
+static void
+gvb_write_chain(gvb_writer_t *w, const token_t *t)
+{
+  htsbuf_queue_t *hq = &w->w_hq;
+  rstr_t *key;
+  int i;
+
+  for(; t != NULL && !w->w_error; t = t->next) {
+    gvb_put_u8(hq, t->type + 1);
+    gvb_put_u32(hq, gvb_file_index(w, t->file));
+    gvb_put_u32(hq, t->line);
+
+    switch(t->type) {
+    case TOKEN_FLOAT:
+      gvb_put_float(hq, t->t_float);
+      break;
+
+    case TOKEN_INT:
+      gvb_put_u32(hq, t->t_int);
+      break;
+
+    case TOKEN_RSTRING:
+      gvb_put_u8(hq, t->t_rstrtype);
+      // FALLTHRU
+    case TOKEN_IDENTIFIER:
+    case TOKEN_PROPERTY_VALUE_NAME:
+    case TOKEN_PROPERTY_CANONICAL_NAME:
+      gvb_put_str(hq, rstr_get(t->t_rstring));
+      break;
+
+    case TOKEN_FUNCTION:
+      gvb_put_str(hq, t->t_func->name);
+      gvb_put_u32(hq, t->t_num_args);
+      break;
+
+    case TOKEN_LEFT_BRACKET:
+      gvb_put_u32(hq, t->t_num_args);
+      break;
+
+    case TOKEN_OBJECT_ATTRIBUTE:
+      gvb_put_str(hq, t->t_attrib->name);
+      break;
+
+    case TOKEN_VECTOR_FLOAT:
+      gvb_put_u8(hq, t->t_elements);
+      for(i = 0; i < 4; i++)
+	gvb_put_float(hq, t->t_float_vector_int[i]);
+      break;
+
+    case TOKEN_PROPERTY_REF:
+      // The parser only creates these for _("...")
+      if((key = nls_get_key(t->t_prop)) == NULL) {
+	w->w_error = 1;
+	break;
+      }
+      gvb_put_str(hq, rstr_get(key));
+      rstr_release(key);
+      break;
+
+    case TOKEN_START:
+    case TOKEN_END:
+    case TOKEN_HASH:
+    case TOKEN_ASSIGNMENT:
+    case TOKEN_COND_ASSIGNMENT:
+    case TOKEN_END_OF_EXPR:
+    case TOKEN_SEPARATOR:
+    case TOKEN_BLOCK_OPEN:
+    case TOKEN_BLOCK_CLOSE:
+    case TOKEN_LEFT_PARENTHESIS:
+    case TOKEN_RIGHT_PARENTHESIS:
+    case TOKEN_RIGHT_BRACKET:
+    case TOKEN_DOT:
+    case TOKEN_ADD:
+    case TOKEN_SUB:
+    case TOKEN_MULTIPLY:
+    case TOKEN_DIVIDE:
+    case TOKEN_MODULO:
+    case TOKEN_DOLLAR:
+    case TOKEN_AMPERSAND:
+    case TOKEN_BOOLEAN_AND:
+    case TOKEN_BOOLEAN_OR:
+    case TOKEN_BOOLEAN_XOR:
+    case TOKEN_BOOLEAN_NOT:
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+    case TOKEN_NULL_COALESCE:
+    case TOKEN_LT:
+    case TOKEN_GT:
+    case TOKEN_COLON:
+    case TOKEN_EXPR:
+    case TOKEN_RPN:
+    case TOKEN_BLOCK:
+    case TOKEN_NOP:
+    case TOKEN_VOID:
+      break;
+
+    default:
+      // Runtime only tokens, can't be stored
+      w->w_error = 1;
+      break;
+    }
+
+    gvb_write_chain(w, t->child);
+  }
+  gvb_put_u8(hq, 0);
+}
+
+
+/**
+ * Returns malloc'ed buffer or NULL if the view can't be stored
+ */
+static void *
+gvb_serialize(const token_t *sof, const glw_view_deps_t *gvds, size_t *sizep)
+{
+  gvb_writer_t w;
+  htsbuf_queue_t hq;
+  void *data = NULL;
+  int i;
+
+  memset(&w, 0, sizeof(w));
+  htsbuf_queue_init(&w.w_hq, 0);
+  gvb_write_chain(&w, sof);
+
+  if(!w.w_error) {
+    htsbuf_queue_init(&hq, 0);
+    gvb_put_u32(&hq, GVB_MAGIC);
+    gvb_put_u32(&hq, GVB_VERSION);
+    gvb_put_str(&hq, htsversion);
+
+    gvb_put_u32(&hq, gvds->gvds_num);
+    for(i = 0; i < gvds->gvds_num; i++) {
+      gvb_put_str(&hq, rstr_get(gvds->gvds_vec[i].gvd_url));
+      htsbuf_append(&hq, gvds->gvds_vec[i].gvd_digest, 20);
+    }
+
+    gvb_put_u32(&hq, w.w_num_files);
+    for(i = 0; i < w.w_num_files; i++)
+      gvb_put_str(&hq, rstr_get(w.w_files[i]));
+
+    htsbuf_appendq(&hq, &w.w_hq);
+
+    *sizep = hq.hq_size;
+    data = malloc(hq.hq_size);
+    htsbuf_read(&hq, data, hq.hq_size);
+  }
+
+  htsbuf_queue_flush(&w.w_hq);
+  free(w.w_files);
+  return data;
+}
+
+
+/**
+ *
+ */
+void
+glw_view_bincache_store(rstr_t *url, const token_t *sof,
+			const glw_view_deps_t *deps)
+{
+  size_t size;
+  void *data = gvb_serialize(sof, deps, &size);
+
+  if(data == NULL)
+    return;
+
+  blobcache_put(rstr_get(url), GVB_STASH, data, size, GVB_MAXAGE, NULL, 0);
+  free(data);
+}
+
+
+/**
+ *
+ */
+typedef struct gvb_reader {
+  const uint8_t *r_ptr;
+  const uint8_t *r_end;
+  int r_error;
+  rstr_t **r_files;
+  int r_num_files;
+} gvb_reader_t;
+
+
+/**
+ *
+ */
+static const uint8_t *
+gvb_get(gvb_reader_t *r, size_t len)
+{
+  const uint8_t *p = r->r_ptr;
+
+  if(r->r_error || r->r_end - r->r_ptr < len) {
+    r->r_error = 1;
+    return NULL;
+  }
+  r->r_ptr += len;
+  return p;
+}
+
+
+/**
+ *
+ */
+static int
+gvb_get_u8(gvb_reader_t *r)
+{
+  const uint8_t *p = gvb_get(r, 1);
+  return p ? p[0] : 0;
+}
+
+
+/**
+ *
+ */
+static uint32_t
+gvb_get_u32(gvb_reader_t *r)
+{
+  const uint8_t *p = gvb_get(r, 4);
+  return p ? p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24 : 0;
+}
+
+
+/**
+ *
+ */
+static float
+gvb_get_float(gvb_reader_t *r)
+{
+  uint32_t u = gvb_get_u32(r);
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+
+/**
+ *
+ */
+static rstr_t *
+gvb_get_rstr(gvb_reader_t *r)
+{
+  uint32_t len = gvb_get_u32(r);
+  const uint8_t *p = gvb_get(r, len);
+  return p ? rstr_allocl((const char *)p, len) : NULL;
+}
+
+
+/**
+ * Check that a string matches without allocating it
+ */
+static int
+gvb_match_str(gvb_reader_t *r, const char *str)
+{
+  uint32_t len = gvb_get_u32(r);
+  const uint8_t *p = gvb_get(r, len);
+  return p != NULL && len == strlen(str) && !memcmp(p, str, len);
+}
+
+
+/**
+ *
+ */
+static token_t *
+gvb_read_chain(glw_root_t *gr, gvb_reader_t *r)
+{
+  token_t *head = NULL, **pp = &head, *t;
+  uint32_t file;
+  rstr_t *str;
+  int type, i;
+
+  while(!r->r_error && (type = gvb_get_u8(r)) != 0) {
+
+    t = glw_view_token_alloc(gr);
+    t->type = TOKEN_NOP; // Until fully constructed
+    *pp = t;
+    pp = &t->next;
+
+    type--;
+    file = gvb_get_u32(r);
+    if(file < r->r_num_files)
+      t->file = rstr_dup(r->r_files[file]);
+    t->line = gvb_get_u32(r);
+
+    switch(type) {
+    case TOKEN_FLOAT:
+      t->t_float = gvb_get_float(r);
+      break;
+
+    case TOKEN_INT:
+      t->t_int = gvb_get_u32(r);
+      break;
+
+    case TOKEN_RSTRING:
+      t->t_rstrtype = gvb_get_u8(r);
+      // FALLTHRU
+    case TOKEN_IDENTIFIER:
+    case TOKEN_PROPERTY_VALUE_NAME:
+    case TOKEN_PROPERTY_CANONICAL_NAME:
+      if((t->t_rstring = gvb_get_rstr(r)) == NULL)
+	continue;
+      break;
+
+    case TOKEN_FUNCTION:
+      if((t->t_rstring = gvb_get_rstr(r)) == NULL)
+	continue;
+      t->t_num_args = gvb_get_u32(r);
+      t->type = TOKEN_IDENTIFIER;
+      if(glw_view_function_resolve(t))
+	r->r_error = 1;
+      break;
+
+    case TOKEN_OBJECT_ATTRIBUTE:
+      if((t->t_rstring = gvb_get_rstr(r)) == NULL)
+	continue;
+      t->type = TOKEN_IDENTIFIER;
+      if(glw_view_attrib_resolve(t))
+	r->r_error = 1;
+      break;
+
+    case TOKEN_LEFT_BRACKET:
+      t->t_num_args = gvb_get_u32(r);
+      break;
+
+    case TOKEN_VECTOR_FLOAT:
+      t->t_elements = gvb_get_u8(r);
+      for(i = 0; i < 4; i++)
+	t->t_float_vector_int[i] = gvb_get_float(r);
+      break;
+
+    case TOKEN_PROPERTY_REF:
+      if((str = gvb_get_rstr(r)) == NULL)
+	continue;
+      t->t_prop = prop_ref_inc(nls_get_prop(rstr_get(str)));
+      rstr_release(str);
+      break;
+
+    case TOKEN_START:
+    case TOKEN_END:
+    case TOKEN_HASH:
+    case TOKEN_ASSIGNMENT:
+    case TOKEN_COND_ASSIGNMENT:
+    case TOKEN_END_OF_EXPR:
+    case TOKEN_SEPARATOR:
+    case TOKEN_BLOCK_OPEN:
+    case TOKEN_BLOCK_CLOSE:
+    case TOKEN_LEFT_PARENTHESIS:
+    case TOKEN_RIGHT_PARENTHESIS:
+    case TOKEN_RIGHT_BRACKET:
+    case TOKEN_DOT:
+    case TOKEN_ADD:
+    case TOKEN_SUB:
+    case TOKEN_MULTIPLY:
+    case TOKEN_DIVIDE:
+    case TOKEN_MODULO:
+    case TOKEN_DOLLAR:
+    case TOKEN_AMPERSAND:
+    case TOKEN_BOOLEAN_AND:
+    case TOKEN_BOOLEAN_OR:
+    case TOKEN_BOOLEAN_XOR:
+    case TOKEN_BOOLEAN_NOT:
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+    case TOKEN_NULL_COALESCE:
+    case TOKEN_LT:
+    case TOKEN_GT:
+    case TOKEN_COLON:
+    case TOKEN_EXPR:
+    case TOKEN_RPN:
+    case TOKEN_BLOCK:
+    case TOKEN_NOP:
+    case TOKEN_VOID:
+      break;
+
+    default:
+      r->r_error = 1;
+      continue;
+    }
+
+    if(r->r_error)
+      continue;
+
+    t->type = type;
+    t->child = gvb_read_chain(gr, r);
+  }
+  return head;
+}
+
+
+/**
+ * Check that all files that went into the view are unchanged
+ */
+static int
+gvb_deps_valid(glw_root_t *gr, gvb_reader_t *r)
+{
+  int i, num = gvb_get_u32(r);
+  const uint8_t *digest;
+  uint8_t d[20];
+  char errbuf[256];
+  rstr_t *url;
+  size_t size;
+  void *data;
+  sha1_decl(shactx);
+
+  for(i = 0; i < num && !r->r_error; i++) {
+    if((url = gvb_get_rstr(r)) == NULL || (digest = gvb_get(r, 20)) == NULL)
+      return 0;
+
+    data = fa_load(rstr_get(url), &size, gr->gr_vpaths, errbuf, sizeof(errbuf),
+		   NULL, 0, NULL, NULL);
+    rstr_release(url);
+    if(data == NULL)
+      return 0;
+
+    sha1_init(shactx);
+    sha1_update(shactx, data, size);
+    sha1_final(shactx, d);
+    free(data);
+
+    if(memcmp(d, digest, 20))
+      return 0;
+  }
+  return !r->r_error;
+}
+
+
+/**
+ *
+ */
+static token_t *
+gvb_load(glw_root_t *gr, const void *data, size_t size)
+{
+  gvb_reader_t r;
+  token_t *sof = NULL;
+  int i;
+
+  memset(&r, 0, sizeof(r));
+  r.r_ptr = data;
+  r.r_end = data + size;
+
+  if(gvb_get_u32(&r) != GVB_MAGIC || gvb_get_u32(&r) != GVB_VERSION ||
+     !gvb_match_str(&r, htsversion) || !gvb_deps_valid(gr, &r))
+    return NULL;
+
+  r.r_num_files = gvb_get_u32(&r);
+  if(r.r_error || r.r_num_files > r.r_end - r.r_ptr)
+    return NULL;
+
+  r.r_files = calloc(r.r_num_files, sizeof(rstr_t *));
+  for(i = 0; i < r.r_num_files; i++)
+    r.r_files[i] = gvb_get_rstr(&r);
+
+  if(!r.r_error)
+    sof = gvb_read_chain(gr, &r);
+
+  if(sof != NULL && (r.r_error || sof->type != TOKEN_START ||
+		     sof->next != NULL)) {
+    glw_view_free_chain(gr, sof);
+    sof = NULL;
+  }
+
+  for(i = 0; i < r.r_num_files; i++)
+    rstr_release(r.r_files[i]);
+  free(r.r_files);
+
+  if(sof != NULL)
+    glw_view_compile(gr, sof);
+  return sof;
+}
+
+
+/**
+ * Get a parsed view from the theme's precompiled views or the
+ * blobcache. Returns NULL if there is no valid entry
+ */
+token_t *
+glw_view_bincache_load(glw_root_t *gr, rstr_t *url)
+{
+  char path[64], errbuf[256];
+  token_t *sof = NULL;
+  size_t size;
+  void *data;
+
+  strcpy(path, "theme://"GVB_DIR"/");
+  gvb_filename(path + strlen(path), sizeof(path) - strlen(path), url);
+
+  data = fa_load(path, &size, gr->gr_vpaths, errbuf, sizeof(errbuf),
+		 NULL, 0, NULL, NULL);
+  if(data != NULL) {
+    sof = gvb_load(gr, data, size);
+    free(data);
+    if(sof != NULL)
+      return sof;
+  }
+
+  data = blobcache_get(rstr_get(url), GVB_STASH, &size, 0, NULL, NULL, NULL);
+  if(data != NULL) {
+    sof = gvb_load(gr, data, size);
+    free(data);
+  }
+  return sof;
+}
+
+
+/**
+ *
+ */
+typedef struct gvb_precompile {
+  glw_root_t *p_gr;
+  const char *p_theme;
+  int p_views;
+  int p_failed;
+  int64_t p_parse_time;
+  int64_t p_load_time;
+} gvb_precompile_t;
+
+
+/**
+ * Parse view, store it in the theme and load it back again to compare
+ * cold and precompiled load times
+ */
+static void
+gvb_precompile_view(gvb_precompile_t *p, const char *rel)
+{
+  glw_root_t *gr = p->p_gr;
+  char path[PATH_MAX], buf[PATH_MAX + sizeof("theme://")];
+  glw_view_deps_t deps;
+  errorinfo_t ei;
+  token_t *sof;
+  int64_t ts, parse, load;
+  size_t size;
+  void *data;
+  FILE *fp;
+  int err;
+
+  snprintf(buf, sizeof(buf), "theme://%s", rel);
+  rstr_t *url = rstr_alloc(buf);
+
+  memset(&deps, 0, sizeof(deps));
+  ts = showtime_get_ts();
+  sof = glw_view_parse_file(gr, url, &ei, &deps);
+  parse = showtime_get_ts() - ts;
+
+  if(sof == NULL) {
+    // Fragments that only work when included by other views end up here
+    TRACE(TRACE_DEBUG, "GLW", "%s: Not precompiled -- %s:%d: %s",
+	  rel, ei.file, ei.line, ei.error);
+    goto out;
+  }
+
+  data = gvb_serialize(sof, &deps, &size);
+  glw_view_free_chain(gr, sof);
+
+  if(data == NULL) {
+    TRACE(TRACE_ERROR, "GLW", "%s: Unable to serialize", rel);
+    p->p_failed++;
+    goto out;
+  }
+
+  snprintf(path, sizeof(path), "%s/"GVB_DIR"/", p->p_theme);
+  gvb_filename(path + strlen(path), sizeof(path) - strlen(path), url);
+
+  if((fp = fopen(path, "wb")) != NULL) {
+    err = fwrite(data, size, 1, fp) != 1;
+    if(fclose(fp))
+      err = 1;
+  } else {
+    err = 1;
+  }
+  free(data);
+
+  if(err) {
+    TRACE(TRACE_ERROR, "GLW", "%s: Unable to write %s -- %s",
+	  rel, path, strerror(errno));
+    p->p_failed++;
+    goto out;
+  }
+
+  ts = showtime_get_ts();
+  sof = glw_view_bincache_load(gr, url);
+  load = showtime_get_ts() - ts;
+
+  if(sof == NULL) {
+    TRACE(TRACE_ERROR, "GLW", "%s: Precompiled view does not load", rel);
+    p->p_failed++;
+    goto out;
+  }
+  glw_view_free_chain(gr, sof);
+
+  TRACE(TRACE_DEBUG, "GLW", "%s: Parsed in %d µs, precompiled in %d µs",
+	rel, (int)parse, (int)load);
+
+  p->p_views++;
+  p->p_parse_time += parse;
+  p->p_load_time += load;
+
+ out:
+  glw_view_deps_free(&deps);
+  rstr_release(url);
+}
+
+
+/**
+ *
+ */
+static void
+gvb_precompile_dir(gvb_precompile_t *p, const char *rel)
+{
+  char path[PATH_MAX], sub[PATH_MAX], errbuf[256];
+  fa_dir_entry_t *fde;
+  const char *name;
+  fa_dir_t *fd;
+  int len;
+
+  snprintf(path, sizeof(path), "%s/%s", p->p_theme, rel);
+  if((fd = fa_scandir(path, errbuf, sizeof(errbuf))) == NULL) {
+    TRACE(TRACE_ERROR, "GLW", "Unable to scan %s -- %s", path, errbuf);
+    p->p_failed++;
+    return;
+  }
+
+  TAILQ_FOREACH(fde, &fd->fd_entries, fde_link) {
+    name = rstr_get(fde->fde_filename);
+    snprintf(sub, sizeof(sub), "%s%s%s", rel, *rel ? "/" : "", name);
+
+    if(fde->fde_type == CONTENT_DIR) {
+      if(strcmp(name, GVB_DIR))
+	gvb_precompile_dir(p, sub);
+      continue;
+    }
+
+    len = strlen(name);
+    if(len > 5 && !strcmp(name + len - 5, ".view"))
+      gvb_precompile_view(p, sub);
+  }
+  fa_dir_free(fd);
+}
+
+
+/**
+ * Precompile all views in a theme directory. Run at build time so
+ * the theme can ship with its views already parsed
+ */
+int
+glw_view_precompile(const char *theme)
+{
+  glw_root_t *gr = calloc(1, sizeof(glw_root_t));
+  gvb_precompile_t p;
+  char path[PATH_MAX];
+  int r;
+
+  snprintf(path, sizeof(path), "%s/"GVB_DIR, theme);
+  if((r = makedirs(path)) != 0) {
+    TRACE(TRACE_ERROR, "GLW", "Unable to create %s -- %s",
+	  path, strerror(r));
+    free(gr);
+    return 1;
+  }
+
+  gr->gr_token_pool = pool_create("glwtokens", sizeof(token_t), POOL_ZERO_MEM);
+  gr->gr_vpaths[0] = "theme";
+  gr->gr_vpaths[1] = theme;
+  gr->gr_vpaths[2] = NULL;
+
+  memset(&p, 0, sizeof(p));
+  p.p_gr = gr;
+  p.p_theme = theme;
+
+  gvb_precompile_dir(&p, "");
+
+  TRACE(TRACE_INFO, "GLW",
+	"Precompiled %d views in %s, %d failed. "
+	"Parse time: %d ms, precompiled load time: %d ms",
+	p.p_views, path, p.p_failed,
+	(int)(p.p_parse_time / 1000), (int)(p.p_load_time / 1000));
+
+  pool_destroy(gr->gr_token_pool);
+  free(gr);
+  return p.p_failed ? 1 : 0;
+}
@@ -218,13 +218,16 @@ static void eval_dynamic(glw_t *w, token_t *rpn, struct glw_rctx *rc,
 static int glw_view_eval_rpn0(token_t *t0, glw_view_eval_context_t *ec);
 
 /**
- *
+ * The value stack is sized by glw_view_lower() so it can't overflow
+ * for well formed expressions. If it does anyway the pushed value is
+ * lost and the consumer will complain about a missing operand
  */
 static void
 eval_push(glw_view_eval_context_t *ec, token_t *t)
 {
-  t->tmp = ec->stack;
-  ec->stack = t;
+  if(ec->stack_depth < ec->stack_size)
+    ec->stack[ec->stack_depth] = t;
+  ec->stack_depth++;
 }
 
 
@@ -234,10 +237,10 @@ eval_push(glw_view_eval_context_t *ec, token_t *t)
 static token_t *
 eval_pop(glw_view_eval_context_t *ec)
 {
-  token_t *r = ec->stack;
-  if(r != NULL)
-    ec->stack = r->tmp;
-  return r;
+  if(ec->stack_depth == 0)
+    return NULL;
+  ec->stack_depth--;
+  return ec->stack_depth < ec->stack_size ? ec->stack[ec->stack_depth] : NULL;
 }
 
 /**
@@ -803,6 +806,7 @@ eval_assign(glw_view_eval_context_t *ec, struct token *self, int conditional)
     n.gr = ec->gr;
     n.rc = ec->rc;
     n.sublist = ec->sublist;
+    n.shared = ec->shared;
 
     n.tgtprop = prop_create_root(NULL);
 
@@ -957,6 +961,7 @@ eval_dynamic(glw_t *w, token_t *rpn, struct glw_rctx *rc,
 	     prop_t *prop, prop_t *view, prop_t *clone)
 {
   glw_view_eval_context_t ec;
+  int64_t ts = w->glw_root->gr_profile ? showtime_get_ts() : 0;
 
   memset(&ec, 0, sizeof(ec));
   ec.w = w;
@@ -972,6 +977,9 @@ eval_dynamic(glw_t *w, token_t *rpn, struct glw_rctx *rc,
 
   glw_view_free_chain(ec.gr, ec.alloc);
 
+  if(ts)
+    ec.gr->gr_profile_eval += showtime_get_ts() - ts;
+
   if(ec.dynamic_eval & GLW_VIEW_DYNAMIC_EVAL_EVERY_FRAME)
     glw_signal_handler_register(w, eval_dynamic_every_frame_sig, rpn, 1000);
   else
@@ -1840,12 +1848,7 @@ invoke_func(glw_view_eval_context_t *ec, token_t *t)
   token_t **vec;
   int i;
 
-  if(t->t_func->nargs >= 0 && t->t_func->nargs != t->t_num_args) {
-    glw_view_seterr(ec->ei, t, "%s(): Invalid number of arguments: %d, "
-		     "expected %d", t->t_func->name, t->t_num_args,
-		     t->t_func->nargs);
-    return -1;
-  }
+  // Number of arguments is checked by glw_view_lower()
 
   if(t->t_num_args == 0)
     return t->t_func->cb(ec, t, NULL, 0);
@@ -1868,10 +1871,6 @@ make_vector(glw_view_eval_context_t *ec, token_t *t)
   token_t *a, *r;
   int i;
 
-  if(t->t_num_args < 1 || t->t_num_args > 4)
-    return glw_view_seterr(ec->ei, t, "Invalid vector length (%d)",
-			   t->t_num_args);
-
   r = eval_alloc(t, ec, TOKEN_VECTOR_FLOAT);
   r->t_elements = t->t_num_args;
  
@@ -1886,101 +1885,365 @@ make_vector(glw_view_eval_context_t *ec, token_t *t)
 
 
 
+/**
+ * Opcodes of compiled RPN expressions. There is one for each token in
+ * the expression, stored in the glw_view_code_t of the TOKEN_RPN
+ */
+enum {
+  GVOP_PUSH,
+  GVOP_ARITH,
+  GVOP_BOOL,
+  GVOP_NOT,
+  GVOP_COALESCE,
+  GVOP_EQ,
+  GVOP_NEQ,
+  GVOP_LT,
+  GVOP_GT,
+  GVOP_CALL,
+  GVOP_VECTOR,
+  GVOP_ASSIGN,
+  GVOP_COND_ASSIGN,
+};
+
+
+/**
+ * Map token to opcode and the number of values it pops off the stack.
+ * Returns -1 if the token can not appear in an RPN expression
+ */
+static int
+glw_view_opcode(const token_t *t, int *popsp)
+{
+  switch(t->type) {
+  case TOKEN_BLOCK:
+  case TOKEN_RSTRING:
+  case TOKEN_CSTRING:
+  case TOKEN_LINK:
+  case TOKEN_FLOAT:
+  case TOKEN_INT:
+  case TOKEN_IDENTIFIER:
+  case TOKEN_OBJECT_ATTRIBUTE:
+  case TOKEN_VOID:
+  case TOKEN_VECTOR_FLOAT:
+  case TOKEN_PROPERTY_REF:
+  case TOKEN_PROPERTY_OWNER:
+  case TOKEN_PROPERTY_VALUE_NAME:
+  case TOKEN_PROPERTY_CANONICAL_NAME:
+  case TOKEN_PROPERTY_SUBSCRIPTION:
+    *popsp = 0;
+    return GVOP_PUSH;
+
+  case TOKEN_ADD:
+  case TOKEN_SUB:
+  case TOKEN_MULTIPLY:
+  case TOKEN_DIVIDE:
+  case TOKEN_MODULO:
+    *popsp = 2;
+    return GVOP_ARITH;
+
+  case TOKEN_BOOLEAN_OR:
+  case TOKEN_BOOLEAN_XOR:
+  case TOKEN_BOOLEAN_AND:
+    *popsp = 2;
+    return GVOP_BOOL;
+
+  case TOKEN_BOOLEAN_NOT:
+    *popsp = 1;
+    return GVOP_NOT;
+
+  case TOKEN_NULL_COALESCE:
+    *popsp = 2;
+    return GVOP_COALESCE;
+
+  case TOKEN_EQ:
+    *popsp = 2;
+    return GVOP_EQ;
+
+  case TOKEN_NEQ:
+    *popsp = 2;
+    return GVOP_NEQ;
+
+  case TOKEN_LT:
+    *popsp = 2;
+    return GVOP_LT;
+
+  case TOKEN_GT:
+    *popsp = 2;
+    return GVOP_GT;
+
+  case TOKEN_FUNCTION:
+    *popsp = t->t_num_args;
+    return GVOP_CALL;
+
+  case TOKEN_LEFT_BRACKET:
+    *popsp = t->t_num_args;
+    return GVOP_VECTOR;
+
+  case TOKEN_ASSIGNMENT:
+    *popsp = 2;
+    return GVOP_ASSIGN;
+
+  case TOKEN_COND_ASSIGNMENT:
+    *popsp = 2;
+    return GVOP_COND_ASSIGN;
+
+  default:
+    return -1;
+  }
+}
+
+
+/**
+ * Lower RPN expression to opcodes and figure out how deep the value
+ * stack can get. Function arguments and vector lengths are checked
+ * here instead of on every evaluation
+ */
+static glw_view_code_t *
+glw_view_lower(token_t *rpn, errorinfo_t *ei)
+{
+  glw_view_code_t *gvc;
+  token_t *t;
+  int n = 0, depth = 0, pops, op;
+
+  for(t = rpn->child; t != NULL; t = t->next)
+    n++;
+
+  gvc = malloc(sizeof(glw_view_code_t) + n);
+  gvc->gvc_refcount = 1;
+  gvc->gvc_depth = 1;
+
+  n = 0;
+  for(t = rpn->child; t != NULL; t = t->next) {
+
+    if((op = glw_view_opcode(t, &pops)) == -1) {
+      glw_view_seterr(ei, t, "Can not handle token %s", token2name(t));
+      goto bad;
+    }
+
+    if(op == GVOP_CALL && t->t_func->nargs >= 0 &&
+       t->t_func->nargs != t->t_num_args) {
+      glw_view_seterr(ei, t, "%s(): Invalid number of arguments: %d, "
+		      "expected %d", t->t_func->name, t->t_num_args,
+		      t->t_func->nargs);
+      goto bad;
+    }
+
+    if(op == GVOP_VECTOR && (t->t_num_args < 1 || t->t_num_args > 4)) {
+      glw_view_seterr(ei, t, "Invalid vector length (%d)", t->t_num_args);
+      goto bad;
+    }
+
+    // Everything pushes at most one value
+    depth = MAX(depth - pops, 0) + 1;
+    gvc->gvc_depth = MAX(gvc->gvc_depth, depth);
+    gvc->gvc_ops[n++] = op;
+  }
+  return gvc;
+
+ bad:
+  free(gvc);
+  return NULL;
+}
+
+
+/**
+ *
+ */
+static int
+glw_view_exec(glw_view_eval_context_t *ec, int op, token_t *t)
+{
+  switch(op) {
+  case GVOP_ARITH:       return eval_op(ec, t);
+  case GVOP_BOOL:        return eval_bool_op(ec, t);
+  case GVOP_NOT:         return eval_bool_not(ec, t);
+  case GVOP_COALESCE:    return eval_null_coalesce(ec, t);
+  case GVOP_EQ:          return eval_eq(ec, t, 0);
+  case GVOP_NEQ:         return eval_eq(ec, t, 1);
+  case GVOP_LT:          return eval_lt(ec, t, 0);
+  case GVOP_GT:          return eval_lt(ec, t, 1);
+  case GVOP_CALL:        return invoke_func(ec, t);
+  case GVOP_VECTOR:      return make_vector(ec, t);
+  case GVOP_ASSIGN:      return eval_assign(ec, t, 0);
+  case GVOP_COND_ASSIGN: return eval_assign(ec, t, 1);
+  default:
+    abort();
+  }
+}
+
+
 /**
  *
  */
 static int
 glw_view_eval_rpn0(token_t *t0, glw_view_eval_context_t *ec)
 {
+  glw_view_code_t *gvc = t0->t_code;
+  const uint8_t *op;
   token_t *t;
 
-  for(t = t0->child; t != NULL; t = t->next) {
-    switch(t->type) {
-    case TOKEN_BLOCK:
-    case TOKEN_RSTRING:
-    case TOKEN_CSTRING:
-    case TOKEN_LINK:
-    case TOKEN_FLOAT:
-    case TOKEN_INT:
-    case TOKEN_IDENTIFIER:
-    case TOKEN_OBJECT_ATTRIBUTE:
-    case TOKEN_VOID:
-    case TOKEN_PROPERTY_REF:
-    case TOKEN_PROPERTY_OWNER:
-    case TOKEN_PROPERTY_VALUE_NAME:
-    case TOKEN_PROPERTY_CANONICAL_NAME:
-    case TOKEN_PROPERTY_SUBSCRIPTION:
+  // Clones of expressions that failed to lower in glw_view_compile()
+  // end up here, as do expressions that are not part of a view
+  if(gvc == NULL && (gvc = t0->t_code = glw_view_lower(t0, ec->ei)) == NULL)
+    return -1;
+
+  ec->stack = alloca(gvc->gvc_depth * sizeof(token_t *));
+  ec->stack_size = gvc->gvc_depth;
+  ec->stack_depth = 0;
+
+  for(t = t0->child, op = gvc->gvc_ops; t != NULL; t = t->next, op++) {
+    if(*op == GVOP_PUSH)
       eval_push(ec, t);
-      break;
+    else if(glw_view_exec(ec, *op, t))
+      return -1;
+  }
+  return 0;
+}
 
-    case TOKEN_ADD:
-    case TOKEN_SUB:
-    case TOKEN_MULTIPLY:
-    case TOKEN_DIVIDE:
-    case TOKEN_MODULO:
-      if(eval_op(ec, t))
-	return -1;
-      break;
 
-    case TOKEN_BOOLEAN_OR:
-    case TOKEN_BOOLEAN_XOR:
-    case TOKEN_BOOLEAN_AND:
-      if(eval_bool_op(ec, t))
-	return -1;
-      break;
+/**
+ *
+ */
+static int
+token_is_constant(const token_t *t)
+{
+  switch(t->type) {
+  case TOKEN_FLOAT:
+  case TOKEN_INT:
+  case TOKEN_CSTRING:
+  case TOKEN_RSTRING:
+  case TOKEN_VECTOR_FLOAT:
+    return 1;
+  default:
+    return 0;
+  }
+}
 
-    case TOKEN_BOOLEAN_NOT:
-      if(eval_bool_not(ec, t))
-	return -1;
-      break;
-	
-    case TOKEN_NULL_COALESCE:
-      if(eval_null_coalesce(ec, t))
-	return -1;
-      break;
 
-    case TOKEN_EQ:
-    case TOKEN_NEQ:
-      if(eval_eq(ec, t, t->type == TOKEN_NEQ))
-	return -1;
-      break;
+/**
+ * Evaluate operator on constant operands at compile time.
+ * Returns a new token holding the result or NULL if it can't be folded
+ */
+static token_t *
+glw_view_fold_op(glw_root_t *gr, token_t *t, int op,
+		 token_t **argv, int argc)
+{
+  glw_view_eval_context_t ec;
+  errorinfo_t ei;
+  token_t *stack[4], *r = NULL;
+  int i;
 
-    case TOKEN_LT:
-    case TOKEN_GT:
-      if(eval_lt(ec, t, t->type == TOKEN_GT))
-	return -1;
-      break;
+  memset(&ec, 0, sizeof(ec));
+  ec.gr = gr;
+  ec.ei = &ei;
+  ec.stack = stack;
+  ec.stack_size = 4;
 
-    case TOKEN_FUNCTION:
-#if 0
-      printf("Invoking %s with %d arguments\n",
-	     t->t_func->name, t->t_num_args);
-#endif
-      if(invoke_func(ec, t))
-	return -1;
-      break;
+  for(i = 0; i < argc; i++)
+    eval_push(&ec, argv[i]);
 
-    case TOKEN_LEFT_BRACKET:
-      if(make_vector(ec, t))
-	return -1;
-      break;
+  if(!glw_view_exec(&ec, op, t) && ec.stack_depth == 1 && !ec.dynamic_eval)
+    r = glw_view_token_copy(gr, stack[0]);
 
-    case TOKEN_ASSIGNMENT:
-      if(eval_assign(ec, t, 0))
-	return -1;
-      break;
+  glw_view_free_chain(gr, ec.alloc);
+  return r;
+}
 
-    case TOKEN_COND_ASSIGNMENT:
-      if(eval_assign(ec, t, 1))
-	return -1;
-      break;
+
+/**
+ * Replace operators whose operands are all constant with the result.
+ *
+ * In RPN the operands of an operator are the values on top of the
+ * stack, and each constant is one value. So if the 'argc' tokens
+ * preceding an operator are constants they are its operands
+ */
+static void
+glw_view_fold_rpn(glw_root_t *gr, token_t *rpn)
+{
+  token_t *t, *next, *r, **vec;
+  int n = 0, i, op, pops;
+
+  for(t = rpn->child; t != NULL; t = t->next)
+    n++;
+
+  if(n == 0)
+    return;
+
+  vec = alloca(n * sizeof(token_t *));
+  n = 0;
+
+  for(t = rpn->child; t != NULL; t = next) {
+    next = t->next;
+    op = glw_view_opcode(t, &pops);
+
+    switch(op) {
+    case GVOP_ARITH:
+    case GVOP_BOOL:
+    case GVOP_NOT:
+    case GVOP_COALESCE:
+    case GVOP_EQ:
+    case GVOP_NEQ:
+    case GVOP_LT:
+    case GVOP_GT:
+    case GVOP_VECTOR:
+      if(pops < 1 || pops > 4 || pops > n)
+	break;
+
+      for(i = n - pops; i < n; i++)
+	if(!token_is_constant(vec[i]))
+	  break;
+      if(i < n)
+	break;
+
+      if((r = glw_view_fold_op(gr, t, op, vec + n - pops, pops)) == NULL)
+	break;
+
+      for(i = n - pops; i < n; i++)
+	glw_view_token_free(gr, vec[i]);
+      glw_view_token_free(gr, t);
+      n -= pops;
+      vec[n++] = r;
+      continue;
 
     default:
-      fprintf(stderr, "Can not handle token %s\n", token2name(t));
-      abort();
+      break;
     }
+    vec[n++] = t;
   }
-  return 0;
+
+  rpn->child = vec[0];
+  for(i = 0; i < n - 1; i++)
+    vec[i]->next = vec[i + 1];
+  vec[n - 1]->next = NULL;
+}
+
+
+/**
+ *
+ */
+static void
+glw_view_compile0(glw_root_t *gr, token_t *t, errorinfo_t *ei)
+{
+  for(; t != NULL; t = t->next) {
+    if(t->type == TOKEN_RPN) {
+      glw_view_fold_rpn(gr, t);
+      if(t->t_code == NULL)
+	t->t_code = glw_view_lower(t, ei);
+    }
+    if(t->child != NULL)
+      glw_view_compile0(gr, t->child, ei);
+  }
+}
+
+
+/**
+ * Fold constant subexpressions and lower all RPN expressions of a
+ * parsed view. Expressions that fail to lower are left as is and
+ * report their error if they are ever evaluated
+ */
+void
+glw_view_compile(glw_root_t *gr, token_t *t)
+{
+  errorinfo_t ei;
+  glw_view_compile0(gr, t, &ei);
 }
 
 
@@ -2009,6 +2272,7 @@ glw_view_eval_rpn(token_t *t, glw_view_eval_context_t *pec, int *copyp)
   ec.sublist = pec->sublist;
   ec.event = pec->event;
   ec.tgtprop = pec->tgtprop;
+  ec.shared = pec->shared;
 
   r = glw_view_eval_rpn0(t, &ec);
 
@@ -2018,6 +2282,63 @@ glw_view_eval_rpn(token_t *t, glw_view_eval_context_t *pec, int *copyp)
 }
 
 
+/**
+ * Hand over a dynamic expression to the widget
+ */
+static void
+glw_view_keep_dynamic(glw_t *w, token_t *t, int copy)
+{
+  t->next =  w->glw_dynamic_expressions;
+  w->glw_dynamic_expressions = t;
+
+  if(copy & GLW_VIEW_DYNAMIC_EVAL_EVERY_FRAME)
+    glw_signal_handler_register(w, eval_dynamic_every_frame_sig, t, 1000);
+
+  if(copy & GLW_VIEW_DYNAMIC_EVAL_FOCUSED_CHILD_CHANGE)
+    glw_signal_handler_register(w, eval_dynamic_focused_child_change_sig,
+				t, 1000);
+
+  if(copy & GLW_VIEW_DYNAMIC_EVAL_FHP_CHANGE)
+    glw_signal_handler_register(w, eval_dynamic_fhp_change_sig, t, 1000);
+
+  if(copy & GLW_VIEW_DYNAMIC_EVAL_WIDGET_META)
+    glw_signal_handler_register(w, eval_dynamic_widget_meta_sig, t, 1000);
+}
+
+
+/**
+ * Evaluate a statement from a cached view. Statements flagged as
+ * shareable are evaluated straight from the cached tokens. Others are
+ * cloned first and the clone is kept by the widget if it's dynamic
+ */
+static int
+glw_view_eval_shared_rpn(token_t *t, glw_view_eval_context_t *ec)
+{
+  token_t *c;
+  int copy, r;
+
+  if(t->t_flags & TOKEN_F_SHAREABLE) {
+    r = glw_view_eval_rpn(t, ec, &copy);
+    assert(copy == 0);
+    return r;
+  }
+
+  c = glw_view_token_copy(ec->gr, t);
+  c->child = glw_view_clone_chain(ec->gr, t->child);
+
+  ec->shared = 0;
+  r = glw_view_eval_rpn(c, ec, &copy);
+  ec->shared = 1;
+
+  if(r || !copy) {
+    glw_view_free_chain(ec->gr, c);
+    return r;
+  }
+  glw_view_keep_dynamic(ec->w, c, copy);
+  return 0;
+}
+
+
 /**
  *
  */
@@ -2026,7 +2347,6 @@ glw_view_eval_block(token_t *t, glw_view_eval_context_t *ec)
 {
   int copy;
   token_t **p;
-  glw_t *w;
 
   assert(ec->dynamic_eval == 0);
 
@@ -2038,6 +2358,12 @@ glw_view_eval_block(token_t *t, glw_view_eval_context_t *ec)
     case TOKEN_NOP:
       break;
     case TOKEN_RPN:
+      if(ec->shared) {
+	if(glw_view_eval_shared_rpn(t, ec))
+	  return -1;
+	break;
+      }
+
       if(glw_view_eval_rpn(t, ec, &copy))
 	return -1;
 
@@ -2045,24 +2371,7 @@ glw_view_eval_block(token_t *t, glw_view_eval_context_t *ec)
 	break;
 
       *p = t->next;
-
-      w = ec->w;
-      t->next =  w->glw_dynamic_expressions;
-      w->glw_dynamic_expressions = t;
-
-      if(copy & GLW_VIEW_DYNAMIC_EVAL_EVERY_FRAME)
-	glw_signal_handler_register(w, eval_dynamic_every_frame_sig, t, 1000);
-
-      if(copy & GLW_VIEW_DYNAMIC_EVAL_FOCUSED_CHILD_CHANGE)
-	glw_signal_handler_register(w, eval_dynamic_focused_child_change_sig,
-				    t, 1000);
-
-      if(copy & GLW_VIEW_DYNAMIC_EVAL_FHP_CHANGE)
-	glw_signal_handler_register(w, eval_dynamic_fhp_change_sig, t, 1000);
-
-      if(copy & GLW_VIEW_DYNAMIC_EVAL_WIDGET_META)
-	glw_signal_handler_register(w, eval_dynamic_widget_meta_sig, t, 1000);
-
+      glw_view_keep_dynamic(ec->w, t, copy);
       continue;
 
     default:
@@ -2114,6 +2423,7 @@ glwf_widget(glw_view_eval_context_t *ec, struct token *self,
   n.gr = ec->gr;
   n.rc = ec->rc;
   n.w = glw_create(ec->gr, c, ec->w, NULL, NULL);
+  n.shared = ec->shared;
 
   if(c->gc_freeze != NULL)
     c->gc_freeze(n.w);
@@ -5387,9 +5697,9 @@ glwf_canSelectPrev(glw_view_eval_context_t *ec, struct token *self,
  *
  */
 static const token_func_t funcvec[] = {
-  {"widget", 2, glwf_widget},
+  {"widget", 2, glwf_widget, NULL, NULL, GLW_VIEW_FUNC_PURE},
   {"cloner", 3, glwf_cloner},
-  {"space", 1, glwf_space},
+  {"space", 1, glwf_space, NULL, NULL, GLW_VIEW_FUNC_PURE},
   {"onEvent", -1, glwf_onEvent},
   {"navOpen", -1, glwf_navOpen},
   {"playTrackFromSource", -1, glwf_playTrackFromSource},
@@ -5402,10 +5712,10 @@ static const token_func_t funcvec[] = {
   {"changed", -1, glwf_changed, glwf_changed_ctor, glwf_changed_dtor},
   {"iir", -1, glwf_iir},
   {"scurve", -1, glwf_scurve, glwf_scurve_ctor, glwf_scurve_dtor},
-  {"translate", -1, glwf_translate},
+  {"translate", -1, glwf_translate, NULL, NULL, GLW_VIEW_FUNC_PURE},
   {"strftime", 2, glwf_strftime},
-  {"isSet", 1, glwf_isset},
-  {"isVoid", 1, glwf_isvoid},
+  {"isSet", 1, glwf_isset, NULL, NULL, GLW_VIEW_FUNC_PURE},
+  {"isVoid", 1, glwf_isvoid, NULL, NULL, GLW_VIEW_FUNC_PURE},
   {"value2duration", 1, glwf_value2duration},
   {"value2size", 1, glwf_value2size},
   {"createChild", 1, glwf_createchild},
@@ -5420,7 +5730,7 @@ static const token_func_t funcvec[] = {
   {"isVisible", 0, glwf_isVisible},
   {"canScroll", 0, glwf_canScroll},
   {"wantFullWindow", 0, glwf_wantFullWindow},
-  {"select", 3, glwf_select},
+  {"select", 3, glwf_select, NULL, NULL, GLW_VIEW_FUNC_PURE},
   {"trace", 2, glwf_trace},
   {"browse", 1, glwf_browse, glwf_browse_ctor, glwf_browse_dtor},
   {"settingInt", 8, glw_settingInt, glwf_null_ctor, glwf_setting_dtor},
@@ -5442,11 +5752,11 @@ static const token_func_t funcvec[] = {
   {"getHeight", 0, glwf_getHeight},
   {"preferTentative", 1, glwf_preferTentative, glwf_null_ctor, glwf_freetoken_dtor},
   {"ignoreTentative", 1, glwf_ignoreTentative, glwf_null_ctor, glwf_freetoken_dtor},
-  {"int", 1,glwf_int},
-  {"clamp", 3, glwf_clamp},
-  {"join", -1, glwf_join},
-  {"fmt", -1, glwf_fmt},
-  {"_pl", 3, glwf_pluralise},
+  {"int", 1,glwf_int, NULL, NULL, GLW_VIEW_FUNC_PURE},
+  {"clamp", 3, glwf_clamp, NULL, NULL, GLW_VIEW_FUNC_PURE},
+  {"join", -1, glwf_join, NULL, NULL, GLW_VIEW_FUNC_PURE},
+  {"fmt", -1, glwf_fmt, NULL, NULL, GLW_VIEW_FUNC_PURE},
+  {"_pl", 3, glwf_pluralise, NULL, NULL, GLW_VIEW_FUNC_PURE},
   {"loadFont", 1, glw_loadFont, glwf_null_ctor, glwf_loadfont_dtor},
   {"multiopt", -1, glwf_multiopt, glwf_multiopt_ctor, glwf_multiopt_dtor},
   {"link", 2, glwf_link},
@@ -5474,3 +5784,176 @@ glw_view_function_resolve(token_t *t)
     }
   return -1;
 }
+
+
+/**
+ * The most frequent expressions in the stock theme
+ */
+static const char *glw_view_bench_src[] = {
+  ".color = select(isFocused(), 1.0, 0.6);",
+  ".alphaSelf = iir(isFocused() * 1, 8) + isHovered() * 0.1;",
+  ".color = iir(0.6 + (isFocused() || isPressed() || isHovered()), 4);",
+  ".alpha = iir(0.3 + 0.3 * (isFocused() || isPressed()), 4) + isHovered();",
+  ".alpha = 1 - iir(clamp(getLayer(), 0, 1), 7) * 0.5;",
+  ".alpha = isFocused() + 0.6;",
+  ".padding = [$ui.size, 0];",
+  ".color = [0.431, 0.811, 1];",
+  ".margin = [-8, -3, -8, -5];",
+  ".height = $ui.size * (2 + isFocused() * 4);",
+};
+
+
+/**
+ *
+ */
+static token_t *
+glw_view_bench_load(glw_root_t *gr, const char *src, rstr_t *file,
+		    errorinfo_t *ei)
+{
+  token_t *sof = glw_view_token_alloc(gr), *l;
+
+  sof->type = TOKEN_START;
+  sof->file = rstr_dup(file);
+
+  if((l = glw_view_lexer(gr, src, ei, file, sof)) == NULL) {
+    glw_view_free_chain(gr, sof);
+    return NULL;
+  }
+  l->next = glw_view_token_alloc(gr);
+  l->next->type = TOKEN_END;
+  l->next->file = rstr_dup(file);
+
+  if(glw_view_preproc(gr, sof, ei) || glw_view_parse(sof, ei, gr)) {
+    glw_view_free_chain(gr, sof);
+    return NULL;
+  }
+  return sof;
+}
+
+
+/**
+ *
+ */
+static int
+glw_view_bench_tokens(const token_t *t)
+{
+  const token_t *c;
+  int n = 0;
+
+  for(t = t->child; t != NULL; t = t->next)
+    if(t->type == TOKEN_RPN)
+      for(c = t->child; c != NULL; c = c->next)
+	n++;
+  return n;
+}
+
+
+/**
+ * Evaluate the expressions over and over, the way they are when
+ * widgets get focused, hovered or are animating. Once with the
+ * expressions lowered when first evaluated and once compiled up
+ * front as glw_view_create() does, which also folds constants
+ */
+int
+glw_view_bench(void)
+{
+  const int num = sizeof(glw_view_bench_src) / sizeof(glw_view_bench_src[0]);
+  const int rounds = 100000;
+  token_t *views[sizeof(glw_view_bench_src) / sizeof(glw_view_bench_src[0])];
+  glw_root_t *gr = calloc(1, sizeof(glw_root_t));
+  rstr_t *file = rstr_alloc("bench");
+  glw_view_eval_context_t ec;
+  errorinfo_t ei;
+  token_t *t;
+  glw_t *w;
+  int compile, i, j, copy, evals, tokens, allocs, rval = 0;
+  int64_t ts;
+
+  gr->gr_courier = prop_courier_create_passive(PROP_COURIER_COALESCE);
+  gr->gr_token_pool = pool_create("glwtokens", sizeof(token_t), POOL_ZERO_MEM);
+  gr->gr_uii.uii_prop = prop_create_root(NULL);
+  prop_set_int(prop_create(gr->gr_uii.uii_prop, "size"), 20);
+  TAILQ_INIT(&gr->gr_destroyer_queue);
+  TAILQ_INIT(&gr->gr_tex_rel_queue);
+
+  for(compile = 0; compile < 2 && rval == 0; compile++) {
+
+    w = glw_create(gr, glw_class_find_by_name("dummy"), NULL, NULL, NULL);
+
+    memset(&ec, 0, sizeof(ec));
+    ec.gr = gr;
+    ec.w = w;
+    ec.ei = &ei;
+    ec.sublist = &w->glw_prop_subscriptions;
+
+    tokens = 0;
+    for(i = 0; i < num; i++) {
+      if((views[i] = glw_view_bench_load(gr, glw_view_bench_src[i],
+					 file, &ei)) == NULL) {
+	TRACE(TRACE_ERROR, "bench", "%s: %s", glw_view_bench_src[i],
+	      ei.error);
+	rval = 1;
+	break;
+      }
+
+      if(compile)
+	glw_view_compile(gr, views[i]);
+
+      tokens += glw_view_bench_tokens(views[i]);
+
+      if(glw_view_eval_block(views[i], &ec)) {
+	TRACE(TRACE_ERROR, "bench", "%s: %s", glw_view_bench_src[i],
+	      ei.error);
+	rval = 1;
+	i++;
+	break;
+      }
+    }
+
+    if(rval == 0) {
+      prop_courier_poll(gr->gr_courier);
+
+      evals = 0;
+      allocs = gr->gr_token_allocs;
+      ts = showtime_get_ts();
+
+      for(j = 0; j < rounds; j++) {
+	for(t = w->glw_dynamic_expressions; t != NULL; t = t->next) {
+	  eval_dynamic(w, t, NULL, NULL, NULL, NULL);
+	  evals++;
+	}
+
+	for(i = 0; i < num; i++) {
+	  for(t = views[i]->child; t != NULL; t = t->next) {
+	    if(t->type == TOKEN_RPN) {
+	      glw_view_eval_rpn(t, &ec, &copy);
+	      evals++;
+	    }
+	  }
+	}
+      }
+
+      ts = showtime_get_ts() - ts;
+
+      TRACE(TRACE_INFO, "bench",
+	    "%s: %d expressions, %d tokens, %.1f ns/eval, "
+	    "%.2f token allocs/eval",
+	    compile ? "Compiled" : "Lowered on first use",
+	    num, tokens, ts * 1000.0 / evals,
+	    (double)(gr->gr_token_allocs - allocs) / evals);
+    }
+
+    while(i > 0)
+      glw_view_free_chain(gr, views[--i]);
+
+    glw_destroy(w);
+    glw_reap(gr);
+  }
+
+  prop_destroy(gr->gr_uii.uii_prop);
+  prop_courier_destroy(gr->gr_courier);
+  pool_destroy(gr->gr_token_pool);
+  rstr_release(file);
+  free(gr);
+  return rval;
+}
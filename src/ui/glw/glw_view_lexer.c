@@ -169,9 +169,9 @@ lexer_single_char(glw_root_t *gr, token_t *next, rstr_t *f, int line, char s)
  * Returns pointer to last token, or NULL if an error occured.
  * If an error occured 'ei' will be filled with data
  */
-static token_t *
-lexer(glw_root_t *gr, 
-      const char *src, errorinfo_t *ei, rstr_t *f, token_t *prev)
+token_t *
+glw_view_lexer(glw_root_t *gr, 
+	       const char *src, errorinfo_t *ei, rstr_t *f, token_t *prev)
 {
   const char *start;
   int line = 1;
@@ -373,9 +373,10 @@ glw_view_load1(glw_root_t *gr, rstr_t *url, errorinfo_t *ei, token_t *prev)
   char *src;
   token_t *last;
   char errbuf[256];
+  size_t size;
 
   rstr_t *p = fa_absolute_path(url, prev->file);
-  src = fa_load(rstr_get(p), NULL, gr->gr_vpaths, 
+  src = fa_load(rstr_get(p), &size, gr->gr_vpaths, 
 		errbuf, sizeof(errbuf), NULL, 0, NULL, NULL);
   if(src == NULL) {
     snprintf(ei->error, sizeof(ei->error), "Unable to open \"%s\" -- %s",
@@ -386,7 +387,10 @@ glw_view_load1(glw_root_t *gr, rstr_t *url, errorinfo_t *ei, token_t *prev)
     return NULL;
   }
 
-  last = lexer(gr, src, ei, p, prev);
+  if(gr->gr_view_deps != NULL)
+    glw_view_deps_add(gr->gr_view_deps, p, src, size);
+
+  last = glw_view_lexer(gr, src, ei, p, prev);
   free(src);
   rstr_release(p);
   return last;
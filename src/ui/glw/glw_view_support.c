@@ -35,6 +35,7 @@
 token_t *
 glw_view_token_alloc(glw_root_t *gr)
 {
+  gr->gr_token_allocs++;
   return pool_get(gr->gr_token_pool);
 }
 
@@ -102,12 +103,16 @@ glw_view_token_free(glw_root_t *gr, token_t *t)
   case TOKEN_LT:
   case TOKEN_GT:
   case TOKEN_EXPR:
-  case TOKEN_RPN:
   case TOKEN_BLOCK:
   case TOKEN_NOP:
   case TOKEN_COLON:
     break;
 
+  case TOKEN_RPN:
+    if(t->t_code != NULL)
+      glw_view_code_release(t->t_code);
+    break;
+
   case TOKEN_RSTRING:
   case TOKEN_IDENTIFIER:
   case TOKEN_PROPERTY_VALUE_NAME:
@@ -141,6 +146,7 @@ glw_view_token_copy(glw_root_t *gr, token_t *src)
 {
   token_t *dst = pool_get(gr->gr_token_pool);
 
+  gr->gr_token_allocs++;
   dst->file = rstr_dup(src->file);
   dst->line = src->line;
 
@@ -223,19 +229,28 @@ glw_view_token_copy(glw_root_t *gr, token_t *src)
   case TOKEN_GT:
   case TOKEN_NULL_COALESCE:
   case TOKEN_EXPR:
-  case TOKEN_RPN:
   case TOKEN_BLOCK:
   case TOKEN_NOP:
   case TOKEN_VOID:
   case TOKEN_COLON:
     break;
 
+  case TOKEN_RPN:
+    if((dst->t_code = src->t_code) != NULL)
+      dst->t_code->gvc_refcount++;
+    break;
+
+  case TOKEN_VECTOR_FLOAT:
+    dst->t_elements = src->t_elements;
+    memcpy(dst->t_float_vector_int, src->t_float_vector_int,
+	   sizeof(dst->t_float_vector_int));
+    break;
+
   case TOKEN_LINK:
     dst->t_link_rtitle = rstr_dup(src->t_link_rtitle);
     dst->t_link_rurl   = rstr_dup(src->t_link_rurl);
     break;
 
-  case TOKEN_VECTOR_FLOAT:
   case TOKEN_num:
   case TOKEN_EVENT:
     abort();
@@ -243,6 +258,17 @@ glw_view_token_copy(glw_root_t *gr, token_t *src)
   return dst;
 }
 
+
+/**
+ *
+ */
+void
+glw_view_code_release(glw_view_code_t *gvc)
+{
+  if(--gvc->gvc_refcount == 0)
+    free(gvc);
+}
+
 /**
  *
  */
@@ -295,6 +321,75 @@ glw_view_clone_chain(glw_root_t *gr, token_t *src)
 
 
 
+/**
+ * Check if evaluating an RPN expression can never make it dynamic
+ * or leave state in its tokens. Such expressions can be evaluated
+ * straight from a cached view. Blocks are evaluated by whoever
+ * consumes them so their statements are checked on their own
+ */
+static int
+rpn_is_shareable(const token_t *t)
+{
+  for(t = t->child; t != NULL; t = t->next) {
+    switch(t->type) {
+    case TOKEN_BLOCK:
+    case TOKEN_RSTRING:
+    case TOKEN_CSTRING:
+    case TOKEN_LINK:
+    case TOKEN_FLOAT:
+    case TOKEN_INT:
+    case TOKEN_IDENTIFIER:
+    case TOKEN_OBJECT_ATTRIBUTE:
+    case TOKEN_VOID:
+    case TOKEN_VECTOR_FLOAT:
+    case TOKEN_ADD:
+    case TOKEN_SUB:
+    case TOKEN_MULTIPLY:
+    case TOKEN_DIVIDE:
+    case TOKEN_MODULO:
+    case TOKEN_BOOLEAN_AND:
+    case TOKEN_BOOLEAN_OR:
+    case TOKEN_BOOLEAN_XOR:
+    case TOKEN_BOOLEAN_NOT:
+    case TOKEN_NULL_COALESCE:
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+    case TOKEN_LT:
+    case TOKEN_GT:
+    case TOKEN_LEFT_BRACKET:
+    case TOKEN_ASSIGNMENT:
+    case TOKEN_COND_ASSIGNMENT:
+      break;
+
+    case TOKEN_FUNCTION:
+      if(t->t_func->flags & GLW_VIEW_FUNC_PURE)
+	break;
+      return 0;
+
+    default:
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+/**
+ * Flag all RPN expressions in a parsed view that can be evaluated
+ * without cloning them first
+ */
+void
+glw_view_mark_shareable(token_t *t)
+{
+  for(; t != NULL; t = t->next) {
+    if(t->type == TOKEN_RPN && rpn_is_shareable(t))
+      t->t_flags |= TOKEN_F_SHAREABLE;
+    if(t->child != NULL)
+      glw_view_mark_shareable(t->child);
+  }
+}
+
+
 /**
  *
  */
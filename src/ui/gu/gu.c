@@ -375,7 +375,7 @@ gu_start(ui_t *ui, prop_t *root, int argc, char **argv, int primary)
 
   gu_pixbuf_init();
 
-  gu->gu_pc = prop_courier_create_thread(&gu_mutex, "GU");
+  gu->gu_pc = prop_courier_create_thread(&gu_mutex, "GU", 0);
 
   gu_win_create(gu, prop_create(prop_get_global(), "nav"), 1);
 
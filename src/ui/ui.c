@@ -44,6 +44,20 @@ uii_register(uii_t *uii, int primary)
 }
 
 
+/**
+ *
+ */
+void
+uii_unregister(uii_t *uii)
+{
+  hts_mutex_lock(&ui_mutex);
+  LIST_REMOVE(uii, uii_link);
+  if(primary_uii == uii)
+    primary_uii = NULL;
+  hts_mutex_unlock(&ui_mutex);
+}
+
+
 
 /**
  *
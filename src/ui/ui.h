@@ -70,6 +70,8 @@ int ui_start(int argc, const char *argv[], const char *argv0);
 
 void uii_register(uii_t *uii, int primary);
 
+void uii_unregister(uii_t *uii);
+
 int ui_shutdown(void);
 
 void ui_primary_event(struct event *e);
@@ -312,7 +312,7 @@ nodes_from_meta(htsmsg_t *meta, prop_t *root, const char *trackid,
   if(items == NULL)
     return;
 
-  void *db = metadb_get();
+  void *db = metadb_get_ro();
 
   HTSMSG_FOREACH(f, items) {
     if(!strcmp(f->hmf_name, "item")) {
@@ -325,7 +325,7 @@ nodes_from_meta(htsmsg_t *meta, prop_t *root, const char *trackid,
 	add_container(container, root, baseurl, skip);
     }
   }
-  metadb_close(db);
+  metadb_close_ro(db);
 }
 
 
@@ -620,7 +620,7 @@ browse_directory(upnp_browse_t *ub, const char *title)
   decorated_browse_create(ub->ub_model, pnf, ub->ub_items, t, 0);
   rstr_release(t);
 
-  pc = prop_courier_create_waitable();
+  pc = prop_courier_create_waitable(0);
   ub->ub_run = 1;
   ub->ub_itemsub = prop_subscribe(PROP_SUB_TRACK_DESTROY,
 				  PROP_TAG_CALLBACK, node_eventsub, ub,
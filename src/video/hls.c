@@ -0,0 +1,1188 @@
+/*
+ *  HTTP Live Streaming
+ *  Copyright (C) 2012 Andreas Öman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "showtime.h"
+#include "media.h"
+#include "hls.h"
+#include "backend/backend.h"
+#include "fileaccess/fileaccess.h"
+#include "fileaccess/fa_proto.h"
+#include "fileaccess/fa_video.h"
+#include "misc/string.h"
+#include "event.h"
+#if ENABLE_HTTPSERVER
+#include "networking/http_server.h"
+#endif
+
+/**
+ * The segments of the selected variant are concatenated into a single
+ * MPEG-TS stream exposed as a file handle, so the regular libav based
+ * player can be used. Before each segment is fetched the variant is
+ * reselected based on measured download throughput and how much media
+ * is queued in the media pipe.
+ *
+ * Buffer levels (in ms of media):
+ *
+ *  Below HLS_BUFFER_PANIC we are close to a stall and pick a variant
+ *  well below the measured throughput.
+ *
+ *  Switching up is only done above HLS_BUFFER_STEADY, one variant at
+ *  a time.
+ *
+ *  Above HLS_BUFFER_COMFORT we never switch down.
+ */
+#define HLS_BUFFER_PANIC     4000
+#define HLS_BUFFER_STEADY   12000
+#define HLS_BUFFER_COMFORT  30000
+
+#define HLS_FRAME_DURATION     40 // Assumed ms per queued video packet
+#define HLS_LIVE_RELOAD_TRIES   6
+#define HLS_MAX_SEGMENT_ERRORS  3
+
+/**
+ *
+ */
+typedef struct hls_segment {
+  char *hs_url;
+  int hs_duration;         // ms
+} hls_segment_t;
+
+
+/**
+ *
+ */
+typedef struct hls_variant {
+  char *hv_url;
+  int hv_bandwidth;        // bit/s as announced in the master playlist
+  int hv_order;            // Position in master playlist
+
+  hls_segment_t *hv_segments;
+  int hv_num_segments;
+  int hv_first_seq;        // Media sequence number of hv_segments[0]
+  int hv_target_duration;  // seconds
+  int hv_endlist;
+  int64_t hv_loaded;       // When playlist was last loaded, 0 = never
+} hls_variant_t;
+
+
+/**
+ *
+ */
+typedef struct hls {
+  fa_handle_t h_fh;
+
+  media_pipe_t *h_mp;
+
+  hls_variant_t *h_variants; // Sorted on ascending bandwidth
+  int h_num_variants;
+  int h_cur;                 // Current variant
+  int h_seq;                 // Media sequence number of next segment
+  int h_eof;
+
+  uint8_t *h_seg;            // Current segment
+  size_t h_seg_size;
+  size_t h_seg_pos;
+  int64_t h_seg_start;       // Offset of h_seg in the concatenated stream
+
+  int64_t h_throughput;      // Estimated throughput in bit/s
+  int h_switches;
+
+  int64_t h_load_start;      // Segment download in progress
+  int h_load_buffered;       // Buffered media (ms) when download started
+  int h_load_aborted;        // Bytes loaded when download was aborted
+  int h_aborts;              // Number of aborted downloads
+  int h_stop;                // Player is stopping, give up
+
+  prop_t *h_prop_root;
+  prop_t *h_prop_bitrate;
+  prop_t *h_prop_throughput;
+  prop_t *h_prop_switches;
+} hls_t;
+
+
+/**
+ *
+ */
+static void
+hls_variant_clear(hls_variant_t *hv)
+{
+  int i;
+  for(i = 0; i < hv->hv_num_segments; i++)
+    free(hv->hv_segments[i].hs_url);
+  free(hv->hv_segments);
+  hv->hv_segments = NULL;
+  hv->hv_num_segments = 0;
+}
+
+
+/**
+ * Split 's' into lines, returns next line or NULL when done.
+ * '*sp' is updated to point to the line after
+ */
+static char *
+hls_getline(char **sp)
+{
+  char *s = *sp, *r;
+  int l;
+
+  while(*s == '\r' || *s == '\n')
+    s++;
+
+  if(*s == 0)
+    return NULL;
+
+  r = s;
+  l = strcspn(s, "\r\n");
+  s += l;
+  if(*s)
+    *s++ = 0;
+  *sp = s;
+  return r;
+}
+
+
+/**
+ * Parse a media playlist, replacing the current segment list
+ */
+static int
+hls_variant_parse(hls_variant_t *hv, char *s, char *errbuf, size_t errlen)
+{
+  const char *v;
+  char *l;
+  int duration = 0, capacity = 0;
+
+  hls_variant_clear(hv);
+  hv->hv_first_seq = 0;
+  hv->hv_endlist = 0;
+  hv->hv_target_duration = 10;
+
+  while((l = hls_getline(&s)) != NULL) {
+
+    if((v = mystrbegins(l, "#EXT-X-TARGETDURATION:")) != NULL) {
+      hv->hv_target_duration = MAX(atoi(v), 1);
+    } else if((v = mystrbegins(l, "#EXT-X-MEDIA-SEQUENCE:")) != NULL) {
+      hv->hv_first_seq = atoi(v);
+    } else if((v = mystrbegins(l, "#EXTINF:")) != NULL) {
+      duration = strtod(v, NULL) * 1000;
+    } else if(mystrbegins(l, "#EXT-X-ENDLIST")) {
+      hv->hv_endlist = 1;
+    } else if((v = mystrbegins(l, "#EXT-X-KEY:")) != NULL) {
+      if(strstr(v, "METHOD=NONE") == NULL) {
+	snprintf(errbuf, errlen, "Encrypted streams are not supported");
+	return -1;
+      }
+    } else if(*l != '#') {
+
+      if(hv->hv_num_segments == capacity) {
+	capacity = MAX(capacity * 2, 16);
+	hv->hv_segments = realloc(hv->hv_segments,
+				  capacity * sizeof(hls_segment_t));
+      }
+
+      hls_segment_t *hs = &hv->hv_segments[hv->hv_num_segments++];
+      hs->hs_url = url_resolve_relative_from_base(hv->hv_url, l);
+      hs->hs_duration = duration ?: hv->hv_target_duration * 1000;
+      duration = 0;
+    }
+  }
+  hv->hv_loaded = showtime_get_ts();
+  return 0;
+}
+
+
+/**
+ *
+ */
+static char *
+hls_load_playlist(const char *url, char *errbuf, size_t errlen)
+{
+  char *buf = fa_load(url, NULL, NULL, errbuf, errlen, DISABLE_CACHE, 0,
+		      NULL, NULL);
+  if(buf == NULL)
+    return NULL;
+
+  if(!mystrbegins(buf, "#EXTM3U")) {
+    snprintf(errbuf, errlen, "Not an EXTM3U playlist");
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+
+/**
+ *
+ */
+static int
+hls_variant_load(hls_variant_t *hv, char *errbuf, size_t errlen)
+{
+  char *buf = hls_load_playlist(hv->hv_url, errbuf, errlen);
+  int r;
+
+  if(buf == NULL)
+    return -1;
+  r = hls_variant_parse(hv, buf, errbuf, errlen);
+  free(buf);
+  return r;
+}
+
+
+/**
+ *
+ */
+static int
+hv_cmp(const void *A, const void *B)
+{
+  const hls_variant_t *a = A, *b = B;
+  if(a->hv_bandwidth != b->hv_bandwidth)
+    return a->hv_bandwidth - b->hv_bandwidth;
+  return a->hv_order - b->hv_order;
+}
+
+
+/**
+ * Parse master playlist. A playlist without any EXT-X-STREAM-INF
+ * is a media playlist and becomes the only variant.
+ *
+ * Playback starts with the first variant listed, as the spec says
+ */
+static int
+hls_parse_master(hls_t *h, const char *url, char *s,
+		 char *errbuf, size_t errlen)
+{
+  hls_variant_t *hv;
+  const char *v;
+  char *l;
+  int i, bandwidth = -1, capacity = 0;
+
+  if(strstr(s, "#EXT-X-STREAM-INF:") == NULL) {
+    h->h_variants = hv = calloc(1, sizeof(hls_variant_t));
+    h->h_num_variants = 1;
+    hv->hv_url = strdup(url);
+    return hls_variant_parse(hv, s, errbuf, errlen);
+  }
+
+  while((l = hls_getline(&s)) != NULL) {
+    if((v = mystrbegins(l, "#EXT-X-STREAM-INF:")) != NULL) {
+      v = strstr(v, "BANDWIDTH=");
+      bandwidth = v ? atoi(v + strlen("BANDWIDTH=")) : 0;
+    } else if(*l == '#') {
+      continue;
+    } else if(bandwidth != -1) {
+
+      if(h->h_num_variants == capacity) {
+	capacity = MAX(capacity * 2, 8);
+	h->h_variants = realloc(h->h_variants,
+				capacity * sizeof(hls_variant_t));
+      }
+
+      hv = &h->h_variants[h->h_num_variants];
+      memset(hv, 0, sizeof(hls_variant_t));
+      hv->hv_url = url_resolve_relative_from_base(url, l);
+      hv->hv_bandwidth = bandwidth;
+      hv->hv_order = h->h_num_variants++;
+      bandwidth = -1;
+    }
+  }
+
+  if(h->h_num_variants == 0) {
+    snprintf(errbuf, errlen, "No variants in playlist");
+    return -1;
+  }
+
+  qsort(h->h_variants, h->h_num_variants, sizeof(hls_variant_t), hv_cmp);
+
+  for(i = 0; i < h->h_num_variants; i++) {
+    hv = &h->h_variants[i];
+    TRACE(TRACE_DEBUG, "HLS", "Variant %d kbit/s: %s",
+	  hv->hv_bandwidth / 1000, hv->hv_url);
+    if(hv->hv_order == 0)
+      h->h_cur = i;
+  }
+  return 0;
+}
+
+
+/**
+ * Pick variant for the next segment given estimated throughput (bit/s)
+ * and buffered media (ms). 'variants' is sorted on ascending bandwidth
+ */
+static int
+hls_abr_select(const hls_variant_t *variants, int num, int cur,
+	       int64_t throughput, int buffered)
+{
+  int64_t budget;
+  int i, best = 0;
+
+  if(throughput == 0)
+    return cur;
+
+  if(buffered < HLS_BUFFER_PANIC)
+    budget = throughput / 2;
+  else if(buffered < HLS_BUFFER_STEADY)
+    budget = throughput * 7 / 10;
+  else
+    budget = throughput * 9 / 10;
+
+  for(i = 1; i < num; i++)
+    if(variants[i].hv_bandwidth <= budget)
+      best = i;
+
+  if(best > cur)
+    return buffered >= HLS_BUFFER_STEADY ? cur + 1 : cur;
+
+  if(best < cur && buffered >= HLS_BUFFER_COMFORT)
+    return cur;
+
+  return best;
+}
+
+
+/**
+ * Estimate how much media (in ms) is queued in the media pipe.
+ *
+ * Queued bytes divided by the variant bitrate is used, capped by the
+ * number of queued video packets (dqlen) as byte counts are misleading
+ * when the announced bitrate is off
+ */
+static int
+hls_buffered(const hls_t *h)
+{
+  const media_pipe_t *mp = h->h_mp;
+  const hls_variant_t *hv = &h->h_variants[h->h_cur];
+  int64_t ms = INT_MAX;
+
+  if(mp->mp_buffer_limit &&
+     mp->mp_buffer_current * 8LL > mp->mp_buffer_limit * 7LL)
+    return INT_MAX; // Full, the demuxer will block anyway
+
+  if(hv->hv_bandwidth > 0)
+    ms = mp->mp_buffer_current * 8000LL / hv->hv_bandwidth;
+
+  if(mp->mp_video.mq_stream != -1)
+    ms = MIN(ms, mp->mp_video.mq_packets_current * HLS_FRAME_DURATION);
+
+  return ms;
+}
+
+
+/**
+ * Update throughput estimate (EWMA) with a download of 'bytes'
+ * that took 'us' microseconds
+ */
+static void
+hls_throughput_update(int64_t *est, int64_t bytes, int64_t us)
+{
+  int64_t sample = bytes * 8000000LL / MAX(us, 1000);
+
+  *est = *est ? (*est * 7 + sample * 3) / 10 : sample;
+}
+
+
+/**
+ * Check if the player has been asked to stop.
+ * mp_mutex must be held
+ */
+static int
+hls_stop_requested(media_pipe_t *mp)
+{
+  event_t *e;
+
+  TAILQ_FOREACH(e, &mp->mp_eq, e_link)
+    if(event_is_type(e, EVENT_EXIT) || event_is_type(e, EVENT_PLAY_URL))
+      return 1;
+  return 0;
+}
+
+
+/**
+ * Wait until 'deadline' unless the player is asked to stop before that.
+ * Returns 1 if stopped
+ */
+static int
+hls_wait(hls_t *h, int64_t deadline)
+{
+  media_pipe_t *mp = h->h_mp;
+  int64_t now;
+
+  hts_mutex_lock(&mp->mp_mutex);
+  while(!(h->h_stop = hls_stop_requested(mp)) &&
+	(now = showtime_get_ts()) < deadline)
+    hts_cond_wait_timeout(&mp->mp_backpressure, &mp->mp_mutex,
+			  MAX((deadline - now) / 1000, 1));
+  hts_mutex_unlock(&mp->mp_mutex);
+  return h->h_stop;
+}
+
+
+/**
+ * Get segment with media sequence number h_seq from variant,
+ * (re)loading the playlist when needed. Returns NULL at end of stream
+ * or on error
+ */
+static const hls_segment_t *
+hls_get_segment(hls_t *h, hls_variant_t *hv, char *errbuf, size_t errlen)
+{
+  int tries = 0;
+
+  while(1) {
+    if(hv->hv_loaded == 0 && hls_variant_load(hv, errbuf, errlen))
+      return NULL;
+
+    if(h->h_seq < hv->hv_first_seq) {
+      TRACE(TRACE_INFO, "HLS",
+	    "Segment %d no longer available, skipping to %d",
+	    h->h_seq, hv->hv_first_seq);
+      h->h_seq = hv->hv_first_seq;
+    }
+
+    if(h->h_seq - hv->hv_first_seq < hv->hv_num_segments)
+      return &hv->hv_segments[h->h_seq - hv->hv_first_seq];
+
+    if(hv->hv_endlist) {
+      h->h_eof = 1;
+      return NULL;
+    }
+
+    if(tries++ == HLS_LIVE_RELOAD_TRIES) {
+      snprintf(errbuf, errlen, "Live playlist is not updated");
+      return NULL;
+    }
+
+    // Live stream, wait for the playlist to grow
+    if(hls_wait(h, hv->hv_loaded + hv->hv_target_duration * 500000LL)) {
+      snprintf(errbuf, errlen, "Aborted");
+      return NULL;
+    }
+    hv->hv_loaded = 0;
+  }
+}
+
+
+/**
+ *
+ */
+static void
+hls_switch(hls_t *h, int next)
+{
+  hls_variant_t *hv = &h->h_variants[next];
+
+  TRACE(TRACE_DEBUG, "HLS",
+	"Switching from %d to %d kbit/s at segment %d, "
+	"throughput %d kbit/s",
+	h->h_variants[h->h_cur].hv_bandwidth / 1000,
+	hv->hv_bandwidth / 1000,
+	h->h_seq, (int)(h->h_throughput / 1000));
+
+  if(!hv->hv_endlist)
+    hv->hv_loaded = 0; // Live playlist might be stale
+  h->h_cur = next;
+  h->h_switches++;
+  prop_set_int(h->h_prop_switches, h->h_switches);
+}
+
+
+/**
+ * Progress callback while loading a segment. Give up if the player
+ * is stopping, or if the download won't finish before the buffer runs
+ * dry and there is a lower variant to fall back to. The latter is never
+ * done for the first segment as nothing is playing yet
+ */
+static int
+hls_load_progress(void *opaque, int loaded, int total)
+{
+  hls_t *h = opaque;
+  int64_t elapsed = showtime_get_ts() - h->h_load_start;
+  int64_t remain;
+
+  hts_mutex_lock(&h->h_mp->mp_mutex);
+  h->h_stop = hls_stop_requested(h->h_mp);
+  hts_mutex_unlock(&h->h_mp->mp_mutex);
+  if(h->h_stop)
+    return 1;
+
+  if(h->h_cur == 0 || h->h_seg == NULL ||
+     loaded == 0 || total <= 0 || elapsed < 1000000)
+    return 0;
+
+  remain = elapsed * (total - loaded) / loaded;
+  if((elapsed + remain) / 1000 < h->h_load_buffered)
+    return 0;
+
+  h->h_load_aborted = loaded;
+  return 1;
+}
+
+
+/**
+ * Select variant and load next segment
+ */
+static int
+hls_next_segment(hls_t *h)
+{
+  char errbuf[256];
+  const hls_segment_t *hs;
+  hls_variant_t *hv;
+  int64_t ts;
+  size_t size;
+  uint8_t *data;
+  int errors = 0, next;
+
+  h->h_load_buffered = hls_buffered(h);
+  next = hls_abr_select(h->h_variants, h->h_num_variants, h->h_cur,
+			h->h_throughput, h->h_load_buffered);
+  if(next != h->h_cur)
+    hls_switch(h, next);
+
+  while(1) {
+    hv = &h->h_variants[h->h_cur];
+    prop_set_int(h->h_prop_bitrate, hv->hv_bandwidth / 1000);
+
+    if((hs = hls_get_segment(h, hv, errbuf, sizeof(errbuf))) == NULL) {
+      if(!h->h_eof && !h->h_stop)
+	TRACE(TRACE_ERROR, "HLS", "%s -- %s", hv->hv_url, errbuf);
+      return -1;
+    }
+
+    h->h_load_aborted = 0;
+    h->h_load_start = showtime_get_ts();
+    data = fa_load(hs->hs_url, &size, NULL, errbuf, sizeof(errbuf),
+		   DISABLE_CACHE, 0, hls_load_progress, h);
+    ts = showtime_get_ts() - h->h_load_start;
+
+    if(data != NULL)
+      break;
+
+    if(h->h_stop)
+      return -1;
+
+    if(h->h_load_aborted) {
+      // Too slow, retry the same segment from a lower variant.
+      // Estimate is reset as the old one was clearly off
+      h->h_aborts++;
+      h->h_throughput = 0;
+      hls_throughput_update(&h->h_throughput, h->h_load_aborted, ts);
+      h->h_load_buffered = hls_buffered(h);
+      next = hls_abr_select(h->h_variants, h->h_num_variants, h->h_cur,
+			    h->h_throughput, h->h_load_buffered);
+      hls_switch(h, MIN(next, h->h_cur - 1));
+      continue;
+    }
+
+    TRACE(TRACE_ERROR, "HLS", "Unable to load segment %d -- %s",
+	  h->h_seq, errbuf);
+
+    if(++errors == HLS_MAX_SEGMENT_ERRORS)
+      return -1;
+    h->h_seq++;
+  }
+
+  hls_throughput_update(&h->h_throughput, size, ts);
+  prop_set_int(h->h_prop_throughput, h->h_throughput / 1000);
+
+  h->h_seg_start += h->h_seg_size;
+  free(h->h_seg);
+  h->h_seg = data;
+  h->h_seg_size = size;
+  h->h_seg_pos = 0;
+  h->h_seq++;
+  return 0;
+}
+
+
+/**
+ *
+ */
+static void
+hls_close(fa_handle_t *fh)
+{
+  hls_t *h = (hls_t *)fh;
+  int i;
+
+  for(i = 0; i < h->h_num_variants; i++) {
+    hls_variant_clear(&h->h_variants[i]);
+    free(h->h_variants[i].hv_url);
+  }
+  free(h->h_variants);
+  free(h->h_seg);
+  prop_destroy(h->h_prop_root);
+  free(h);
+}
+
+
+/**
+ *
+ */
+static int
+hls_read(fa_handle_t *fh, void *buf, size_t size)
+{
+  hls_t *h = (hls_t *)fh;
+
+  while(h->h_seg_pos == h->h_seg_size)
+    if(hls_next_segment(h))
+      return h->h_eof ? 0 : -1;
+
+  size = MIN(size, h->h_seg_size - h->h_seg_pos);
+  memcpy(buf, h->h_seg + h->h_seg_pos, size);
+  h->h_seg_pos += size;
+  return size;
+}
+
+
+/**
+ * Only seeking within the current segment is possible
+ */
+static int64_t
+hls_seek(fa_handle_t *fh, int64_t pos, int whence)
+{
+  hls_t *h = (hls_t *)fh;
+
+  switch(whence) {
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    pos += h->h_seg_start + h->h_seg_pos;
+    break;
+  default:
+    return -1;
+  }
+
+  if(pos < h->h_seg_start || pos > h->h_seg_start + h->h_seg_size)
+    return -1;
+
+  h->h_seg_pos = pos - h->h_seg_start;
+  return pos;
+}
+
+
+/**
+ *
+ */
+static int64_t
+hls_fsize(fa_handle_t *fh)
+{
+  return -1;
+}
+
+
+/**
+ *
+ */
+static int
+hls_seek_is_fast(fa_handle_t *fh)
+{
+  return 0;
+}
+
+
+static fa_protocol_t fa_protocol_hls = {
+  .fap_name  = "hls",
+  .fap_close = hls_close,
+  .fap_read  = hls_read,
+  .fap_seek  = hls_seek,
+  .fap_fsize = hls_fsize,
+  .fap_seek_is_fast = hls_seek_is_fast,
+};
+
+
+/**
+ *
+ */
+static fa_handle_t *
+hls_open(const char *url, media_pipe_t *mp, char *errbuf, size_t errlen)
+{
+  hls_variant_t *hv;
+  char *buf;
+  int r;
+
+  if((buf = hls_load_playlist(url, errbuf, errlen)) == NULL)
+    return NULL;
+
+  hls_t *h = calloc(1, sizeof(hls_t));
+  h->h_fh.fh_proto = &fa_protocol_hls;
+  h->h_mp = mp;
+
+  h->h_prop_root       = prop_create(mp->mp_prop_root, "hls");
+  h->h_prop_bitrate    = prop_create(h->h_prop_root, "bitrate");
+  h->h_prop_throughput = prop_create(h->h_prop_root, "throughput");
+  h->h_prop_switches   = prop_create(h->h_prop_root, "switches");
+
+  r = hls_parse_master(h, url, buf, errbuf, errlen);
+  free(buf);
+
+  if(r) {
+    hls_close(&h->h_fh);
+    return NULL;
+  }
+
+  hv = &h->h_variants[h->h_cur];
+  if(hv->hv_loaded == 0 && hls_variant_load(hv, errbuf, errlen)) {
+    hls_close(&h->h_fh);
+    return NULL;
+  }
+
+  // Live streams should not start closer than three segments to the end
+  h->h_seq = hv->hv_first_seq;
+  if(!hv->hv_endlist)
+    h->h_seq += MAX(hv->hv_num_segments - 3, 0);
+
+  if(hls_next_segment(h)) {
+    snprintf(errbuf, errlen, "Unable to load first segment");
+    hls_close(&h->h_fh);
+    return NULL;
+  }
+
+  prop_set_int(prop_create(h->h_prop_root, "variants"), h->h_num_variants);
+  return &h->h_fh;
+}
+
+
+/**
+ *
+ */
+event_t *
+hls_play(const char *url, media_pipe_t *mp,
+	 int flags, int priority,
+	 char *errbuf, size_t errlen,
+	 const char *canonical_url)
+{
+  fa_handle_t *fh;
+
+  if((fh = hls_open(url, mp, errbuf, errlen)) == NULL)
+    return NULL;
+
+  TRACE(TRACE_DEBUG, "HLS", "Starting playback of %s", url);
+
+  return be_file_playvideo_fh(url, mp, flags | BACKEND_VIDEO_NO_FS_SCAN,
+			      priority, errbuf, errlen, "video/MP2T",
+			      canonical_url ?: url, fh);
+}
+
+
+#if ENABLE_HTTPSERVER
+
+/**
+ * Benchmark harness
+ *
+ * A five variant VOD stream with one second segments is served by the
+ * embedded HTTP server. Segment bodies are throttled to a link whose
+ * bandwidth varies over time. The real segment loader is run against
+ * it while playback (draining the buffer in real time, capped at
+ * 30 seconds) is simulated by updating the media pipe's buffer level.
+ *
+ * Finally a live playlist that never grows is opened and we check that
+ * a stop request gets the loader out of its reload wait promptly.
+ */
+#define HLS_BENCH_SEGMENTS   45
+#define HLS_BENCH_SEGDUR   1000 // ms
+#define HLS_BENCH_MAXBUF  30000 // ms
+#define HLS_BENCH_LIVE_TD    10 // s, target duration of live playlist
+
+static const int hls_bench_bitrates[] = {
+  400000, 800000, 1500000, 3000000, 6000000
+};
+
+#define HLS_BENCH_VARIANTS \
+  (sizeof(hls_bench_bitrates) / sizeof(hls_bench_bitrates[0]))
+
+static const struct {
+  int duration;  // s
+  int bandwidth; // bit/s
+} hls_bench_link[] = {
+  {  6, 8000000 },
+  { 10, 2000000 },
+  {  5,  600000 },
+  {  8, 4000000 },
+  {  4,  300000 },
+  { 12, 5000000 },
+};
+
+static int64_t hls_bench_start;
+static int64_t hls_bench_stop_ts;
+
+
+/**
+ * Link bandwidth at current time, the schedule repeats
+ */
+static int
+hls_bench_link_bw(void)
+{
+  int64_t total = 0, t;
+  int i;
+
+  for(i = 0; i < sizeof(hls_bench_link) / sizeof(hls_bench_link[0]); i++)
+    total += hls_bench_link[i].duration * 1000000LL;
+
+  t = (showtime_get_ts() - hls_bench_start) % total;
+  for(i = 0; t >= hls_bench_link[i].duration * 1000000LL; i++)
+    t -= hls_bench_link[i].duration * 1000000LL;
+  return hls_bench_link[i].bandwidth;
+}
+
+
+/**
+ * Throttled segment body
+ */
+typedef struct hls_bench_fh {
+  fa_handle_t hbf_fh;
+  int64_t hbf_size;
+  int64_t hbf_pos;
+  int hbf_bandwidth;   // 0 = Follow link schedule
+} hls_bench_fh_t;
+
+
+/**
+ *
+ */
+static int
+hls_bench_read(fa_handle_t *fh, void *buf, size_t size)
+{
+  hls_bench_fh_t *hbf = (hls_bench_fh_t *)fh;
+  int bw = hbf->hbf_bandwidth ?: hls_bench_link_bw();
+
+  size = MIN(size, 8192);
+  size = MIN(size, hbf->hbf_size - hbf->hbf_pos);
+  usleep(size * 8000000LL / bw);
+  memset(buf, 0x47, size);
+  hbf->hbf_pos += size;
+  return size;
+}
+
+
+/**
+ *
+ */
+static int64_t
+hls_bench_seek(fa_handle_t *fh, int64_t pos, int whence)
+{
+  hls_bench_fh_t *hbf = (hls_bench_fh_t *)fh;
+
+  switch(whence) {
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    pos += hbf->hbf_pos;
+    break;
+  case SEEK_END:
+    pos += hbf->hbf_size;
+    break;
+  default:
+    return -1;
+  }
+  if(pos < 0 || pos > hbf->hbf_size)
+    return -1;
+  return hbf->hbf_pos = pos;
+}
+
+
+/**
+ *
+ */
+static int64_t
+hls_bench_fsize(fa_handle_t *fh)
+{
+  return ((hls_bench_fh_t *)fh)->hbf_size;
+}
+
+
+/**
+ *
+ */
+static void
+hls_bench_close(fa_handle_t *fh)
+{
+  free(fh);
+}
+
+
+static fa_protocol_t fa_protocol_hls_bench = {
+  .fap_name  = "hlsbench",
+  .fap_close = hls_bench_close,
+  .fap_read  = hls_bench_read,
+  .fap_seek  = hls_bench_seek,
+  .fap_fsize = hls_bench_fsize,
+};
+
+
+/**
+ * Serves:
+ *   master.m3u8      Master playlist, 1500 kbit/s variant listed first
+ *   <v>/index.m3u8   VOD media playlist of variant <v>
+ *   <v>/<n>.ts       Segment <n> of variant <v>
+ *   live/index.m3u8  Live media playlist that never grows
+ *   live/<n>.ts      Live segment
+ */
+static int
+hls_bench_http(http_connection_t *hc, const char *remain, void *opaque,
+	       http_cmd_t method)
+{
+  static const int order[HLS_BENCH_VARIANTS] = {2, 0, 1, 3, 4};
+  htsbuf_queue_t out;
+  hls_bench_fh_t *hbf;
+  const char *s;
+  int i, v;
+
+  if(remain == NULL)
+    return 404;
+
+  htsbuf_queue_init(&out, 0);
+
+  if(!strcmp(remain, "master.m3u8")) {
+    htsbuf_qprintf(&out, "#EXTM3U\n");
+    for(i = 0; i < HLS_BENCH_VARIANTS; i++)
+      htsbuf_qprintf(&out, "#EXT-X-STREAM-INF:BANDWIDTH=%d\n%d/index.m3u8\n",
+		     hls_bench_bitrates[order[i]], order[i]);
+    goto playlist;
+  }
+
+  if(!strcmp(remain, "live/index.m3u8")) {
+    htsbuf_qprintf(&out, "#EXTM3U\n#EXT-X-TARGETDURATION:%d\n"
+		   "#EXT-X-MEDIA-SEQUENCE:0\n", HLS_BENCH_LIVE_TD);
+    for(i = 0; i < 4; i++)
+      htsbuf_qprintf(&out, "#EXTINF:%d,\n%d.ts\n", HLS_BENCH_LIVE_TD, i);
+    goto playlist;
+  }
+
+  if((s = mystrbegins(remain, "live/")) != NULL) {
+    v = -1;
+  } else {
+    v = atoi(remain);
+    if(v < 0 || v >= HLS_BENCH_VARIANTS || (s = strchr(remain, '/')) == NULL)
+      return 404;
+    s++;
+  }
+
+  if(v >= 0 && !strcmp(s, "index.m3u8")) {
+    htsbuf_qprintf(&out, "#EXTM3U\n#EXT-X-TARGETDURATION:%d\n",
+		   HLS_BENCH_SEGDUR / 1000);
+    for(i = 0; i < HLS_BENCH_SEGMENTS; i++)
+      htsbuf_qprintf(&out, "#EXTINF:%d.0,\n%d.ts\n",
+		     HLS_BENCH_SEGDUR / 1000, i);
+    htsbuf_qprintf(&out, "#EXT-X-ENDLIST\n");
+    goto playlist;
+  }
+
+  hbf = calloc(1, sizeof(hls_bench_fh_t));
+  hbf->hbf_fh.fh_proto = &fa_protocol_hls_bench;
+  if(v == -1) {
+    hbf->hbf_size = 16384;
+    hbf->hbf_bandwidth = 8000000;
+  } else {
+    hbf->hbf_size = (int64_t)hls_bench_bitrates[v] * HLS_BENCH_SEGDUR / 8000;
+  }
+  return http_send_fh(hc, hbf, "video/MP2T", 0);
+
+ playlist:
+  return http_send_reply(hc, 0, "application/vnd.apple.mpegurl",
+			 NULL, NULL, 0, &out);
+}
+
+
+/**
+ * Set buffer level of the media pipe as seen by hls_buffered()
+ */
+static void
+hls_bench_set_buffered(hls_t *h, int ms)
+{
+  media_pipe_t *mp = h->h_mp;
+
+  hts_mutex_lock(&mp->mp_mutex);
+  mp->mp_buffer_current =
+    (int64_t)ms * h->h_variants[h->h_cur].hv_bandwidth / 8000;
+  hts_mutex_unlock(&mp->mp_mutex);
+}
+
+
+/**
+ *
+ */
+static void *
+hls_bench_stop_thread(void *aux)
+{
+  media_pipe_t *mp = aux;
+  event_t *e = event_create_type(EVENT_EXIT);
+
+  usleep(200000);
+  hls_bench_stop_ts = showtime_get_ts();
+  mp_enqueue_event(mp, e);
+  event_release(e);
+  mp_ref_dec(mp);
+  return NULL;
+}
+
+
+/**
+ * Run the stream through the segment loader while simulating playback
+ */
+static int
+hls_bench_vod(media_pipe_t *mp, const char *url)
+{
+  char errbuf[256];
+  fa_handle_t *fh;
+  hls_t *h;
+  int64_t now, dry, stalled = 0, bits = 0;
+  int buffered, segments = 0, stalls = 0, r;
+
+  mp->mp_buffer_limit = 0;
+  hls_bench_start = showtime_get_ts();
+
+  if((fh = hls_open(url, mp, errbuf, sizeof(errbuf))) == NULL) {
+    TRACE(TRACE_ERROR, "HLS", "Unable to open %s -- %s", url, errbuf);
+    return 1;
+  }
+  h = (hls_t *)fh;
+
+  // Buffer runs dry at 'dry'
+  dry = showtime_get_ts();
+
+  while(1) {
+    now = showtime_get_ts();
+
+    if(segments > 0 && now > dry) {
+      stalls++;
+      stalled += now - dry;
+      dry = now;
+    }
+
+    bits += h->h_variants[h->h_cur].hv_bandwidth;
+    dry = MAX(dry, now) + HLS_BENCH_SEGDUR * 1000LL;
+    segments++;
+
+    buffered = (dry - now) / 1000;
+    if(buffered + HLS_BENCH_SEGDUR > HLS_BENCH_MAXBUF) {
+      // Demuxer blocks until there is room
+      usleep((buffered + HLS_BENCH_SEGDUR - HLS_BENCH_MAXBUF) * 1000LL);
+      buffered = HLS_BENCH_MAXBUF - HLS_BENCH_SEGDUR;
+    }
+
+    hls_bench_set_buffered(h, buffered);
+
+    if(hls_next_segment(h))
+      break;
+  }
+
+  TRACE(TRACE_INFO, "HLS",
+	"%d segments, %d switches (%d aborted downloads), "
+	"%d stalls (%d ms), average bitrate %d kbit/s, "
+	"throughput estimate %d kbit/s",
+	segments, h->h_switches, h->h_aborts, stalls, (int)(stalled / 1000),
+	(int)(bits / segments / 1000), (int)(h->h_throughput / 1000));
+
+  r = !h->h_eof;
+  hls_close(fh);
+  return r;
+}
+
+
+/**
+ * Check that a live reload wait is cut short by a stop request
+ */
+static int
+hls_bench_live(media_pipe_t *mp, const char *url)
+{
+  char errbuf[256];
+  fa_handle_t *fh;
+  hls_t *h;
+  int64_t ts;
+  int r;
+
+  if((fh = hls_open(url, mp, errbuf, sizeof(errbuf))) == NULL) {
+    TRACE(TRACE_ERROR, "HLS", "Unable to open %s -- %s", url, errbuf);
+    return 1;
+  }
+  h = (hls_t *)fh;
+
+  // Load up to the end of the playlist, next one needs a reload
+  while(h->h_seq < 4)
+    if(hls_next_segment(h))
+      break;
+
+  mp_ref_inc(mp);
+  hts_thread_create_detached("hlsbenchstop", hls_bench_stop_thread, mp,
+			     THREAD_PRIO_LOW);
+
+  r = hls_next_segment(h);
+  ts = showtime_get_ts();
+
+  if(!r || !h->h_stop || hls_bench_stop_ts == 0) {
+    TRACE(TRACE_ERROR, "HLS", "Live stream did not stop as expected");
+    r = 1;
+  } else {
+    ts -= hls_bench_stop_ts;
+    TRACE(TRACE_INFO, "HLS", "Live reload wait stopped after %d ms "
+	  "(target duration %d s)", (int)(ts / 1000), HLS_BENCH_LIVE_TD);
+    r = ts > 500000;
+  }
+
+  hls_close(fh);
+  return r;
+}
+
+
+/**
+ *
+ */
+int
+hls_bench(void)
+{
+  char url[128];
+  media_pipe_t *mp;
+  void *hp;
+  int r;
+
+  if(http_server_port == 0)
+    http_server_init();
+  if(http_server_port == 0)
+    return 1;
+
+  hp = http_path_add("/hlsbench", NULL, hls_bench_http, 0);
+
+  mp = mp_create("hlsbench", MP_VIDEO, "video");
+  snprintf(url, sizeof(url), "http://127.0.0.1:%d/hlsbench/master.m3u8",
+	   http_server_port);
+  r = hls_bench_vod(mp, url);
+  mp_ref_dec(mp);
+
+  if(!r) {
+    mp = mp_create("hlsbench", MP_VIDEO, "video");
+    snprintf(url, sizeof(url),
+	     "http://127.0.0.1:%d/hlsbench/live/index.m3u8", http_server_port);
+    r = hls_bench_live(mp, url);
+    mp_ref_dec(mp);
+  }
+
+  http_path_remove(hp);
+  return r;
+}
+
+#else
+
+int
+hls_bench(void)
+{
+  TRACE(TRACE_ERROR, "HLS", "Benchmark needs the HTTP server");
+  return 1;
+}
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ *  HTTP Live Streaming
+ *  Copyright (C) 2012 Andreas Öman
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HLS_H__
+#define HLS_H__
+
+#include "media.h"
+
+event_t *hls_play(const char *url, media_pipe_t *mp,
+		  int flags, int priority,
+		  char *errbuf, size_t errlen,
+		  const char *canonical_url);
+
+int hls_bench(void);
+
+#endif // HLS_H__
@@ -294,20 +294,22 @@ vd_thread(void *aux)
 
   while(run) {
 
+    mq_ring_drain(mp, mq);
+
     if((mb = TAILQ_FIRST(&mq->mq_q)) == NULL) {
-      hts_cond_wait(&mq->mq_avail, &mp->mp_mutex);
+      mq_wait_avail(mp, mq);
       continue;
     }
 
     if(mb->mb_data_type == MB_VIDEO && vd->vd_hold && 
        vd->vd_skip == 0 && mb->mb_skip == 0) {
-      hts_cond_wait(&mq->mq_avail, &mp->mp_mutex);
+      mq_wait_avail(mp, mq);
       continue;
     }
 
     TAILQ_REMOVE(&mq->mq_q, mb, mb_link);
-    mq->mq_packets_current--;
-    mp->mp_buffer_current -= mb->mb_size;
+    atomic_add(&mq->mq_packets_current, -1);
+    atomic_add(&mp->mp_buffer_current, -mb->mb_size);
     mq_update_stats(mp, mq);
 
     hts_cond_signal(&mp->mp_backpressure);
@@ -24,6 +24,7 @@
 #include "showtime.h"
 #include "video_playback.h"
 #include "video_settings.h"
+#include "hls.h"
 #include "event.h"
 #include "media.h"
 #include "backend/backend.h"
@@ -118,52 +119,15 @@ vsource_cleanup(struct vsource_list *list)
 
 
 /**
- *
+ * Check if the path of an URL ends in .m3u8, ignoring any query
+ * string or fragment
  */
-static void
-vsource_load_hls(struct vsource_list *list, const char *url,
-		 const char *mimetype)
+static int
+is_hls_url(const char *url)
 {
-  int l;
-  char *buf, *s;
-  char errbuf[256];
-  int flags = 0;
+  size_t len = strcspn(url, "?#");
 
-  s = buf = fa_load(url, NULL, NULL, errbuf, sizeof(errbuf), NULL, flags,
-		    NULL, NULL);
-
-  if(s == NULL) {
-    TRACE(TRACE_INFO, "HLS", "Unable to open %s -- %s", url, errbuf);
-    return;
-  }
-
-  if(mystrbegins(s, "#EXTM3U")) {
-
-    int bandwidth = -1;
-
-    for(; l = strcspn(s, "\r\n"), *s; s += l+1+strspn(s+l+1, "\r\n")) {
-      s[l] = 0;
-      if(l == 0)
-	continue;
-
-      const char *s2, *s3;
-      if((s2 = mystrbegins(s, "#EXT-X-STREAM-INF:")) != NULL) {
-	s3 = strstr(s2, "BANDWIDTH=");
-	if(s3 != NULL)
-	  bandwidth = atoi(s3 + strlen("BANDWIDTH="));
-      } else if(*s == '#') {
-	continue;
-      } else if(bandwidth != -1) {
-	char *playlist = url_resolve_relative_from_base(url, s);
-	vsource_insert(list, playlist, mimetype, bandwidth);
-	free(playlist);
-	bandwidth = -1;
-      }
-    }
-  } else {
-    TRACE(TRACE_INFO, "HLS", "%s is not an EXTM3U file", url);
-  }
-  free(buf);
+  return len >= 5 && !strncasecmp(url + len - 5, ".m3u8", 5);
 }
 
 
@@ -180,12 +144,19 @@ play_video(const char *url, struct media_pipe *mp,
   htsmsg_field_t *f;
   vsource_t *vs;
   struct vsource_list vsources;
+  const char *hls_url = NULL;
+  event_t *e;
 
   mp_reinit_streams(mp);
 
-  if(strncmp(url, "videoparams:", strlen("videoparams:"))) 
+  if(strncmp(url, "videoparams:", strlen("videoparams:"))) {
+    if(is_hls_url(url))
+      return hls_play(url, mp, flags | BACKEND_VIDEO_SET_TITLE, priority,
+		      errbuf, errlen, url);
+
     return backend_play_video(url, mp, flags | BACKEND_VIDEO_SET_TITLE,
 			      priority, errbuf, errlen, NULL, url);
+  }
 
   url += strlen("videoparams:");
   htsmsg_t *m = htsmsg_json_deserialize(url);
@@ -218,14 +189,15 @@ play_video(const char *url, struct media_pipe *mp,
     if(mimetype != NULL && 
        (!strcmp(mimetype, "application/vnd.apple.mpegurl") ||
 	!strcmp(mimetype, "audio/mpegurl"))) {
-      if(0)vsource_load_hls(&vsources, url, mimetype);
+      if(hls_url == NULL)
+	hls_url = url;
       continue;
     }
 
     vsource_insert(&vsources, url, mimetype, bitrate);
   }
 
-  if(LIST_FIRST(&vsources) == NULL) {
+  if(LIST_FIRST(&vsources) == NULL && hls_url == NULL) {
     snprintf(errbuf, errlen, "No players found for sources");
     vsource_cleanup(&vsources);
     return NULL;
@@ -267,16 +239,31 @@ play_video(const char *url, struct media_pipe *mp,
   }
 
 
-  vs = LIST_FIRST(&vsources);
-  
-  if(canonical_url == NULL)
-    canonical_url = vs->vs_url;
+  e = NULL;
 
-  event_t *e;
+  if(hls_url != NULL) {
+
+    // HLS does its own bitrate selection among the variants
+
+    e = hls_play(hls_url, mp, flags, priority, errbuf, errlen,
+		 canonical_url ?: hls_url);
 
-  e = backend_play_video(vs->vs_url, mp, flags, priority, 
-			 errbuf, errlen, vs->vs_mimetype,
-			 canonical_url);
+    if(e == NULL && LIST_FIRST(&vsources) != NULL) {
+      TRACE(TRACE_INFO, "Video", "HLS playback of %s failed -- %s, "
+	    "trying other sources", hls_url, errbuf);
+      mp_reinit_streams(mp);
+    }
+  }
+
+  if(e == NULL && (vs = LIST_FIRST(&vsources)) != NULL) {
+  
+    if(canonical_url == NULL)
+      canonical_url = vs->vs_url;
+
+    e = backend_play_video(vs->vs_url, mp, flags, priority, 
+			   errbuf, errlen, vs->vs_mimetype,
+			   canonical_url);
+  }
 
   vsource_cleanup(&vsources);
 
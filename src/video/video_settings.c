@@ -189,6 +189,12 @@ set_continuous_playback(void *opaque, int v)
   video_settings.continuous_playback = v;
 }
 
+static void
+set_seek_thumbnails(void *opaque, int v)
+{
+  video_settings.seek_thumbnails = v;
+}
+
 
 void
 video_settings_init(void)
@@ -291,6 +297,13 @@ video_settings_init(void)
 		       settings_generic_save_settings, 
 		       (void *)"videoplayback");
 
+  settings_create_bool(s, "seek_thumbnails",
+		       _p("Prepare seek bar thumbnails during playback"), 0,
+		       store, set_seek_thumbnails, NULL,
+		       SETTINGS_INITIAL_UPDATE, NULL,
+		       settings_generic_save_settings, 
+		       (void *)"videoplayback");
+
 
   //----------------------------------------------------------
 
@@ -35,6 +35,7 @@ struct video_settings {
   int vdpau_deinterlace_resolution_limit;
   int continuous_playback;
   int vda;
+  int seek_thumbnails;
 };
 
 extern struct video_settings video_settings;